@@ -0,0 +1,98 @@
+/*
+ * Cogl-GStreamer.
+ *
+ * GStreamer integration library for Cogl.
+ *
+ * cogl-gst-buffer-pool-private.h - Buffer pool that lets upstream
+ *                                  elements decode into Cogl pixel
+ *                                  buffers.
+ *
+ * Copyright (C) 2013 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __COGL_GST_BUFFER_POOL_PRIVATE_H__
+#define __COGL_GST_BUFFER_POOL_PRIVATE_H__
+
+#include <gst/gst.h>
+#include <gst/video/gstvideopool.h>
+#include <cogl/cogl.h>
+
+G_BEGIN_DECLS
+
+/* The buffer pool hands out buffers whose memory is a mapped
+ * CoglPixelBuffer so that upstream elements write the frames straight
+ * into memory that GL can upload from. Cogl can only be used from the
+ * thread that the sink dispatches frames on, so the pixel buffers are
+ * created and mapped there by _cogl_gst_buffer_pool_prepare(). The
+ * streaming thread only swaps them into the buffers that it acquires.
+ * Until a pixel buffer is available the pool falls back to plain
+ * system memory. */
+
+#define COGL_GST_TYPE_BUFFER_POOL _cogl_gst_buffer_pool_get_type()
+
+#define COGL_GST_BUFFER_POOL(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((obj), \
+  COGL_GST_TYPE_BUFFER_POOL, CoglGstBufferPool))
+
+#define COGL_GST_IS_BUFFER_POOL(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), \
+  COGL_GST_TYPE_BUFFER_POOL))
+
+typedef struct _CoglGstBufferPool CoglGstBufferPool;
+typedef struct _CoglGstBufferPoolClass CoglGstBufferPoolClass;
+
+GType
+_cogl_gst_buffer_pool_get_type (void) G_GNUC_CONST;
+
+GstBufferPool *
+_cogl_gst_buffer_pool_new (void);
+
+/* Creates and maps any pixel buffers that the pool is missing and
+ * frees the ones that are no longer used. This must be called from
+ * the thread that uses @ctx. Returns %FALSE once the pool is inactive
+ * and all of its pixel buffers have been freed */
+CoglBool
+_cogl_gst_buffer_pool_prepare (GstBufferPool *pool,
+                               CoglContext *ctx);
+
+/* Returns whether the memory of @buffer is a pixel buffer from a
+ * CoglGstBufferPool. This can be called from any thread */
+CoglBool
+_cogl_gst_buffer_pool_is_pixel_buffer (GstBuffer *buffer);
+
+/* If @buffer is backed by a pixel buffer from a CoglGstBufferPool and
+ * nothing else can see its memory then this unmaps the pixel buffer
+ * so that it can be used as the source of a texture upload and
+ * returns it. The address that the memory was mapped at is returned
+ * in @data_out so that plane offsets can be calculated from the frame
+ * layout. _cogl_gst_buffer_pool_end_upload() must be called once the
+ * uploads have been submitted. Otherwise this returns %NULL and the
+ * frame should be uploaded from the mapped buffer as usual. */
+CoglPixelBuffer *
+_cogl_gst_buffer_pool_begin_upload (GstBuffer *buffer,
+                                    const uint8_t **data_out);
+
+/* Maps the pixel buffer again so that @buffer can be reused by the
+ * pool. The old contents are discarded so this doesn't need to wait
+ * for the upload to finish */
+void
+_cogl_gst_buffer_pool_end_upload (GstBuffer *buffer);
+
+G_END_DECLS
+
+#endif /* __COGL_GST_BUFFER_POOL_PRIVATE_H__ */
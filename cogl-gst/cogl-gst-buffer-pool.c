@@ -0,0 +1,482 @@
+/*
+ * Cogl-GStreamer.
+ *
+ * GStreamer integration library for Cogl.
+ *
+ * cogl-gst-buffer-pool.c - Buffer pool that lets upstream elements
+ *                          decode into Cogl pixel buffers.
+ *
+ * Copyright (C) 2013 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "cogl-gst-buffer-pool-private.h"
+
+/* The number of pixel buffers that are created if the pool config
+ * doesn't ask for more */
+#define COGL_GST_BUFFER_POOL_MIN_PIXEL_BUFFERS 4
+
+/* A pixel buffer along with the address it is mapped at. The entry
+ * is shared by all of the GstMemory objects that wrap the mapping */
+typedef struct
+{
+  CoglGstBufferPool *pool;
+  CoglPixelBuffer *pixel_buffer;
+  uint8_t *data;
+  size_t size;
+  /* Whether the pixel buffer is currently mapped at data */
+  CoglBool mapped;
+  /* Number of GstMemory objects that wrap the entry */
+  int ref_count;
+} CoglGstPixelBufferEntry;
+
+struct _CoglGstBufferPool
+{
+  GstVideoBufferPool parent;
+
+  GMutex lock;
+  /* Mapped entries that aren't used by any buffer yet */
+  GQueue ready;
+  /* Entries that are no longer used and need to be freed from the
+   * Cogl thread */
+  GQueue dead;
+  /* The total number of entries that haven't been freed */
+  int n_entries;
+  /* The number of entries the pool tries to keep */
+  int n_wanted;
+  size_t size;
+  /* The main context of the thread that created the entries. This is
+   * where any entries that are left when the pool is finalized get
+   * freed */
+  GMainContext *main_context;
+};
+
+struct _CoglGstBufferPoolClass
+{
+  GstVideoBufferPoolClass parent_class;
+};
+
+G_DEFINE_TYPE (CoglGstBufferPool,
+               _cogl_gst_buffer_pool,
+               GST_TYPE_VIDEO_BUFFER_POOL);
+
+static GQuark
+get_entry_quark (void)
+{
+  static GQuark quark = 0;
+
+  if (G_UNLIKELY (quark == 0))
+    quark = g_quark_from_static_string ("cogl-gst-pixel-buffer-entry");
+
+  return quark;
+}
+
+static CoglGstPixelBufferEntry *
+get_memory_entry (GstMemory *memory)
+{
+  return gst_mini_object_get_qdata (GST_MINI_OBJECT_CAST (memory),
+                                    get_entry_quark ());
+}
+
+static void
+entry_free (CoglGstPixelBufferEntry *entry)
+{
+  if (entry->mapped)
+    cogl_buffer_unmap (COGL_BUFFER (entry->pixel_buffer));
+  cogl_object_unref (entry->pixel_buffer);
+  g_slice_free (CoglGstPixelBufferEntry, entry);
+}
+
+static void
+entry_memory_destroyed_cb (void *user_data)
+{
+  CoglGstPixelBufferEntry *entry = user_data;
+  CoglGstBufferPool *pool = entry->pool;
+
+  if (g_atomic_int_dec_and_test (&entry->ref_count))
+    {
+      /* This can be called from any thread so the entry can only be
+       * freed later */
+      g_mutex_lock (&pool->lock);
+      g_queue_push_tail (&pool->dead, entry);
+      g_mutex_unlock (&pool->lock);
+    }
+
+  gst_object_unref (pool);
+}
+
+static GstMemory *
+entry_wrap (CoglGstPixelBufferEntry *entry)
+{
+  GstMemory *memory;
+
+  g_atomic_int_inc (&entry->ref_count);
+  gst_object_ref (entry->pool);
+
+  memory = gst_memory_new_wrapped (0, /* flags */
+                                   entry->data,
+                                   entry->size,
+                                   0, /* offset */
+                                   entry->size,
+                                   entry,
+                                   entry_memory_destroyed_cb);
+  gst_mini_object_set_qdata (GST_MINI_OBJECT_CAST (memory),
+                             get_entry_quark (),
+                             entry,
+                             NULL);
+
+  return memory;
+}
+
+static void
+replace_buffer_memory (GstBuffer *buffer,
+                       GstMemory *memory)
+{
+  gst_buffer_replace_all_memory (buffer, memory);
+  /* The new memory has the same size and layout so there's no reason
+   * for the pool to throw the buffer away when it is released */
+  GST_BUFFER_FLAG_UNSET (buffer, GST_BUFFER_FLAG_TAG_MEMORY);
+}
+
+static void
+discard_ready_entries (CoglGstBufferPool *pool)
+{
+  CoglGstPixelBufferEntry *entry;
+
+  while ((entry = g_queue_pop_head (&pool->ready)))
+    g_queue_push_tail (&pool->dead, entry);
+}
+
+static gboolean
+_cogl_gst_buffer_pool_set_config (GstBufferPool *bpool,
+                                  GstStructure *config)
+{
+  CoglGstBufferPool *pool = COGL_GST_BUFFER_POOL (bpool);
+  GstBufferPoolClass *parent_class =
+    GST_BUFFER_POOL_CLASS (_cogl_gst_buffer_pool_parent_class);
+  GstCaps *caps;
+  unsigned int size, min_buffers, max_buffers;
+
+  if (!parent_class->set_config (bpool, config))
+    return FALSE;
+
+  /* The parent may have updated the size in the config, for example
+     to make room for the padding when VIDEO_ALIGNMENT is set, so the
+     params are only read once it has accepted it */
+  if (!gst_buffer_pool_config_get_params (config,
+                                          &caps,
+                                          &size,
+                                          &min_buffers,
+                                          &max_buffers))
+    return FALSE;
+
+  g_mutex_lock (&pool->lock);
+
+  if (pool->size != size)
+    discard_ready_entries (pool);
+
+  pool->size = size;
+  pool->n_wanted = MAX (min_buffers, COGL_GST_BUFFER_POOL_MIN_PIXEL_BUFFERS);
+  if (max_buffers > 0 && pool->n_wanted > max_buffers)
+    pool->n_wanted = max_buffers;
+
+  g_mutex_unlock (&pool->lock);
+
+  return TRUE;
+}
+
+static GstFlowReturn
+_cogl_gst_buffer_pool_acquire_buffer (GstBufferPool *bpool,
+                                      GstBuffer **buffer,
+                                      GstBufferPoolAcquireParams *params)
+{
+  CoglGstBufferPool *pool = COGL_GST_BUFFER_POOL (bpool);
+  GstBufferPoolClass *parent_class =
+    GST_BUFFER_POOL_CLASS (_cogl_gst_buffer_pool_parent_class);
+  CoglGstPixelBufferEntry *entry;
+  GstFlowReturn ret;
+
+  ret = parent_class->acquire_buffer (bpool, buffer, params);
+
+  if (ret != GST_FLOW_OK ||
+      gst_buffer_n_memory (*buffer) != 1 ||
+      get_memory_entry (gst_buffer_peek_memory (*buffer, 0)))
+    return ret;
+
+  /* The buffer is still using system memory so if a pixel buffer has
+   * become available since it was allocated then switch to that */
+  g_mutex_lock (&pool->lock);
+  entry = g_queue_pop_head (&pool->ready);
+  g_mutex_unlock (&pool->lock);
+
+  if (entry)
+    replace_buffer_memory (*buffer, entry_wrap (entry));
+
+  return GST_FLOW_OK;
+}
+
+static gboolean
+_cogl_gst_buffer_pool_stop (GstBufferPool *bpool)
+{
+  CoglGstBufferPool *pool = COGL_GST_BUFFER_POOL (bpool);
+  GstBufferPoolClass *parent_class =
+    GST_BUFFER_POOL_CLASS (_cogl_gst_buffer_pool_parent_class);
+
+  g_mutex_lock (&pool->lock);
+  discard_ready_entries (pool);
+  g_mutex_unlock (&pool->lock);
+
+  return parent_class->stop (bpool);
+}
+
+static gboolean
+free_entries_cb (void *user_data)
+{
+  GList *entries = user_data;
+
+  g_list_free_full (entries, (GDestroyNotify) entry_free);
+
+  return FALSE;
+}
+
+static void
+_cogl_gst_buffer_pool_finalize (GObject *object)
+{
+  CoglGstBufferPool *pool = COGL_GST_BUFFER_POOL (object);
+
+  /* Each entry holds a reference on the pool so only the ready and
+   * dead entries can be left. The sink keeps the pool until
+   * _cogl_gst_buffer_pool_prepare() has freed them so normally there
+   * won't be any. Otherwise the last reference may have been dropped
+   * from any thread and the pixel buffers can only be freed from the
+   * thread that created them, so they are handed over to its main
+   * context */
+  discard_ready_entries (pool);
+
+  if (pool->dead.head)
+    g_main_context_invoke (pool->main_context,
+                           free_entries_cb,
+                           pool->dead.head);
+
+  if (pool->main_context)
+    g_main_context_unref (pool->main_context);
+
+  g_mutex_clear (&pool->lock);
+
+  G_OBJECT_CLASS (_cogl_gst_buffer_pool_parent_class)->finalize (object);
+}
+
+static void
+_cogl_gst_buffer_pool_class_init (CoglGstBufferPoolClass *klass)
+{
+  GObjectClass *go_class = G_OBJECT_CLASS (klass);
+  GstBufferPoolClass *gbp_class = GST_BUFFER_POOL_CLASS (klass);
+
+  go_class->finalize = _cogl_gst_buffer_pool_finalize;
+
+  gbp_class->set_config = _cogl_gst_buffer_pool_set_config;
+  gbp_class->acquire_buffer = _cogl_gst_buffer_pool_acquire_buffer;
+  gbp_class->stop = _cogl_gst_buffer_pool_stop;
+}
+
+static void
+_cogl_gst_buffer_pool_init (CoglGstBufferPool *pool)
+{
+  g_mutex_init (&pool->lock);
+  g_queue_init (&pool->ready);
+  g_queue_init (&pool->dead);
+}
+
+GstBufferPool *
+_cogl_gst_buffer_pool_new (void)
+{
+  return g_object_new (COGL_GST_TYPE_BUFFER_POOL, NULL);
+}
+
+CoglBool
+_cogl_gst_buffer_pool_prepare (GstBufferPool *bpool,
+                               CoglContext *ctx)
+{
+  CoglGstBufferPool *pool = COGL_GST_BUFFER_POOL (bpool);
+  CoglGstPixelBufferEntry *entry;
+  GQueue dead;
+  GList *new_entries = NULL;
+  /* This can't be checked with our lock held because the pool calls
+   * set_config with its own lock held */
+  CoglBool active = gst_buffer_pool_is_active (bpool);
+  int n_missing;
+  size_t size;
+
+  g_mutex_lock (&pool->lock);
+
+  if (pool->main_context == NULL)
+    pool->main_context = g_main_context_ref_thread_default ();
+
+  dead = pool->dead;
+  g_queue_init (&pool->dead);
+  pool->n_entries -= dead.length;
+
+  if (active)
+    n_missing = pool->n_wanted - pool->n_entries;
+  else
+    n_missing = 0;
+  size = pool->size;
+
+  g_mutex_unlock (&pool->lock);
+
+  while ((entry = g_queue_pop_head (&dead)))
+    entry_free (entry);
+
+  for (; n_missing > 0; n_missing--)
+    {
+      entry = g_slice_new0 (CoglGstPixelBufferEntry);
+      entry->pool = pool;
+      entry->size = size;
+      entry->pixel_buffer = cogl_pixel_buffer_new (ctx, size, NULL);
+      cogl_buffer_set_update_hint (COGL_BUFFER (entry->pixel_buffer),
+                                   COGL_BUFFER_UPDATE_HINT_STREAM);
+      entry->data = cogl_buffer_map (COGL_BUFFER (entry->pixel_buffer),
+                                     COGL_BUFFER_ACCESS_WRITE,
+                                     COGL_BUFFER_MAP_HINT_DISCARD);
+
+      if (entry->data == NULL)
+        {
+          /* Carry on with system memory */
+          entry_free (entry);
+          break;
+        }
+
+      entry->mapped = TRUE;
+      new_entries = g_list_prepend (new_entries, entry);
+    }
+
+  if (new_entries)
+    {
+      GList *l;
+
+      g_mutex_lock (&pool->lock);
+
+      for (l = new_entries; l; l = l->next)
+        {
+          g_queue_push_tail (&pool->ready, l->data);
+          pool->n_entries++;
+        }
+
+      g_mutex_unlock (&pool->lock);
+
+      g_list_free (new_entries);
+    }
+
+  if (active)
+    return TRUE;
+  else
+    {
+      int n_entries;
+
+      g_mutex_lock (&pool->lock);
+      n_entries = pool->n_entries;
+      g_mutex_unlock (&pool->lock);
+
+      return n_entries > 0;
+    }
+}
+
+CoglBool
+_cogl_gst_buffer_pool_is_pixel_buffer (GstBuffer *buffer)
+{
+  return (gst_buffer_n_memory (buffer) == 1 &&
+          get_memory_entry (gst_buffer_peek_memory (buffer, 0)) != NULL);
+}
+
+static CoglGstPixelBufferEntry *
+get_exclusive_entry (GstBuffer *buffer)
+{
+  CoglGstPixelBufferEntry *entry;
+  GstMemory *memory;
+
+  if (gst_buffer_n_memory (buffer) != 1)
+    return NULL;
+
+  memory = gst_buffer_peek_memory (buffer, 0);
+  entry = get_memory_entry (memory);
+
+  /* If anything else has a reference to the buffer or the memory then
+   * it might still read from it */
+  if (entry == NULL ||
+      !gst_buffer_is_writable (buffer) ||
+      GST_MINI_OBJECT_REFCOUNT_VALUE (memory) != 1 ||
+      g_atomic_int_get (&entry->ref_count) != 1)
+    return NULL;
+
+  return entry;
+}
+
+CoglPixelBuffer *
+_cogl_gst_buffer_pool_begin_upload (GstBuffer *buffer,
+                                    const uint8_t **data_out)
+{
+  CoglGstPixelBufferEntry *entry = get_exclusive_entry (buffer);
+
+  if (entry == NULL || !entry->mapped)
+    return NULL;
+
+  cogl_buffer_unmap (COGL_BUFFER (entry->pixel_buffer));
+  entry->mapped = FALSE;
+
+  *data_out = entry->data;
+
+  return entry->pixel_buffer;
+}
+
+void
+_cogl_gst_buffer_pool_end_upload (GstBuffer *buffer)
+{
+  CoglGstPixelBufferEntry *entry = get_exclusive_entry (buffer);
+  uint8_t *data;
+
+  g_return_if_fail (entry != NULL && !entry->mapped);
+
+  /* Discarding the contents lets GL give us new storage instead of
+   * waiting for the upload from the old storage */
+  data = cogl_buffer_map (COGL_BUFFER (entry->pixel_buffer),
+                          COGL_BUFFER_ACCESS_WRITE,
+                          COGL_BUFFER_MAP_HINT_DISCARD);
+
+  if (data == NULL)
+    {
+      /* Give the buffer system memory instead. This will drop the
+       * last reference to the entry so it will be freed */
+      replace_buffer_memory (buffer,
+                             gst_allocator_alloc (NULL, entry->size, NULL));
+      return;
+    }
+
+  entry->mapped = TRUE;
+
+  if (data != entry->data)
+    {
+      /* The memory has to be replaced so that it points to the new
+       * mapping. The new memory holds a reference on the entry so it
+       * survives the old memory being destroyed */
+      entry->data = data;
+      replace_buffer_memory (buffer, entry_wrap (entry));
+    }
+}
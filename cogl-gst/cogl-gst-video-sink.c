@@ -43,12 +43,41 @@
 #include <string.h>
 
 #include "cogl-gst-video-sink.h"
+#include "cogl-gst-buffer-pool-private.h"
 
 #define COGL_GST_DEFAULT_PRIORITY G_PRIORITY_HIGH_IDLE
 
+/* The number of buffers that are queued when the frames are being
+ * scheduled against the onscreen's frame timing. Older buffers are
+ * dropped if the main thread falls further behind than this */
+#define COGL_GST_MAX_PENDING_FRAMES 3
+
+/* Used if the onscreen can report presentation times but not its
+ * refresh rate */
+#define COGL_GST_DEFAULT_REFRESH_RATE 60.0f
+
+/* The 10-bit formats aren't available in older versions of GStreamer */
+#if GST_CHECK_VERSION (1, 2, 0)
+#define COGL_GST_HAVE_I420_10LE
+#define I420_10LE_SINK_CAPS "I420_10LE,"
+#else
+#define I420_10LE_SINK_CAPS
+#endif
+
+#if GST_CHECK_VERSION (1, 10, 0)
+#define COGL_GST_HAVE_P010
+#define P010_SINK_CAPS "P010_10LE,"
+#else
+#define P010_SINK_CAPS
+#endif
+
 #define BASE_SINK_CAPS "{ AYUV," \
                        "YV12," \
                        "I420," \
+                       "NV12," \
+                       "NV21," \
+                       I420_10LE_SINK_CAPS \
+                       P010_SINK_CAPS \
                        "RGBA," \
                        "BGRA," \
                        "RGB," \
@@ -79,7 +108,8 @@ G_DEFINE_TYPE (CoglGstVideoSink, cogl_gst_video_sink, GST_TYPE_BASE_SINK);
 enum
 {
   PROP_0,
-  PROP_UPDATE_PRIORITY
+  PROP_UPDATE_PRIORITY,
+  PROP_THREADED_UPLOAD
 };
 
 enum
@@ -100,7 +130,11 @@ typedef enum
   COGL_GST_AYUV,
   COGL_GST_YV12,
   COGL_GST_SURFACE,
-  COGL_GST_I420
+  COGL_GST_I420,
+  COGL_GST_NV12,
+  COGL_GST_NV21,
+  COGL_GST_I420_10LE,
+  COGL_GST_P010
 } CoglGstVideoFormat;
 
 typedef enum
@@ -125,18 +159,55 @@ typedef struct
   GQueue entries;
 } SnippetCache;
 
+typedef struct
+{
+  GstBuffer *buffer;
+  /* The running time of the buffer and the time on the pipeline clock
+   * that it should be shown at. These are GST_CLOCK_TIME_NONE if the
+   * buffer doesn't have a timestamp */
+  GstClockTime running_time;
+  GstClockTime clock_time;
+} CoglGstPendingFrame;
+
 typedef struct _CoglGstSource
 {
   GSource source;
   CoglGstVideoSink *sink;
   GMutex buffer_lock;
-  GstBuffer *buffer;
+  /* Frames that haven't been uploaded yet, oldest first. Unless the
+   * frames are being scheduled only the latest one is kept */
+  GQueue pending_frames;
   CoglBool has_new_caps;
 } CoglGstSource;
 
+/* A frame that is being uploaded. If the buffer is backed by a pixel
+ * buffer from the sink's buffer pool then the planes are uploaded
+ * straight from that instead of from the mapped frame */
+typedef struct
+{
+  GstVideoFrame frame;
+  GstBuffer *buffer;
+  CoglPixelBuffer *pixel_buffer;
+  const uint8_t *pixel_buffer_data;
+} CoglGstFrame;
+
 typedef void (CoglGstRendererPaint) (CoglGstVideoSink *);
 typedef void (CoglGstRendererPostPaint) (CoglGstVideoSink *);
 
+/* Number of sets of textures that are kept for uploading frames */
+#define COGL_GST_TEXTURE_POOL_SIZE 2
+
+/* A set of plane textures that frames are uploaded into. The sink
+ * holds a reference while the set is in its texture pool or holds
+ * the current frame, and every pipeline that the frame has been
+ * attached to holds another one until it is destroyed. The textures
+ * are only overwritten when the pool's reference is the only one */
+typedef struct
+{
+  int ref_count;
+  CoglTexture *textures[3];
+} CoglGstTextureSet;
+
 typedef struct _CoglGstRenderer
 {
   const char *name;
@@ -155,29 +226,89 @@ struct _CoglGstVideoSinkPrivate
   CoglContext *ctx;
   CoglPipeline *pipeline;
   CoglTexture *frame[3];
+  /* The texture set that the textures in frame belong to */
+  CoglGstTextureSet *frame_set;
   CoglBool frame_dirty;
+  /* Sets of plane textures that are reused for each frame. They are
+   * used in rotation so that the textures for the frame that was last
+   * shown aren't overwritten immediately. A set that is still
+   * attached to a pipeline, possibly one that the application took
+   * for an older frame, is replaced with a new one instead of being
+   * reused so that the pipeline keeps showing that frame */
+  CoglGstTextureSet *texture_pool[COGL_GST_TEXTURE_POOL_SIZE];
+  int next_pool_slot;
   CoglGstVideoFormat format;
   CoglBool bgr;
   CoglGstSource *source;
   GSList *renderers;
   GstCaps *caps;
+  /* The buffer pools that have been offered upstream, most recent
+   * first. Older pools are kept until all of their pixel buffers have
+   * been freed from the main thread. This is protected by the object
+   * lock */
+  GList *buffer_pools;
+  /* Pools that frames are copied into from the streaming thread when
+   * threaded_upload is set. These are handled in the same way as the
+   * buffer pools above */
+  GList *staging_pools;
+  /* Pools that were in use when the sink was stopped. These are kept
+   * until all of their pixel buffers have been freed so that the last
+   * reference isn't dropped from another thread while it still has
+   * some */
+  GList *retired_pools;
+  /* Whether the context can map pixel buffers for writing. This is
+   * checked when the context is set so that the streaming thread
+   * doesn't have to use Cogl to find out */
+  CoglBool can_map_pixel_buffers;
+  CoglBool threaded_upload;
+  /* The negotiated caps. These are only used from the streaming
+   * thread */
+  GstCaps *staging_caps;
+  GstVideoInfo staging_info;
   CoglGstRenderer *renderer;
   GstFlowReturn flow_return;
   int custom_start;
   int free_layer;
   CoglBool default_sample;
   GstVideoInfo info;
+  /* The onscreen whose frame timing is used to schedule the frames */
+  CoglOnscreen *onscreen;
+  CoglFrameClosure *frame_closure;
+  /* The presentation time of the last frame shown on the onscreen and
+   * the time between refreshes, in nanoseconds on Cogl's clock */
+  int64_t last_presentation_time;
+  int64_t refresh_interval;
+  /* Set once the presentation times are known. This is read from the
+   * streaming thread */
+  CoglBool has_frame_timing;
+  /* Running average of the number of frames that were ready for each
+   * frame that was shown. This is reported upstream in QoS events */
+  double qos_proportion;
 };
 
+static void
+pending_frame_free (CoglGstPendingFrame *frame)
+{
+  gst_buffer_unref (frame->buffer);
+  g_slice_free (CoglGstPendingFrame, frame);
+}
+
+static void
+clear_pending_frames (CoglGstSource *gst_source)
+{
+  CoglGstPendingFrame *frame;
+
+  while ((frame = g_queue_pop_head (&gst_source->pending_frames)))
+    pending_frame_free (frame);
+}
+
 static void
 cogl_gst_source_finalize (GSource *source)
 {
   CoglGstSource *gst_source = (CoglGstSource *) source;
 
   g_mutex_lock (&gst_source->buffer_lock);
-  if (gst_source->buffer)
-    gst_buffer_unref (gst_source->buffer);
-  gst_source->buffer = NULL;
+  clear_pending_frames (gst_source);
   g_mutex_unlock (&gst_source->buffer_lock);
   g_mutex_clear (&gst_source->buffer_lock);
 }
@@ -188,6 +319,41 @@ cogl_gst_video_sink_get_free_layer (CoglGstVideoSink *sink)
   return sink->priv->free_layer;
 }
 
+static CoglUserDataKey texture_set_key;
+
+static CoglGstTextureSet *
+texture_set_new (void)
+{
+  CoglGstTextureSet *set = g_slice_new0 (CoglGstTextureSet);
+
+  set->ref_count = 1;
+
+  return set;
+}
+
+static CoglGstTextureSet *
+texture_set_ref (CoglGstTextureSet *set)
+{
+  set->ref_count++;
+
+  return set;
+}
+
+static void
+texture_set_unref (CoglGstTextureSet *set)
+{
+  int i;
+
+  if (--set->ref_count > 0)
+    return;
+
+  for (i = 0; i < G_N_ELEMENTS (set->textures); i++)
+    if (set->textures[i])
+      cogl_object_unref (set->textures[i]);
+
+  g_slice_free (CoglGstTextureSet, set);
+}
+
 void
 cogl_gst_video_sink_attach_frame (CoglGstVideoSink *sink,
                                   CoglPipeline *pln)
@@ -199,6 +365,121 @@ cogl_gst_video_sink_attach_frame (CoglGstVideoSink *sink,
     if (priv->frame[i] != NULL)
       cogl_pipeline_set_layer_texture (pln, i + priv->custom_start,
                                        COGL_TEXTURE (priv->frame[i]));
+
+  /* Keep the frame's textures from being reused for as long as the
+   * pipeline is alive. This replaces the set from any frame that was
+   * previously attached to the same pipeline */
+  if (priv->frame_set)
+    cogl_object_set_user_data (COGL_OBJECT (pln),
+                               &texture_set_key,
+                               texture_set_ref (priv->frame_set),
+                               (CoglUserDataDestroyCallback)
+                               texture_set_unref);
+}
+
+/* Gets the current time on Cogl's clock along with the offset that
+ * converts times on the pipeline clock to Cogl's clock. Returns FALSE
+ * if either clock isn't available */
+static CoglBool
+get_clock_offset (CoglGstVideoSink *sink,
+                  int64_t *now_out,
+                  int64_t *offset_out)
+{
+  CoglGstVideoSinkPrivate *priv = sink->priv;
+  GstClock *clock;
+  int64_t now;
+
+  if (priv->ctx == NULL || !g_atomic_int_get (&priv->has_frame_timing))
+    return FALSE;
+
+  clock = gst_element_get_clock (GST_ELEMENT (sink));
+
+  if (clock == NULL)
+    return FALSE;
+
+  now = cogl_get_clock_time (priv->ctx);
+
+  if (now)
+    {
+      *now_out = now;
+      *offset_out = now - (int64_t) gst_clock_get_time (clock);
+    }
+
+  gst_object_unref (clock);
+
+  return now != 0;
+}
+
+/* Predicts when the first refresh after @now will be presented */
+static int64_t
+predict_presentation_time (CoglGstVideoSink *sink,
+                           int64_t now)
+{
+  CoglGstVideoSinkPrivate *priv = sink->priv;
+  int64_t n_refreshes =
+    MAX (now - priv->last_presentation_time, 0) / priv->refresh_interval + 1;
+
+  return priv->last_presentation_time + n_refreshes * priv->refresh_interval;
+}
+
+/* Returns the time on Cogl's clock after which a frame that should be
+ * shown at @target_time should be uploaded. This is the refresh
+ * before the one that is closest to the target time so that the
+ * application has time to paint the frame */
+static int64_t
+get_frame_ready_time (CoglGstVideoSink *sink,
+                      int64_t target_time)
+{
+  CoglGstVideoSinkPrivate *priv = sink->priv;
+  int64_t earliest_time = target_time - priv->refresh_interval / 2;
+  int64_t n_refreshes;
+
+  if (earliest_time <= priv->last_presentation_time)
+    return G_MININT64;
+
+  n_refreshes = ((earliest_time - priv->last_presentation_time +
+                  priv->refresh_interval - 1) /
+                 priv->refresh_interval);
+
+  return (priv->last_presentation_time +
+          (n_refreshes - 1) * priv->refresh_interval);
+}
+
+/* Returns whether the oldest pending frame should be uploaded now.
+ * Otherwise if @timeout is not NULL then it is set to the number of
+ * milliseconds until it should be */
+static CoglBool
+cogl_gst_source_is_ready (CoglGstSource *gst_source,
+                          int *timeout)
+{
+  CoglGstVideoSink *sink = gst_source->sink;
+  CoglGstPendingFrame *frame;
+  int64_t now, offset, ready_time;
+  CoglBool have_timing;
+  CoglBool ready;
+
+  have_timing = get_clock_offset (sink, &now, &offset);
+
+  g_mutex_lock (&gst_source->buffer_lock);
+
+  frame = g_queue_peek_head (&gst_source->pending_frames);
+
+  if (frame == NULL)
+    ready = FALSE;
+  else if (!have_timing || !GST_CLOCK_TIME_IS_VALID (frame->clock_time))
+    ready = TRUE;
+  else
+    {
+      ready_time = get_frame_ready_time (sink, frame->clock_time + offset);
+      ready = ready_time <= now;
+
+      if (!ready && timeout)
+        *timeout = (ready_time - now + 999999) / 1000000;
+    }
+
+  g_mutex_unlock (&gst_source->buffer_lock);
+
+  return ready;
 }
 
 static CoglBool
@@ -209,7 +490,7 @@ cogl_gst_source_prepare (GSource *source,
 
   *timeout = -1;
 
-  return gst_source->buffer != NULL;
+  return cogl_gst_source_is_ready (gst_source, timeout);
 }
 
 static CoglBool
@@ -217,7 +498,88 @@ cogl_gst_source_check (GSource *source)
 {
   CoglGstSource *gst_source = (CoglGstSource *) source;
 
-  return gst_source->buffer != NULL;
+  return cogl_gst_source_is_ready (gst_source, NULL);
+}
+
+/* Takes the frame that should be shown at the next refresh out of the
+ * queue. Any older frames that are also ready would be replaced
+ * before they could be seen so they are dropped without being
+ * uploaded. The lateness of the last dropped frame is returned so
+ * that it can be reported upstream. This must be called with the
+ * buffer lock held */
+static CoglGstPendingFrame *
+take_next_frame (CoglGstSource *gst_source,
+                 CoglBool have_timing,
+                 int64_t now,
+                 int64_t offset,
+                 int *n_dropped_out,
+                 GstClockTime *late_running_time_out,
+                 GstClockTimeDiff *late_jitter_out)
+{
+  CoglGstVideoSink *sink = gst_source->sink;
+  CoglGstPendingFrame *frame, *next_frame = NULL;
+  int64_t presentation_time = 0;
+  int n_dropped = 0;
+
+  if (have_timing)
+    presentation_time = predict_presentation_time (sink, now);
+
+  while ((frame = g_queue_peek_head (&gst_source->pending_frames)))
+    {
+      if (have_timing &&
+          GST_CLOCK_TIME_IS_VALID (frame->clock_time) &&
+          get_frame_ready_time (sink, frame->clock_time + offset) > now)
+        break;
+
+      g_queue_pop_head (&gst_source->pending_frames);
+
+      if (next_frame)
+        {
+          if (have_timing &&
+              GST_CLOCK_TIME_IS_VALID (next_frame->clock_time))
+            {
+              *late_running_time_out = next_frame->running_time;
+              *late_jitter_out = (presentation_time -
+                                  (int64_t) next_frame->clock_time - offset);
+            }
+
+          pending_frame_free (next_frame);
+          n_dropped++;
+        }
+
+      next_frame = frame;
+    }
+
+  *n_dropped_out = n_dropped;
+
+  return next_frame;
+}
+
+/* Tells upstream elements that frames are being dropped so that
+ * decoders can skip decoding frames that would be late anyway */
+static void
+send_qos_event (CoglGstVideoSink *sink,
+                int n_dropped,
+                GstClockTime late_running_time,
+                GstClockTimeDiff late_jitter)
+{
+  CoglGstVideoSinkPrivate *priv = sink->priv;
+
+  priv->qos_proportion = (priv->qos_proportion * 7.0 + n_dropped + 1) / 8.0;
+
+  if (n_dropped > 0 &&
+      GST_CLOCK_TIME_IS_VALID (late_running_time) &&
+      gst_base_sink_is_qos_enabled (GST_BASE_SINK (sink)))
+    {
+      GstEvent *event = gst_event_new_qos (GST_QOS_TYPE_UNDERFLOW,
+                                           priv->qos_proportion,
+                                           late_jitter,
+                                           late_running_time);
+
+      GST_DEBUG_OBJECT (sink, "Dropped %i late frames", n_dropped);
+
+      gst_pad_push_event (GST_BASE_SINK_PAD (sink), event);
+    }
 }
 
 static void
@@ -381,8 +743,18 @@ cogl_gst_video_sink_get_pipeline (CoglGstVideoSink *vt)
 
   if (priv->pipeline == NULL)
     {
-      priv->pipeline = cogl_pipeline_new (priv->ctx);
-      cogl_gst_video_sink_setup_pipeline (vt, priv->pipeline);
+      CoglPipeline *template = cogl_pipeline_new (priv->ctx);
+
+      /* The frame is attached to a copy of the set up pipeline so
+       * that the pipelines for later frames are derived from a parent
+       * that doesn't refer to any frame's textures. Otherwise the
+       * first pipeline would be kept alive as the parent of all of
+       * the others and the textures of the first frame would never
+       * get reused */
+      cogl_gst_video_sink_setup_pipeline (vt, template);
+      priv->pipeline = cogl_pipeline_copy (template);
+      cogl_object_unref (template);
+
       cogl_gst_video_sink_attach_frame (vt, priv->pipeline);
       priv->frame_dirty = FALSE;
     }
@@ -415,6 +787,12 @@ clear_frame_textures (CoglGstVideoSink *sink)
 
   memset (priv->frame, 0, sizeof (priv->frame));
 
+  if (priv->frame_set)
+    {
+      texture_set_unref (priv->frame_set);
+      priv->frame_set = NULL;
+    }
+
   priv->frame_dirty = TRUE;
 }
 
@@ -463,25 +841,14 @@ is_pot (unsigned int number)
  * Auto-mipmapping of any uploaded texture is disabled
  */
 static CoglTexture *
-video_texture_new_from_data (CoglContext *ctx,
-                             int width,
-                             int height,
-                             CoglPixelFormat format,
-                             CoglPixelFormat internal_format,
-                             int rowstride,
-                             const uint8_t *data,
-                             CoglError **error)
+video_texture_new_from_bitmap (CoglContext *ctx,
+                               CoglBitmap *bitmap,
+                               CoglPixelFormat internal_format,
+                               CoglError **error)
 {
-  CoglBitmap *bitmap;
   CoglTexture *tex;
   CoglError *internal_error = NULL;
 
-  bitmap = cogl_bitmap_new_for_data (ctx,
-                                     width, height,
-                                     format,
-                                     rowstride,
-                                     (uint8_t *) data);
-
   if ((is_pot (cogl_bitmap_get_width (bitmap)) &&
        is_pot (cogl_bitmap_get_height (bitmap))) ||
       cogl_has_feature (ctx, COGL_FEATURE_ID_TEXTURE_NPOT_BASIC))
@@ -509,36 +876,190 @@ video_texture_new_from_data (CoglContext *ctx,
       tex = COGL_TEXTURE (tex_2ds);
     }
 
-  cogl_object_unref (bitmap);
-
   return tex;
 }
 
+static void
+clear_texture_pool (CoglGstVideoSink *sink)
+{
+  CoglGstVideoSinkPrivate *priv = sink->priv;
+  int slot;
+
+  for (slot = 0; slot < COGL_GST_TEXTURE_POOL_SIZE; slot++)
+    if (priv->texture_pool[slot])
+      texture_set_unref (priv->texture_pool[slot]);
+
+  memset (priv->texture_pool, 0, sizeof (priv->texture_pool));
+  priv->next_pool_slot = 0;
+}
+
+/* Drops the textures for the previous frame and picks the next set
+ * of textures from the pool to upload the new frame into. If the set
+ * is still attached to a pipeline then it is left to that pipeline
+ * and a new set is started in its place */
+static CoglTexture **
+begin_frame_upload (CoglGstVideoSink *sink)
+{
+  CoglGstVideoSinkPrivate *priv = sink->priv;
+  int slot = priv->next_pool_slot;
+  CoglGstTextureSet *set;
+
+  clear_frame_textures (sink);
+
+  priv->next_pool_slot = (slot + 1) % COGL_GST_TEXTURE_POOL_SIZE;
+
+  set = priv->texture_pool[slot];
+
+  if (set == NULL || set->ref_count > 1)
+    {
+      if (set)
+        texture_set_unref (set);
+
+      set = texture_set_new ();
+      priv->texture_pool[slot] = set;
+    }
+
+  priv->frame_set = texture_set_ref (set);
+
+  return set->textures;
+}
+
+static CoglBool
+map_frame (CoglGstVideoSink *sink,
+           GstBuffer *buffer,
+           CoglGstFrame *frame)
+{
+  CoglGstVideoSinkPrivate *priv = sink->priv;
+
+  frame->buffer = buffer;
+
+  /* This has to be checked before the frame is mapped because
+   * mapping it takes another reference on the buffer */
+  frame->pixel_buffer =
+    _cogl_gst_buffer_pool_begin_upload (buffer, &frame->pixel_buffer_data);
+
+  if (!gst_video_frame_map (&frame->frame, &priv->info, buffer, GST_MAP_READ))
+    {
+      if (frame->pixel_buffer)
+        _cogl_gst_buffer_pool_end_upload (buffer);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+unmap_frame (CoglGstFrame *frame)
+{
+  gst_video_frame_unmap (&frame->frame);
+
+  if (frame->pixel_buffer)
+    _cogl_gst_buffer_pool_end_upload (frame->buffer);
+}
+
+/* Uploads a plane of the frame into the texture from the pool,
+ * creating it if this is the first frame since the caps changed or
+ * if the set of textures was just started */
+static void
+upload_frame_plane (CoglGstVideoSink *sink,
+                    CoglTexture **pool,
+                    CoglGstFrame *frame,
+                    int plane,
+                    int width,
+                    int height,
+                    CoglPixelFormat format)
+{
+  CoglGstVideoSinkPrivate *priv = sink->priv;
+  CoglTexture *tex = pool[plane];
+  const uint8_t *data = GST_VIDEO_FRAME_PLANE_DATA (&frame->frame, plane);
+  int rowstride = GST_VIDEO_FRAME_PLANE_STRIDE (&frame->frame, plane);
+  CoglBitmap *bitmap;
+
+  /* If the frame is in a pixel buffer then the data pointer is only
+   * used to find the offset of the plane within it */
+  if (frame->pixel_buffer)
+    bitmap = cogl_bitmap_new_from_buffer (COGL_BUFFER (frame->pixel_buffer),
+                                          format,
+                                          width, height,
+                                          rowstride,
+                                          data - frame->pixel_buffer_data);
+  else
+    bitmap = NULL;
+
+  if (tex &&
+      (cogl_texture_get_width (tex) != width ||
+       cogl_texture_get_height (tex) != height))
+    {
+      cogl_object_unref (tex);
+      tex = NULL;
+    }
+  else if (tex)
+    {
+      CoglBool updated;
+
+      if (bitmap)
+        updated = cogl_texture_set_region_from_bitmap (tex,
+                                                       0, 0, /* src_x/y */
+                                                       0, 0, /* dst_x/y */
+                                                       width, height,
+                                                       bitmap);
+      else
+        updated = cogl_texture_set_region (tex,
+                                           0, 0, /* src_x/y */
+                                           0, 0, /* dst_x/y */
+                                           width, height,
+                                           width, height,
+                                           format,
+                                           rowstride,
+                                           data);
+
+      if (!updated)
+        {
+          cogl_object_unref (tex);
+          tex = NULL;
+        }
+    }
+
+  if (tex == NULL)
+    {
+      if (bitmap == NULL)
+        bitmap = cogl_bitmap_new_for_data (priv->ctx,
+                                           width, height,
+                                           format,
+                                           rowstride,
+                                           (uint8_t *) data);
+
+      tex = video_texture_new_from_bitmap (priv->ctx, bitmap, format, NULL);
+    }
+
+  if (bitmap)
+    cogl_object_unref (bitmap);
+
+  pool[plane] = tex;
+  priv->frame[plane] = tex ? cogl_object_ref (tex) : NULL;
+}
+
 static CoglBool
 cogl_gst_rgb24_upload (CoglGstVideoSink *sink,
                        GstBuffer *buffer)
 {
   CoglGstVideoSinkPrivate *priv = sink->priv;
   CoglPixelFormat format;
-  GstVideoFrame frame;
+  CoglGstFrame frame;
 
   if (priv->bgr)
     format = COGL_PIXEL_FORMAT_BGR_888;
   else
     format = COGL_PIXEL_FORMAT_RGB_888;
 
-  if (!gst_video_frame_map (&frame, &priv->info, buffer, GST_MAP_READ))
+  if (!map_frame (sink, buffer, &frame))
     goto map_fail;
 
-  clear_frame_textures (sink);
-
-  priv->frame[0] = video_texture_new_from_data (priv->ctx, priv->info.width,
-                                                priv->info.height,
-                                                format, format,
-                                                priv->info.stride[0],
-                                                frame.data[0], NULL);
+  upload_frame_plane (sink, begin_frame_upload (sink), &frame, 0,
+                      priv->info.width, priv->info.height,
+                      format);
 
-  gst_video_frame_unmap (&frame);
+  unmap_frame (&frame);
 
   return TRUE;
 
@@ -566,25 +1087,21 @@ cogl_gst_rgb32_upload (CoglGstVideoSink *sink,
 {
   CoglGstVideoSinkPrivate *priv = sink->priv;
   CoglPixelFormat format;
-  GstVideoFrame frame;
+  CoglGstFrame frame;
 
   if (priv->bgr)
     format = COGL_PIXEL_FORMAT_BGRA_8888;
   else
     format = COGL_PIXEL_FORMAT_RGBA_8888;
 
-  if (!gst_video_frame_map (&frame, &priv->info, buffer, GST_MAP_READ))
+  if (!map_frame (sink, buffer, &frame))
     goto map_fail;
 
-  clear_frame_textures (sink);
-
-  priv->frame[0] = video_texture_new_from_data (priv->ctx, priv->info.width,
-                                                priv->info.height,
-                                                format, format,
-                                                priv->info.stride[0],
-                                                frame.data[0], NULL);
+  upload_frame_plane (sink, begin_frame_upload (sink), &frame, 0,
+                      priv->info.width, priv->info.height,
+                      format);
 
-  gst_video_frame_unmap (&frame);
+  unmap_frame (&frame);
 
   return TRUE;
 
@@ -611,36 +1128,23 @@ cogl_gst_yv12_upload (CoglGstVideoSink *sink,
                       GstBuffer *buffer)
 {
   CoglGstVideoSinkPrivate *priv = sink->priv;
-  GstVideoFrame frame;
+  CoglGstFrame frame;
   CoglPixelFormat format = COGL_PIXEL_FORMAT_A_8;
+  CoglTexture **pool;
+  int i;
 
-  if (!gst_video_frame_map (&frame, &priv->info, buffer, GST_MAP_READ))
+  if (!map_frame (sink, buffer, &frame))
     goto map_fail;
 
-  clear_frame_textures (sink);
+  pool = begin_frame_upload (sink);
+
+  for (i = 0; i < 3; i++)
+    upload_frame_plane (sink, pool, &frame, i,
+                        GST_VIDEO_INFO_COMP_WIDTH (&priv->info, i),
+                        GST_VIDEO_INFO_COMP_HEIGHT (&priv->info, i),
+                        format);
 
-  priv->frame[0] =
-    video_texture_new_from_data (priv->ctx,
-                                 GST_VIDEO_INFO_COMP_WIDTH (&priv->info, 0),
-                                 GST_VIDEO_INFO_COMP_HEIGHT (&priv->info, 0),
-                                 format, format,
-                                 priv->info.stride[0], frame.data[0], NULL);
-
-  priv->frame[1] =
-    video_texture_new_from_data (priv->ctx,
-                                 GST_VIDEO_INFO_COMP_WIDTH (&priv->info, 1),
-                                 GST_VIDEO_INFO_COMP_HEIGHT (&priv->info, 1),
-                                 format, format,
-                                 priv->info.stride[1], frame.data[1], NULL);
-
-  priv->frame[2] =
-    video_texture_new_from_data (priv->ctx,
-                                 GST_VIDEO_INFO_COMP_WIDTH (&priv->info, 2),
-                                 GST_VIDEO_INFO_COMP_HEIGHT (&priv->info, 2),
-                                 format, format,
-                                 priv->info.stride[2], frame.data[2], NULL);
-
-  gst_video_frame_unmap (&frame);
+  unmap_frame (&frame);
 
   return TRUE;
 
@@ -757,20 +1261,16 @@ cogl_gst_ayuv_upload (CoglGstVideoSink *sink,
 {
   CoglGstVideoSinkPrivate *priv = sink->priv;
   CoglPixelFormat format = COGL_PIXEL_FORMAT_RGBA_8888;
-  GstVideoFrame frame;
+  CoglGstFrame frame;
 
-  if (!gst_video_frame_map (&frame, &priv->info, buffer, GST_MAP_READ))
+  if (!map_frame (sink, buffer, &frame))
     goto map_fail;
 
-  clear_frame_textures (sink);
-
-  priv->frame[0] = video_texture_new_from_data (priv->ctx, priv->info.width,
-                                                priv->info.height,
-                                                format, format,
-                                                priv->info.stride[0],
-                                                frame.data[0], NULL);
+  upload_frame_plane (sink, begin_frame_upload (sink), &frame, 0,
+                      priv->info.width, priv->info.height,
+                      format);
 
-  gst_video_frame_unmap (&frame);
+  unmap_frame (&frame);
 
   return TRUE;
 
@@ -792,67 +1292,381 @@ static CoglGstRenderer ayuv_glsl_renderer =
   cogl_gst_ayuv_upload,
 };
 
-static GSList*
-cogl_gst_build_renderers_list (CoglContext *ctx)
+static CoglBool
+upload_planes (CoglGstVideoSink *sink,
+               GstBuffer *buffer,
+               int n_planes,
+               const CoglPixelFormat *formats)
 {
-  GSList *list = NULL;
-  CoglBool has_glsl;
+  CoglGstVideoSinkPrivate *priv = sink->priv;
+  CoglGstFrame frame;
+  CoglTexture **pool;
   int i;
-  static CoglGstRenderer *const renderers[] =
-  {
-    &rgb24_renderer,
-    &rgb32_renderer,
-    &yv12_glsl_renderer,
-    &i420_glsl_renderer,
-    &ayuv_glsl_renderer,
-    NULL
-  };
 
-  has_glsl = cogl_has_feature (ctx, COGL_FEATURE_ID_GLSL);
+  if (!map_frame (sink, buffer, &frame))
+    goto map_fail;
 
-  for (i = 0; renderers[i]; i++)
-    if (has_glsl || !(renderers[i]->flags & COGL_GST_RENDERER_NEEDS_GLSL))
-      list = g_slist_prepend (list, renderers[i]);
+  pool = begin_frame_upload (sink);
 
-  return list;
-}
+  for (i = 0; i < n_planes; i++)
+    upload_frame_plane (sink, pool, &frame, i,
+                        GST_VIDEO_INFO_COMP_WIDTH (&priv->info, i),
+                        GST_VIDEO_INFO_COMP_HEIGHT (&priv->info, i),
+                        formats[i]);
 
-static void
-append_cap (gpointer data,
-            gpointer user_data)
-{
-  CoglGstRenderer *renderer = (CoglGstRenderer *) data;
-  GstCaps *caps = (GstCaps *) user_data;
-  GstCaps *writable_caps;
-  writable_caps =
-    gst_caps_make_writable (gst_static_caps_get (&renderer->caps));
-  gst_caps_append (caps, writable_caps);
-}
+  unmap_frame (&frame);
 
-static GstCaps *
-cogl_gst_build_caps (GSList *renderers)
-{
-  GstCaps *caps;
+  return TRUE;
 
-  caps = gst_caps_new_empty ();
+map_fail:
+  {
+    GST_ERROR_OBJECT (sink, "Could not map incoming video frame");
+    return FALSE;
+  }
+}
 
-  g_slist_foreach (renderers, append_cap, caps);
+/* The 10-bit formats are uploaded with the two bytes of each sample
+ * in separate components. Interpolating them separately would give
+ * garbage so the layers have to be sampled without filtering */
+static void
+set_nearest_filters (CoglGstVideoSink *sink,
+                     CoglPipeline *pipeline,
+                     int n_layers)
+{
+  CoglGstVideoSinkPrivate *priv = sink->priv;
+  int i;
 
-  return caps;
+  for (i = 0; i < n_layers; i++)
+    cogl_pipeline_set_layer_filters (pipeline,
+                                     priv->custom_start + i,
+                                     COGL_PIPELINE_FILTER_NEAREST,
+                                     COGL_PIPELINE_FILTER_NEAREST);
 }
 
-void
-cogl_gst_video_sink_set_context (CoglGstVideoSink *vt,
-                                 CoglContext *ctx)
+/* NV12 and NV21 have a full size luma plane followed by a plane with
+ * the two chroma components interleaved. The second plane is uploaded
+ * to a red-green texture so that both components can be sampled at
+ * once. The two formats only differ in the order of the components */
+static void
+setup_semi_planar_pipeline (CoglGstVideoSink *sink,
+                            CoglPipeline *pipeline,
+                            SnippetCache *snippet_cache,
+                            const char *chroma_swizzle)
 {
-  CoglGstVideoSinkPrivate *priv = vt->priv;
+  CoglGstVideoSinkPrivate *priv = sink->priv;
+  SnippetCacheEntry *entry;
 
-  if (ctx)
-    ctx = cogl_object_ref (ctx);
+  entry = get_cache_entry (sink, snippet_cache);
 
-  if (priv->ctx)
+  if (entry == NULL)
     {
-      cogl_object_unref (priv->ctx);
+      char *source;
+
+      source =
+        g_strdup_printf ("vec4\n"
+                         "cogl_gst_sample_video%i (vec2 UV)\n"
+                         "{\n"
+                         "  float y = 1.1640625 * "
+                         "(texture2D (cogl_sampler%i, UV).a - 0.0625);\n"
+                         "  vec2 uv = texture2D (cogl_sampler%i, UV).%s;\n"
+                         "  float u = uv.x - 0.5;\n"
+                         "  float v = uv.y - 0.5;\n"
+                         "  vec4 color;\n"
+                         "  color.r = y + 1.59765625 * v;\n"
+                         "  color.g = y - 0.390625 * u - 0.8125 * v;\n"
+                         "  color.b = y + 2.015625 * u;\n"
+                         "  color.a = 1.0;\n"
+                         "  return color;\n"
+                         "}\n",
+                         priv->custom_start,
+                         priv->custom_start,
+                         priv->custom_start + 1,
+                         chroma_swizzle);
+
+      entry = add_cache_entry (sink, snippet_cache, source);
+      g_free (source);
+    }
+
+  setup_pipeline_from_cache_entry (sink, pipeline, entry, 2);
+}
+
+static void
+cogl_gst_nv12_glsl_setup_pipeline (CoglGstVideoSink *sink,
+                                   CoglPipeline *pipeline)
+{
+  static SnippetCache snippet_cache;
+
+  setup_semi_planar_pipeline (sink, pipeline, &snippet_cache, "rg");
+}
+
+static void
+cogl_gst_nv21_glsl_setup_pipeline (CoglGstVideoSink *sink,
+                                   CoglPipeline *pipeline)
+{
+  static SnippetCache snippet_cache;
+
+  setup_semi_planar_pipeline (sink, pipeline, &snippet_cache, "gr");
+}
+
+static CoglBool
+cogl_gst_nv12_upload (CoglGstVideoSink *sink,
+                      GstBuffer *buffer)
+{
+  static const CoglPixelFormat formats[] =
+    {
+      COGL_PIXEL_FORMAT_A_8,
+      COGL_PIXEL_FORMAT_RG_88
+    };
+
+  return upload_planes (sink, buffer, G_N_ELEMENTS (formats), formats);
+}
+
+static CoglGstRenderer nv12_glsl_renderer =
+{
+  "NV12 glsl",
+  COGL_GST_NV12,
+  COGL_GST_RENDERER_NEEDS_GLSL,
+  GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("NV12")),
+  2, /* n_layers */
+  cogl_gst_nv12_glsl_setup_pipeline,
+  cogl_gst_nv12_upload,
+};
+
+static CoglGstRenderer nv21_glsl_renderer =
+{
+  "NV21 glsl",
+  COGL_GST_NV21,
+  COGL_GST_RENDERER_NEEDS_GLSL,
+  GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("NV21")),
+  2, /* n_layers */
+  cogl_gst_nv21_glsl_setup_pipeline,
+  cogl_gst_nv12_upload,
+};
+
+#ifdef COGL_GST_HAVE_I420_10LE
+
+/* Each plane has little-endian 16-bit samples with the value in the
+ * low 10 bits. The planes are uploaded to red-green textures so the
+ * low byte ends up in the red component and the high byte in green */
+static void
+cogl_gst_i420_10le_glsl_setup_pipeline (CoglGstVideoSink *sink,
+                                        CoglPipeline *pipeline)
+{
+  CoglGstVideoSinkPrivate *priv = sink->priv;
+  static SnippetCache snippet_cache;
+  SnippetCacheEntry *entry;
+
+  entry = get_cache_entry (sink, &snippet_cache);
+
+  if (entry == NULL)
+    {
+      char *source;
+
+      source =
+        g_strdup_printf ("vec4\n"
+                         "cogl_gst_sample_video%i (vec2 UV)\n"
+                         "{\n"
+                         "  vec2 scale = vec2 (255.0, 65280.0) / 1023.0;\n"
+                         "  float y = 1.1640625 * "
+                         "(dot (texture2D (cogl_sampler%i, UV).rg, scale) - "
+                         "0.0625);\n"
+                         "  float u = dot (texture2D (cogl_sampler%i, UV).rg, "
+                         "scale) - 0.5;\n"
+                         "  float v = dot (texture2D (cogl_sampler%i, UV).rg, "
+                         "scale) - 0.5;\n"
+                         "  vec4 color;\n"
+                         "  color.r = y + 1.59765625 * v;\n"
+                         "  color.g = y - 0.390625 * u - 0.8125 * v;\n"
+                         "  color.b = y + 2.015625 * u;\n"
+                         "  color.a = 1.0;\n"
+                         "  return color;\n"
+                         "}\n",
+                         priv->custom_start,
+                         priv->custom_start,
+                         priv->custom_start + 1,
+                         priv->custom_start + 2);
+
+      entry = add_cache_entry (sink, &snippet_cache, source);
+      g_free (source);
+    }
+
+  setup_pipeline_from_cache_entry (sink, pipeline, entry, 3);
+  set_nearest_filters (sink, pipeline, 3);
+}
+
+static CoglBool
+cogl_gst_i420_10le_upload (CoglGstVideoSink *sink,
+                           GstBuffer *buffer)
+{
+  static const CoglPixelFormat formats[] =
+    {
+      COGL_PIXEL_FORMAT_RG_88,
+      COGL_PIXEL_FORMAT_RG_88,
+      COGL_PIXEL_FORMAT_RG_88
+    };
+
+  return upload_planes (sink, buffer, G_N_ELEMENTS (formats), formats);
+}
+
+static CoglGstRenderer i420_10le_glsl_renderer =
+{
+  "I420 10LE glsl",
+  COGL_GST_I420_10LE,
+  COGL_GST_RENDERER_NEEDS_GLSL,
+  GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("I420_10LE")),
+  3, /* n_layers */
+  cogl_gst_i420_10le_glsl_setup_pipeline,
+  cogl_gst_i420_10le_upload,
+};
+
+#endif /* COGL_GST_HAVE_I420_10LE */
+
+#ifdef COGL_GST_HAVE_P010
+
+/* P010 is laid out like NV12 but with little-endian 16-bit samples
+ * that have the value in the high 10 bits. The luma plane is uploaded
+ * to a red-green texture and the interleaved chroma plane to an RGBA
+ * texture so that each texel holds the two bytes of U followed by the
+ * two bytes of V */
+static void
+cogl_gst_p010_glsl_setup_pipeline (CoglGstVideoSink *sink,
+                                   CoglPipeline *pipeline)
+{
+  CoglGstVideoSinkPrivate *priv = sink->priv;
+  static SnippetCache snippet_cache;
+  SnippetCacheEntry *entry;
+
+  entry = get_cache_entry (sink, &snippet_cache);
+
+  if (entry == NULL)
+    {
+      char *source;
+
+      source =
+        g_strdup_printf ("vec4\n"
+                         "cogl_gst_sample_video%i (vec2 UV)\n"
+                         "{\n"
+                         "  vec2 scale = vec2 (255.0, 65280.0) / 65535.0;\n"
+                         "  vec4 uv = texture2D (cogl_sampler%i, UV);\n"
+                         "  float y = 1.1640625 * "
+                         "(dot (texture2D (cogl_sampler%i, UV).rg, scale) - "
+                         "0.0625);\n"
+                         "  float u = dot (uv.rg, scale) - 0.5;\n"
+                         "  float v = dot (uv.ba, scale) - 0.5;\n"
+                         "  vec4 color;\n"
+                         "  color.r = y + 1.59765625 * v;\n"
+                         "  color.g = y - 0.390625 * u - 0.8125 * v;\n"
+                         "  color.b = y + 2.015625 * u;\n"
+                         "  color.a = 1.0;\n"
+                         "  return color;\n"
+                         "}\n",
+                         priv->custom_start,
+                         priv->custom_start + 1,
+                         priv->custom_start);
+
+      entry = add_cache_entry (sink, &snippet_cache, source);
+      g_free (source);
+    }
+
+  setup_pipeline_from_cache_entry (sink, pipeline, entry, 2);
+  set_nearest_filters (sink, pipeline, 2);
+}
+
+static CoglBool
+cogl_gst_p010_upload (CoglGstVideoSink *sink,
+                      GstBuffer *buffer)
+{
+  static const CoglPixelFormat formats[] =
+    {
+      COGL_PIXEL_FORMAT_RG_88,
+      COGL_PIXEL_FORMAT_RGBA_8888
+    };
+
+  return upload_planes (sink, buffer, G_N_ELEMENTS (formats), formats);
+}
+
+static CoglGstRenderer p010_glsl_renderer =
+{
+  "P010 glsl",
+  COGL_GST_P010,
+  COGL_GST_RENDERER_NEEDS_GLSL,
+  GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("P010_10LE")),
+  2, /* n_layers */
+  cogl_gst_p010_glsl_setup_pipeline,
+  cogl_gst_p010_upload,
+};
+
+#endif /* COGL_GST_HAVE_P010 */
+
+static GSList*
+cogl_gst_build_renderers_list (CoglContext *ctx)
+{
+  GSList *list = NULL;
+  CoglBool has_glsl;
+  int i;
+  static CoglGstRenderer *const renderers[] =
+  {
+    &rgb24_renderer,
+    &rgb32_renderer,
+    &yv12_glsl_renderer,
+    &i420_glsl_renderer,
+    &ayuv_glsl_renderer,
+    &nv12_glsl_renderer,
+    &nv21_glsl_renderer,
+#ifdef COGL_GST_HAVE_I420_10LE
+    &i420_10le_glsl_renderer,
+#endif
+#ifdef COGL_GST_HAVE_P010
+    &p010_glsl_renderer,
+#endif
+    NULL
+  };
+
+  has_glsl = cogl_has_feature (ctx, COGL_FEATURE_ID_GLSL);
+
+  for (i = 0; renderers[i]; i++)
+    if (has_glsl || !(renderers[i]->flags & COGL_GST_RENDERER_NEEDS_GLSL))
+      list = g_slist_prepend (list, renderers[i]);
+
+  return list;
+}
+
+static void
+append_cap (gpointer data,
+            gpointer user_data)
+{
+  CoglGstRenderer *renderer = (CoglGstRenderer *) data;
+  GstCaps *caps = (GstCaps *) user_data;
+  GstCaps *writable_caps;
+  writable_caps =
+    gst_caps_make_writable (gst_static_caps_get (&renderer->caps));
+  gst_caps_append (caps, writable_caps);
+}
+
+static GstCaps *
+cogl_gst_build_caps (GSList *renderers)
+{
+  GstCaps *caps;
+
+  caps = gst_caps_new_empty ();
+
+  g_slist_foreach (renderers, append_cap, caps);
+
+  return caps;
+}
+
+void
+cogl_gst_video_sink_set_context (CoglGstVideoSink *vt,
+                                 CoglContext *ctx)
+{
+  CoglGstVideoSinkPrivate *priv = vt->priv;
+
+  if (ctx)
+    ctx = cogl_object_ref (ctx);
+
+  if (priv->ctx)
+    {
+      cogl_object_unref (priv->ctx);
       g_slist_free (priv->renderers);
       priv->renderers = NULL;
       if (priv->caps)
@@ -868,6 +1682,13 @@ cogl_gst_video_sink_set_context (CoglGstVideoSink *vt,
       priv->renderers = cogl_gst_build_renderers_list (priv->ctx);
       priv->caps = cogl_gst_build_caps (priv->renderers);
     }
+  else
+    priv->ctx = NULL;
+
+  g_atomic_int_set (&priv->can_map_pixel_buffers,
+                    ctx &&
+                    cogl_has_feature (ctx,
+                                      COGL_FEATURE_ID_MAP_BUFFER_FOR_WRITE));
 }
 
 static CoglGstRenderer *
@@ -933,6 +1754,22 @@ cogl_gst_video_sink_parse_caps (GstCaps *caps,
       format = COGL_GST_AYUV;
       bgr = FALSE;
       break;
+    case GST_VIDEO_FORMAT_NV12:
+      format = COGL_GST_NV12;
+      break;
+    case GST_VIDEO_FORMAT_NV21:
+      format = COGL_GST_NV21;
+      break;
+#ifdef COGL_GST_HAVE_I420_10LE
+    case GST_VIDEO_FORMAT_I420_10LE:
+      format = COGL_GST_I420_10LE;
+      break;
+#endif
+#ifdef COGL_GST_HAVE_P010
+    case GST_VIDEO_FORMAT_P010_10LE:
+      format = COGL_GST_P010;
+      break;
+#endif
     case GST_VIDEO_FORMAT_RGB:
       format = COGL_GST_RGB24;
       bgr = FALSE;
@@ -1012,6 +1849,10 @@ cogl_gst_video_sink_set_caps (GstBaseSink *bsink,
   if (!cogl_gst_video_sink_parse_caps (caps, sink, FALSE))
     return FALSE;
 
+  if (!gst_video_info_from_caps (&priv->staging_info, caps))
+    return FALSE;
+  gst_caps_replace (&priv->staging_caps, caps);
+
   g_mutex_lock (&priv->source->buffer_lock);
   priv->source->has_new_caps = TRUE;
   g_mutex_unlock (&priv->source->buffer_lock);
@@ -1019,6 +1860,341 @@ cogl_gst_video_sink_set_caps (GstBaseSink *bsink,
   return TRUE;
 }
 
+static gboolean
+cogl_gst_video_sink_propose_allocation (GstBaseSink *bsink,
+                                        GstQuery *query)
+{
+  CoglGstVideoSink *sink = COGL_GST_VIDEO_SINK (bsink);
+  CoglGstVideoSinkPrivate *priv = sink->priv;
+  GstBufferPool *pool = NULL;
+  GstStructure *config;
+  GstCaps *caps;
+  gboolean need_pool;
+  GstVideoInfo info;
+
+  gst_query_parse_allocation (query, &caps, &need_pool);
+
+  if (caps == NULL || !gst_video_info_from_caps (&info, caps))
+    return FALSE;
+
+  /* The pool is only useful if the pixel buffers can be mapped */
+  if (need_pool && g_atomic_int_get (&priv->can_map_pixel_buffers))
+    {
+      GST_OBJECT_LOCK (sink);
+
+      if (priv->buffer_pools)
+        {
+          GstCaps *pool_caps;
+
+          config = gst_buffer_pool_get_config (priv->buffer_pools->data);
+          gst_buffer_pool_config_get_params (config, &pool_caps,
+                                             NULL, NULL, NULL);
+
+          if (gst_caps_is_equal (pool_caps, caps))
+            pool = gst_object_ref (priv->buffer_pools->data);
+
+          gst_structure_free (config);
+        }
+
+      GST_OBJECT_UNLOCK (sink);
+
+      if (pool == NULL)
+        {
+          pool = _cogl_gst_buffer_pool_new ();
+
+          config = gst_buffer_pool_get_config (pool);
+          gst_buffer_pool_config_set_params (config, caps, info.size, 0, 0);
+          gst_buffer_pool_config_add_option (config,
+                                             GST_BUFFER_POOL_OPTION_VIDEO_META);
+
+          if (!gst_buffer_pool_set_config (pool, config))
+            {
+              GST_WARNING_OBJECT (sink, "Failed to configure buffer pool");
+              gst_object_unref (pool);
+              return FALSE;
+            }
+
+          GST_OBJECT_LOCK (sink);
+          priv->buffer_pools = g_list_prepend (priv->buffer_pools,
+                                               gst_object_ref (pool));
+          GST_OBJECT_UNLOCK (sink);
+        }
+
+      gst_query_add_allocation_pool (query, pool, info.size, 0, 0);
+      gst_object_unref (pool);
+    }
+
+  gst_query_add_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+
+  return TRUE;
+}
+
+/* Gives the pools in a list a chance to create and free their pixel
+ * buffers from the main thread. Pools that are done are dropped from
+ * the list unless @keep_first is set and the pool is the current one
+ * at the head of the list */
+static void
+prepare_pool_list (CoglGstVideoSink *sink,
+                   GList **pool_list,
+                   CoglBool keep_first)
+{
+  CoglGstVideoSinkPrivate *priv = sink->priv;
+  GList *pools, *l;
+
+  GST_OBJECT_LOCK (sink);
+  pools = g_list_copy (*pool_list);
+  g_list_foreach (pools, (GFunc) gst_object_ref, NULL);
+  GST_OBJECT_UNLOCK (sink);
+
+  for (l = pools; l; l = l->next)
+    {
+      GstBufferPool *pool = l->data;
+
+      if (!_cogl_gst_buffer_pool_prepare (pool, priv->ctx))
+        {
+          GList *link;
+
+          GST_OBJECT_LOCK (sink);
+          /* Drop pools that have been replaced or retired once they
+           * are done */
+          link = g_list_find (*pool_list, pool);
+          if (link && (link != *pool_list || !keep_first))
+            {
+              *pool_list = g_list_delete_link (*pool_list, link);
+              gst_object_unref (pool);
+            }
+          GST_OBJECT_UNLOCK (sink);
+        }
+
+      gst_object_unref (pool);
+    }
+
+  g_list_free (pools);
+}
+
+static void
+prepare_buffer_pools (CoglGstVideoSink *sink)
+{
+  CoglGstVideoSinkPrivate *priv = sink->priv;
+
+  prepare_pool_list (sink, &priv->buffer_pools, TRUE);
+  prepare_pool_list (sink, &priv->staging_pools, TRUE);
+  prepare_pool_list (sink, &priv->retired_pools, FALSE);
+}
+
+static gboolean
+prepare_retired_pools_cb (void *user_data)
+{
+  CoglGstVideoSink *sink = user_data;
+  CoglGstVideoSinkPrivate *priv = sink->priv;
+
+  /* Anything that is still in use after this will be freed the next
+   * time the pools are prepared or by the pool itself once it is
+   * finalized */
+  if (priv->ctx)
+    prepare_pool_list (sink, &priv->retired_pools, FALSE);
+
+  return FALSE;
+}
+
+/* Moves all of the pools to the retired list when the sink is
+ * stopped. They are released from the main thread once their pixel
+ * buffers have been freed */
+static void
+retire_buffer_pools (CoglGstVideoSink *sink)
+{
+  CoglGstVideoSinkPrivate *priv = sink->priv;
+  GList *staging_pools;
+
+  GST_OBJECT_LOCK (sink);
+  staging_pools = g_list_copy (priv->staging_pools);
+  g_list_foreach (staging_pools, (GFunc) gst_object_ref, NULL);
+  priv->retired_pools = g_list_concat (priv->retired_pools,
+                                       priv->buffer_pools);
+  priv->retired_pools = g_list_concat (priv->retired_pools,
+                                       priv->staging_pools);
+  priv->buffer_pools = NULL;
+  priv->staging_pools = NULL;
+  GST_OBJECT_UNLOCK (sink);
+
+  /* Unlike the buffer pools the staging pools are activated by us */
+  g_list_foreach (staging_pools, (GFunc) gst_buffer_pool_set_active,
+                  GINT_TO_POINTER (FALSE));
+  g_list_free_full (staging_pools, gst_object_unref);
+
+  g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+                   prepare_retired_pools_cb,
+                   g_object_ref (sink),
+                   g_object_unref);
+}
+
+/* Drops all of the pools when the sink is disposed. If any of them
+ * still have pixel buffers then the pools free them from the main
+ * thread once they are finalized */
+static void
+clear_buffer_pools (CoglGstVideoSink *sink)
+{
+  CoglGstVideoSinkPrivate *priv = sink->priv;
+  GList *pools, *staging_pools;
+
+  GST_OBJECT_LOCK (sink);
+  pools = g_list_concat (priv->buffer_pools, priv->retired_pools);
+  priv->buffer_pools = NULL;
+  priv->retired_pools = NULL;
+  staging_pools = priv->staging_pools;
+  priv->staging_pools = NULL;
+  GST_OBJECT_UNLOCK (sink);
+
+  g_list_free_full (pools, gst_object_unref);
+
+  /* Unlike the buffer pools the staging pools are activated by us */
+  g_list_foreach (staging_pools, (GFunc) gst_buffer_pool_set_active,
+                  GINT_TO_POINTER (FALSE));
+  g_list_free_full (staging_pools, gst_object_unref);
+}
+
+/* Returns the staging pool for the negotiated caps, replacing the
+ * current one if the caps have changed since it was created. No
+ * reference is returned because the streaming thread must never
+ * release a pool. The main thread only drops a staging pool once it
+ * is no longer at the head of the list so the pool stays valid until
+ * the next call to this function */
+static GstBufferPool *
+get_staging_pool (CoglGstVideoSink *sink)
+{
+  CoglGstVideoSinkPrivate *priv = sink->priv;
+  GstBufferPool *pool = NULL, *old_pool = NULL;
+  GstStructure *config;
+
+  GST_OBJECT_LOCK (sink);
+
+  if (priv->staging_pools)
+    {
+      GstCaps *pool_caps;
+
+      config = gst_buffer_pool_get_config (priv->staging_pools->data);
+      gst_buffer_pool_config_get_params (config, &pool_caps,
+                                         NULL, NULL, NULL);
+
+      if (gst_caps_is_equal (pool_caps, priv->staging_caps))
+        pool = priv->staging_pools->data;
+      else
+        old_pool = priv->staging_pools->data;
+
+      gst_structure_free (config);
+    }
+
+  GST_OBJECT_UNLOCK (sink);
+
+  if (pool)
+    return pool;
+
+  /* The old pool is still at the head of the list so it can be used
+   * here without a reference. It will be dropped from the list by the
+   * main thread once it has freed all of its pixel buffers */
+  if (old_pool)
+    gst_buffer_pool_set_active (old_pool, FALSE);
+
+  pool = _cogl_gst_buffer_pool_new ();
+
+  config = gst_buffer_pool_get_config (pool);
+  gst_buffer_pool_config_set_params (config,
+                                     priv->staging_caps,
+                                     priv->staging_info.size,
+                                     0, 0);
+
+  if (!gst_buffer_pool_set_config (pool, config) ||
+      !gst_buffer_pool_set_active (pool, TRUE))
+    {
+      GST_WARNING_OBJECT (sink, "Failed to set up staging buffer pool");
+      /* The main thread hasn't created any pixel buffers for the pool
+       * yet so it is safe to release it here */
+      gst_object_unref (pool);
+      return NULL;
+    }
+
+  /* The list takes over our reference */
+  GST_OBJECT_LOCK (sink);
+  priv->staging_pools = g_list_prepend (priv->staging_pools, pool);
+  GST_OBJECT_UNLOCK (sink);
+
+  return pool;
+}
+
+/* Copies the frame into a mapped pixel buffer so that the main thread
+ * only has to start the upload from it. This is called from the
+ * streaming thread so it can't use Cogl. The pixel buffers are
+ * created by the main thread in prepare_buffer_pools() so until some
+ * are ready the buffer is passed on unchanged. Returns a new
+ * reference to the buffer that should be displayed */
+static GstBuffer *
+copy_to_staging_buffer (CoglGstVideoSink *sink,
+                        GstBuffer *buffer)
+{
+  CoglGstVideoSinkPrivate *priv = sink->priv;
+  GstBufferPool *pool;
+  GstBuffer *staging_buffer;
+  GstVideoFrame src_frame, dst_frame;
+  CoglBool copied;
+
+  /* Copying only helps if the pixel buffers can be mapped and
+   * upstream hasn't already decoded into one of them */
+  if (priv->staging_caps == NULL ||
+      !g_atomic_int_get (&priv->can_map_pixel_buffers) ||
+      _cogl_gst_buffer_pool_is_pixel_buffer (buffer))
+    return gst_buffer_ref (buffer);
+
+  pool = get_staging_pool (sink);
+
+  if (pool == NULL)
+    return gst_buffer_ref (buffer);
+
+  if (gst_buffer_pool_acquire_buffer (pool, &staging_buffer, NULL) !=
+      GST_FLOW_OK)
+    staging_buffer = NULL;
+
+  if (staging_buffer == NULL)
+    return gst_buffer_ref (buffer);
+
+  if (!_cogl_gst_buffer_pool_is_pixel_buffer (staging_buffer))
+    goto no_copy;
+
+  if (!gst_video_frame_map (&src_frame,
+                            &priv->staging_info,
+                            buffer,
+                            GST_MAP_READ))
+    goto no_copy;
+
+  if (!gst_video_frame_map (&dst_frame,
+                            &priv->staging_info,
+                            staging_buffer,
+                            GST_MAP_WRITE))
+    {
+      gst_video_frame_unmap (&src_frame);
+      goto no_copy;
+    }
+
+  copied = gst_video_frame_copy (&dst_frame, &src_frame);
+
+  gst_video_frame_unmap (&dst_frame);
+  gst_video_frame_unmap (&src_frame);
+
+  if (!copied)
+    goto no_copy;
+
+  gst_buffer_copy_into (staging_buffer, buffer,
+                        GST_BUFFER_COPY_TIMESTAMPS,
+                        0, -1);
+
+  return staging_buffer;
+
+no_copy:
+  {
+    gst_buffer_unref (staging_buffer);
+    return gst_buffer_ref (buffer);
+  }
+}
+
 static CoglBool
 cogl_gst_source_dispatch (GSource *source,
                           GSourceFunc callback,
@@ -1026,8 +2202,16 @@ cogl_gst_source_dispatch (GSource *source,
 {
   CoglGstSource *gst_source= (CoglGstSource*) source;
   CoglGstVideoSinkPrivate *priv = gst_source->sink->priv;
-  GstBuffer *buffer;
+  CoglGstPendingFrame *frame;
+  GstBuffer *buffer = NULL;
   gboolean pipeline_ready = FALSE;
+  int64_t now = 0, offset = 0;
+  CoglBool have_timing;
+  int n_dropped;
+  GstClockTime late_running_time = GST_CLOCK_TIME_NONE;
+  GstClockTimeDiff late_jitter = 0;
+
+  have_timing = get_clock_offset (gst_source->sink, &now, &offset);
 
   g_mutex_lock (&gst_source->buffer_lock);
 
@@ -1043,6 +2227,9 @@ cogl_gst_source_dispatch (GSource *source,
       gst_source->has_new_caps = FALSE;
       priv->free_layer = priv->custom_start + priv->renderer->n_layers;
 
+      /* The pooled textures may not match the new caps */
+      clear_texture_pool (gst_source->sink);
+
       dirty_default_pipeline (gst_source->sink);
 
       /* We are now in a state where we could generate the pipeline if
@@ -1052,13 +2239,32 @@ cogl_gst_source_dispatch (GSource *source,
       pipeline_ready = TRUE;
     }
 
-  buffer = gst_source->buffer;
-  gst_source->buffer = NULL;
+  frame = take_next_frame (gst_source,
+                           have_timing,
+                           now,
+                           offset,
+                           &n_dropped,
+                           &late_running_time,
+                           &late_jitter);
 
   g_mutex_unlock (&gst_source->buffer_lock);
 
+  if (frame)
+    {
+      buffer = frame->buffer;
+      g_slice_free (CoglGstPendingFrame, frame);
+
+      if (have_timing)
+        send_qos_event (gst_source->sink,
+                        n_dropped,
+                        late_running_time,
+                        late_jitter);
+    }
+
   if (buffer)
     {
+      prepare_buffer_pools (gst_source->sink);
+
       if (!priv->renderer->upload (gst_source->sink, buffer))
         goto fail_upload;
 
@@ -1119,7 +2325,7 @@ cogl_gst_source_new (CoglGstVideoSink *sink)
 
   gst_source->sink = sink;
   g_mutex_init (&gst_source->buffer_lock);
-  gst_source->buffer = NULL;
+  g_queue_init (&gst_source->pending_frames);
 
   return gst_source;
 }
@@ -1134,6 +2340,41 @@ cogl_gst_video_sink_init (CoglGstVideoSink *sink)
                                                    CoglGstVideoSinkPrivate);
   priv->custom_start = 0;
   priv->default_sample = TRUE;
+  priv->qos_proportion = 1.0;
+}
+
+/* Works out when the buffer should be shown in the same way as
+ * GstBaseSink does when it synchronises to the clock */
+static void
+get_buffer_times (CoglGstVideoSink *sink,
+                  GstBuffer *buffer,
+                  GstClockTime *running_time_out,
+                  GstClockTime *clock_time_out)
+{
+  GstBaseSink *bsink = GST_BASE_SINK (sink);
+  GstClockTime running_time = GST_CLOCK_TIME_NONE;
+  GstClockTime base_time = 0;
+
+  GST_OBJECT_LOCK (sink);
+
+  if (GST_BUFFER_PTS_IS_VALID (buffer) &&
+      bsink->segment.format == GST_FORMAT_TIME)
+    {
+      running_time = gst_segment_to_running_time (&bsink->segment,
+                                                  GST_FORMAT_TIME,
+                                                  GST_BUFFER_PTS (buffer));
+      base_time = GST_ELEMENT_CAST (sink)->base_time;
+    }
+
+  GST_OBJECT_UNLOCK (sink);
+
+  *running_time_out = running_time;
+
+  if (GST_CLOCK_TIME_IS_VALID (running_time))
+    *clock_time_out = (running_time + base_time +
+                       gst_base_sink_get_latency (bsink));
+  else
+    *clock_time_out = GST_CLOCK_TIME_NONE;
 }
 
 static GstFlowReturn
@@ -1143,16 +2384,31 @@ _cogl_gst_video_sink_render (GstBaseSink *bsink,
   CoglGstVideoSink *sink = COGL_GST_VIDEO_SINK (bsink);
   CoglGstVideoSinkPrivate *priv = sink->priv;
   CoglGstSource *gst_source = priv->source;
+  CoglGstPendingFrame *frame;
+
+  frame = g_slice_new (CoglGstPendingFrame);
+  get_buffer_times (sink, buffer, &frame->running_time, &frame->clock_time);
+
+  /* This is done before taking the lock so that the main thread
+   * isn't blocked while the frame is copied */
+  if (g_atomic_int_get (&priv->threaded_upload))
+    frame->buffer = copy_to_staging_buffer (sink, buffer);
+  else
+    frame->buffer = gst_buffer_ref (buffer);
 
   g_mutex_lock (&gst_source->buffer_lock);
 
   if (G_UNLIKELY (priv->flow_return != GST_FLOW_OK))
     goto dispatch_flow_ret;
 
-  if (gst_source->buffer)
-    gst_buffer_unref (gst_source->buffer);
+  /* Without frame timing the latest buffer is always shown */
+  if (!g_atomic_int_get (&priv->has_frame_timing))
+    clear_pending_frames (gst_source);
+  else
+    while (gst_source->pending_frames.length >= COGL_GST_MAX_PENDING_FRAMES)
+      pending_frame_free (g_queue_pop_head (&gst_source->pending_frames));
 
-  gst_source->buffer = gst_buffer_ref (buffer);
+  g_queue_push_tail (&gst_source->pending_frames, frame);
   g_mutex_unlock (&gst_source->buffer_lock);
 
   g_main_context_wakeup (NULL);
@@ -1162,10 +2418,98 @@ _cogl_gst_video_sink_render (GstBaseSink *bsink,
   dispatch_flow_ret:
   {
     g_mutex_unlock (&gst_source->buffer_lock);
+    pending_frame_free (frame);
     return priv->flow_return;
   }
 }
 
+static void
+frame_cb (CoglOnscreen *onscreen,
+          CoglFrameEvent event,
+          CoglFrameInfo *info,
+          void *user_data)
+{
+  CoglGstVideoSink *sink = user_data;
+  CoglGstVideoSinkPrivate *priv = sink->priv;
+  int64_t presentation_time;
+  int64_t refresh_interval;
+  float refresh_rate;
+
+  if (event != COGL_FRAME_EVENT_COMPLETE)
+    return;
+
+  /* Some platforms can't report when frames are presented */
+  presentation_time = cogl_frame_info_get_presentation_time (info);
+  if (presentation_time == 0)
+    return;
+
+  refresh_rate = cogl_frame_info_get_refresh_rate (info);
+  if (refresh_rate <= 0.0f)
+    refresh_rate = COGL_GST_DEFAULT_REFRESH_RATE;
+
+  refresh_interval = 1000000000.0 / refresh_rate;
+
+  priv->last_presentation_time = presentation_time;
+
+  if (refresh_interval != priv->refresh_interval)
+    {
+      priv->refresh_interval = refresh_interval;
+      /* Have the base sink hand over buffers a refresh early so that
+       * they can be queued until the refresh they should be shown at */
+      gst_base_sink_set_render_delay (GST_BASE_SINK (sink), refresh_interval);
+    }
+
+  g_atomic_int_set (&priv->has_frame_timing, TRUE);
+}
+
+static void
+clear_onscreen (CoglGstVideoSink *sink)
+{
+  CoglGstVideoSinkPrivate *priv = sink->priv;
+
+  if (priv->onscreen == NULL)
+    return;
+
+  cogl_onscreen_remove_frame_callback (priv->onscreen, priv->frame_closure);
+  cogl_object_unref (priv->onscreen);
+  priv->onscreen = NULL;
+  priv->frame_closure = NULL;
+
+  g_atomic_int_set (&priv->has_frame_timing, FALSE);
+  priv->last_presentation_time = 0;
+  priv->refresh_interval = 0;
+  priv->qos_proportion = 1.0;
+
+  gst_base_sink_set_render_delay (GST_BASE_SINK (sink), 0);
+}
+
+void
+cogl_gst_video_sink_set_onscreen (CoglGstVideoSink *sink,
+                                  CoglOnscreen *onscreen)
+{
+  CoglGstVideoSinkPrivate *priv;
+
+  g_return_if_fail (COGL_GST_IS_VIDEO_SINK (sink));
+  g_return_if_fail (onscreen == NULL || cogl_is_onscreen (onscreen));
+
+  priv = sink->priv;
+
+  if (onscreen == priv->onscreen)
+    return;
+
+  clear_onscreen (sink);
+
+  if (onscreen)
+    {
+      priv->onscreen = cogl_object_ref (onscreen);
+      priv->frame_closure =
+        cogl_onscreen_add_frame_callback (onscreen,
+                                          frame_cb,
+                                          sink,
+                                          NULL /* destroy */);
+    }
+}
+
 static void
 cogl_gst_video_sink_dispose (GObject *object)
 {
@@ -1176,6 +2520,9 @@ cogl_gst_video_sink_dispose (GObject *object)
   priv = self->priv;
 
   clear_frame_textures (self);
+  clear_texture_pool (self);
+  clear_buffer_pools (self);
+  clear_onscreen (self);
 
   if (priv->pipeline)
     {
@@ -1189,6 +2536,8 @@ cogl_gst_video_sink_dispose (GObject *object)
       priv->caps = NULL;
     }
 
+  gst_caps_replace (&priv->staging_caps, NULL);
+
   G_OBJECT_CLASS (cogl_gst_video_sink_parent_class)->dispose (object);
 }
 
@@ -1227,6 +2576,10 @@ cogl_gst_video_sink_set_property (GObject *object,
     case PROP_UPDATE_PRIORITY:
       cogl_gst_video_sink_set_priority (sink, g_value_get_int (value));
       break;
+    case PROP_THREADED_UPLOAD:
+      g_atomic_int_set (&sink->priv->threaded_upload,
+                        g_value_get_boolean (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -1247,6 +2600,9 @@ cogl_gst_video_sink_get_property (GObject *object,
     case PROP_UPDATE_PRIORITY:
       g_value_set_int (value, g_source_get_priority ((GSource *) priv->source));
       break;
+    case PROP_THREADED_UPLOAD:
+      g_value_set_boolean (value, g_atomic_int_get (&priv->threaded_upload));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -1267,6 +2623,8 @@ cogl_gst_video_sink_stop (GstBaseSink *base_sink)
       priv->source = NULL;
     }
 
+  retire_buffer_pools (sink);
+
   return TRUE;
 }
 
@@ -1304,6 +2662,7 @@ cogl_gst_video_sink_class_init (CoglGstVideoSinkClass *klass)
   gb_class->stop = cogl_gst_video_sink_stop;
   gb_class->set_caps = cogl_gst_video_sink_set_caps;
   gb_class->get_caps = cogl_gst_video_sink_get_caps;
+  gb_class->propose_allocation = cogl_gst_video_sink_propose_allocation;
 
   pspec = g_param_spec_int ("update-priority",
                             "Update Priority",
@@ -1314,6 +2673,16 @@ cogl_gst_video_sink_class_init (CoglGstVideoSinkClass *klass)
 
   g_object_class_install_property (go_class, PROP_UPDATE_PRIORITY, pspec);
 
+  pspec = g_param_spec_boolean ("threaded-upload",
+                                "Threaded Upload",
+                                "Copy frames into pixel buffers from the "
+                                "streaming thread so that the main thread "
+                                "only has to start the texture upload",
+                                FALSE,
+                                COGL_GST_PARAM_READWRITE);
+
+  g_object_class_install_property (go_class, PROP_THREADED_UPLOAD, pspec);
+
   video_sink_signals[PIPELINE_READY_SIGNAL] =
     g_signal_new ("pipeline-ready",
                   COGL_GST_TYPE_VIDEO_SINK,
@@ -282,6 +282,9 @@ cogl_gst_video_sink_get_free_layer (CoglGstVideoSink *sink);
  * would then make a copy of its template pipeline and call this to
  * set the textures.
  *
+ * The sink won't upload any later frames into the attached textures
+ * for as long as @pln is alive.
+ *
  * Since: 1.16
  */
 void
@@ -330,6 +333,32 @@ void
 cogl_gst_video_sink_set_default_sample (CoglGstVideoSink *sink,
                                         CoglBool default_sample);
 
+/**
+ * cogl_gst_video_sink_set_onscreen:
+ * @sink: The #CoglGstVideoSink
+ * @onscreen: (allow-none): The #CoglOnscreen that the video is shown
+ *   on, or %NULL
+ *
+ * Lets the sink use the frame timing of @onscreen to schedule the
+ * video. Once the onscreen reports presentation times the sink will
+ * try to show each frame on the refresh closest to its timestamp
+ * instead of showing whichever frame arrived last.
+ * #CoglGstVideoSink::new-frame is emitted a refresh before the frame
+ * should be visible. Frames that have been overtaken by later ones are
+ * dropped without being uploaded and QoS events are sent upstream so
+ * that decoders can skip work when the application can't keep up.
+ *
+ * For this to work the application should paint the video and swap
+ * the buffers of @onscreen as soon as it can after the new-frame
+ * signal is emitted.
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+void
+cogl_gst_video_sink_set_onscreen (CoglGstVideoSink *sink,
+                                  CoglOnscreen *onscreen);
+
 /**
  * cogl_gst_video_sink_setup_pipeline:
  * @sink: The #CoglGstVideoSink
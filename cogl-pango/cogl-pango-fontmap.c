@@ -163,6 +163,77 @@ cogl_pango_font_map_get_use_mipmapping (CoglPangoFontMap *fm)
     _cogl_pango_renderer_get_use_mipmapping (COGL_PANGO_RENDERER (renderer));
 }
 
+void
+cogl_pango_font_map_set_glyph_cache_budget (CoglPangoFontMap *fm,
+                                            size_t            budget)
+{
+  PangoRenderer *renderer;
+
+  _COGL_RETURN_IF_FAIL (COGL_PANGO_IS_FONT_MAP (fm));
+
+  renderer = _cogl_pango_font_map_get_renderer (fm);
+
+  _cogl_pango_renderer_set_glyph_cache_budget (COGL_PANGO_RENDERER (renderer),
+                                               budget);
+}
+
+size_t
+cogl_pango_font_map_get_glyph_cache_budget (CoglPangoFontMap *fm)
+{
+  PangoRenderer *renderer;
+  CoglPangoRenderer *cogl_renderer;
+
+  _COGL_RETURN_VAL_IF_FAIL (COGL_PANGO_IS_FONT_MAP (fm), 0);
+
+  renderer = _cogl_pango_font_map_get_renderer (fm);
+  cogl_renderer = COGL_PANGO_RENDERER (renderer);
+
+  return _cogl_pango_renderer_get_glyph_cache_budget (cogl_renderer);
+}
+
+size_t
+cogl_pango_font_map_get_glyph_cache_size (CoglPangoFontMap *fm)
+{
+  PangoRenderer *renderer;
+  CoglPangoRenderer *cogl_renderer;
+
+  _COGL_RETURN_VAL_IF_FAIL (COGL_PANGO_IS_FONT_MAP (fm), 0);
+
+  renderer = _cogl_pango_font_map_get_renderer (fm);
+  cogl_renderer = COGL_PANGO_RENDERER (renderer);
+
+  return _cogl_pango_renderer_get_glyph_cache_size (cogl_renderer);
+}
+
+void
+cogl_pango_font_map_set_rasterization_threads (CoglPangoFontMap *fm,
+                                               int               n_threads)
+{
+  PangoRenderer *renderer;
+
+  _COGL_RETURN_IF_FAIL (COGL_PANGO_IS_FONT_MAP (fm));
+  _COGL_RETURN_IF_FAIL (n_threads >= 0);
+
+  renderer = _cogl_pango_font_map_get_renderer (fm);
+
+  _cogl_pango_renderer_set_rasterization_threads
+    (COGL_PANGO_RENDERER (renderer), n_threads);
+}
+
+int
+cogl_pango_font_map_get_rasterization_threads (CoglPangoFontMap *fm)
+{
+  PangoRenderer *renderer;
+  CoglPangoRenderer *cogl_renderer;
+
+  _COGL_RETURN_VAL_IF_FAIL (COGL_PANGO_IS_FONT_MAP (fm), 0);
+
+  renderer = _cogl_pango_font_map_get_renderer (fm);
+  cogl_renderer = COGL_PANGO_RENDERER (renderer);
+
+  return _cogl_pango_renderer_get_rasterization_threads (cogl_renderer);
+}
+
 static GQuark
 cogl_pango_font_map_get_priv_key (void)
 {
@@ -32,7 +32,12 @@
 #include "cogl/cogl-atlas.h"
 #include "cogl/cogl-atlas-texture-private.h"
 
+/* The default limit for the amount of texture memory used by the
+   glyphs in each cache */
+#define COGL_PANGO_GLYPH_CACHE_DEFAULT_MAX_SIZE (16 * 1024 * 1024)
+
 typedef struct _CoglPangoGlyphCacheKey     CoglPangoGlyphCacheKey;
+typedef struct _CoglPangoGlyphCacheAtlas   CoglPangoGlyphCacheAtlas;
 
 struct _CoglPangoGlyphCache
 {
@@ -42,7 +47,7 @@ struct _CoglPangoGlyphCache
      particular font is already cached */
   GHashTable       *hash_table;
 
-  /* List of CoglAtlases */
+  /* List of CoglPangoGlyphCacheAtlases */
   GSList           *atlases;
 
   /* List of callbacks to invoke when an atlas is reorganized */
@@ -61,6 +66,20 @@ struct _CoglPangoGlyphCache
   /* Whether mipmapping is being used for this cache. This only
      affects whether we decide to put the glyph in the global atlas */
   CoglBool          use_mipmapping;
+
+  /* Queue of the glyphs that take up space in a texture with the
+     most recently used glyph at the head */
+  GQueue            lru_queue;
+  /* The total size in bytes of the glyphs in lru_queue */
+  size_t            size;
+  /* The size that the cache tries to stay under by evicting the
+     least recently used glyphs. Zero means there's no limit */
+  size_t            max_size;
+
+  /* This is incremented every time the dirty glyphs are redrawn.
+     Glyphs that have been used since then may be about to be
+     rendered so they will never be evicted */
+  unsigned int      age;
 };
 
 struct _CoglPangoGlyphCacheKey
@@ -69,6 +88,15 @@ struct _CoglPangoGlyphCacheKey
   PangoGlyph  glyph;
 };
 
+struct _CoglPangoGlyphCacheAtlas
+{
+  CoglAtlas *atlas;
+
+  /* The number of glyphs that are stored in the atlas. The atlas is
+     freed when this drops to zero */
+  int        n_glyphs;
+};
+
 static void
 cogl_pango_glyph_cache_value_free (CoglPangoGlyphCacheValue *value)
 {
@@ -139,6 +167,11 @@ cogl_pango_glyph_cache_new (CoglContext *ctx,
 
   cache->use_mipmapping = use_mipmapping;
 
+  g_queue_init (&cache->lru_queue);
+  cache->size = 0;
+  cache->max_size = COGL_PANGO_GLYPH_CACHE_DEFAULT_MAX_SIZE;
+  cache->age = 0;
+
   return cache;
 }
 
@@ -150,14 +183,28 @@ cogl_pango_glyph_cache_reorganize_cb (void *user_data)
   g_hook_list_invoke (&cache->reorganize_callbacks, FALSE);
 }
 
+static void
+cogl_pango_glyph_cache_atlas_free (CoglPangoGlyphCacheAtlas *cache_atlas)
+{
+  cogl_object_unref (cache_atlas->atlas);
+  g_slice_free (CoglPangoGlyphCacheAtlas, cache_atlas);
+}
+
 void
 cogl_pango_glyph_cache_clear (CoglPangoGlyphCache *cache)
 {
-  g_slist_foreach (cache->atlases, (GFunc) cogl_object_unref, NULL);
+  g_slist_foreach (cache->atlases,
+                   (GFunc) cogl_pango_glyph_cache_atlas_free,
+                   NULL);
   g_slist_free (cache->atlases);
   cache->atlases = NULL;
   cache->has_dirty_glyphs = FALSE;
 
+  /* The links are embedded in the values so they will be freed along
+     with the hash table entries */
+  g_queue_init (&cache->lru_queue);
+  cache->size = 0;
+
   g_hash_table_remove_all (cache->hash_table);
 }
 
@@ -265,22 +312,27 @@ cogl_pango_glyph_cache_add_to_local_atlas (CoglPangoGlyphCache *cache,
                                            PangoGlyph glyph,
                                            CoglPangoGlyphCacheValue *value)
 {
-  CoglAtlas *atlas = NULL;
+  CoglPangoGlyphCacheAtlas *cache_atlas = NULL;
+  CoglAtlas *atlas;
   GSList *l;
 
   /* Look for an atlas that can reserve the space */
   for (l = cache->atlases; l; l = l->next)
-    if (_cogl_atlas_reserve_space (l->data,
-                                   value->draw_width + 1,
-                                   value->draw_height + 1,
-                                   value))
-      {
-        atlas = l->data;
-        break;
-      }
+    {
+      CoglPangoGlyphCacheAtlas *this_atlas = l->data;
+
+      if (_cogl_atlas_reserve_space (this_atlas->atlas,
+                                     value->draw_width + 1,
+                                     value->draw_height + 1,
+                                     value))
+        {
+          cache_atlas = this_atlas;
+          break;
+        }
+    }
 
   /* If we couldn't find one then start a new atlas */
-  if (atlas == NULL)
+  if (cache_atlas == NULL)
     {
       atlas = _cogl_atlas_new (COGL_PIXEL_FORMAT_A_8,
                                COGL_ATLAS_CLEAR_TEXTURE |
@@ -301,12 +353,143 @@ cogl_pango_glyph_cache_add_to_local_atlas (CoglPangoGlyphCache *cache,
       _cogl_atlas_add_reorganize_callback
         (atlas, cogl_pango_glyph_cache_reorganize_cb, NULL, cache);
 
-      cache->atlases = g_slist_prepend (cache->atlases, atlas);
+      cache_atlas = g_slice_new0 (CoglPangoGlyphCacheAtlas);
+      cache_atlas->atlas = atlas;
+      cache->atlases = g_slist_prepend (cache->atlases, cache_atlas);
     }
 
+  cache_atlas->n_glyphs++;
+  value->atlas = cache_atlas->atlas;
+
   return TRUE;
 }
 
+static CoglPangoGlyphCacheValue *
+cogl_pango_glyph_cache_value_from_link (GList *link)
+{
+  return (CoglPangoGlyphCacheValue *)
+    ((char *) link - G_STRUCT_OFFSET (CoglPangoGlyphCacheValue, lru_link));
+}
+
+/* Evicts a single glyph. Returns TRUE if the glyph's space in a
+   local atlas was given back so that it may be reused by another
+   glyph */
+static CoglBool
+cogl_pango_glyph_cache_evict_glyph (CoglPangoGlyphCache *cache,
+                                    CoglPangoGlyphCacheValue *value)
+{
+  CoglPangoGlyphCacheKey *key = value->lru_link.data;
+  CoglBool freed_atlas_space = FALSE;
+
+  g_queue_unlink (&cache->lru_queue, &value->lru_link);
+  cache->size -= value->size;
+
+  if (value->atlas)
+    {
+      CoglPangoGlyphCacheAtlas *cache_atlas = NULL;
+      CoglRectangleMapEntry rectangle;
+      GSList *l;
+
+      for (l = cache->atlases; l; l = l->next)
+        if (((CoglPangoGlyphCacheAtlas *) l->data)->atlas == value->atlas)
+          {
+            cache_atlas = l->data;
+            break;
+          }
+
+      g_assert (cache_atlas != NULL);
+
+      if (--cache_atlas->n_glyphs == 0)
+        {
+          COGL_NOTE (ATLAS, "Freeing empty glyph atlas %p",
+                     cache_atlas->atlas);
+          cache->atlases = g_slist_remove (cache->atlases, cache_atlas);
+          cogl_pango_glyph_cache_atlas_free (cache_atlas);
+        }
+      else
+        {
+          /* This has to match the space that was reserved in
+             cogl_pango_glyph_cache_add_to_local_atlas */
+          rectangle.x = value->tx_pixel;
+          rectangle.y = value->ty_pixel;
+          rectangle.width = value->draw_width + 1;
+          rectangle.height = value->draw_height + 1;
+
+          _cogl_atlas_remove (cache_atlas->atlas, &rectangle);
+
+          freed_atlas_space = TRUE;
+        }
+    }
+
+  /* This will also free the key and the value. For glyphs in the
+     global atlas dropping the reference to the texture gives the
+     space back once nothing else is using it */
+  g_hash_table_remove (cache->hash_table, key);
+
+  return freed_atlas_space;
+}
+
+/* Evicts the least recently used glyphs until there is space for
+   another @needed bytes */
+static void
+cogl_pango_glyph_cache_evict (CoglPangoGlyphCache *cache,
+                              size_t needed)
+{
+  CoglBool freed_atlas_space = FALSE;
+  size_t target;
+
+  if (cache->max_size == 0 ||
+      cache->size + needed <= cache->max_size)
+    return;
+
+  /* Free up a bit more than we need so that we don't have to evict
+     again straight away for the next glyph */
+  target = cache->max_size - cache->max_size / 4;
+
+  while (cache->lru_queue.tail &&
+         cache->size + needed > target)
+    {
+      CoglPangoGlyphCacheValue *value =
+        cogl_pango_glyph_cache_value_from_link (cache->lru_queue.tail);
+
+      /* All of the glyphs after this one have been used more recently
+         so they are all in use */
+      if (value->age == cache->age)
+        break;
+
+      if (cogl_pango_glyph_cache_evict_glyph (cache, value))
+        freed_atlas_space = TRUE;
+    }
+
+  /* The space of the evicted glyphs can now be given to new glyphs
+     so anything that is still referring to it, such as a display
+     list, needs to be rebuilt in the same way as when an atlas is
+     reorganized */
+  if (freed_atlas_space)
+    g_hook_list_invoke (&cache->reorganize_callbacks, FALSE);
+}
+
+void
+_cogl_pango_glyph_cache_set_max_size (CoglPangoGlyphCache *cache,
+                                      size_t max_size)
+{
+  cache->max_size = max_size;
+
+  cogl_pango_glyph_cache_evict (cache, 0);
+}
+
+size_t
+_cogl_pango_glyph_cache_get_max_size (CoglPangoGlyphCache *cache)
+{
+  return cache->max_size;
+}
+
+size_t
+_cogl_pango_glyph_cache_get_size (CoglPangoGlyphCache *cache)
+{
+  return cache->size;
+}
+
 CoglPangoGlyphCacheValue *
 cogl_pango_glyph_cache_lookup (CoglPangoGlyphCache *cache,
                                CoglBool             create,
@@ -321,13 +504,25 @@ cogl_pango_glyph_cache_lookup (CoglPangoGlyphCache *cache,
 
   value = g_hash_table_lookup (cache->hash_table, &lookup_key);
 
-  if (create && value == NULL)
+  if (value)
+    {
+      value->age = cache->age;
+
+      /* Move the glyph to the front of the queue */
+      if (value->texture)
+        {
+          g_queue_unlink (&cache->lru_queue, &value->lru_link);
+          g_queue_push_head_link (&cache->lru_queue, &value->lru_link);
+        }
+    }
+  else if (create)
     {
       CoglPangoGlyphCacheKey *key;
       PangoRectangle ink_rect;
 
-      value = g_slice_new (CoglPangoGlyphCacheValue);
+      value = g_slice_new0 (CoglPangoGlyphCacheValue);
       value->texture = NULL;
+      value->age = cache->age;
 
       pango_font_get_glyph_extents (font, glyph, &ink_rect, NULL);
       pango_extents_to_pixels (&ink_rect, NULL);
@@ -343,6 +538,12 @@ cogl_pango_glyph_cache_lookup (CoglPangoGlyphCache *cache,
         value->dirty = FALSE;
       else
         {
+          /* Make some space for the glyph. This assumes it will go in
+             a local atlas because that is the smallest it can be */
+          cogl_pango_glyph_cache_evict (cache,
+                                        (ink_rect.width + 1) *
+                                        (ink_rect.height + 1));
+
           /* Try adding the glyph to the global atlas... */
           if (!cogl_pango_glyph_cache_add_to_global_atlas (cache,
                                                            font,
@@ -358,6 +559,12 @@ cogl_pango_glyph_cache_lookup (CoglPangoGlyphCache *cache,
               return NULL;
             }
 
+          if (value->atlas)
+            value->size = ((value->draw_width + 1) *
+                           (value->draw_height + 1));
+          else
+            value->size = value->draw_width * value->draw_height * 4;
+
           value->dirty = TRUE;
           cache->has_dirty_glyphs = TRUE;
         }
@@ -367,40 +574,299 @@ cogl_pango_glyph_cache_lookup (CoglPangoGlyphCache *cache,
       key->glyph = glyph;
 
       g_hash_table_insert (cache->hash_table, key, value);
+
+      if (value->texture)
+        {
+          value->lru_link.data = key;
+          g_queue_push_head_link (&cache->lru_queue, &value->lru_link);
+          cache->size += value->size;
+        }
     }
 
   return value;
 }
 
+typedef struct
+{
+  /* Array of CoglPangoGlyphCacheDirtyGlyphs */
+  GArray *dirty_glyphs;
+  /* Array of pointers to the values of the glyphs that have a
+     texture but don't need redrawing */
+  GArray *clean_glyphs;
+} CoglPangoGlyphCacheCollectData;
+
+typedef struct
+{
+  int x1, y1, x2, y2;
+} CoglPangoGlyphCacheRegion;
+
 static void
-_cogl_pango_glyph_cache_set_dirty_glyphs_cb (void *key_ptr,
-                                             void *value_ptr,
-                                             void *user_data)
+_cogl_pango_glyph_cache_collect_glyphs_cb (void *key_ptr,
+                                           void *value_ptr,
+                                           void *user_data)
 {
   CoglPangoGlyphCacheKey *key = key_ptr;
   CoglPangoGlyphCacheValue *value = value_ptr;
-  CoglPangoGlyphCacheDirtyFunc func = user_data;
+  CoglPangoGlyphCacheCollectData *data = user_data;
 
   if (value->dirty)
     {
-      func (key->font, key->glyph, value);
+      CoglPangoGlyphCacheDirtyGlyph dirty_glyph;
+
+      dirty_glyph.font = key->font;
+      dirty_glyph.glyph = key->glyph;
+      dirty_glyph.value = value;
+      g_array_append_val (data->dirty_glyphs, dirty_glyph);
 
       value->dirty = FALSE;
     }
+  else if (value->texture)
+    g_array_append_val (data->clean_glyphs, value);
+}
+
+static int
+compare_textures (CoglTexture *a,
+                  CoglTexture *b)
+{
+  if (a < b)
+    return -1;
+  else if (a > b)
+    return 1;
+  else
+    return 0;
+}
+
+static int
+compare_dirty_glyphs (const void *a_ptr,
+                      const void *b_ptr)
+{
+  const CoglPangoGlyphCacheValue *a =
+    ((const CoglPangoGlyphCacheDirtyGlyph *) a_ptr)->value;
+  const CoglPangoGlyphCacheValue *b =
+    ((const CoglPangoGlyphCacheDirtyGlyph *) b_ptr)->value;
+
+  /* Sort by texture and then in reading order within the texture so
+     that neighbouring glyphs end up next to each other */
+  if (a->texture != b->texture)
+    return compare_textures (a->texture, b->texture);
+  else if (a->ty_pixel != b->ty_pixel)
+    return a->ty_pixel - b->ty_pixel;
+  else
+    return a->tx_pixel - b->tx_pixel;
+}
+
+static int
+compare_clean_glyphs (const void *a_ptr,
+                      const void *b_ptr)
+{
+  const CoglPangoGlyphCacheValue *a =
+    *(CoglPangoGlyphCacheValue * const *) a_ptr;
+  const CoglPangoGlyphCacheValue *b =
+    *(CoglPangoGlyphCacheValue * const *) b_ptr;
+
+  return compare_textures (a->texture, b->texture);
+}
+
+static CoglBool
+region_overlaps_glyph (const CoglPangoGlyphCacheRegion *region,
+                       const CoglPangoGlyphCacheValue *value)
+{
+  return (value->tx_pixel < region->x2 &&
+          value->tx_pixel + value->draw_width > region->x1 &&
+          value->ty_pixel < region->y2 &&
+          value->ty_pixel + value->draw_height > region->y1);
+}
+
+static CoglBool
+region_overlaps_glyphs (const CoglPangoGlyphCacheRegion *region,
+                        CoglPangoGlyphCacheValue **glyphs,
+                        int n_glyphs)
+{
+  int i;
+
+  for (i = 0; i < n_glyphs; i++)
+    if (region_overlaps_glyph (region, glyphs[i]))
+      return TRUE;
+
+  return FALSE;
+}
+
+/* Checks whether the region overlaps any of the dirty glyphs apart
+   from the ones in the range [first, last]. The other dirty glyphs
+   are drawn by a different job so the region would clear them if it
+   was uploaded after their job */
+static CoglBool
+region_overlaps_dirty_glyphs (const CoglPangoGlyphCacheRegion *region,
+                              const CoglPangoGlyphCacheDirtyGlyph *glyphs,
+                              int n_glyphs,
+                              int first,
+                              int last)
+{
+  int i;
+
+  for (i = 0; i < n_glyphs; i++)
+    if ((i < first || i > last) &&
+        region_overlaps_glyph (region, glyphs[i].value))
+      return TRUE;
+
+  return FALSE;
+}
+
+static int
+get_glyph_region (const CoglPangoGlyphCacheValue *value,
+                  CoglPangoGlyphCacheRegion *region)
+{
+  /* Include the border that local atlases leave around the glyph so
+     that regions can be joined up without any gaps */
+  int border = value->atlas ? 1 : 0;
+
+  region->x1 = value->tx_pixel;
+  region->y1 = value->ty_pixel;
+  region->x2 = value->tx_pixel + value->draw_width + border;
+  region->y2 = value->ty_pixel + value->draw_height + border;
+
+  return (region->x2 - region->x1) * (region->y2 - region->y1);
+}
+
+/* Redraws the dirty glyphs of a single texture. Neighbouring glyphs
+   are combined into one region as long as the region wouldn't cover
+   any other glyph, clean or dirty, and wouldn't be mostly empty. This
+   means that when the whole atlas is dirty after a reorganization it
+   can be uploaded in one go */
+static void
+_cogl_pango_glyph_cache_redraw_texture (CoglPangoGlyphCacheDirtyGlyph *glyphs,
+                                        int n_glyphs,
+                                        CoglPangoGlyphCacheValue **clean,
+                                        int n_clean,
+                                        CoglPangoGlyphCacheDirtyFunc func,
+                                        void *user_data)
+{
+  CoglTexture *texture = glyphs[0].value->texture;
+  CoglPangoGlyphCacheRegion region;
+  int region_area;
+  int first_glyph = 0;
+  int i;
+
+  region_area = get_glyph_region (glyphs[0].value, &region);
+
+  for (i = 1; i < n_glyphs; i++)
+    {
+      CoglPangoGlyphCacheRegion glyph_region, combined;
+      int glyph_area = get_glyph_region (glyphs[i].value, &glyph_region);
+
+      combined.x1 = MIN (region.x1, glyph_region.x1);
+      combined.y1 = MIN (region.y1, glyph_region.y1);
+      combined.x2 = MAX (region.x2, glyph_region.x2);
+      combined.y2 = MAX (region.y2, glyph_region.y2);
+
+      if ((combined.x2 - combined.x1) * (combined.y2 - combined.y1) <=
+          (region_area + glyph_area) * 2 &&
+          !region_overlaps_glyphs (&combined, clean, n_clean) &&
+          !region_overlaps_dirty_glyphs (&combined,
+                                         glyphs, n_glyphs,
+                                         first_glyph, i))
+        {
+          region = combined;
+          region_area += glyph_area;
+        }
+      else
+        {
+          func (texture,
+                region.x1, region.y1,
+                region.x2 - region.x1, region.y2 - region.y1,
+                glyphs + first_glyph,
+                i - first_glyph,
+                user_data);
+
+          first_glyph = i;
+          region = glyph_region;
+          region_area = glyph_area;
+        }
+    }
+
+  func (texture,
+        region.x1, region.y1,
+        region.x2 - region.x1, region.y2 - region.y1,
+        glyphs + first_glyph,
+        n_glyphs - first_glyph,
+        user_data);
 }
 
 void
 _cogl_pango_glyph_cache_set_dirty_glyphs (CoglPangoGlyphCache *cache,
-                                          CoglPangoGlyphCacheDirtyFunc func)
+                                          CoglPangoGlyphCacheDirtyFunc func,
+                                          void *user_data)
 {
+  CoglPangoGlyphCacheCollectData data;
+  CoglPangoGlyphCacheDirtyGlyph *dirty_glyphs;
+  CoglPangoGlyphCacheValue **clean_glyphs;
+  int n_dirty_glyphs, n_clean_glyphs;
+  int dirty_start, clean_start;
+
+  /* Any glyphs used from now on will be newer than the glyphs that
+     were needed to get here */
+  cache->age++;
+
   /* If we know that there are no dirty glyphs then we can shortcut
      out early */
   if (!cache->has_dirty_glyphs)
     return;
 
+  data.dirty_glyphs =
+    g_array_new (FALSE, FALSE, sizeof (CoglPangoGlyphCacheDirtyGlyph));
+  data.clean_glyphs =
+    g_array_new (FALSE, FALSE, sizeof (CoglPangoGlyphCacheValue *));
+
   g_hash_table_foreach (cache->hash_table,
-                        _cogl_pango_glyph_cache_set_dirty_glyphs_cb,
-                        func);
+                        _cogl_pango_glyph_cache_collect_glyphs_cb,
+                        &data);
+
+  g_array_sort (data.dirty_glyphs, compare_dirty_glyphs);
+  g_array_sort (data.clean_glyphs, compare_clean_glyphs);
+
+  dirty_glyphs = (CoglPangoGlyphCacheDirtyGlyph *) data.dirty_glyphs->data;
+  n_dirty_glyphs = data.dirty_glyphs->len;
+  clean_glyphs = (CoglPangoGlyphCacheValue **) data.clean_glyphs->data;
+  n_clean_glyphs = data.clean_glyphs->len;
+
+  /* Both arrays are sorted by texture so we can walk through them
+     together to redraw each texture in turn */
+  clean_start = 0;
+
+  for (dirty_start = 0; dirty_start < n_dirty_glyphs; )
+    {
+      CoglTexture *texture = dirty_glyphs[dirty_start].value->texture;
+      int dirty_end, clean_end;
+
+      for (dirty_end = dirty_start + 1;
+           dirty_end < n_dirty_glyphs &&
+             dirty_glyphs[dirty_end].value->texture == texture;
+           dirty_end++)
+        ;
+
+      while (clean_start < n_clean_glyphs &&
+             compare_textures (clean_glyphs[clean_start]->texture,
+                               texture) < 0)
+        clean_start++;
+      for (clean_end = clean_start;
+           clean_end < n_clean_glyphs &&
+             clean_glyphs[clean_end]->texture == texture;
+           clean_end++)
+        ;
+
+      _cogl_pango_glyph_cache_redraw_texture (dirty_glyphs + dirty_start,
+                                              dirty_end - dirty_start,
+                                              clean_glyphs + clean_start,
+                                              clean_end - clean_start,
+                                              func,
+                                              user_data);
+
+      dirty_start = dirty_end;
+      clean_start = clean_end;
+    }
+
+  g_array_free (data.dirty_glyphs, TRUE);
+  g_array_free (data.clean_glyphs, TRUE);
 
   cache->has_dirty_glyphs = FALSE;
 }
@@ -28,6 +28,8 @@
 #include <cogl/cogl.h>
 #include <pango/pango-font.h>
 
+#include "cogl/cogl-atlas.h"
+
 COGL_BEGIN_DECLS
 
 typedef struct _CoglPangoGlyphCache      CoglPangoGlyphCache;
@@ -50,14 +52,44 @@ struct _CoglPangoGlyphCacheValue
   int draw_width;
   int draw_height;
 
+  /* The local atlas that the glyph was put in or NULL if it is in the
+     global atlas */
+  CoglAtlas *atlas;
+
+  /* The number of bytes of texture memory used by the glyph */
+  size_t size;
+  /* The value of the cache's age counter when the glyph was last
+     used */
+  unsigned int age;
+  /* Link in the cache's list of glyphs that take up space. The list
+     is sorted so that the most recently used glyph is first. The
+     data points to the glyph's key */
+  GList lru_link;
+
   /* This will be set to TRUE when the glyph atlas is reorganized
      which means the glyph will need to be redrawn */
   CoglBool   dirty;
 };
 
-typedef void (* CoglPangoGlyphCacheDirtyFunc) (PangoFont *font,
-                                               PangoGlyph glyph,
-                                               CoglPangoGlyphCacheValue *value);
+typedef struct
+{
+  PangoFont *font;
+  PangoGlyph glyph;
+  CoglPangoGlyphCacheValue *value;
+} CoglPangoGlyphCacheDirtyGlyph;
+
+/* Called to redraw a region of a texture. The region contains all of
+   the given glyphs. Any part of the region that isn't covered by the
+   glyphs doesn't contain any other glyphs so it can be cleared */
+typedef void (* CoglPangoGlyphCacheDirtyFunc)
+     (CoglTexture *texture,
+      int x,
+      int y,
+      int width,
+      int height,
+      const CoglPangoGlyphCacheDirtyGlyph *glyphs,
+      int n_glyphs,
+      void *user_data);
 
 CoglPangoGlyphCache *
 cogl_pango_glyph_cache_new (CoglContext *ctx,
@@ -75,6 +107,16 @@ cogl_pango_glyph_cache_lookup (CoglPangoGlyphCache *cache,
 void
 cogl_pango_glyph_cache_clear (CoglPangoGlyphCache *cache);
 
+void
+_cogl_pango_glyph_cache_set_max_size (CoglPangoGlyphCache *cache,
+                                      size_t max_size);
+
+size_t
+_cogl_pango_glyph_cache_get_max_size (CoglPangoGlyphCache *cache);
+
+size_t
+_cogl_pango_glyph_cache_get_size (CoglPangoGlyphCache *cache);
+
 void
 _cogl_pango_glyph_cache_add_reorganize_callback (CoglPangoGlyphCache *cache,
                                                  GHookFunc func,
@@ -87,7 +129,8 @@ _cogl_pango_glyph_cache_remove_reorganize_callback (CoglPangoGlyphCache *cache,
 
 void
 _cogl_pango_glyph_cache_set_dirty_glyphs (CoglPangoGlyphCache *cache,
-                                          CoglPangoGlyphCacheDirtyFunc func);
+                                          CoglPangoGlyphCacheDirtyFunc func,
+                                          void *user_data);
 
 COGL_END_DECLS
 
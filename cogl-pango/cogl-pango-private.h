@@ -46,6 +46,23 @@ _cogl_pango_renderer_set_use_mipmapping (CoglPangoRenderer *renderer,
 CoglBool
 _cogl_pango_renderer_get_use_mipmapping (CoglPangoRenderer *renderer);
 
+void
+_cogl_pango_renderer_set_glyph_cache_budget (CoglPangoRenderer *renderer,
+                                             size_t budget);
+
+size_t
+_cogl_pango_renderer_get_glyph_cache_budget (CoglPangoRenderer *renderer);
+
+size_t
+_cogl_pango_renderer_get_glyph_cache_size (CoglPangoRenderer *renderer);
+
+void
+_cogl_pango_renderer_set_rasterization_threads (CoglPangoRenderer *renderer,
+                                                int n_threads);
+
+int
+_cogl_pango_renderer_get_rasterization_threads (CoglPangoRenderer *renderer);
+
 
 
 CoglContext *
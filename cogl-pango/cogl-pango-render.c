@@ -76,6 +76,18 @@ struct _CoglPangoRenderer
 
   /* The current display list that is being built */
   CoglPangoDisplayList *display_list;
+
+  /* Thread pool used to rasterize the glyphs or NULL if they are
+     rasterized on the main thread */
+  GThreadPool *rasterize_pool;
+  int n_rasterize_threads;
+  /* Queue of CoglPangoGlyphJobs in the order that they were
+     submitted. They are uploaded in the same order so that a later
+     job always wins if two jobs cover the same part of a texture */
+  GQueue glyph_jobs;
+  /* Protects the done flag of the jobs */
+  GMutex glyph_jobs_mutex;
+  GCond glyph_jobs_cond;
 };
 
 struct _CoglPangoRendererClass
@@ -101,9 +113,43 @@ struct _CoglPangoLayoutQdata
   CoglBool mipmapping_used;
 };
 
+typedef struct
+{
+  cairo_scaled_font_t *scaled_font;
+  unsigned long index;
+  /* The rectangle for the glyph within the job's surface */
+  int x, y;
+  int width, height;
+  /* The offset of the glyph's origin from its rectangle */
+  int draw_x, draw_y;
+} CoglPangoGlyphJobGlyph;
+
+/* A region of a glyph texture that needs to be rasterized and
+   uploaded. The rasterization only uses cairo so it can be done on
+   another thread but the upload is always done on the main thread */
+typedef struct
+{
+  CoglTexture *texture;
+  int x, y;
+  int width, height;
+
+  cairo_format_t format_cairo;
+  CoglPixelFormat format_cogl;
+
+  CoglPangoGlyphJobGlyph *glyphs;
+  int n_glyphs;
+
+  cairo_surface_t *surface;
+  CoglBool done;
+} CoglPangoGlyphJob;
+
 static void
 _cogl_pango_ensure_glyph_cache_for_layout_line (PangoLayoutLine *line);
 
+static void
+_cogl_pango_renderer_finish_glyph_jobs (CoglPangoRenderer *priv,
+                                        CoglBool wait);
+
 typedef struct
 {
   CoglPangoDisplayList *display_list;
@@ -201,6 +247,9 @@ G_DEFINE_TYPE (CoglPangoRenderer, cogl_pango_renderer, PANGO_TYPE_RENDERER);
 static void
 cogl_pango_renderer_init (CoglPangoRenderer *priv)
 {
+  g_queue_init (&priv->glyph_jobs);
+  g_mutex_init (&priv->glyph_jobs_mutex);
+  g_cond_init (&priv->glyph_jobs_cond);
 }
 
 static void
@@ -276,6 +325,10 @@ cogl_pango_renderer_dispose (GObject *object)
 {
   CoglPangoRenderer *priv = COGL_PANGO_RENDERER (object);
 
+  /* The jobs need the context to upload their results so they have
+     to be finished before we let go of it */
+  _cogl_pango_renderer_set_rasterization_threads (priv, 0);
+
   if (priv->ctx)
     {
       cogl_object_unref (priv->ctx);
@@ -294,6 +347,9 @@ cogl_pango_renderer_finalize (GObject *object)
   _cogl_pango_pipeline_cache_free (priv->no_mipmap_caches.pipeline_cache);
   _cogl_pango_pipeline_cache_free (priv->mipmap_caches.pipeline_cache);
 
+  g_mutex_clear (&priv->glyph_jobs_mutex);
+  g_cond_clear (&priv->glyph_jobs_cond);
+
   G_OBJECT_CLASS (cogl_pango_renderer_parent_class)->finalize (object);
 }
 
@@ -420,6 +476,9 @@ cogl_pango_show_layout (CoglFramebuffer *fb,
       qdata->mipmapping_used = priv->use_mipmapping;
     }
 
+  /* The glyphs need to be in their textures before we can draw */
+  _cogl_pango_renderer_finish_glyph_jobs (priv, TRUE);
+
   cogl_framebuffer_push_matrix (fb);
   cogl_framebuffer_translate (fb, x, y, 0);
 
@@ -500,6 +559,8 @@ cogl_pango_show_layout_line (CoglFramebuffer *fb,
   pango_renderer_draw_layout_line (PANGO_RENDERER (priv), line,
                                    pango_x, pango_y);
 
+  _cogl_pango_renderer_finish_glyph_jobs (priv, TRUE);
+
   _cogl_pango_display_list_render (fb,
                                    priv->display_list,
                                    color);
@@ -541,6 +602,32 @@ _cogl_pango_renderer_get_use_mipmapping (CoglPangoRenderer *renderer)
   return renderer->use_mipmapping;
 }
 
+void
+_cogl_pango_renderer_set_glyph_cache_budget (CoglPangoRenderer *renderer,
+                                             size_t budget)
+{
+  _cogl_pango_glyph_cache_set_max_size (renderer->mipmap_caches.glyph_cache,
+                                        budget);
+  _cogl_pango_glyph_cache_set_max_size (renderer->no_mipmap_caches.glyph_cache,
+                                        budget);
+}
+
+size_t
+_cogl_pango_renderer_get_glyph_cache_budget (CoglPangoRenderer *renderer)
+{
+  CoglPangoGlyphCache *cache = renderer->no_mipmap_caches.glyph_cache;
+
+  return _cogl_pango_glyph_cache_get_max_size (cache);
+}
+
+size_t
+_cogl_pango_renderer_get_glyph_cache_size (CoglPangoRenderer *renderer)
+{
+  return
+    _cogl_pango_glyph_cache_get_size (renderer->mipmap_caches.glyph_cache) +
+    _cogl_pango_glyph_cache_get_size (renderer->no_mipmap_caches.glyph_cache);
+}
+
 static CoglPangoGlyphCacheValue *
 cogl_pango_renderer_get_cached_glyph (PangoRenderer *renderer,
                                       CoglBool       create,
@@ -557,79 +644,236 @@ cogl_pango_renderer_get_cached_glyph (PangoRenderer *renderer,
 }
 
 static void
-cogl_pango_renderer_set_dirty_glyph (PangoFont *font,
-                                     PangoGlyph glyph,
-                                     CoglPangoGlyphCacheValue *value)
+cogl_pango_glyph_job_rasterize (CoglPangoGlyphJob *job)
 {
-  cairo_surface_t *surface;
   cairo_t *cr;
-  cairo_scaled_font_t *scaled_font;
-  cairo_glyph_t cairo_glyph;
-  cairo_format_t format_cairo;
-  CoglPixelFormat format_cogl;
+  int i;
+
+  /* All of the glyphs are drawn into one surface laid out like the
+     texture so that the region can be uploaded with a single
+     transfer */
+  job->surface = cairo_image_surface_create (job->format_cairo,
+                                             job->width,
+                                             job->height);
+  cr = cairo_create (job->surface);
+
+  cairo_set_source_rgba (cr, 1.0, 1.0, 1.0, 1.0);
+
+  for (i = 0; i < job->n_glyphs; i++)
+    {
+      const CoglPangoGlyphJobGlyph *glyph = job->glyphs + i;
+      cairo_glyph_t cairo_glyph;
+
+      cairo_set_scaled_font (cr, glyph->scaled_font);
+
+      /* Make sure the glyph can't spill over into its neighbours */
+      cairo_save (cr);
+      cairo_rectangle (cr, glyph->x, glyph->y, glyph->width, glyph->height);
+      cairo_clip (cr);
+
+      cairo_glyph.x = glyph->x - glyph->draw_x;
+      cairo_glyph.y = glyph->y - glyph->draw_y;
+      /* The PangoCairo glyph numbers directly map to Cairo glyph
+         numbers */
+      cairo_glyph.index = glyph->index;
+      cairo_show_glyphs (cr, &cairo_glyph, 1);
+
+      cairo_restore (cr);
+    }
+
+  cairo_destroy (cr);
+  cairo_surface_flush (job->surface);
+}
+
+static void
+cogl_pango_glyph_job_upload (CoglPangoGlyphJob *job)
+{
+  /* Copy the glyphs to the texture */
+  cogl_texture_set_region (job->texture,
+                           0, /* src_x */
+                           0, /* src_y */
+                           job->x, /* dst_x */
+                           job->y, /* dst_y */
+                           job->width, /* dst_width */
+                           job->height, /* dst_height */
+                           job->width, /* width */
+                           job->height, /* height */
+                           job->format_cogl,
+                           cairo_image_surface_get_stride (job->surface),
+                           cairo_image_surface_get_data (job->surface));
+}
+
+static void
+cogl_pango_glyph_job_free (CoglPangoGlyphJob *job)
+{
+  int i;
+
+  for (i = 0; i < job->n_glyphs; i++)
+    cairo_scaled_font_destroy (job->glyphs[i].scaled_font);
+  g_free (job->glyphs);
+
+  if (job->surface)
+    cairo_surface_destroy (job->surface);
+
+  cogl_object_unref (job->texture);
+
+  g_slice_free (CoglPangoGlyphJob, job);
+}
+
+static void
+cogl_pango_renderer_rasterize_thread_func (void *data,
+                                           void *user_data)
+{
+  CoglPangoGlyphJob *job = data;
+  CoglPangoRenderer *priv = user_data;
+
+  cogl_pango_glyph_job_rasterize (job);
+
+  g_mutex_lock (&priv->glyph_jobs_mutex);
+  job->done = TRUE;
+  g_cond_broadcast (&priv->glyph_jobs_cond);
+  g_mutex_unlock (&priv->glyph_jobs_mutex);
+}
+
+/* Uploads the results of the jobs that have finished rasterizing. If
+   @wait is TRUE then this will block until all of the jobs are
+   finished, otherwise it stops at the first job that is still being
+   rasterized */
+static void
+_cogl_pango_renderer_finish_glyph_jobs (CoglPangoRenderer *priv,
+                                        CoglBool wait)
+{
+  CoglPangoGlyphJob *job;
+
+  while ((job = g_queue_peek_head (&priv->glyph_jobs)))
+    {
+      CoglBool done;
+
+      g_mutex_lock (&priv->glyph_jobs_mutex);
+      if (wait)
+        while (!job->done)
+          g_cond_wait (&priv->glyph_jobs_cond, &priv->glyph_jobs_mutex);
+      done = job->done;
+      g_mutex_unlock (&priv->glyph_jobs_mutex);
+
+      if (!done)
+        break;
+
+      g_queue_pop_head (&priv->glyph_jobs);
+
+      cogl_pango_glyph_job_upload (job);
+      cogl_pango_glyph_job_free (job);
+    }
+}
 
-  COGL_NOTE (PANGO, "redrawing glyph %i", glyph);
+static void
+cogl_pango_renderer_set_dirty_glyphs
+                              (CoglTexture *texture,
+                               int x,
+                               int y,
+                               int width,
+                               int height,
+                               const CoglPangoGlyphCacheDirtyGlyph *glyphs,
+                               int n_glyphs,
+                               void *user_data)
+{
+  CoglPangoRenderer *priv = user_data;
+  CoglPangoGlyphJob *job;
+  int i;
 
-  /* Glyphs that don't take up any space will end up without a
-     texture. These should never become dirty so they shouldn't end up
-     here */
-  _COGL_RETURN_IF_FAIL (value->texture != NULL);
+  job = g_slice_new0 (CoglPangoGlyphJob);
+  job->texture = cogl_object_ref (texture);
+  job->x = x;
+  job->y = y;
+  job->width = width;
+  job->height = height;
 
-  if (cogl_texture_get_format (value->texture) == COGL_PIXEL_FORMAT_A_8)
+  if (cogl_texture_get_format (texture) == COGL_PIXEL_FORMAT_A_8)
     {
-      format_cairo = CAIRO_FORMAT_A8;
-      format_cogl = COGL_PIXEL_FORMAT_A_8;
+      job->format_cairo = CAIRO_FORMAT_A8;
+      job->format_cogl = COGL_PIXEL_FORMAT_A_8;
     }
   else
     {
-      format_cairo = CAIRO_FORMAT_ARGB32;
+      job->format_cairo = CAIRO_FORMAT_ARGB32;
 
       /* Cairo stores the data in native byte order as ARGB but Cogl's
          pixel formats specify the actual byte order. Therefore we
          need to use a different format depending on the
          architecture */
 #if G_BYTE_ORDER == G_LITTLE_ENDIAN
-      format_cogl = COGL_PIXEL_FORMAT_BGRA_8888_PRE;
+      job->format_cogl = COGL_PIXEL_FORMAT_BGRA_8888_PRE;
 #else
-      format_cogl = COGL_PIXEL_FORMAT_ARGB_8888_PRE;
+      job->format_cogl = COGL_PIXEL_FORMAT_ARGB_8888_PRE;
 #endif
     }
 
-  surface = cairo_image_surface_create (format_cairo,
-                                        value->draw_width,
-                                        value->draw_height);
-  cr = cairo_create (surface);
+  /* Copy everything the rasterization needs out of the glyph cache
+     because the cache may change before the job gets run */
+  job->n_glyphs = n_glyphs;
+  job->glyphs = g_new (CoglPangoGlyphJobGlyph, n_glyphs);
 
-  scaled_font = pango_cairo_font_get_scaled_font (PANGO_CAIRO_FONT (font));
-  cairo_set_scaled_font (cr, scaled_font);
+  for (i = 0; i < n_glyphs; i++)
+    {
+      const CoglPangoGlyphCacheDirtyGlyph *dirty_glyph = glyphs + i;
+      const CoglPangoGlyphCacheValue *value = dirty_glyph->value;
+      CoglPangoGlyphJobGlyph *job_glyph = job->glyphs + i;
+      PangoCairoFont *font = PANGO_CAIRO_FONT (dirty_glyph->font);
+
+      COGL_NOTE (PANGO, "redrawing glyph %i", dirty_glyph->glyph);
+
+      job_glyph->scaled_font =
+        cairo_scaled_font_reference (pango_cairo_font_get_scaled_font (font));
+      job_glyph->index = dirty_glyph->glyph;
+      job_glyph->x = value->tx_pixel - x;
+      job_glyph->y = value->ty_pixel - y;
+      job_glyph->width = value->draw_width;
+      job_glyph->height = value->draw_height;
+      job_glyph->draw_x = value->draw_x;
+      job_glyph->draw_y = value->draw_y;
+    }
 
-  cairo_set_source_rgba (cr, 1.0, 1.0, 1.0, 1.0);
+  if (priv->rasterize_pool)
+    {
+      g_queue_push_tail (&priv->glyph_jobs, job);
+      g_thread_pool_push (priv->rasterize_pool, job, NULL);
+    }
+  else
+    {
+      cogl_pango_glyph_job_rasterize (job);
+      cogl_pango_glyph_job_upload (job);
+      cogl_pango_glyph_job_free (job);
+    }
+}
 
-  cairo_glyph.x = -value->draw_x;
-  cairo_glyph.y = -value->draw_y;
-  /* The PangoCairo glyph numbers directly map to Cairo glyph
-     numbers */
-  cairo_glyph.index = glyph;
-  cairo_show_glyphs (cr, &cairo_glyph, 1);
+void
+_cogl_pango_renderer_set_rasterization_threads (CoglPangoRenderer *renderer,
+                                                int n_threads)
+{
+  if (renderer->rasterize_pool)
+    {
+      _cogl_pango_renderer_finish_glyph_jobs (renderer, TRUE);
+      g_thread_pool_free (renderer->rasterize_pool,
+                          FALSE, /* don't drop queued jobs */
+                          TRUE /* wait */);
+      renderer->rasterize_pool = NULL;
+    }
 
-  cairo_destroy (cr);
-  cairo_surface_flush (surface);
+  renderer->n_rasterize_threads = MAX (n_threads, 0);
 
-  /* Copy the glyph to the texture */
-  cogl_texture_set_region (value->texture,
-                           0, /* src_x */
-                           0, /* src_y */
-                           value->tx_pixel, /* dst_x */
-                           value->ty_pixel, /* dst_y */
-                           value->draw_width, /* dst_width */
-                           value->draw_height, /* dst_height */
-                           value->draw_width, /* width */
-                           value->draw_height, /* height */
-                           format_cogl,
-                           cairo_image_surface_get_stride (surface),
-                           cairo_image_surface_get_data (surface));
+  if (renderer->n_rasterize_threads > 0)
+    renderer->rasterize_pool =
+      g_thread_pool_new (cogl_pango_renderer_rasterize_thread_func,
+                         renderer,
+                         renderer->n_rasterize_threads,
+                         FALSE, /* not exclusive */
+                         NULL /* error */);
+}
 
-  cairo_surface_destroy (surface);
+int
+_cogl_pango_renderer_get_rasterization_threads (CoglPangoRenderer *renderer)
+{
+  return renderer->n_rasterize_threads;
 }
 
 static void
@@ -669,10 +913,18 @@ _cogl_pango_ensure_glyph_cache_for_layout_line_internal (PangoLayoutLine *line)
 static void
 _cogl_pango_set_dirty_glyphs (CoglPangoRenderer *priv)
 {
+  /* Upload anything that has already been rasterized while we're
+     here so that it doesn't pile up */
+  _cogl_pango_renderer_finish_glyph_jobs (priv, FALSE);
+
   _cogl_pango_glyph_cache_set_dirty_glyphs
-    (priv->mipmap_caches.glyph_cache, cogl_pango_renderer_set_dirty_glyph);
+    (priv->mipmap_caches.glyph_cache,
+     cogl_pango_renderer_set_dirty_glyphs,
+     priv);
   _cogl_pango_glyph_cache_set_dirty_glyphs
-    (priv->no_mipmap_caches.glyph_cache, cogl_pango_renderer_set_dirty_glyph);
+    (priv->no_mipmap_caches.glyph_cache,
+     cogl_pango_renderer_set_dirty_glyphs,
+     priv);
 }
 
 static void
@@ -140,6 +140,102 @@ cogl_pango_font_map_set_use_mipmapping (CoglPangoFontMap *font_map,
 CoglBool
 cogl_pango_font_map_get_use_mipmapping (CoglPangoFontMap *font_map);
 
+/**
+ * cogl_pango_font_map_set_glyph_cache_budget:
+ * @font_map: a #CoglPangoFontMap
+ * @budget: the maximum number of bytes of texture memory to use for
+ *   glyphs or 0 for no limit
+ *
+ * Sets the amount of texture memory that the glyph cache for
+ * @font_map should try to stay within. When the limit is reached
+ * the glyphs that were used least recently are evicted to make space
+ * for new ones. Glyphs that are needed by the layout currently being
+ * rendered are never evicted so the budget may be exceeded
+ * temporarily. The budget applies separately to the mipmapped and
+ * non-mipmapped glyphs.
+ *
+ * The default budget is 16MB.
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+void
+cogl_pango_font_map_set_glyph_cache_budget (CoglPangoFontMap *font_map,
+                                            size_t budget);
+
+/**
+ * cogl_pango_font_map_get_glyph_cache_budget:
+ * @font_map: a #CoglPangoFontMap
+ *
+ * Retrieves the budget for the glyph cache set with
+ * cogl_pango_font_map_set_glyph_cache_budget().
+ *
+ * Return value: the maximum number of bytes of texture memory that
+ *   the glyph cache will try to use or 0 if there is no limit
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+size_t
+cogl_pango_font_map_get_glyph_cache_budget (CoglPangoFontMap *font_map);
+
+/**
+ * cogl_pango_font_map_get_glyph_cache_size:
+ * @font_map: a #CoglPangoFontMap
+ *
+ * Retrieves the amount of texture memory that is currently used by
+ * the glyphs cached for @font_map. This can be compared with the
+ * budget set with cogl_pango_font_map_set_glyph_cache_budget().
+ *
+ * Return value: the number of bytes of texture memory used by the
+ *   mipmapped and non-mipmapped glyph caches together
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+size_t
+cogl_pango_font_map_get_glyph_cache_size (CoglPangoFontMap *font_map);
+
+/**
+ * cogl_pango_font_map_set_rasterization_threads:
+ * @font_map: a #CoglPangoFontMap
+ * @n_threads: the number of threads to use or 0 to rasterize glyphs
+ *   on the calling thread
+ *
+ * Sets how many worker threads the renderer for @font_map should use
+ * to rasterize new glyphs. When this is non-zero
+ * cogl_pango_ensure_glyph_cache_for_layout() only starts rendering
+ * the glyphs and returns straight away. The glyphs are uploaded to
+ * their textures the next time a layout is drawn, which will block
+ * until any glyphs still being rendered are finished. Calling
+ * cogl_pango_ensure_glyph_cache_for_layout() well before drawing a
+ * layout therefore lets the glyphs be rendered while the application
+ * carries on with other work.
+ *
+ * The default is 0.
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+void
+cogl_pango_font_map_set_rasterization_threads (CoglPangoFontMap *font_map,
+                                               int n_threads);
+
+/**
+ * cogl_pango_font_map_get_rasterization_threads:
+ * @font_map: a #CoglPangoFontMap
+ *
+ * Retrieves the number of threads set with
+ * cogl_pango_font_map_set_rasterization_threads().
+ *
+ * Return value: the number of threads used to rasterize glyphs
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+int
+cogl_pango_font_map_get_rasterization_threads (CoglPangoFontMap *font_map);
+
 /**
  * cogl_pango_font_map_get_renderer:
  * @font_map: a #CoglPangoFontMap
@@ -76,6 +76,11 @@ struct _CoglAttribute
     } constant;
   } d;
 
+  /* When this is non-zero the attribute advances once per this many
+   * instances instead of once per vertex. This is only used
+   * internally by the journal and requires instanced arrays */
+  int instance_divisor;
+
   int immutable_ref;
 };
 
@@ -107,6 +112,10 @@ CoglAttributeNameState *
 _cogl_attribute_register_attribute_name (CoglContext *context,
                                          const char *name);
 
+void
+_cogl_attribute_set_instance_divisor (CoglAttribute *attribute,
+                                      int divisor);
+
 CoglAttribute *
 _cogl_attribute_immutable_ref (CoglAttribute *attribute);
 
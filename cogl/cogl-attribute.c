@@ -241,6 +241,7 @@ cogl_attribute_new (CoglAttributeBuffer *attribute_buffer,
   attribute->d.buffered.n_components = n_components;
   attribute->d.buffered.type = type;
 
+  attribute->instance_divisor = 0;
   attribute->immutable_ref = 0;
 
   if (attribute->name_state->name_id != COGL_ATTRIBUTE_NAME_ID_CUSTOM_ARRAY)
@@ -286,6 +287,7 @@ _cogl_attribute_new_const (CoglContext *context,
 
   attribute->is_buffered = FALSE;
   attribute->normalized = FALSE;
+  attribute->instance_divisor = 0;
 
   attribute->d.constant.context = cogl_object_ref (context);
 
@@ -517,6 +519,19 @@ cogl_attribute_set_buffer (CoglAttribute *attribute,
   attribute->d.buffered.attribute_buffer = attribute_buffer;
 }
 
+void
+_cogl_attribute_set_instance_divisor (CoglAttribute *attribute,
+                                      int divisor)
+{
+  _COGL_RETURN_IF_FAIL (cogl_is_attribute (attribute));
+  _COGL_RETURN_IF_FAIL (attribute->is_buffered);
+
+  if (G_UNLIKELY (attribute->immutable_ref))
+    warn_about_midscene_changes ();
+
+  attribute->instance_divisor = divisor;
+}
+
 CoglAttribute *
 _cogl_attribute_immutable_ref (CoglAttribute *attribute)
 {
@@ -32,6 +32,8 @@
 
 #include <string.h>
 
+#include <test-fixtures/test-unit.h>
+
 #define component_type uint8_t
 #define component_size 8
 /* We want to specially optimise the packing when we are converting
@@ -284,6 +286,997 @@ _cogl_bitmap_premult_unpacked_span_16 (uint16_t *data,
     }
 }
 
+/* Span kernels
+ *
+ * The generic unpack/pack functions in cogl-bitmap-packing.h work on
+ * one component at a time. The conversions that are hit the most are
+ * swizzles between the 32-bit byte orders, premultiplication,
+ * expanding 24-bit RGB and packing to the 16-bit formats so these
+ * have specialised kernels. The best implementation for the CPU we
+ * are running on is picked the first time any of them are needed. */
+
+#if defined(__GNUC__) && (defined(__x86_64) || defined(__i386)) && \
+  (defined(__clang__) || __GNUC__ > 4 || \
+   (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+/* GCC >= 4.9 lets us use the intrinsics for any instruction set from
+   within a function marked with the target attribute so we can build
+   the kernels without requiring the whole file to be compiled with
+   -mavx2 */
+#define COGL_USE_X86_SPAN_KERNELS
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define COGL_USE_NEON_SPAN_KERNELS
+#include <arm_neon.h>
+#endif
+
+typedef struct
+{
+  /* dst[i] = src[shuffle[i]] for each byte of each 32-bit pixel. This
+     may be used in-place */
+  void (* swizzle_8888) (const uint8_t *src,
+                         uint8_t *dst,
+                         const uint8_t *shuffle,
+                         int width);
+  /* Expands 24-bit pixels to 32-bit pixels. dst[i] = src[shuffle[i]]
+     or 255 if shuffle[i] is -1 */
+  void (* expand_888) (const uint8_t *src,
+                       uint8_t *dst,
+                       const int8_t *shuffle,
+                       int width);
+  /* Premultiplies a span of 32-bit pixels in-place where alpha_index
+     is the byte offset of the alpha component (either 0 or 3) */
+  void (* premult_8888) (uint8_t *data,
+                         int alpha_index,
+                         int width);
+  /* Packs an unpacked 8-bit RGBA span */
+  void (* pack_rgb_565) (const uint8_t *src,
+                         uint8_t *dst,
+                         int width);
+  void (* pack_rgba_4444) (const uint8_t *src,
+                           uint8_t *dst,
+                           int width);
+} CoglBitmapSpanFuncs;
+
+static void
+_cogl_swizzle_8888_c (const uint8_t *src,
+                      uint8_t *dst,
+                      const uint8_t *shuffle,
+                      int width)
+{
+  while (width-- > 0)
+    {
+      uint8_t c0 = src[shuffle[0]];
+      uint8_t c1 = src[shuffle[1]];
+      uint8_t c2 = src[shuffle[2]];
+      uint8_t c3 = src[shuffle[3]];
+
+      dst[0] = c0;
+      dst[1] = c1;
+      dst[2] = c2;
+      dst[3] = c3;
+      src += 4;
+      dst += 4;
+    }
+}
+
+static void
+_cogl_expand_888_c (const uint8_t *src,
+                    uint8_t *dst,
+                    const int8_t *shuffle,
+                    int width)
+{
+  int i;
+
+  while (width-- > 0)
+    {
+      for (i = 0; i < 4; i++)
+        dst[i] = shuffle[i] < 0 ? 255 : src[shuffle[i]];
+      src += 3;
+      dst += 4;
+    }
+}
+
+static void
+_cogl_premult_8888_c (uint8_t *data,
+                      int alpha_index,
+                      int width)
+{
+  if (alpha_index == 0)
+    {
+      while (width-- > 0)
+        {
+          _cogl_premult_alpha_first (data);
+          data += 4;
+        }
+    }
+  else
+    /* This will still use the SSE2 assembler version if it was
+       enabled at compile time */
+    _cogl_bitmap_premult_unpacked_span_8 (data, width);
+}
+
+static void
+_cogl_pack_rgb_565_c (const uint8_t *src,
+                      uint8_t *dst,
+                      int width)
+{
+  _cogl_pack_rgb_565_8 (src, dst, width);
+}
+
+static void
+_cogl_pack_rgba_4444_c (const uint8_t *src,
+                        uint8_t *dst,
+                        int width)
+{
+  _cogl_pack_rgba_4444_8 (src, dst, width);
+}
+
+#ifdef COGL_USE_X86_SPAN_KERNELS
+
+/* Exact floor (x / 255) for 16-bit lanes where x <= 255 * 255 */
+#define COGL_DIV_255_EPI16(x)                                           \
+  _mm_srli_epi16 (_mm_add_epi16 (_mm_add_epi16 ((x),                    \
+                                                _mm_set1_epi16 (1)),    \
+                                 _mm_srli_epi16 ((x), 8)),              \
+                  8)
+
+/* The packing helpers work on four pixels stored as 32-bit lanes and
+   return the result in the low 16 bits of each lane */
+__attribute__ ((target ("sse2"))) static inline __m128i
+_cogl_pack_component_sse2 (__m128i pixels,
+                           int shift,
+                           int max)
+{
+  __m128i c = _mm_and_si128 (_mm_srli_epi32 (pixels, shift),
+                             _mm_set1_epi32 (0xff));
+
+  /* PACK_SIZE from cogl-bitmap-packing.h, ie, (c * max + 127) / 255 */
+  c = _mm_add_epi16 (_mm_mullo_epi16 (c, _mm_set1_epi32 (max)),
+                     _mm_set1_epi32 (127));
+
+  return _mm_and_si128 (COGL_DIV_255_EPI16 (c), _mm_set1_epi32 (0xffff));
+}
+
+/* Packs the low 16 bits of each 32-bit lane of the two registers into
+   eight 16-bit values. _mm_packs_epi32 saturates as signed values so
+   the range is shifted down first and then restored */
+__attribute__ ((target ("sse2"))) static inline __m128i
+_cogl_pack_32_to_16_sse2 (__m128i a,
+                          __m128i b)
+{
+  __m128i bias = _mm_set1_epi32 (0x8000);
+
+  return _mm_xor_si128 (_mm_packs_epi32 (_mm_sub_epi32 (a, bias),
+                                         _mm_sub_epi32 (b, bias)),
+                        _mm_set1_epi16 ((int16_t) 0x8000));
+}
+
+__attribute__ ((target ("sse2"))) static inline __m128i
+_cogl_pack_rgb_565_four_pixels_sse2 (__m128i pixels)
+{
+  return _mm_or_si128 (_mm_or_si128
+                       (_mm_slli_epi32 (_cogl_pack_component_sse2 (pixels,
+                                                                   0, 31),
+                                        11),
+                        _mm_slli_epi32 (_cogl_pack_component_sse2 (pixels,
+                                                                   8, 63),
+                                        5)),
+                       _cogl_pack_component_sse2 (pixels, 16, 31));
+}
+
+__attribute__ ((target ("sse2"))) static inline __m128i
+_cogl_pack_rgba_4444_four_pixels_sse2 (__m128i pixels)
+{
+  return _mm_or_si128 (_mm_or_si128
+                       (_mm_slli_epi32 (_cogl_pack_component_sse2 (pixels,
+                                                                   0, 15),
+                                        12),
+                        _mm_slli_epi32 (_cogl_pack_component_sse2 (pixels,
+                                                                   8, 15),
+                                        8)),
+                       _mm_or_si128
+                       (_mm_slli_epi32 (_cogl_pack_component_sse2 (pixels,
+                                                                   16, 15),
+                                        4),
+                        _cogl_pack_component_sse2 (pixels, 24, 15)));
+}
+
+__attribute__ ((target ("sse2"))) static void
+_cogl_pack_rgb_565_sse2 (const uint8_t *src,
+                         uint8_t *dst,
+                         int width)
+{
+  while (width >= 8)
+    {
+      __m128i a = _mm_loadu_si128 ((const __m128i *) src);
+      __m128i b = _mm_loadu_si128 ((const __m128i *) (src + 16));
+
+      _mm_storeu_si128 ((__m128i *) dst,
+                        _cogl_pack_32_to_16_sse2
+                        (_cogl_pack_rgb_565_four_pixels_sse2 (a),
+                         _cogl_pack_rgb_565_four_pixels_sse2 (b)));
+
+      src += 8 * 4;
+      dst += 8 * 2;
+      width -= 8;
+    }
+
+  _cogl_pack_rgb_565_8 (src, dst, width);
+}
+
+__attribute__ ((target ("sse2"))) static void
+_cogl_pack_rgba_4444_sse2 (const uint8_t *src,
+                           uint8_t *dst,
+                           int width)
+{
+  while (width >= 8)
+    {
+      __m128i a = _mm_loadu_si128 ((const __m128i *) src);
+      __m128i b = _mm_loadu_si128 ((const __m128i *) (src + 16));
+
+      _mm_storeu_si128 ((__m128i *) dst,
+                        _cogl_pack_32_to_16_sse2
+                        (_cogl_pack_rgba_4444_four_pixels_sse2 (a),
+                         _cogl_pack_rgba_4444_four_pixels_sse2 (b)));
+
+      src += 8 * 4;
+      dst += 8 * 2;
+      width -= 8;
+    }
+
+  _cogl_pack_rgba_4444_8 (src, dst, width);
+}
+
+__attribute__ ((target ("ssse3"))) static void
+_cogl_swizzle_8888_ssse3 (const uint8_t *src,
+                          uint8_t *dst,
+                          const uint8_t *shuffle,
+                          int width)
+{
+  int8_t mask_bytes[16];
+  __m128i mask;
+  int i;
+
+  for (i = 0; i < 16; i++)
+    mask_bytes[i] = (i & ~3) + shuffle[i & 3];
+  mask = _mm_loadu_si128 ((const __m128i *) mask_bytes);
+
+  while (width >= 4)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) src);
+
+      _mm_storeu_si128 ((__m128i *) dst, _mm_shuffle_epi8 (v, mask));
+
+      src += 4 * 4;
+      dst += 4 * 4;
+      width -= 4;
+    }
+
+  _cogl_swizzle_8888_c (src, dst, shuffle, width);
+}
+
+__attribute__ ((target ("ssse3"))) static void
+_cogl_expand_888_ssse3 (const uint8_t *src,
+                        uint8_t *dst,
+                        const int8_t *shuffle,
+                        int width)
+{
+  int8_t mask_bytes[16];
+  int8_t alpha_bytes[16];
+  __m128i mask, alpha;
+  int i;
+
+  for (i = 0; i < 16; i++)
+    {
+      int pixel = i / 4;
+      int component = shuffle[i & 3];
+
+      /* A mask byte with the top bit set makes pshufb write a zero */
+      mask_bytes[i] = component < 0 ? -128 : pixel * 3 + component;
+      alpha_bytes[i] = component < 0 ? -1 : 0;
+    }
+  mask = _mm_loadu_si128 ((const __m128i *) mask_bytes);
+  alpha = _mm_loadu_si128 ((const __m128i *) alpha_bytes);
+
+  /* Each iteration reads 16 bytes of which only 12 are used so stop
+     while there are still enough bytes left to avoid reading past the
+     end of the span */
+  while (width >= 6)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) src);
+
+      _mm_storeu_si128 ((__m128i *) dst,
+                        _mm_or_si128 (_mm_shuffle_epi8 (v, mask), alpha));
+
+      src += 4 * 3;
+      dst += 4 * 4;
+      width -= 4;
+    }
+
+  _cogl_expand_888_c (src, dst, shuffle, width);
+}
+
+/* The premultiplication kernels broadcast the alpha of each pixel to
+   all of its components except for the alpha itself which is
+   multiplied by 255 so that it is left unchanged. This means the same
+   code can handle both alpha-first and alpha-last formats. */
+static void
+_cogl_premult_get_masks (int alpha_index,
+                         int8_t *broadcast_bytes,
+                         int8_t *alpha_bytes,
+                         int n_bytes)
+{
+  int i;
+
+  for (i = 0; i < n_bytes; i++)
+    {
+      CoglBool is_alpha = (i & 3) == alpha_index;
+
+      broadcast_bytes[i] = is_alpha ? -128 : (i & 12) + alpha_index;
+      alpha_bytes[i] = is_alpha ? -1 : 0;
+    }
+}
+
+__attribute__ ((target ("ssse3"))) static void
+_cogl_premult_8888_ssse3 (uint8_t *data,
+                          int alpha_index,
+                          int width)
+{
+  int8_t broadcast_bytes[16];
+  int8_t alpha_bytes[16];
+  __m128i broadcast, alpha_mask, zero, half;
+
+  _cogl_premult_get_masks (alpha_index, broadcast_bytes, alpha_bytes, 16);
+  broadcast = _mm_loadu_si128 ((const __m128i *) broadcast_bytes);
+  alpha_mask = _mm_loadu_si128 ((const __m128i *) alpha_bytes);
+  zero = _mm_setzero_si128 ();
+  half = _mm_set1_epi16 (128);
+
+  while (width >= 4)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) data);
+      __m128i a = _mm_or_si128 (_mm_shuffle_epi8 (v, broadcast), alpha_mask);
+      __m128i lo, hi;
+
+      lo = _mm_add_epi16 (_mm_mullo_epi16 (_mm_unpacklo_epi8 (v, zero),
+                                           _mm_unpacklo_epi8 (a, zero)),
+                          half);
+      hi = _mm_add_epi16 (_mm_mullo_epi16 (_mm_unpackhi_epi8 (v, zero),
+                                           _mm_unpackhi_epi8 (a, zero)),
+                          half);
+      /* Same as the MULT macro above */
+      lo = _mm_srli_epi16 (_mm_add_epi16 (lo, _mm_srli_epi16 (lo, 8)), 8);
+      hi = _mm_srli_epi16 (_mm_add_epi16 (hi, _mm_srli_epi16 (hi, 8)), 8);
+
+      _mm_storeu_si128 ((__m128i *) data, _mm_packus_epi16 (lo, hi));
+
+      data += 4 * 4;
+      width -= 4;
+    }
+
+  _cogl_premult_8888_c (data, alpha_index, width);
+}
+
+__attribute__ ((target ("avx2"))) static void
+_cogl_swizzle_8888_avx2 (const uint8_t *src,
+                         uint8_t *dst,
+                         const uint8_t *shuffle,
+                         int width)
+{
+  int8_t mask_bytes[32];
+  __m256i mask;
+  int i;
+
+  /* vpshufb shuffles within each 128-bit lane */
+  for (i = 0; i < 32; i++)
+    mask_bytes[i] = (i & 12) + shuffle[i & 3];
+  mask = _mm256_loadu_si256 ((const __m256i *) mask_bytes);
+
+  while (width >= 8)
+    {
+      __m256i v = _mm256_loadu_si256 ((const __m256i *) src);
+
+      _mm256_storeu_si256 ((__m256i *) dst, _mm256_shuffle_epi8 (v, mask));
+
+      src += 8 * 4;
+      dst += 8 * 4;
+      width -= 8;
+    }
+
+  _cogl_swizzle_8888_ssse3 (src, dst, shuffle, width);
+}
+
+__attribute__ ((target ("avx2"))) static void
+_cogl_premult_8888_avx2 (uint8_t *data,
+                         int alpha_index,
+                         int width)
+{
+  int8_t broadcast_bytes[32];
+  int8_t alpha_bytes[32];
+  __m256i broadcast, alpha_mask, zero, half;
+
+  _cogl_premult_get_masks (alpha_index, broadcast_bytes, alpha_bytes, 32);
+  broadcast = _mm256_loadu_si256 ((const __m256i *) broadcast_bytes);
+  alpha_mask = _mm256_loadu_si256 ((const __m256i *) alpha_bytes);
+  zero = _mm256_setzero_si256 ();
+  half = _mm256_set1_epi16 (128);
+
+  while (width >= 8)
+    {
+      __m256i v = _mm256_loadu_si256 ((const __m256i *) data);
+      __m256i a = _mm256_or_si256 (_mm256_shuffle_epi8 (v, broadcast),
+                                   alpha_mask);
+      __m256i lo, hi;
+
+      /* The unpack and pack instructions also work within each
+         128-bit lane so the pixels end up back in the right order */
+      lo = _mm256_add_epi16 (_mm256_mullo_epi16
+                             (_mm256_unpacklo_epi8 (v, zero),
+                              _mm256_unpacklo_epi8 (a, zero)),
+                             half);
+      hi = _mm256_add_epi16 (_mm256_mullo_epi16
+                             (_mm256_unpackhi_epi8 (v, zero),
+                              _mm256_unpackhi_epi8 (a, zero)),
+                             half);
+      lo = _mm256_srli_epi16 (_mm256_add_epi16 (lo,
+                                                _mm256_srli_epi16 (lo, 8)),
+                              8);
+      hi = _mm256_srli_epi16 (_mm256_add_epi16 (hi,
+                                                _mm256_srli_epi16 (hi, 8)),
+                              8);
+
+      _mm256_storeu_si256 ((__m256i *) data, _mm256_packus_epi16 (lo, hi));
+
+      data += 8 * 4;
+      width -= 8;
+    }
+
+  _cogl_premult_8888_ssse3 (data, alpha_index, width);
+}
+
+#undef COGL_DIV_255_EPI16
+
+#endif /* COGL_USE_X86_SPAN_KERNELS */
+
+#ifdef COGL_USE_NEON_SPAN_KERNELS
+
+/* Exact floor (x / 255) for 16-bit lanes where x <= 255 * 255 */
+#define COGL_DIV_255_U16(x)                                     \
+  vshrq_n_u16 (vaddq_u16 (vaddq_u16 ((x), vdupq_n_u16 (1)),    \
+                          vshrq_n_u16 ((x), 8)),                \
+               8)
+
+static void
+_cogl_swizzle_8888_neon (const uint8_t *src,
+                         uint8_t *dst,
+                         const uint8_t *shuffle,
+                         int width)
+{
+  while (width >= 8)
+    {
+      uint8x8x4_t in = vld4_u8 (src);
+      uint8x8x4_t out;
+
+      out.val[0] = in.val[shuffle[0]];
+      out.val[1] = in.val[shuffle[1]];
+      out.val[2] = in.val[shuffle[2]];
+      out.val[3] = in.val[shuffle[3]];
+      vst4_u8 (dst, out);
+
+      src += 8 * 4;
+      dst += 8 * 4;
+      width -= 8;
+    }
+
+  _cogl_swizzle_8888_c (src, dst, shuffle, width);
+}
+
+static void
+_cogl_expand_888_neon (const uint8_t *src,
+                       uint8_t *dst,
+                       const int8_t *shuffle,
+                       int width)
+{
+  uint8x8_t opaque = vdup_n_u8 (255);
+  int i;
+
+  while (width >= 8)
+    {
+      uint8x8x3_t in = vld3_u8 (src);
+      uint8x8x4_t out;
+
+      for (i = 0; i < 4; i++)
+        out.val[i] = shuffle[i] < 0 ? opaque : in.val[shuffle[i]];
+      vst4_u8 (dst, out);
+
+      src += 8 * 3;
+      dst += 8 * 4;
+      width -= 8;
+    }
+
+  _cogl_expand_888_c (src, dst, shuffle, width);
+}
+
+static void
+_cogl_premult_8888_neon (uint8_t *data,
+                         int alpha_index,
+                         int width)
+{
+  uint16x8_t half = vdupq_n_u16 (128);
+  int i;
+
+  while (width >= 8)
+    {
+      uint8x8x4_t v = vld4_u8 (data);
+      uint8x8_t alpha = v.val[alpha_index];
+
+      for (i = 0; i < 4; i++)
+        if (i != alpha_index)
+          {
+            /* Same as the MULT macro above */
+            uint16x8_t t = vaddq_u16 (vmull_u8 (v.val[i], alpha), half);
+            v.val[i] = vshrn_n_u16 (vaddq_u16 (t, vshrq_n_u16 (t, 8)), 8);
+          }
+      vst4_u8 (data, v);
+
+      data += 8 * 4;
+      width -= 8;
+    }
+
+  _cogl_premult_8888_c (data, alpha_index, width);
+}
+
+static inline uint16x8_t
+_cogl_pack_component_neon (uint8x8_t c,
+                           uint8_t max)
+{
+  /* PACK_SIZE from cogl-bitmap-packing.h, ie, (c * max + 127) / 255 */
+  uint16x8_t t = vaddq_u16 (vmull_u8 (c, vdup_n_u8 (max)),
+                            vdupq_n_u16 (127));
+
+  return COGL_DIV_255_U16 (t);
+}
+
+static void
+_cogl_pack_rgb_565_neon (const uint8_t *src,
+                         uint8_t *dst,
+                         int width)
+{
+  while (width >= 8)
+    {
+      uint8x8x4_t in = vld4_u8 (src);
+      uint16x8_t v;
+
+      v = vshlq_n_u16 (_cogl_pack_component_neon (in.val[0], 31), 11);
+      v = vorrq_u16 (v, vshlq_n_u16 (_cogl_pack_component_neon (in.val[1],
+                                                                63),
+                                     5));
+      v = vorrq_u16 (v, _cogl_pack_component_neon (in.val[2], 31));
+      vst1q_u16 ((uint16_t *) dst, v);
+
+      src += 8 * 4;
+      dst += 8 * 2;
+      width -= 8;
+    }
+
+  _cogl_pack_rgb_565_8 (src, dst, width);
+}
+
+static void
+_cogl_pack_rgba_4444_neon (const uint8_t *src,
+                           uint8_t *dst,
+                           int width)
+{
+  while (width >= 8)
+    {
+      uint8x8x4_t in = vld4_u8 (src);
+      uint16x8_t v;
+
+      v = vshlq_n_u16 (_cogl_pack_component_neon (in.val[0], 15), 12);
+      v = vorrq_u16 (v, vshlq_n_u16 (_cogl_pack_component_neon (in.val[1],
+                                                                15),
+                                     8));
+      v = vorrq_u16 (v, vshlq_n_u16 (_cogl_pack_component_neon (in.val[2],
+                                                                15),
+                                     4));
+      v = vorrq_u16 (v, _cogl_pack_component_neon (in.val[3], 15));
+      vst1q_u16 ((uint16_t *) dst, v);
+
+      src += 8 * 4;
+      dst += 8 * 2;
+      width -= 8;
+    }
+
+  _cogl_pack_rgba_4444_8 (src, dst, width);
+}
+
+#undef COGL_DIV_255_U16
+
+#endif /* COGL_USE_NEON_SPAN_KERNELS */
+
+/* Each level adds the kernels for an instruction set on top of the
+   levels before it */
+typedef enum
+{
+  COGL_BITMAP_SPAN_LEVEL_C,
+  COGL_BITMAP_SPAN_LEVEL_SSE2,
+  COGL_BITMAP_SPAN_LEVEL_SSSE3,
+  COGL_BITMAP_SPAN_LEVEL_AVX2,
+  COGL_BITMAP_SPAN_LEVEL_NEON,
+
+  COGL_BITMAP_N_SPAN_LEVELS
+} CoglBitmapSpanLevel;
+
+static CoglBitmapSpanFuncs _cogl_bitmap_span_funcs;
+static CoglBool _cogl_bitmap_span_funcs_initialized = FALSE;
+
+/* Fills in funcs with the kernels for the given level. Returns FALSE
+   if the level isn't compiled in or the CPU doesn't support it */
+static CoglBool
+_cogl_bitmap_init_span_funcs (CoglBitmapSpanFuncs *funcs,
+                              CoglBitmapSpanLevel level)
+{
+  funcs->swizzle_8888 = _cogl_swizzle_8888_c;
+  funcs->expand_888 = _cogl_expand_888_c;
+  funcs->premult_8888 = _cogl_premult_8888_c;
+  funcs->pack_rgb_565 = _cogl_pack_rgb_565_c;
+  funcs->pack_rgba_4444 = _cogl_pack_rgba_4444_c;
+
+  if (level == COGL_BITMAP_SPAN_LEVEL_C)
+    return TRUE;
+
+#if defined(COGL_USE_X86_SPAN_KERNELS)
+
+  __builtin_cpu_init ();
+
+  if (!__builtin_cpu_supports ("sse2"))
+    return FALSE;
+
+  funcs->pack_rgb_565 = _cogl_pack_rgb_565_sse2;
+  funcs->pack_rgba_4444 = _cogl_pack_rgba_4444_sse2;
+
+  if (level == COGL_BITMAP_SPAN_LEVEL_SSE2)
+    return TRUE;
+
+  if (!__builtin_cpu_supports ("ssse3"))
+    return FALSE;
+
+  funcs->swizzle_8888 = _cogl_swizzle_8888_ssse3;
+  funcs->expand_888 = _cogl_expand_888_ssse3;
+  funcs->premult_8888 = _cogl_premult_8888_ssse3;
+
+  if (level == COGL_BITMAP_SPAN_LEVEL_SSSE3)
+    return TRUE;
+
+  if (!__builtin_cpu_supports ("avx2"))
+    return FALSE;
+
+  funcs->swizzle_8888 = _cogl_swizzle_8888_avx2;
+  funcs->premult_8888 = _cogl_premult_8888_avx2;
+
+  return level == COGL_BITMAP_SPAN_LEVEL_AVX2;
+
+#elif defined(COGL_USE_NEON_SPAN_KERNELS)
+
+  /* NEON can only be enabled at compile time so there is nothing to
+     check at runtime */
+  if (level != COGL_BITMAP_SPAN_LEVEL_NEON)
+    return FALSE;
+
+  funcs->swizzle_8888 = _cogl_swizzle_8888_neon;
+  funcs->expand_888 = _cogl_expand_888_neon;
+  funcs->premult_8888 = _cogl_premult_8888_neon;
+  funcs->pack_rgb_565 = _cogl_pack_rgb_565_neon;
+  funcs->pack_rgba_4444 = _cogl_pack_rgba_4444_neon;
+
+  return TRUE;
+
+#else
+
+  return FALSE;
+
+#endif
+}
+
+static const CoglBitmapSpanFuncs *
+_cogl_bitmap_get_span_funcs (void)
+{
+  int level;
+
+  if (G_LIKELY (_cogl_bitmap_span_funcs_initialized))
+    return &_cogl_bitmap_span_funcs;
+
+  /* Pick the best level that the CPU supports. The C level is always
+     available so this will stop there at the latest */
+  for (level = COGL_BITMAP_N_SPAN_LEVELS - 1;
+       !_cogl_bitmap_init_span_funcs (&_cogl_bitmap_span_funcs, level);
+       level--)
+    ;
+
+  _cogl_bitmap_span_funcs_initialized = TRUE;
+
+  return &_cogl_bitmap_span_funcs;
+}
+
+/* Formats where each component is stored in its own byte. These can
+   be converted between each other by just moving bytes around */
+typedef struct
+{
+  CoglPixelFormat format;
+  int bpp;
+  /* The byte offset of the red, green, blue and alpha components or
+     -1 if the component isn't stored */
+  int8_t order[4];
+} CoglBitmapByteFormat;
+
+static const CoglBitmapByteFormat
+_cogl_bitmap_byte_formats[] =
+  {
+    { COGL_PIXEL_FORMAT_RGB_888, 3, { 0, 1, 2, -1 } },
+    { COGL_PIXEL_FORMAT_BGR_888, 3, { 2, 1, 0, -1 } },
+    { COGL_PIXEL_FORMAT_RGBA_8888, 4, { 0, 1, 2, 3 } },
+    { COGL_PIXEL_FORMAT_BGRA_8888, 4, { 2, 1, 0, 3 } },
+    { COGL_PIXEL_FORMAT_ARGB_8888, 4, { 1, 2, 3, 0 } },
+    { COGL_PIXEL_FORMAT_ABGR_8888, 4, { 3, 2, 1, 0 } }
+  };
+
+static const CoglBitmapByteFormat *
+_cogl_bitmap_find_byte_format (CoglPixelFormat format)
+{
+  int i;
+
+  for (i = 0; i < G_N_ELEMENTS (_cogl_bitmap_byte_formats); i++)
+    if (_cogl_bitmap_byte_formats[i].format == (format & ~COGL_PREMULT_BIT))
+      return _cogl_bitmap_byte_formats + i;
+
+  return NULL;
+}
+
+static void
+_cogl_bitmap_unpack_span_8 (CoglPixelFormat format,
+                            const uint8_t *src,
+                            uint8_t *dst,
+                            int width)
+{
+  const CoglBitmapSpanFuncs *funcs = _cogl_bitmap_get_span_funcs ();
+  const CoglBitmapByteFormat *byte_format =
+    _cogl_bitmap_find_byte_format (format);
+
+  if (byte_format == NULL)
+    _cogl_unpack_8 (format, src, dst, width);
+  else if (byte_format->bpp == 3)
+    funcs->expand_888 (src, dst, byte_format->order, width);
+  else
+    funcs->swizzle_8888 (src, dst, (const uint8_t *) byte_format->order, width);
+}
+
+static void
+_cogl_bitmap_pack_span_8 (CoglPixelFormat format,
+                          const uint8_t *src,
+                          uint8_t *dst,
+                          int width)
+{
+  const CoglBitmapSpanFuncs *funcs = _cogl_bitmap_get_span_funcs ();
+  const CoglBitmapByteFormat *byte_format;
+
+  switch (format)
+    {
+    case COGL_PIXEL_FORMAT_RGB_565:
+      funcs->pack_rgb_565 (src, dst, width);
+      break;
+
+    case COGL_PIXEL_FORMAT_RGBA_4444:
+    case COGL_PIXEL_FORMAT_RGBA_4444_PRE:
+      funcs->pack_rgba_4444 (src, dst, width);
+      break;
+
+    default:
+      byte_format = _cogl_bitmap_find_byte_format (format);
+
+      if (byte_format && byte_format->bpp == 4)
+        {
+          uint8_t shuffle[4];
+          int i;
+
+          /* Packing is the inverse of unpacking so we need the
+             inverse permutation */
+          for (i = 0; i < 4; i++)
+            shuffle[byte_format->order[i]] = i;
+
+          funcs->swizzle_8888 (src, dst, shuffle, width);
+        }
+      else
+        _cogl_pack_8 (format, src, dst, width);
+      break;
+    }
+}
+
+static void
+_cogl_bitmap_unpremult_span_8888 (uint8_t *data,
+                                  int alpha_index,
+                                  int width)
+{
+  if (alpha_index == 0)
+    {
+      while (width-- > 0)
+        {
+          if (data[0] == 0)
+            _cogl_unpremult_alpha_0 (data);
+          else
+            _cogl_unpremult_alpha_first (data);
+          data += 4;
+        }
+    }
+  else
+    _cogl_bitmap_unpremult_unpacked_span_8 (data, width);
+}
+
+/* Direct conversions
+ *
+ * When both formats store each component in a separate byte the
+ * conversion can go straight from the source row to the destination
+ * row without unpacking to a temporary RGBA row first. Packing to
+ * RGB_565 or RGBA_4444 can also be done directly from an RGBA_8888
+ * source because that is already the unpacked layout. */
+
+typedef enum
+{
+  /* 32-bit to 32-bit using the swizzle_8888 kernel */
+  COGL_BITMAP_DIRECT_SWIZZLE_8888,
+  /* 24-bit to 32-bit using the expand_888 kernel */
+  COGL_BITMAP_DIRECT_EXPAND_888,
+  /* 24 or 32-bit to 24-bit */
+  COGL_BITMAP_DIRECT_SHUFFLE_TO_888,
+  COGL_BITMAP_DIRECT_PACK_RGB_565,
+  COGL_BITMAP_DIRECT_PACK_RGBA_4444
+} CoglBitmapDirectType;
+
+typedef struct
+{
+  CoglBitmapDirectType type;
+  int src_bpp;
+  /* The source byte for each destination byte or -1 for an opaque
+     alpha */
+  int8_t shuffle[4];
+  /* Whether to premultiply or unpremultiply the destination in-place
+     after the conversion */
+  CoglBool premult;
+  CoglBool unpremult;
+  int dst_alpha_index;
+} CoglBitmapDirectConverter;
+
+static CoglBool
+_cogl_bitmap_get_direct_converter (CoglPixelFormat src_format,
+                                   CoglPixelFormat dst_format,
+                                   CoglBool need_premult,
+                                   CoglBitmapDirectConverter *converter)
+{
+  const CoglBitmapByteFormat *src_byte_format =
+    _cogl_bitmap_find_byte_format (src_format);
+  const CoglBitmapByteFormat *dst_byte_format;
+  int i;
+
+  if (src_byte_format == NULL)
+    return FALSE;
+
+  converter->src_bpp = src_byte_format->bpp;
+  converter->premult = FALSE;
+  converter->unpremult = FALSE;
+  converter->dst_alpha_index = -1;
+
+  if (src_format == COGL_PIXEL_FORMAT_RGBA_8888 ||
+      src_format == COGL_PIXEL_FORMAT_RGBA_8888_PRE)
+    {
+      if (dst_format == COGL_PIXEL_FORMAT_RGB_565)
+        {
+          converter->type = COGL_BITMAP_DIRECT_PACK_RGB_565;
+          return TRUE;
+        }
+      else if ((dst_format & ~COGL_PREMULT_BIT) ==
+               COGL_PIXEL_FORMAT_RGBA_4444 &&
+               !need_premult)
+        {
+          converter->type = COGL_BITMAP_DIRECT_PACK_RGBA_4444;
+          return TRUE;
+        }
+    }
+
+  dst_byte_format = _cogl_bitmap_find_byte_format (dst_format);
+
+  if (dst_byte_format == NULL)
+    return FALSE;
+
+  memset (converter->shuffle, -1, sizeof (converter->shuffle));
+
+  /* Compose the source and destination orders so that each byte of
+     the destination pixel knows where it comes from */
+  for (i = 0; i < 4; i++)
+    if (dst_byte_format->order[i] >= 0)
+      converter->shuffle[dst_byte_format->order[i]] =
+        src_byte_format->order[i];
+
+  if (dst_byte_format->bpp == 3)
+    converter->type = COGL_BITMAP_DIRECT_SHUFFLE_TO_888;
+  else if (src_byte_format->bpp == 3)
+    converter->type = COGL_BITMAP_DIRECT_EXPAND_888;
+  else
+    {
+      converter->type = COGL_BITMAP_DIRECT_SWIZZLE_8888;
+
+      if (need_premult)
+        {
+          converter->dst_alpha_index = dst_byte_format->order[3];
+
+          if ((dst_format & COGL_PREMULT_BIT))
+            converter->premult = TRUE;
+          else
+            converter->unpremult = TRUE;
+        }
+    }
+
+  return TRUE;
+}
+
+static void
+_cogl_bitmap_convert_span_direct (const CoglBitmapDirectConverter *converter,
+                                  const uint8_t *src,
+                                  uint8_t *dst,
+                                  int width)
+{
+  const CoglBitmapSpanFuncs *funcs = _cogl_bitmap_get_span_funcs ();
+  int x;
+
+  switch (converter->type)
+    {
+    case COGL_BITMAP_DIRECT_SWIZZLE_8888:
+      funcs->swizzle_8888 (src,
+                           dst,
+                           (const uint8_t *) converter->shuffle,
+                           width);
+      break;
+
+    case COGL_BITMAP_DIRECT_EXPAND_888:
+      funcs->expand_888 (src, dst, converter->shuffle, width);
+      break;
+
+    case COGL_BITMAP_DIRECT_SHUFFLE_TO_888:
+      for (x = 0; x < width; x++)
+        {
+          /* Read all of the components first in case this is
+             in-place */
+          uint8_t c0 = src[converter->shuffle[0]];
+          uint8_t c1 = src[converter->shuffle[1]];
+          uint8_t c2 = src[converter->shuffle[2]];
+
+          dst[0] = c0;
+          dst[1] = c1;
+          dst[2] = c2;
+          src += converter->src_bpp;
+          dst += 3;
+        }
+      break;
+
+    case COGL_BITMAP_DIRECT_PACK_RGB_565:
+      funcs->pack_rgb_565 (src, dst, width);
+      break;
+
+    case COGL_BITMAP_DIRECT_PACK_RGBA_4444:
+      funcs->pack_rgba_4444 (src, dst, width);
+      break;
+    }
+
+  /* The destination row is still in the cache at this point so
+     (un)premultiplying it in-place is cheap */
+  if (converter->premult)
+    funcs->premult_8888 (dst, converter->dst_alpha_index, width);
+  else if (converter->unpremult)
+    _cogl_bitmap_unpremult_span_8888 (dst,
+                                      converter->dst_alpha_index,
+                                      width);
+}
+
 static CoglBool
 _cogl_bitmap_can_fast_premult (CoglPixelFormat format)
 {
@@ -323,6 +1316,7 @@ _cogl_bitmap_needs_short_temp_buffer (CoglPixelFormat format)
     case COGL_PIXEL_FORMAT_RGBA_4444:
     case COGL_PIXEL_FORMAT_RGBA_5551:
     case COGL_PIXEL_FORMAT_G_8:
+    case COGL_PIXEL_FORMAT_RG_88:
     case COGL_PIXEL_FORMAT_RGB_888:
     case COGL_PIXEL_FORMAT_BGR_888:
     case COGL_PIXEL_FORMAT_RGBA_8888:
@@ -351,69 +1345,166 @@ _cogl_bitmap_needs_short_temp_buffer (CoglPixelFormat format)
   g_assert_not_reached ();
 }
 
+/* Large conversions can be split into bands of rows which are
+   processed in parallel by the context's worker pool */
+static int
+_cogl_bitmap_get_n_bands (CoglContext *ctx,
+                          int width,
+                          int height)
+{
+  int n_threads = _cogl_worker_pool_get_n_threads (ctx->worker_pool);
+
+  if (n_threads == 0 || width * height < ctx->conversion_threshold)
+    return 1;
+
+  /* The calling thread also processes one of the bands */
+  return MIN (n_threads + 1, height);
+}
+
+static void
+_cogl_bitmap_get_band_rows (int band,
+                            int n_bands,
+                            int height,
+                            int *first_row,
+                            int *n_rows)
+{
+  *first_row = height * band / n_bands;
+  *n_rows = height * (band + 1) / n_bands - *first_row;
+}
+
+typedef struct
+{
+  const uint8_t *src_data;
+  uint8_t *dst_data;
+  int src_rowstride;
+  int dst_rowstride;
+  int width;
+  int height;
+  int n_bands;
+  CoglPixelFormat src_format;
+  CoglPixelFormat dst_format;
+  CoglBool use_16;
+  CoglBool need_premult;
+  CoglBool use_direct;
+  CoglBitmapDirectConverter direct_converter;
+} CoglBitmapConvertState;
+
+/* This may be called from a worker thread so it must not use any
+   Cogl API */
+static void
+_cogl_bitmap_convert_band (int band,
+                           void *user_data)
+{
+  CoglBitmapConvertState *state = user_data;
+  const CoglBitmapSpanFuncs *span_funcs = _cogl_bitmap_get_span_funcs ();
+  const uint8_t *src;
+  uint8_t *dst;
+  void *tmp_row;
+  int width = state->width;
+  int first_row, n_rows;
+  int y;
+
+  _cogl_bitmap_get_band_rows (band, state->n_bands, state->height,
+                              &first_row, &n_rows);
+
+  if (state->use_direct)
+    {
+      for (y = first_row; y < first_row + n_rows; y++)
+        _cogl_bitmap_convert_span_direct (&state->direct_converter,
+                                          state->src_data +
+                                          y * state->src_rowstride,
+                                          state->dst_data +
+                                          y * state->dst_rowstride,
+                                          width);
+      return;
+    }
+
+  /* Allocate a buffer to hold a temporary RGBA row */
+  tmp_row = g_malloc (width *
+                      (state->use_16 ? sizeof (uint16_t) : sizeof (uint8_t)) *
+                      4);
+
+  for (y = first_row; y < first_row + n_rows; y++)
+    {
+      src = state->src_data + y * state->src_rowstride;
+      dst = state->dst_data + y * state->dst_rowstride;
+
+      if (state->use_16)
+        _cogl_unpack_16 (state->src_format, src, tmp_row, width);
+      else
+        _cogl_bitmap_unpack_span_8 (state->src_format, src, tmp_row, width);
+
+      /* Handle premultiplication */
+      if (state->need_premult)
+        {
+          if (state->dst_format & COGL_PREMULT_BIT)
+            {
+              if (state->use_16)
+                _cogl_bitmap_premult_unpacked_span_16 (tmp_row, width);
+              else
+                span_funcs->premult_8888 (tmp_row, 3, width);
+            }
+          else
+            {
+              if (state->use_16)
+                _cogl_bitmap_unpremult_unpacked_span_16 (tmp_row, width);
+              else
+                _cogl_bitmap_unpremult_unpacked_span_8 (tmp_row, width);
+            }
+        }
+
+      if (state->use_16)
+        _cogl_pack_16 (state->dst_format, tmp_row, dst, width);
+      else
+        _cogl_bitmap_pack_span_8 (state->dst_format, tmp_row, dst, width);
+    }
+
+  g_free (tmp_row);
+}
+
 CoglBool
 _cogl_bitmap_convert_into_bitmap (CoglBitmap *src_bmp,
                                   CoglBitmap *dst_bmp,
                                   CoglError **error)
 {
+  CoglContext *ctx = _cogl_bitmap_get_context (src_bmp);
+  CoglBitmapConvertState state;
   uint8_t *src_data;
   uint8_t *dst_data;
-  uint8_t *src;
-  uint8_t *dst;
-  void *tmp_row;
-  int src_rowstride;
-  int dst_rowstride;
-  int y;
   int width, height;
   CoglPixelFormat src_format;
   CoglPixelFormat dst_format;
-  CoglBool use_16;
-  CoglBool need_premult;
 
   src_format = cogl_bitmap_get_format (src_bmp);
-  src_rowstride = cogl_bitmap_get_rowstride (src_bmp);
   dst_format = cogl_bitmap_get_format (dst_bmp);
-  dst_rowstride = cogl_bitmap_get_rowstride (dst_bmp);
   width = cogl_bitmap_get_width (src_bmp);
   height = cogl_bitmap_get_height (src_bmp);
 
   _COGL_RETURN_VAL_IF_FAIL (width == cogl_bitmap_get_width (dst_bmp), FALSE);
   _COGL_RETURN_VAL_IF_FAIL (height == cogl_bitmap_get_height (dst_bmp), FALSE);
 
-  need_premult
+  state.need_premult
     = ((src_format & COGL_PREMULT_BIT) != (dst_format & COGL_PREMULT_BIT) &&
        src_format != COGL_PIXEL_FORMAT_A_8 &&
        dst_format != COGL_PIXEL_FORMAT_A_8 &&
        (src_format & dst_format & COGL_A_BIT));
 
   /* If the base format is the same then we can just copy the bitmap
-     instead */
+     instead. If only the premultiplication differs then the direct
+     converter below will handle it in a single pass */
   if ((src_format & ~COGL_PREMULT_BIT) == (dst_format & ~COGL_PREMULT_BIT) &&
-      (!need_premult || _cogl_bitmap_can_fast_premult (dst_format)))
-    {
-      if (!_cogl_bitmap_copy_subregion (src_bmp, dst_bmp,
+      !state.need_premult)
+    return _cogl_bitmap_copy_subregion (src_bmp, dst_bmp,
                                         0, 0, /* src_x / src_y */
                                         0, 0, /* dst_x / dst_y */
                                         width, height,
-                                        error))
-        return FALSE;
-
-      if (need_premult)
-        {
-          if ((dst_format & COGL_PREMULT_BIT))
-            {
-              if (!_cogl_bitmap_premult (dst_bmp, error))
-                return FALSE;
-            }
-          else
-            {
-              if (!_cogl_bitmap_unpremult (dst_bmp, error))
-                return FALSE;
-            }
-        }
+                                        error);
 
-      return TRUE;
-    }
+  state.use_direct =
+    _cogl_bitmap_get_direct_converter (src_format,
+                                       dst_format,
+                                       state.need_premult,
+                                       &state.direct_converter);
 
   src_data = _cogl_bitmap_map (src_bmp, COGL_BUFFER_ACCESS_READ, 0, error);
   if (src_data == NULL)
@@ -428,53 +1519,30 @@ _cogl_bitmap_convert_into_bitmap (CoglBitmap *src_bmp,
       return FALSE;
     }
 
-  use_16 = _cogl_bitmap_needs_short_temp_buffer (dst_format);
-
-  /* Allocate a buffer to hold a temporary RGBA row */
-  tmp_row = g_malloc (width *
-                      (use_16 ? sizeof (uint16_t) : sizeof (uint8_t)) * 4);
-
-  /* FIXME: Optimize */
-  for (y = 0; y < height; y++)
-    {
-      src = src_data + y * src_rowstride;
-      dst = dst_data + y * dst_rowstride;
-
-      if (use_16)
-        _cogl_unpack_16 (src_format, src, tmp_row, width);
-      else
-        _cogl_unpack_8 (src_format, src, tmp_row, width);
-
-      /* Handle premultiplication */
-      if (need_premult)
-        {
-          if (dst_format & COGL_PREMULT_BIT)
-            {
-              if (use_16)
-                _cogl_bitmap_premult_unpacked_span_16 (tmp_row, width);
-              else
-                _cogl_bitmap_premult_unpacked_span_8 (tmp_row, width);
-            }
-          else
-            {
-              if (use_16)
-                _cogl_bitmap_unpremult_unpacked_span_16 (tmp_row, width);
-              else
-                _cogl_bitmap_unpremult_unpacked_span_8 (tmp_row, width);
-            }
-        }
-
-      if (use_16)
-        _cogl_pack_16 (dst_format, tmp_row, dst, width);
-      else
-        _cogl_pack_8 (dst_format, tmp_row, dst, width);
-    }
+  state.src_data = src_data;
+  state.dst_data = dst_data;
+  state.src_rowstride = cogl_bitmap_get_rowstride (src_bmp);
+  state.dst_rowstride = cogl_bitmap_get_rowstride (dst_bmp);
+  state.width = width;
+  state.height = height;
+  state.n_bands = _cogl_bitmap_get_n_bands (ctx, width, height);
+  state.src_format = src_format;
+  state.dst_format = dst_format;
+  state.use_16 = (!state.use_direct &&
+                  _cogl_bitmap_needs_short_temp_buffer (dst_format));
+
+  /* Make sure the kernels are picked on this thread before any of
+     the workers need them */
+  _cogl_bitmap_get_span_funcs ();
+
+  _cogl_worker_pool_run (ctx->worker_pool,
+                         state.n_bands,
+                         _cogl_bitmap_convert_band,
+                         &state);
 
   _cogl_bitmap_unmap (src_bmp);
   _cogl_bitmap_unmap (dst_bmp);
 
-  g_free (tmp_row);
-
   return TRUE;
 }
 
@@ -586,134 +1654,273 @@ _cogl_bitmap_convert_for_upload (CoglBitmap *src_bmp,
   return dst_bmp;
 }
 
-CoglBool
-_cogl_bitmap_unpremult (CoglBitmap *bmp,
-                        CoglError **error)
+typedef struct
 {
-  uint8_t *p, *data;
-  uint16_t *tmp_row;
-  int x,y;
-  CoglPixelFormat format;
-  int width, height;
+  uint8_t *data;
   int rowstride;
+  int width;
+  int height;
+  int n_bands;
+  CoglPixelFormat format;
+  CoglBool premult;
+} CoglBitmapPremultState;
 
-  format = cogl_bitmap_get_format (bmp);
-  width = cogl_bitmap_get_width (bmp);
-  height = cogl_bitmap_get_height (bmp);
-  rowstride = cogl_bitmap_get_rowstride (bmp);
-
-  if ((data = _cogl_bitmap_map (bmp,
-                                COGL_BUFFER_ACCESS_READ |
-                                COGL_BUFFER_ACCESS_WRITE,
-                                0,
-                                error)) == NULL)
-    return FALSE;
+/* This may be called from a worker thread so it must not use any
+   Cogl API */
+static void
+_cogl_bitmap_premult_band (int band,
+                           void *user_data)
+{
+  CoglBitmapPremultState *state = user_data;
+  const CoglBitmapSpanFuncs *span_funcs = _cogl_bitmap_get_span_funcs ();
+  CoglPixelFormat format = state->format;
+  int width = state->width;
+  int alpha_index = (format & COGL_AFIRST_BIT) ? 0 : 3;
+  uint8_t *p;
+  uint16_t *tmp_row;
+  int first_row, n_rows;
+  int y;
+
+  _cogl_bitmap_get_band_rows (band, state->n_bands, state->height,
+                              &first_row, &n_rows);
 
-  /* If we can't directly unpremult the data inline then we'll
+  /* If we can't directly (un)premult the data inline then we'll
      allocate a temporary row and unpack the data. This assumes if we
-      can fast premult then we can also fast unpremult */
+     can fast premult then we can also fast unpremult */
   if (_cogl_bitmap_can_fast_premult (format))
     tmp_row = NULL;
   else
     tmp_row = g_malloc (sizeof (uint16_t) * 4 * width);
 
-  for (y = 0; y < height; y++)
+  for (y = first_row; y < first_row + n_rows; y++)
     {
-      p = (uint8_t*) data + y * rowstride;
+      p = state->data + y * state->rowstride;
 
       if (tmp_row)
         {
           _cogl_unpack_16 (format, p, tmp_row, width);
-          _cogl_bitmap_unpremult_unpacked_span_16 (tmp_row, width);
+          if (state->premult)
+            _cogl_bitmap_premult_unpacked_span_16 (tmp_row, width);
+          else
+            _cogl_bitmap_unpremult_unpacked_span_16 (tmp_row, width);
           _cogl_pack_16 (format, tmp_row, p, width);
         }
+      else if (state->premult)
+        span_funcs->premult_8888 (p, alpha_index, width);
       else
-        {
-          if (format & COGL_AFIRST_BIT)
-            {
-              for (x = 0; x < width; x++)
-                {
-                  if (p[0] == 0)
-                    _cogl_unpremult_alpha_0 (p);
-                  else
-                    _cogl_unpremult_alpha_first (p);
-                  p += 4;
-                }
-            }
-          else
-            _cogl_bitmap_unpremult_unpacked_span_8 (p, width);
-        }
+        _cogl_bitmap_unpremult_span_8888 (p, alpha_index, width);
     }
 
   g_free (tmp_row);
+}
+
+static CoglBool
+_cogl_bitmap_change_premult (CoglBitmap *bmp,
+                             CoglBool premult,
+                             CoglError **error)
+{
+  CoglContext *ctx = _cogl_bitmap_get_context (bmp);
+  CoglBitmapPremultState state;
+  CoglPixelFormat format;
+
+  format = cogl_bitmap_get_format (bmp);
+
+  state.data = _cogl_bitmap_map (bmp,
+                                 COGL_BUFFER_ACCESS_READ |
+                                 COGL_BUFFER_ACCESS_WRITE,
+                                 0,
+                                 error);
+  if (state.data == NULL)
+    return FALSE;
+
+  state.rowstride = cogl_bitmap_get_rowstride (bmp);
+  state.width = cogl_bitmap_get_width (bmp);
+  state.height = cogl_bitmap_get_height (bmp);
+  state.n_bands = _cogl_bitmap_get_n_bands (ctx, state.width, state.height);
+  state.format = format;
+  state.premult = premult;
+
+  /* Make sure the kernels are picked on this thread before any of
+     the workers need them */
+  _cogl_bitmap_get_span_funcs ();
+
+  _cogl_worker_pool_run (ctx->worker_pool,
+                         state.n_bands,
+                         _cogl_bitmap_premult_band,
+                         &state);
 
   _cogl_bitmap_unmap (bmp);
 
-  _cogl_bitmap_set_format (bmp, format & ~COGL_PREMULT_BIT);
+  if (premult)
+    _cogl_bitmap_set_format (bmp, format | COGL_PREMULT_BIT);
+  else
+    _cogl_bitmap_set_format (bmp, format & ~COGL_PREMULT_BIT);
 
   return TRUE;
 }
 
+CoglBool
+_cogl_bitmap_unpremult (CoglBitmap *bmp,
+                        CoglError **error)
+{
+  return _cogl_bitmap_change_premult (bmp, FALSE, error);
+}
+
 CoglBool
 _cogl_bitmap_premult (CoglBitmap *bmp,
                       CoglError **error)
 {
-  uint8_t *p, *data;
-  uint16_t *tmp_row;
-  int x,y;
-  CoglPixelFormat format;
-  int width, height;
-  int rowstride;
-
-  format = cogl_bitmap_get_format (bmp);
-  width = cogl_bitmap_get_width (bmp);
-  height = cogl_bitmap_get_height (bmp);
-  rowstride = cogl_bitmap_get_rowstride (bmp);
-
-  if ((data = _cogl_bitmap_map (bmp,
-                                COGL_BUFFER_ACCESS_READ |
-                                COGL_BUFFER_ACCESS_WRITE,
-                                0,
-                                error)) == NULL)
-    return FALSE;
+  return _cogl_bitmap_change_premult (bmp, TRUE, error);
+}
 
-  /* If we can't directly premult the data inline then we'll allocate
-     a temporary row and unpack the data. */
-  if (_cogl_bitmap_can_fast_premult (format))
-    tmp_row = NULL;
-  else
-    tmp_row = g_malloc (sizeof (uint16_t) * 4 * width);
+static void
+fill_random_span (uint8_t *data,
+                  int n_bytes)
+{
+  static uint32_t seed = 0x12345678;
+  int i;
 
-  for (y = 0; y < height; y++)
+  /* A simple LCG so that the test doesn't depend on GRand which
+   * isn't available in the bundled glib subset */
+  for (i = 0; i < n_bytes; i++)
     {
-      p = (uint8_t*) data + y * rowstride;
+      seed = seed * 1103515245 + 12345;
+      data[i] = seed >> 24;
+    }
+}
 
-      if (tmp_row)
+static void
+check_span_kernels (void)
+{
+  static const CoglPixelFormat formats[] =
+    {
+      COGL_PIXEL_FORMAT_RGB_888,
+      COGL_PIXEL_FORMAT_BGR_888,
+      COGL_PIXEL_FORMAT_RGBA_8888,
+      COGL_PIXEL_FORMAT_BGRA_8888_PRE,
+      COGL_PIXEL_FORMAT_ARGB_8888,
+      COGL_PIXEL_FORMAT_ABGR_8888_PRE,
+      COGL_PIXEL_FORMAT_RGB_565,
+      COGL_PIXEL_FORMAT_RGBA_4444_PRE
+    };
+  const CoglBitmapSpanFuncs *funcs = _cogl_bitmap_get_span_funcs ();
+  uint8_t src[64 * 4], expected[64 * 4], result[64 * 4];
+  int width, i, alpha_index;
+
+  /* Try every width up to a size that will hit both the vectorized
+     loop and the scalar tail of each kernel */
+  for (width = 0; width < 64; width++)
+    {
+      for (i = 0; i < G_N_ELEMENTS (formats); i++)
         {
-          _cogl_unpack_16 (format, p, tmp_row, width);
-          _cogl_bitmap_premult_unpacked_span_16 (tmp_row, width);
-          _cogl_pack_16 (format, tmp_row, p, width);
+          fill_random_span (src, sizeof (src));
+
+          _cogl_unpack_8 (formats[i], src, expected, width);
+          _cogl_bitmap_unpack_span_8 (formats[i], src, result, width);
+          g_assert (memcmp (expected, result, width * 4) == 0);
+
+          _cogl_pack_8 (formats[i], src, expected, width);
+          _cogl_bitmap_pack_span_8 (formats[i], src, result, width);
+          g_assert (memcmp (expected,
+                            result,
+                            width * _cogl_pixel_format_get_bytes_per_pixel
+                            (formats[i])) == 0);
         }
-      else
+
+      for (alpha_index = 0; alpha_index <= 3; alpha_index += 3)
         {
-          if (format & COGL_AFIRST_BIT)
-            {
-              for (x = 0; x < width; x++)
-                {
-                  _cogl_premult_alpha_first (p);
-                  p += 4;
-                }
-            }
-          else
-            _cogl_bitmap_premult_unpacked_span_8 (p, width);
+          fill_random_span (src, sizeof (src));
+
+          memcpy (expected, src, width * 4);
+          _cogl_premult_8888_c (expected, alpha_index, width);
+          memcpy (result, src, width * 4);
+          funcs->premult_8888 (result, alpha_index, width);
+          g_assert (memcmp (expected, result, width * 4) == 0);
         }
     }
+}
 
-  g_free (tmp_row);
+UNIT_TEST (check_bitmap_span_kernels,
+           0 /* no requirements */,
+           0 /* no failure cases */)
+{
+  CoglBitmapSpanFuncs best_funcs = *_cogl_bitmap_get_span_funcs ();
+  int level;
 
-  _cogl_bitmap_unmap (bmp);
+  /* Force each level that this CPU supports into the dispatch table
+     so that every kernel gets checked, not just the best ones */
+  for (level = 0; level < COGL_BITMAP_N_SPAN_LEVELS; level++)
+    if (_cogl_bitmap_init_span_funcs (&_cogl_bitmap_span_funcs, level))
+      check_span_kernels ();
 
-  _cogl_bitmap_set_format (bmp, format | COGL_PREMULT_BIT);
+  _cogl_bitmap_span_funcs = best_funcs;
+}
 
-  return TRUE;
+UNIT_TEST (check_bitmap_direct_conversion,
+           0 /* no requirements */,
+           0 /* no failure cases */)
+{
+  static const CoglPixelFormat formats[] =
+    {
+      COGL_PIXEL_FORMAT_RGB_888,
+      COGL_PIXEL_FORMAT_BGR_888,
+      COGL_PIXEL_FORMAT_RGBA_8888,
+      COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+      COGL_PIXEL_FORMAT_BGRA_8888,
+      COGL_PIXEL_FORMAT_BGRA_8888_PRE,
+      COGL_PIXEL_FORMAT_ARGB_8888,
+      COGL_PIXEL_FORMAT_ARGB_8888_PRE,
+      COGL_PIXEL_FORMAT_ABGR_8888,
+      COGL_PIXEL_FORMAT_ABGR_8888_PRE,
+      COGL_PIXEL_FORMAT_RGB_565,
+      COGL_PIXEL_FORMAT_RGBA_4444,
+      COGL_PIXEL_FORMAT_RGBA_4444_PRE
+    };
+  const int width = 37;
+  uint8_t src[37 * 4], tmp_row[37 * 4], expected[37 * 4], result[37 * 4];
+  int n_direct = 0;
+  int i, j;
+
+  for (i = 0; i < G_N_ELEMENTS (formats); i++)
+    for (j = 0; j < G_N_ELEMENTS (formats); j++)
+      {
+        CoglPixelFormat src_format = formats[i];
+        CoglPixelFormat dst_format = formats[j];
+        CoglBitmapDirectConverter converter;
+        CoglBool need_premult =
+          ((src_format & COGL_PREMULT_BIT) !=
+           (dst_format & COGL_PREMULT_BIT) &&
+           (src_format & dst_format & COGL_A_BIT));
+
+        if (!_cogl_bitmap_get_direct_converter (src_format,
+                                                dst_format,
+                                                need_premult,
+                                                &converter))
+          continue;
+
+        n_direct++;
+
+        fill_random_span (src, sizeof (src));
+
+        /* Convert the slow way via an unpacked row */
+        _cogl_unpack_8 (src_format, src, tmp_row, width);
+        if (need_premult)
+          {
+            if ((dst_format & COGL_PREMULT_BIT))
+              _cogl_premult_8888_c (tmp_row, 3, width);
+            else
+              _cogl_bitmap_unpremult_unpacked_span_8 (tmp_row, width);
+          }
+        _cogl_pack_8 (dst_format, tmp_row, expected, width);
+
+        _cogl_bitmap_convert_span_direct (&converter, src, result, width);
+
+        g_assert (memcmp (expected,
+                          result,
+                          width * _cogl_pixel_format_get_bytes_per_pixel
+                          (dst_format)) == 0);
+      }
+
+  /* All of the pairs of byte formats should be handled */
+  g_assert_cmpint (n_direct, >=, 10 * 10);
 }
@@ -153,6 +153,11 @@ _cogl_bitmap_copy_subregion (CoglBitmap *src,
 			     int height,
                              CoglError **error);
 
+/* Reverses the order of the rows of the bitmap in-place */
+CoglBool
+_cogl_bitmap_flip_vertically (CoglBitmap *bitmap,
+                              CoglError **error);
+
 /* Creates a deep copy of the source bitmap */
 CoglBitmap *
 _cogl_bitmap_copy (CoglBitmap *src_bmp,
@@ -158,6 +158,43 @@ _cogl_bitmap_copy_subregion (CoglBitmap *src,
   return succeeded;
 }
 
+CoglBool
+_cogl_bitmap_flip_vertically (CoglBitmap *bitmap,
+                              CoglError **error)
+{
+  uint8_t *pixels;
+  uint8_t *temprow;
+  int rowstride = bitmap->rowstride;
+  int height = bitmap->height;
+  int y;
+
+  pixels = _cogl_bitmap_map (bitmap,
+                             COGL_BUFFER_ACCESS_READ |
+                             COGL_BUFFER_ACCESS_WRITE,
+                             0, /* hints */
+                             error);
+
+  if (pixels == NULL)
+    return FALSE;
+
+  temprow = g_alloca (rowstride * sizeof (uint8_t));
+
+  for (y = 0; y < height / 2; y++)
+    {
+      memcpy (temprow,
+              pixels + y * rowstride, rowstride);
+      memcpy (pixels + y * rowstride,
+              pixels + (height - y - 1) * rowstride, rowstride);
+      memcpy (pixels + (height - y - 1) * rowstride,
+              temprow,
+              rowstride);
+    }
+
+  _cogl_bitmap_unmap (bitmap);
+
+  return TRUE;
+}
+
 CoglBool
 cogl_bitmap_get_size_from_file (const char *filename,
                                 int        *width,
@@ -65,6 +65,12 @@ typedef enum _CoglBufferFlags
   COGL_BUFFER_FLAG_MAPPED_FALLBACK = 1UL << 2
 } CoglBufferFlags;
 
+typedef enum {
+  /* The caller guarantees that the GPU isn't using the mapped range
+     so the driver doesn't need to synchronise before mapping it */
+  COGL_BUFFER_MAP_HINT_UNSYNCHRONIZED = 1L << 30
+} CoglPrivateBufferMapHint;
+
 typedef enum {
   COGL_BUFFER_USAGE_HINT_TEXTURE,
   COGL_BUFFER_USAGE_HINT_ATTRIBUTE_BUFFER,
@@ -101,6 +107,13 @@ struct _CoglBuffer
    * ... or points to allocated memory in the fallback paths */
   uint8_t *data;
 
+  /* Small attribute and index buffers that are backed by a buffer
+   * object keep a copy of their contents here so that the journal can
+   * read them back without mapping the buffer. This is NULL if the
+   * copy isn't complete or has been invalidated by mapping the buffer
+   * for writing */
+  uint8_t *shadow_data;
+
   int immutable_ref;
 
   unsigned int store_created:1;
@@ -127,6 +140,11 @@ _cogl_buffer_initialize (CoglBuffer *buffer,
 void
 _cogl_buffer_fini (CoglBuffer *buffer);
 
+/* Returns a pointer to the contents of the buffer if they can be read
+ * on the CPU without mapping the buffer, or NULL otherwise */
+const uint8_t *
+_cogl_buffer_get_cpu_data (CoglBuffer *buffer);
+
 CoglBufferUsageHint
 _cogl_buffer_get_usage_hint (CoglBuffer *buffer);
 
@@ -43,6 +43,10 @@
 #include "cogl-object-private.h"
 #include "cogl-pixel-buffer-private.h"
 
+/* Attribute and index buffers up to this size keep a CPU copy of
+ * their contents. See _cogl_buffer_get_cpu_data() */
+#define COGL_BUFFER_SHADOW_MAX_SIZE 4096
+
 /* XXX:
  * The CoglObject macros don't support any form of inheritance, so for
  * now we implement the CoglObject support for the CoglBuffer
@@ -124,6 +128,7 @@ _cogl_buffer_initialize (CoglBuffer *buffer,
   buffer->usage_hint = usage_hint;
   buffer->update_hint = update_hint;
   buffer->data = NULL;
+  buffer->shadow_data = NULL;
   buffer->immutable_ref = 0;
 
   if (default_target == COGL_BUFFER_BIND_TARGET_PIXEL_PACK ||
@@ -169,6 +174,53 @@ _cogl_buffer_fini (CoglBuffer *buffer)
     buffer->context->driver_vtable->buffer_destroy (buffer);
   else
     g_free (buffer->data);
+
+  g_free (buffer->shadow_data);
+}
+
+static void
+invalidate_shadow_data (CoglBuffer *buffer)
+{
+  g_free (buffer->shadow_data);
+  buffer->shadow_data = NULL;
+}
+
+static void
+update_shadow_data (CoglBuffer *buffer,
+                    size_t offset,
+                    const void *data,
+                    size_t size)
+{
+  if (!(buffer->flags & COGL_BUFFER_FLAG_BUFFER_OBJECT) ||
+      buffer->size > COGL_BUFFER_SHADOW_MAX_SIZE ||
+      (buffer->usage_hint != COGL_BUFFER_USAGE_HINT_ATTRIBUTE_BUFFER &&
+       buffer->usage_hint != COGL_BUFFER_USAGE_HINT_INDEX_BUFFER))
+    return;
+
+  /* We can only start tracking the contents when the whole buffer is
+   * replaced. After that partial updates can be applied to the copy */
+  if (buffer->shadow_data == NULL)
+    {
+      if (offset != 0 || size != buffer->size)
+        return;
+
+      buffer->shadow_data = g_malloc (buffer->size);
+    }
+
+  memcpy (buffer->shadow_data + offset, data, size);
+}
+
+const uint8_t *
+_cogl_buffer_get_cpu_data (CoglBuffer *buffer)
+{
+  if (buffer->flags & (COGL_BUFFER_FLAG_MAPPED |
+                       COGL_BUFFER_FLAG_MAPPED_FALLBACK))
+    return NULL;
+
+  if (buffer->flags & COGL_BUFFER_FLAG_BUFFER_OBJECT)
+    return buffer->shadow_data;
+  else
+    return buffer->data;
 }
 
 unsigned int
@@ -253,6 +305,9 @@ cogl_buffer_map_range (CoglBuffer *buffer,
   if (G_UNLIKELY (buffer->immutable_ref))
     warn_about_midscene_changes ();
 
+  if (access & COGL_BUFFER_ACCESS_WRITE)
+    invalidate_shadow_data (buffer);
+
   buffer->data = buffer->vtable.map_range (buffer,
                                            offset,
                                            size,
@@ -367,7 +422,15 @@ _cogl_buffer_set_data (CoglBuffer *buffer,
   if (G_UNLIKELY (buffer->immutable_ref))
     warn_about_midscene_changes ();
 
-  return buffer->vtable.set_data (buffer, offset, data, size, error);
+  if (!buffer->vtable.set_data (buffer, offset, data, size, error))
+    {
+      invalidate_shadow_data (buffer);
+      return FALSE;
+    }
+
+  update_shadow_data (buffer, offset, data, size);
+
+  return TRUE;
 }
 
 CoglBool
@@ -35,5 +35,9 @@ extern char *_cogl_config_driver;
 extern char *_cogl_config_renderer;
 extern char *_cogl_config_disable_gl_extensions;
 extern char *_cogl_config_override_gl_version;
+extern char *_cogl_config_worker_threads;
+extern char *_cogl_config_conversion_threshold;
+extern char *_cogl_config_pipeline_cache_size;
+extern char *_cogl_config_program_cache_dir;
 
 #endif /* __COGL_CONFIG_PRIVATE_H */
@@ -37,6 +37,10 @@ char *_cogl_config_driver;
 char *_cogl_config_renderer;
 char *_cogl_config_disable_gl_extensions;
 char *_cogl_config_override_gl_version;
+char *_cogl_config_worker_threads;
+char *_cogl_config_conversion_threshold;
+char *_cogl_config_pipeline_cache_size;
+char *_cogl_config_program_cache_dir;
 
 #ifndef COGL_HAS_GLIB_SUPPORT
 
@@ -58,7 +62,11 @@ static const struct
     { "COGL_DRIVER", &_cogl_config_driver },
     { "COGL_RENDERER", &_cogl_config_renderer },
     { "COGL_DISABLE_GL_EXTENSIONS", &_cogl_config_disable_gl_extensions },
-    { "COGL_OVERRIDE_GL_VERSION", &_cogl_config_override_gl_version }
+    { "COGL_OVERRIDE_GL_VERSION", &_cogl_config_override_gl_version },
+    { "COGL_WORKER_THREADS", &_cogl_config_worker_threads },
+    { "COGL_CONVERSION_THRESHOLD", &_cogl_config_conversion_threshold },
+    { "COGL_PIPELINE_CACHE_SIZE", &_cogl_config_pipeline_cache_size },
+    { "COGL_PROGRAM_CACHE_DIR", &_cogl_config_program_cache_dir }
   };
 
 static void
@@ -53,6 +53,10 @@
 #include "cogl-onscreen-private.h"
 #include "cogl-fence-private.h"
 #include "cogl-poll-private.h"
+#include "cogl-worker-pool-private.h"
+#include "cogl-program-binary-cache-private.h"
+#include "cogl-upload-ring-private.h"
+#include "cogl-stream-buffer-private.h"
 #include "cogl-path/cogl-path-types.h"
 
 typedef struct
@@ -109,6 +113,9 @@ struct _CoglContext
   CoglBitmask       enabled_builtin_attributes;
   CoglBitmask       enabled_texcoord_attributes;
   CoglBitmask       enabled_custom_attributes;
+  /* The custom attribute locations that currently have a non-zero
+   * instance divisor */
+  CoglBitmask       instanced_custom_attributes;
 
   /* These are temporary bitmasks that are used when disabling
    * builtin,texcoord and custom attribute arrays. They are here just
@@ -116,6 +123,7 @@ struct _CoglContext
   CoglBitmask       enable_builtin_attributes_tmp;
   CoglBitmask       enable_texcoord_attributes_tmp;
   CoglBitmask       enable_custom_attributes_tmp;
+  CoglBitmask       instanced_custom_attributes_tmp;
   CoglBitmask       changed_bits_tmp;
 
   CoglBool          legacy_backface_culling_enabled;
@@ -322,6 +330,29 @@ struct _CoglContext
   CoglPollSource *fences_poll_source;
   CoglList fences;
 
+  /* Pixel buffers used to stage texture uploads */
+  CoglUploadRing *upload_ring;
+
+  /* Shared buffer for transient geometry such as the journal */
+  CoglStreamBuffer *stream_buffer;
+
+  /* Pipelines that were passed to cogl_pipeline_add_ready_callback()
+     and haven't finished compiling yet */
+  CoglPollSource *pipeline_ready_poll_source;
+  CoglList pipeline_ready_closures;
+
+  /* Optional pool of threads for splitting up CPU-side work. This is
+     NULL unless COGL_WORKER_THREADS is set */
+  CoglWorkerPool *worker_pool;
+  /* The minimum number of pixels in a bitmap before a conversion
+     will be split up between the worker threads */
+  int conversion_threshold;
+
+  /* Optional on-disk cache of linked GLSL programs. This is NULL
+     unless COGL_PROGRAM_CACHE_DIR is set and the driver supports
+     retrieving program binaries */
+  CoglProgramBinaryCache *program_binary_cache;
+
   /* This defines a list of function pointers that Cogl uses from
      either GL or GLES. All functions are accessed indirectly through
      these pointers rather than linking to them directly */
@@ -121,6 +121,24 @@ _cogl_context_get_winsys (CoglContext *context)
   return context->display->renderer->winsys_vtable;
 }
 
+/* Reads an integer option either from the environment or from the
+ * config file with the environment taking priority */
+static int
+get_int_option (const char *env_name,
+                const char *config_value,
+                int default_value)
+{
+  const char *value = g_getenv (env_name);
+
+  if (value == NULL)
+    value = config_value;
+
+  if (value == NULL)
+    return default_value;
+
+  return strtol (value, NULL, 10);
+}
+
 /* For reference: There was some deliberation over whether to have a
  * constructor that could throw an exception but looking at standard
  * practices with several high level OO languages including python, C++,
@@ -138,6 +156,7 @@ cogl_context_new (CoglDisplay *display,
   uint8_t default_texture_data[] = { 0xff, 0xff, 0xff, 0xff };
   CoglBitmap *default_texture_bitmap;
   const CoglWinsysVtable *winsys;
+  const char *program_cache_dir;
   int i;
   CoglError *internal_error = NULL;
 
@@ -338,6 +357,8 @@ cogl_context_new (CoglDisplay *display,
   _cogl_bitmask_init (&context->enable_texcoord_attributes_tmp);
   _cogl_bitmask_init (&context->enabled_custom_attributes);
   _cogl_bitmask_init (&context->enable_custom_attributes_tmp);
+  _cogl_bitmask_init (&context->instanced_custom_attributes);
+  _cogl_bitmask_init (&context->instanced_custom_attributes_tmp);
   _cogl_bitmask_init (&context->changed_bits_tmp);
 
   context->max_texture_units = -1;
@@ -360,7 +381,10 @@ cogl_context_new (CoglDisplay *display,
 
   context->legacy_depth_test_enabled = FALSE;
 
-  context->pipeline_cache = _cogl_pipeline_cache_new ();
+  context->pipeline_cache =
+    _cogl_pipeline_cache_new (get_int_option ("COGL_PIPELINE_CACHE_SIZE",
+                                              _cogl_config_pipeline_cache_size,
+                                              0 /* unlimited */));
 
   for (i = 0; i < COGL_BUFFER_BIND_TARGET_COUNT; i++)
     context->current_buffer[i] = NULL;
@@ -484,6 +508,32 @@ cogl_context_new (CoglDisplay *display,
     GE (context, glEnable (GL_POINT_SPRITE));
 
   _cogl_list_init (&context->fences);
+  _cogl_list_init (&context->pipeline_ready_closures);
+
+  context->upload_ring = _cogl_upload_ring_new (context);
+  context->stream_buffer = _cogl_stream_buffer_new (context);
+
+  /* Let the driver compile shaders on as many threads as it likes so
+   * that cogl_pipeline_precompile() doesn't block */
+  if (context->glMaxShaderCompilerThreads)
+    GE (context, glMaxShaderCompilerThreads (0xffffffff));
+
+  context->worker_pool =
+    _cogl_worker_pool_new (get_int_option ("COGL_WORKER_THREADS",
+                                           _cogl_config_worker_threads,
+                                           0));
+  context->conversion_threshold =
+    get_int_option ("COGL_CONVERSION_THRESHOLD",
+                    _cogl_config_conversion_threshold,
+                    512 * 512);
+
+  program_cache_dir = g_getenv ("COGL_PROGRAM_CACHE_DIR");
+  if (program_cache_dir == NULL)
+    program_cache_dir = _cogl_config_program_cache_dir;
+  if (program_cache_dir && *program_cache_dir &&
+      (context->private_feature_flags & COGL_PRIVATE_FEATURE_GL_PROGRAMMABLE))
+    context->program_binary_cache =
+      _cogl_program_binary_cache_new (context, program_cache_dir);
 
   return context;
 }
@@ -493,6 +543,11 @@ _cogl_context_free (CoglContext *context)
 {
   const CoglWinsysVtable *winsys = _cogl_context_get_winsys (context);
 
+  _cogl_pipeline_remove_all_ready_callbacks (context);
+
+  _cogl_upload_ring_free (context->upload_ring);
+  _cogl_stream_buffer_free (context->stream_buffer);
+
   winsys->context_deinit (context);
 
   _cogl_free_framebuffer_stack (context->framebuffer_stack);
@@ -562,6 +617,8 @@ _cogl_context_free (CoglContext *context)
   _cogl_bitmask_destroy (&context->enable_texcoord_attributes_tmp);
   _cogl_bitmask_destroy (&context->enabled_custom_attributes);
   _cogl_bitmask_destroy (&context->enable_custom_attributes_tmp);
+  _cogl_bitmask_destroy (&context->instanced_custom_attributes);
+  _cogl_bitmask_destroy (&context->instanced_custom_attributes_tmp);
   _cogl_bitmask_destroy (&context->changed_bits_tmp);
 
   if (context->current_modelview_entry)
@@ -585,6 +642,12 @@ _cogl_context_free (CoglContext *context)
 
   g_byte_array_free (context->buffer_map_fallback_array, TRUE);
 
+  if (context->worker_pool)
+    _cogl_worker_pool_free (context->worker_pool);
+
+  if (context->program_binary_cache)
+    _cogl_program_binary_cache_free (context->program_binary_cache);
+
   cogl_object_unref (context->display);
 
   g_free (context);
@@ -767,6 +830,50 @@ _cogl_context_get_gl_version (CoglContext *context)
 
 }
 
+void
+cogl_get_pipeline_cache_stats (CoglContext *context,
+                               int *n_entries,
+                               unsigned long *n_hits,
+                               unsigned long *n_misses,
+                               unsigned long *n_evictions)
+{
+  CoglPipelineCacheStats stats;
+
+  _cogl_pipeline_cache_get_stats (context->pipeline_cache, &stats);
+
+  if (n_entries)
+    *n_entries = stats.n_entries;
+  if (n_hits)
+    *n_hits = stats.n_hits;
+  if (n_misses)
+    *n_misses = stats.n_misses;
+  if (n_evictions)
+    *n_evictions = stats.n_evictions;
+}
+
+CoglBool
+cogl_save_pipeline_manifest (CoglContext *context,
+                             const char *filename,
+                             CoglError **error)
+{
+  CoglPipelineManifest *manifest =
+    _cogl_pipeline_cache_get_manifest (context->pipeline_cache);
+
+  return _cogl_pipeline_manifest_save (manifest, filename, error);
+}
+
+CoglBool
+cogl_load_pipeline_manifest (CoglContext *context,
+                             const char *filename,
+                             CoglError **error)
+{
+  /* Start recording before replaying so that the loaded pipelines
+   * will be in the next manifest that is saved */
+  _cogl_pipeline_cache_get_manifest (context->pipeline_cache);
+
+  return _cogl_pipeline_manifest_replay (context, filename, error);
+}
+
 int64_t
 cogl_get_clock_time (CoglContext *context)
 {
@@ -231,6 +231,11 @@ cogl_is_context (void *object);
  *     the depth buffer to a texture.
  * @COGL_FEATURE_ID_PRESENTATION_TIME: Whether frame presentation
  *    time stamps will be recorded in #CoglFrameInfo objects.
+ * @COGL_FEATURE_ID_HALF_FLOAT_VERTEX: Whether attributes can use
+ *    %COGL_ATTRIBUTE_TYPE_HALF_FLOAT. (Since 2.0)
+ * @COGL_FEATURE_ID_TEXTURE_RG: Whether textures can be stored with
+ *    only red and green components using %COGL_PIXEL_FORMAT_RG_88.
+ *    (Since 2.0)
  *
  * All the capabilities that can vary between different GPUs supported
  * by Cogl. Applications that depend on any of these features should explicitly
@@ -263,6 +268,8 @@ typedef enum _CoglFeatureID
   COGL_FEATURE_ID_PRESENTATION_TIME,
   COGL_FEATURE_ID_FENCE,
   COGL_FEATURE_ID_PER_VERTEX_POINT_SIZE,
+  COGL_FEATURE_ID_HALF_FLOAT_VERTEX,
+  COGL_FEATURE_ID_TEXTURE_RG,
 
   /*< private >*/
   _COGL_N_FEATURE_IDS   /*< skip >*/
@@ -365,6 +372,104 @@ cogl_foreach_feature (CoglContext *context,
 int64_t
 cogl_get_clock_time (CoglContext *context);
 
+/**
+ * cogl_get_pipeline_cache_stats:
+ * @context: a #CoglContext pointer
+ * @n_entries: (out) (allow-none): return location for the number of
+ *   entries currently in the cache
+ * @n_hits: (out) (allow-none): return location for the number of
+ *   lookups that found an existing entry
+ * @n_misses: (out) (allow-none): return location for the number of
+ *   lookups that had to add a new entry
+ * @n_evictions: (out) (allow-none): return location for the number of
+ *   entries that have been evicted to stay within the cache size
+ *
+ * Queries statistics about the cache that Cogl uses to share
+ * generated shaders and programs between pipelines with similar
+ * state. The numbers are the totals for the vertex shader, fragment
+ * shader and program caches.
+ *
+ * By default the cache grows without bound. The maximum number of
+ * entries can be limited with the COGL_PIPELINE_CACHE_SIZE
+ * environment variable or the option of the same name in the
+ * configuration file. When the limit is reached the least recently
+ * used entries will be evicted.
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+void
+cogl_get_pipeline_cache_stats (CoglContext *context,
+                               int *n_entries,
+                               unsigned long *n_hits,
+                               unsigned long *n_misses,
+                               unsigned long *n_evictions);
+
+/**
+ * cogl_save_pipeline_manifest:
+ * @context: a #CoglContext pointer
+ * @filename: The file to write the manifest to
+ * @error: A #CoglError return location
+ *
+ * Writes a description of every pipeline program that Cogl has had to
+ * generate so far to @filename. The description only contains the
+ * state that affects the generated shaders, such as the layer combine
+ * functions, texture types and snippets, so the file is small and
+ * doesn't depend on any textures or other resources of the
+ * application.
+ *
+ * The file can be passed to cogl_load_pipeline_manifest() in a later
+ * session, for example while showing a loading screen, so that all
+ * of the programs will already be compiled before the first frame
+ * of an animation instead of being compiled as each pipeline is first
+ * used. Pipelines loaded from a manifest are recorded again so saving
+ * the manifest at the end of each session will accumulate the
+ * pipelines seen in all of them.
+ *
+ * Cogl only starts recording pipelines the first time this function
+ * or cogl_load_pipeline_manifest() is called. At that point the
+ * programs that are still in the pipeline cache are added to the
+ * manifest. If the size of the cache has been limited then an
+ * application that wants a complete manifest should call one of the
+ * functions early on. Pipelines that use a #CoglProgram are not
+ * recorded and at most 1024 pipelines are recorded in total.
+ *
+ * Return value: %TRUE if the file was written or %FALSE otherwise
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+CoglBool
+cogl_save_pipeline_manifest (CoglContext *context,
+                             const char *filename,
+                             CoglError **error);
+
+/**
+ * cogl_load_pipeline_manifest:
+ * @context: a #CoglContext pointer
+ * @filename: A file written by cogl_save_pipeline_manifest()
+ * @error: A #CoglError return location
+ *
+ * Recreates each pipeline described in @filename and calls
+ * cogl_pipeline_precompile() on it so that the programs for any
+ * pipeline with the same state will be ready by the time it is first
+ * used. Entries in the manifest that can't be used with the current
+ * driver are silently skipped. This also starts recording new
+ * pipelines for cogl_save_pipeline_manifest(), even if @filename
+ * can't be read.
+ *
+ * Return value: %TRUE if the manifest was loaded or %FALSE if the
+ *   file couldn't be read or is not a manifest written by a
+ *   compatible version of Cogl
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+CoglBool
+cogl_load_pipeline_manifest (CoglContext *context,
+                             const char *filename,
+                             CoglError **error);
+
 #endif /* COGL_ENABLE_EXPERIMENTAL_API */
 
 COGL_END_DECLS
@@ -180,6 +180,30 @@ OPT (DISABLE_FAST_READ_PIXEL,
      N_("Disable read pixel optimization"),
      N_("Disable optimization for reading 1px for simple "
         "scenes of opaque rectangles"))
+OPT (DISABLE_JOURNAL_REORDER,
+     N_("Root Cause"),
+     "disable-journal-reorder",
+     N_("Disable journal reordering"),
+     N_("Disables moving non-overlapping journal entries to improve "
+        "batching"))
+OPT (DISABLE_INSTANCED_QUADS,
+     N_("Root Cause"),
+     "disable-instanced-quads",
+     N_("Disable instanced journal quads"),
+     N_("Always expand journal rectangles to four vertices instead of "
+        "drawing them with instanced arrays"))
+OPT (DISABLE_COMPACT_VERTICES,
+     N_("Root Cause"),
+     "disable-compact-vertices",
+     N_("Disable compact journal vertices"),
+     N_("Always upload the journal's vertices as floats even if they "
+        "would fit in shorts"))
+OPT (DISABLE_OVERDRAW_CULLING,
+     N_("Root Cause"),
+     "disable-overdraw-culling",
+     N_("Disable journal overdraw culling"),
+     N_("Draw journal entries even if they are completely covered by "
+        "a later opaque rectangle"))
 OPT (CLIPPING,
      N_("Cogl Tracing"),
      "clipping",
@@ -80,7 +80,11 @@ static const GDebugKey cogl_behavioural_debug_keys[] = {
   { "wireframe", COGL_DEBUG_WIREFRAME},
   { "disable-software-clip", COGL_DEBUG_DISABLE_SOFTWARE_CLIP},
   { "disable-program-caches", COGL_DEBUG_DISABLE_PROGRAM_CACHES},
-  { "disable-fast-read-pixel", COGL_DEBUG_DISABLE_FAST_READ_PIXEL}
+  { "disable-fast-read-pixel", COGL_DEBUG_DISABLE_FAST_READ_PIXEL},
+  { "disable-journal-reorder", COGL_DEBUG_DISABLE_JOURNAL_REORDER},
+  { "disable-instanced-quads", COGL_DEBUG_DISABLE_INSTANCED_QUADS},
+  { "disable-compact-vertices", COGL_DEBUG_DISABLE_COMPACT_VERTICES},
+  { "disable-overdraw-culling", COGL_DEBUG_DISABLE_OVERDRAW_CULLING}
 };
 static const int n_cogl_behavioural_debug_keys =
   G_N_ELEMENTS (cogl_behavioural_debug_keys);
@@ -186,12 +190,24 @@ _cogl_parse_debug_string (const char *value,
       g_printerr ("\n"
                   "%28s\n"
                   " COGL_DISABLE_GL_EXTENSIONS: %s\n"
-                  "   COGL_OVERRIDE_GL_VERSION: %s\n",
+                  "   COGL_OVERRIDE_GL_VERSION: %s\n"
+                  "        COGL_WORKER_THREADS: %s\n"
+                  "  COGL_CONVERSION_THRESHOLD: %s\n"
+                  "   COGL_PIPELINE_CACHE_SIZE: %s\n"
+                  "     COGL_PROGRAM_CACHE_DIR: %s\n",
                   _("Additional environment variables:"),
                   _("Comma-separated list of GL extensions to pretend are "
                     "disabled"),
                   _("Override the GL version that Cogl will assume the driver "
-                    "supports"));
+                    "supports"),
+                  _("Number of worker threads to use for CPU-side work such "
+                    "as converting bitmaps"),
+                  _("Minimum number of pixels in a bitmap before converting "
+                    "it is split between the worker threads"),
+                  _("Maximum number of generated shaders and programs to "
+                    "keep in each cache or 0 for no limit"),
+                  _("Directory in which to save linked GLSL programs so "
+                    "they can be reused by later processes"));
       exit (1);
     }
   else
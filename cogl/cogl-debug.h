@@ -65,6 +65,10 @@ typedef enum {
   COGL_DEBUG_DISABLE_SOFTWARE_CLIP,
   COGL_DEBUG_DISABLE_PROGRAM_CACHES,
   COGL_DEBUG_DISABLE_FAST_READ_PIXEL,
+  COGL_DEBUG_DISABLE_JOURNAL_REORDER,
+  COGL_DEBUG_DISABLE_INSTANCED_QUADS,
+  COGL_DEBUG_DISABLE_COMPACT_VERTICES,
+  COGL_DEBUG_DISABLE_OVERDRAW_CULLING,
   COGL_DEBUG_CLIPPING,
   COGL_DEBUG_WINSYS,
   COGL_DEBUG_PERFORMANCE,
@@ -0,0 +1,109 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2013 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#ifndef __COGL_DRAW_LIST_PRIVATE_H
+#define __COGL_DRAW_LIST_PRIVATE_H
+
+#include "cogl-object-private.h"
+#include "cogl-draw-list.h"
+#include "cogl-matrix-stack.h"
+
+typedef enum
+{
+  /* Rectangles that have already been transformed and which are
+   * drawn from a single vertex buffer */
+  COGL_DRAW_LIST_NODE_BATCH,
+  /* Rectangles that can't be batched, for example because they use
+   * a meta texture. These are drawn through the journal */
+  COGL_DRAW_LIST_NODE_RECTANGLES,
+  COGL_DRAW_LIST_NODE_PRIMITIVE,
+  COGL_DRAW_LIST_NODE_PUSH_CLIP,
+  COGL_DRAW_LIST_NODE_POP_CLIP
+} CoglDrawListNodeType;
+
+typedef struct _CoglDrawListNode
+{
+  CoglDrawListNodeType type;
+
+  CoglPipeline *pipeline;
+
+  /* The transformation that was current when the node was recorded.
+   * This isn't used for batches because their vertices have already
+   * been transformed */
+  CoglMatrixEntry *modelview_entry;
+  CoglMatrix modelview;
+
+  union
+  {
+    struct
+    {
+      int n_layers;
+      int n_rectangles;
+      /* The transformed vertices. These are kept after the primitive
+       * is created so that it can be recreated if more rectangles are
+       * added */
+      GArray *vertices;
+      CoglPrimitive *primitive;
+    } batch;
+
+    struct
+    {
+      int tex_coords_len;
+      /* The position followed by the texture coordinates for each
+       * rectangle */
+      GArray *data;
+    } rectangles;
+
+    struct
+    {
+      CoglPrimitive *primitive;
+    } primitive;
+
+    struct
+    {
+      float x_1, y_1;
+      float x_2, y_2;
+    } clip;
+  } d;
+} CoglDrawListNode;
+
+struct _CoglDrawList
+{
+  CoglObject _parent;
+
+  CoglContext *context;
+
+  CoglMatrixStack *matrix_stack;
+
+  /* The matrix for the last entry that was looked up from the stack
+   * so that we don't have to recalculate it for every rectangle */
+  CoglMatrixEntry *cached_entry;
+  CoglMatrix cached_matrix;
+
+  /* A queue of CoglDrawListNodes */
+  GQueue nodes;
+
+  int n_clips;
+};
+
+#endif /* __COGL_DRAW_LIST_PRIVATE_H */
@@ -0,0 +1,706 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2013 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "cogl-util.h"
+#include "cogl-draw-list.h"
+#include "cogl-draw-list-private.h"
+#include "cogl-context-private.h"
+#include "cogl-texture-private.h"
+#include "cogl-primitive-texture.h"
+#include "cogl-primitives-private.h"
+#include "cogl-attribute-buffer.h"
+#include "cogl-indices.h"
+
+/* The rectangles in a batch are drawn using the shared rectangle
+ * indices which can't address more vertices than this */
+#define COGL_DRAW_LIST_MAX_BATCH_RECTANGLES (65536 / 4)
+
+static void _cogl_draw_list_free (CoglDrawList *list);
+
+COGL_OBJECT_DEFINE (DrawList, draw_list);
+
+CoglDrawList *
+cogl_draw_list_new (CoglContext *context)
+{
+  CoglDrawList *list = g_slice_new0 (CoglDrawList);
+
+  list->context = context;
+  list->matrix_stack = cogl_matrix_stack_new (context);
+  g_queue_init (&list->nodes);
+
+  return _cogl_draw_list_object_new (list);
+}
+
+static void
+_cogl_draw_list_node_free (CoglDrawListNode *node)
+{
+  switch (node->type)
+    {
+    case COGL_DRAW_LIST_NODE_BATCH:
+      g_array_free (node->d.batch.vertices, TRUE);
+      if (node->d.batch.primitive)
+        cogl_object_unref (node->d.batch.primitive);
+      break;
+
+    case COGL_DRAW_LIST_NODE_RECTANGLES:
+      g_array_free (node->d.rectangles.data, TRUE);
+      break;
+
+    case COGL_DRAW_LIST_NODE_PRIMITIVE:
+      cogl_object_unref (node->d.primitive.primitive);
+      break;
+
+    case COGL_DRAW_LIST_NODE_PUSH_CLIP:
+    case COGL_DRAW_LIST_NODE_POP_CLIP:
+      break;
+    }
+
+  if (node->pipeline)
+    cogl_object_unref (node->pipeline);
+  if (node->modelview_entry)
+    cogl_matrix_entry_unref (node->modelview_entry);
+
+  g_slice_free (CoglDrawListNode, node);
+}
+
+static void
+_cogl_draw_list_free_nodes (CoglDrawList *list)
+{
+  CoglDrawListNode *node;
+
+  while ((node = g_queue_pop_head (&list->nodes)))
+    _cogl_draw_list_node_free (node);
+
+  list->n_clips = 0;
+}
+
+static void
+_cogl_draw_list_free (CoglDrawList *list)
+{
+  _cogl_draw_list_free_nodes (list);
+
+  if (list->cached_entry)
+    cogl_matrix_entry_unref (list->cached_entry);
+  cogl_object_unref (list->matrix_stack);
+
+  g_slice_free (CoglDrawList, list);
+}
+
+void
+cogl_draw_list_clear (CoglDrawList *list)
+{
+  _COGL_RETURN_IF_FAIL (cogl_is_draw_list (list));
+
+  _cogl_draw_list_free_nodes (list);
+
+  /* There's no way to drop the saved matrices from a stack so we
+   * just start a new one */
+  cogl_object_unref (list->matrix_stack);
+  list->matrix_stack = cogl_matrix_stack_new (list->context);
+}
+
+void
+cogl_draw_list_push_matrix (CoglDrawList *list)
+{
+  _COGL_RETURN_IF_FAIL (cogl_is_draw_list (list));
+
+  cogl_matrix_stack_push (list->matrix_stack);
+}
+
+void
+cogl_draw_list_pop_matrix (CoglDrawList *list)
+{
+  _COGL_RETURN_IF_FAIL (cogl_is_draw_list (list));
+
+  cogl_matrix_stack_pop (list->matrix_stack);
+}
+
+void
+cogl_draw_list_identity_matrix (CoglDrawList *list)
+{
+  _COGL_RETURN_IF_FAIL (cogl_is_draw_list (list));
+
+  cogl_matrix_stack_load_identity (list->matrix_stack);
+}
+
+void
+cogl_draw_list_translate (CoglDrawList *list,
+                          float x,
+                          float y,
+                          float z)
+{
+  _COGL_RETURN_IF_FAIL (cogl_is_draw_list (list));
+
+  cogl_matrix_stack_translate (list->matrix_stack, x, y, z);
+}
+
+void
+cogl_draw_list_scale (CoglDrawList *list,
+                      float x,
+                      float y,
+                      float z)
+{
+  _COGL_RETURN_IF_FAIL (cogl_is_draw_list (list));
+
+  cogl_matrix_stack_scale (list->matrix_stack, x, y, z);
+}
+
+void
+cogl_draw_list_rotate (CoglDrawList *list,
+                       float angle,
+                       float x,
+                       float y,
+                       float z)
+{
+  _COGL_RETURN_IF_FAIL (cogl_is_draw_list (list));
+
+  cogl_matrix_stack_rotate (list->matrix_stack, angle, x, y, z);
+}
+
+void
+cogl_draw_list_transform (CoglDrawList *list,
+                          const CoglMatrix *matrix)
+{
+  _COGL_RETURN_IF_FAIL (cogl_is_draw_list (list));
+
+  cogl_matrix_stack_multiply (list->matrix_stack, matrix);
+}
+
+/* Gets the current transformation of the list. The entry for it is
+ * returned in @entry_out without taking a reference */
+static const CoglMatrix *
+get_current_matrix (CoglDrawList *list,
+                    CoglMatrixEntry **entry_out)
+{
+  CoglMatrixEntry *entry = cogl_matrix_stack_get_entry (list->matrix_stack);
+
+  if (entry != list->cached_entry)
+    {
+      cogl_matrix_entry_ref (entry);
+      if (list->cached_entry)
+        cogl_matrix_entry_unref (list->cached_entry);
+      list->cached_entry = entry;
+
+      cogl_matrix_entry_get (entry, &list->cached_matrix);
+    }
+
+  if (entry_out)
+    *entry_out = entry;
+
+  return &list->cached_matrix;
+}
+
+static CoglDrawListNode *
+add_node (CoglDrawList *list,
+          CoglDrawListNodeType type,
+          CoglPipeline *pipeline,
+          CoglBool needs_modelview)
+{
+  CoglDrawListNode *node = g_slice_new0 (CoglDrawListNode);
+
+  node->type = type;
+
+  if (pipeline)
+    node->pipeline = cogl_object_ref (pipeline);
+
+  if (needs_modelview)
+    {
+      CoglMatrixEntry *entry;
+      const CoglMatrix *matrix = get_current_matrix (list, &entry);
+
+      node->modelview_entry = cogl_matrix_entry_ref (entry);
+      node->modelview = *matrix;
+    }
+
+  g_queue_push_tail (&list->nodes, node);
+
+  return node;
+}
+
+void
+cogl_draw_list_push_rectangle_clip (CoglDrawList *list,
+                                    float x_1,
+                                    float y_1,
+                                    float x_2,
+                                    float y_2)
+{
+  CoglDrawListNode *node;
+
+  _COGL_RETURN_IF_FAIL (cogl_is_draw_list (list));
+
+  node = add_node (list, COGL_DRAW_LIST_NODE_PUSH_CLIP, NULL, TRUE);
+  node->d.clip.x_1 = x_1;
+  node->d.clip.y_1 = y_1;
+  node->d.clip.x_2 = x_2;
+  node->d.clip.y_2 = y_2;
+
+  list->n_clips++;
+}
+
+void
+cogl_draw_list_pop_clip (CoglDrawList *list)
+{
+  _COGL_RETURN_IF_FAIL (cogl_is_draw_list (list));
+  _COGL_RETURN_IF_FAIL (list->n_clips > 0);
+
+  add_node (list, COGL_DRAW_LIST_NODE_POP_CLIP, NULL, FALSE);
+
+  list->n_clips--;
+}
+
+typedef struct
+{
+  int i;
+  const float *user_tex_coords;
+  int user_tex_coords_len;
+  float *final_tex_coords;
+  CoglBool can_batch;
+} ValidateBatchLayerState;
+
+static CoglBool
+validate_batch_layer_cb (CoglPipeline *pipeline,
+                         int layer_index,
+                         void *user_data)
+{
+  ValidateBatchLayerState *state = user_data;
+  static const float default_tex_coords[4] = { 0.0, 0.0, 1.0, 1.0 };
+  const float *in_tex_coords;
+  float *out_tex_coords;
+  CoglTexture *texture;
+  CoglTransformResult transform_result;
+
+  state->i++;
+
+  if (state->i >= state->user_tex_coords_len / 4)
+    in_tex_coords = default_tex_coords;
+  else
+    in_tex_coords = &state->user_tex_coords[state->i * 4];
+
+  out_tex_coords = &state->final_tex_coords[state->i * 4];
+  memcpy (out_tex_coords, in_tex_coords, sizeof (float) * 4);
+
+  texture = cogl_pipeline_get_layer_texture (pipeline, layer_index);
+
+  if (texture == NULL)
+    return TRUE;
+
+  /* Meta textures such as atlas textures can move their storage
+   * around so we can't convert the texture coordinates up front */
+  if (!cogl_is_primitive_texture (texture))
+    {
+      state->can_batch = FALSE;
+      return FALSE;
+    }
+
+  transform_result =
+    _cogl_texture_transform_quad_coords_to_gl (texture, out_tex_coords);
+
+  /* Repeating needs the wrap mode of the pipeline to be overridden
+   * when it is automatic so we'll let the journal handle it */
+  if (transform_result != COGL_TRANSFORM_NO_REPEAT)
+    {
+      state->can_batch = FALSE;
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static CoglBool
+matrix_is_affine (const CoglMatrix *matrix)
+{
+  return (matrix->wx == 0.0f &&
+          matrix->wy == 0.0f &&
+          matrix->wz == 0.0f &&
+          matrix->ww == 1.0f);
+}
+
+static void
+add_batch_rectangle (CoglDrawList *list,
+                     CoglPipeline *pipeline,
+                     const float *position,
+                     int n_layers,
+                     const float *tex_coords)
+{
+  CoglDrawListNode *node = g_queue_peek_tail (&list->nodes);
+  const CoglMatrix *matrix = get_current_matrix (list, NULL);
+  size_t stride = 3 + n_layers * 2;
+  float corners[8];
+  float *v;
+  int i;
+
+  if (node == NULL ||
+      node->type != COGL_DRAW_LIST_NODE_BATCH ||
+      node->pipeline != pipeline ||
+      node->d.batch.n_layers != n_layers ||
+      node->d.batch.n_rectangles >= COGL_DRAW_LIST_MAX_BATCH_RECTANGLES)
+    {
+      node = add_node (list, COGL_DRAW_LIST_NODE_BATCH, pipeline, FALSE);
+      node->d.batch.n_layers = n_layers;
+      node->d.batch.vertices = g_array_new (FALSE, FALSE, sizeof (float));
+    }
+  else if (node->d.batch.primitive)
+    {
+      /* Get rid of the primitive so that it will be recreated with
+       * the new rectangle */
+      cogl_object_unref (node->d.batch.primitive);
+      node->d.batch.primitive = NULL;
+    }
+
+  g_array_set_size (node->d.batch.vertices,
+                    node->d.batch.vertices->len + stride * 4);
+  v = &g_array_index (node->d.batch.vertices, float,
+                      node->d.batch.vertices->len - stride * 4);
+
+  /* The corners are in the same order as the vertices used by the
+   * journal so that the rectangle indices can be used */
+  corners[0] = position[0];
+  corners[1] = position[1];
+  corners[2] = position[0];
+  corners[3] = position[3];
+  corners[4] = position[2];
+  corners[5] = position[3];
+  corners[6] = position[2];
+  corners[7] = position[1];
+
+  cogl_matrix_transform_points (matrix,
+                                2, /* n_components */
+                                sizeof (float) * 2, /* stride_in */
+                                corners, /* points_in */
+                                sizeof (float) * stride, /* stride_out */
+                                v, /* points_out */
+                                4 /* n_points */);
+
+  for (i = 0; i < n_layers; i++)
+    {
+      const float *t = tex_coords + i * 4;
+      float *tout = v + 3 + i * 2;
+
+      tout[stride * 0] = t[0];
+      tout[stride * 0 + 1] = t[1];
+      tout[stride * 1] = t[0];
+      tout[stride * 1 + 1] = t[3];
+      tout[stride * 2] = t[2];
+      tout[stride * 2 + 1] = t[3];
+      tout[stride * 3] = t[2];
+      tout[stride * 3 + 1] = t[1];
+    }
+
+  node->d.batch.n_rectangles++;
+}
+
+static void
+add_fallback_rectangle (CoglDrawList *list,
+                        CoglPipeline *pipeline,
+                        const float *position,
+                        const float *tex_coords,
+                        int tex_coords_len)
+{
+  CoglDrawListNode *node = g_queue_peek_tail (&list->nodes);
+  CoglMatrixEntry *entry;
+  GArray *data;
+
+  get_current_matrix (list, &entry);
+
+  if (node == NULL ||
+      node->type != COGL_DRAW_LIST_NODE_RECTANGLES ||
+      node->pipeline != pipeline ||
+      node->modelview_entry != entry ||
+      node->d.rectangles.tex_coords_len != tex_coords_len)
+    {
+      node = add_node (list, COGL_DRAW_LIST_NODE_RECTANGLES, pipeline, TRUE);
+      node->d.rectangles.tex_coords_len = tex_coords_len;
+      node->d.rectangles.data = g_array_new (FALSE, FALSE, sizeof (float));
+    }
+
+  data = node->d.rectangles.data;
+  g_array_append_vals (data, position, 4);
+  g_array_append_vals (data, tex_coords, tex_coords_len);
+}
+
+void
+cogl_draw_list_draw_multitextured_rectangle (CoglDrawList *list,
+                                             CoglPipeline *pipeline,
+                                             float x_1,
+                                             float y_1,
+                                             float x_2,
+                                             float y_2,
+                                             const float *tex_coords,
+                                             int tex_coords_len)
+{
+  const float position[4] = { x_1, y_1, x_2, y_2 };
+  int n_layers;
+  ValidateBatchLayerState state;
+
+  _COGL_RETURN_IF_FAIL (cogl_is_draw_list (list));
+  _COGL_RETURN_IF_FAIL (cogl_is_pipeline (pipeline));
+
+  n_layers = cogl_pipeline_get_n_layers (pipeline);
+
+  state.i = -1;
+  state.user_tex_coords = tex_coords;
+  state.user_tex_coords_len = tex_coords_len;
+  state.final_tex_coords = g_alloca (sizeof (float) * 4 * n_layers);
+  state.can_batch = matrix_is_affine (get_current_matrix (list, NULL));
+
+  if (state.can_batch)
+    cogl_pipeline_foreach_layer (pipeline,
+                                 validate_batch_layer_cb,
+                                 &state);
+
+  if (state.can_batch)
+    add_batch_rectangle (list,
+                         pipeline,
+                         position,
+                         n_layers,
+                         state.final_tex_coords);
+  else
+    add_fallback_rectangle (list,
+                            pipeline,
+                            position,
+                            tex_coords,
+                            tex_coords_len);
+}
+
+void
+cogl_draw_list_draw_rectangle (CoglDrawList *list,
+                               CoglPipeline *pipeline,
+                               float x_1,
+                               float y_1,
+                               float x_2,
+                               float y_2)
+{
+  cogl_draw_list_draw_multitextured_rectangle (list,
+                                               pipeline,
+                                               x_1, y_1, x_2, y_2,
+                                               NULL, 0);
+}
+
+void
+cogl_draw_list_draw_textured_rectangle (CoglDrawList *list,
+                                        CoglPipeline *pipeline,
+                                        float x_1,
+                                        float y_1,
+                                        float x_2,
+                                        float y_2,
+                                        float s_1,
+                                        float t_1,
+                                        float s_2,
+                                        float t_2)
+{
+  const float tex_coords[4] = { s_1, t_1, s_2, t_2 };
+
+  cogl_draw_list_draw_multitextured_rectangle (list,
+                                               pipeline,
+                                               x_1, y_1, x_2, y_2,
+                                               tex_coords, 4);
+}
+
+void
+cogl_draw_list_draw_primitive (CoglDrawList *list,
+                               CoglPipeline *pipeline,
+                               CoglPrimitive *primitive)
+{
+  CoglDrawListNode *node;
+
+  _COGL_RETURN_IF_FAIL (cogl_is_draw_list (list));
+  _COGL_RETURN_IF_FAIL (cogl_is_pipeline (pipeline));
+  _COGL_RETURN_IF_FAIL (cogl_is_primitive (primitive));
+
+  node = add_node (list, COGL_DRAW_LIST_NODE_PRIMITIVE, pipeline, TRUE);
+  node->d.primitive.primitive = cogl_object_ref (primitive);
+}
+
+static CoglPrimitive *
+create_batch_primitive (CoglContext *ctx,
+                        CoglDrawListNode *node)
+{
+  static const char *names[] = {
+      "cogl_tex_coord0_in",
+      "cogl_tex_coord1_in",
+      "cogl_tex_coord2_in",
+      "cogl_tex_coord3_in",
+      "cogl_tex_coord4_in",
+      "cogl_tex_coord5_in",
+      "cogl_tex_coord6_in",
+      "cogl_tex_coord7_in"
+  };
+  int n_layers = node->d.batch.n_layers;
+  size_t stride = (3 + n_layers * 2) * sizeof (float);
+  int n_vertices = node->d.batch.n_rectangles * 4;
+  CoglAttributeBuffer *buffer;
+  CoglAttribute **attributes;
+  CoglPrimitive *primitive;
+  CoglIndices *indices;
+  int i;
+
+  buffer = cogl_attribute_buffer_new (ctx,
+                                      node->d.batch.vertices->len *
+                                      sizeof (float),
+                                      node->d.batch.vertices->data);
+
+  attributes = g_alloca (sizeof (CoglAttribute *) * (n_layers + 1));
+
+  attributes[0] = cogl_attribute_new (buffer,
+                                      "cogl_position_in",
+                                      stride,
+                                      0, /* offset */
+                                      3, /* n_components */
+                                      COGL_ATTRIBUTE_TYPE_FLOAT);
+
+  for (i = 0; i < n_layers; i++)
+    {
+      char *name = (i < G_N_ELEMENTS (names) ?
+                    (char *) names[i] :
+                    g_strdup_printf ("cogl_tex_coord%d_in", i));
+
+      attributes[i + 1] =
+        cogl_attribute_new (buffer,
+                            name,
+                            stride,
+                            (3 + i * 2) * sizeof (float),
+                            2, /* n_components */
+                            COGL_ATTRIBUTE_TYPE_FLOAT);
+
+      if (i >= G_N_ELEMENTS (names))
+        g_free (name);
+    }
+
+  primitive =
+    cogl_primitive_new_with_attributes (COGL_VERTICES_MODE_TRIANGLES,
+                                        n_vertices,
+                                        attributes,
+                                        n_layers + 1);
+
+  indices = cogl_get_rectangle_indices (ctx, node->d.batch.n_rectangles);
+  cogl_primitive_set_indices (primitive,
+                              indices,
+                              node->d.batch.n_rectangles * 6);
+
+  for (i = 0; i < n_layers + 1; i++)
+    cogl_object_unref (attributes[i]);
+  cogl_object_unref (buffer);
+
+  return primitive;
+}
+
+static void
+replay_rectangles (CoglFramebuffer *framebuffer,
+                   CoglDrawListNode *node)
+{
+  int tex_coords_len = node->d.rectangles.tex_coords_len;
+  const float *data = (const float *) node->d.rectangles.data->data;
+  int n_rects = node->d.rectangles.data->len / (4 + tex_coords_len);
+  CoglMultiTexturedRect *rects = g_new (CoglMultiTexturedRect, n_rects);
+  int i;
+
+  for (i = 0; i < n_rects; i++)
+    {
+      rects[i].position = data;
+      rects[i].tex_coords = tex_coords_len ? data + 4 : NULL;
+      rects[i].tex_coords_len = tex_coords_len;
+      data += 4 + tex_coords_len;
+    }
+
+  _cogl_framebuffer_draw_multitextured_rectangles (framebuffer,
+                                                   node->pipeline,
+                                                   rects,
+                                                   n_rects,
+                                                   TRUE);
+
+  g_free (rects);
+}
+
+void
+cogl_draw_list_replay (CoglDrawList *list,
+                       CoglFramebuffer *framebuffer)
+{
+  CoglContext *ctx = list->context;
+  GList *l;
+  int n_clips = 0;
+
+  _COGL_RETURN_IF_FAIL (cogl_is_draw_list (list));
+  _COGL_RETURN_IF_FAIL (cogl_is_framebuffer (framebuffer));
+
+  for (l = list->nodes.head; l; l = l->next)
+    {
+      CoglDrawListNode *node = l->data;
+      CoglBool push_modelview =
+        (node->modelview_entry &&
+         !cogl_matrix_entry_is_identity (node->modelview_entry));
+
+      if (push_modelview)
+        {
+          cogl_framebuffer_push_matrix (framebuffer);
+          cogl_framebuffer_transform (framebuffer, &node->modelview);
+        }
+
+      switch (node->type)
+        {
+        case COGL_DRAW_LIST_NODE_BATCH:
+          if (node->d.batch.primitive == NULL)
+            node->d.batch.primitive = create_batch_primitive (ctx, node);
+          cogl_primitive_draw (node->d.batch.primitive,
+                               framebuffer,
+                               node->pipeline);
+          break;
+
+        case COGL_DRAW_LIST_NODE_RECTANGLES:
+          replay_rectangles (framebuffer, node);
+          break;
+
+        case COGL_DRAW_LIST_NODE_PRIMITIVE:
+          cogl_primitive_draw (node->d.primitive.primitive,
+                               framebuffer,
+                               node->pipeline);
+          break;
+
+        case COGL_DRAW_LIST_NODE_PUSH_CLIP:
+          cogl_framebuffer_push_rectangle_clip (framebuffer,
+                                                node->d.clip.x_1,
+                                                node->d.clip.y_1,
+                                                node->d.clip.x_2,
+                                                node->d.clip.y_2);
+          n_clips++;
+          break;
+
+        case COGL_DRAW_LIST_NODE_POP_CLIP:
+          cogl_framebuffer_pop_clip (framebuffer);
+          n_clips--;
+          break;
+        }
+
+      if (push_modelview)
+        cogl_framebuffer_pop_matrix (framebuffer);
+    }
+
+  /* Leave the clip stack as we found it */
+  while (n_clips-- > 0)
+    cogl_framebuffer_pop_clip (framebuffer);
+}
@@ -0,0 +1,404 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2013 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#if !defined(__COGL_H_INSIDE__) && !defined(COGL_COMPILATION)
+#error "Only <cogl/cogl.h> can be included directly."
+#endif
+
+#ifndef __COGL_DRAW_LIST_H__
+#define __COGL_DRAW_LIST_H__
+
+#include <cogl/cogl-types.h>
+#include <cogl/cogl-context.h>
+#include <cogl/cogl-framebuffer.h>
+#include <cogl/cogl-pipeline.h>
+#include <cogl/cogl-primitive.h>
+
+COGL_BEGIN_DECLS
+
+/**
+ * SECTION:cogl-draw-list
+ * @short_description: Functions for recording a sequence of drawing
+ *   commands that can be replayed many times
+ *
+ * A #CoglDrawList records a sequence of drawing commands, along with
+ * the transformations and clip rectangles that apply to them, so
+ * that the same scene can be drawn again without having to issue
+ * each command again.
+ *
+ * Consecutive rectangles that are drawn with the same pipeline are
+ * transformed when they are recorded and are uploaded to a single
+ * vertex buffer the first time the list is replayed. Replaying a list
+ * then only costs a draw call for each of these batches instead of
+ * the work needed to log, transform and upload every rectangle.
+ *
+ * The list doesn't have a framebuffer of its own. When it is replayed
+ * with cogl_draw_list_replay() the recorded transformations are
+ * applied on top of the current model-view matrix of the framebuffer
+ * so the same list can be drawn in different places.
+ *
+ * The list takes a reference on the pipelines and primitives that
+ * are recorded rather than copying them so later changes to state
+ * such as the color or blending of a pipeline will be seen when the
+ * list is replayed. However the number of layers of a batched
+ * rectangle and its texture coordinates, which are converted using
+ * the textures of the layers, are fixed when the rectangle is
+ * recorded. If the layers or their textures are changed afterwards
+ * then the list should be cleared and recorded again.
+ */
+
+/**
+ * CoglDrawList:
+ *
+ * An opaque object representing a recorded sequence of drawing
+ * commands.
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+typedef struct _CoglDrawList CoglDrawList;
+
+/**
+ * cogl_draw_list_new:
+ * @context: A #CoglContext
+ *
+ * Creates a new empty draw list. The current transformation of the
+ * list starts as the identity matrix.
+ *
+ * Return value: A newly allocated #CoglDrawList
+ * Since: 2.0
+ * Stability: Unstable
+ */
+CoglDrawList *
+cogl_draw_list_new (CoglContext *context);
+
+/**
+ * cogl_is_draw_list:
+ * @object: A #CoglObject
+ *
+ * Gets whether the given object references a #CoglDrawList.
+ *
+ * Return value: %TRUE if the @object references a #CoglDrawList,
+ *   %FALSE otherwise
+ * Since: 2.0
+ * Stability: Unstable
+ */
+CoglBool
+cogl_is_draw_list (void *object);
+
+/**
+ * cogl_draw_list_clear:
+ * @list: A #CoglDrawList
+ *
+ * Removes all of the recorded commands from @list and resets its
+ * current transformation back to the identity matrix.
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+void
+cogl_draw_list_clear (CoglDrawList *list);
+
+/**
+ * cogl_draw_list_push_matrix:
+ * @list: A #CoglDrawList
+ *
+ * Saves a copy of the current transformation of @list so that it can
+ * be restored with cogl_draw_list_pop_matrix().
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+void
+cogl_draw_list_push_matrix (CoglDrawList *list);
+
+/**
+ * cogl_draw_list_pop_matrix:
+ * @list: A #CoglDrawList
+ *
+ * Restores the transformation of @list that was saved with the
+ * last call to cogl_draw_list_push_matrix().
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+void
+cogl_draw_list_pop_matrix (CoglDrawList *list);
+
+/**
+ * cogl_draw_list_identity_matrix:
+ * @list: A #CoglDrawList
+ *
+ * Resets the current transformation of @list to the identity matrix.
+ * Commands recorded after this will only be transformed by the
+ * model-view matrix of the framebuffer that the list is replayed to.
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+void
+cogl_draw_list_identity_matrix (CoglDrawList *list);
+
+/**
+ * cogl_draw_list_translate:
+ * @list: A #CoglDrawList
+ * @x: Distance to translate along the x-axis
+ * @y: Distance to translate along the y-axis
+ * @z: Distance to translate along the z-axis
+ *
+ * Multiplies the current transformation of @list by one that
+ * translates along all three axes.
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+void
+cogl_draw_list_translate (CoglDrawList *list,
+                          float x,
+                          float y,
+                          float z);
+
+/**
+ * cogl_draw_list_scale:
+ * @list: A #CoglDrawList
+ * @x: Amount to scale along the x-axis
+ * @y: Amount to scale along the y-axis
+ * @z: Amount to scale along the z-axis
+ *
+ * Multiplies the current transformation of @list by one that scales
+ * the x, y and z axes by the given values.
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+void
+cogl_draw_list_scale (CoglDrawList *list,
+                      float x,
+                      float y,
+                      float z);
+
+/**
+ * cogl_draw_list_rotate:
+ * @list: A #CoglDrawList
+ * @angle: Angle in degrees to rotate.
+ * @x: X-component of vertex to rotate around.
+ * @y: Y-component of vertex to rotate around.
+ * @z: Z-component of vertex to rotate around.
+ *
+ * Multiplies the current transformation of @list by one that rotates
+ * around the axis-vector specified by @x, @y and @z.
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+void
+cogl_draw_list_rotate (CoglDrawList *list,
+                       float angle,
+                       float x,
+                       float y,
+                       float z);
+
+/**
+ * cogl_draw_list_transform:
+ * @list: A #CoglDrawList
+ * @matrix: the matrix to multiply with the current transformation
+ *
+ * Multiplies the current transformation of @list by the given
+ * matrix.
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+void
+cogl_draw_list_transform (CoglDrawList *list,
+                          const CoglMatrix *matrix);
+
+/**
+ * cogl_draw_list_push_rectangle_clip:
+ * @list: A #CoglDrawList
+ * @x_1: x coordinate for top left corner of the clip rectangle
+ * @y_1: y coordinate for top left corner of the clip rectangle
+ * @x_2: x coordinate for bottom right corner of the clip rectangle
+ * @y_2: y coordinate for bottom right corner of the clip rectangle
+ *
+ * Records a command to clip all of the following drawing to the
+ * given rectangle until the matching call to
+ * cogl_draw_list_pop_clip(). The rectangle is transformed by the
+ * current transformation of @list when the list is replayed, in the
+ * same way as cogl_framebuffer_push_rectangle_clip().
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+void
+cogl_draw_list_push_rectangle_clip (CoglDrawList *list,
+                                    float x_1,
+                                    float y_1,
+                                    float x_2,
+                                    float y_2);
+
+/**
+ * cogl_draw_list_pop_clip:
+ * @list: A #CoglDrawList
+ *
+ * Records a command to revert the clip that was pushed with the last
+ * call to cogl_draw_list_push_rectangle_clip().
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+void
+cogl_draw_list_pop_clip (CoglDrawList *list);
+
+/**
+ * cogl_draw_list_draw_rectangle:
+ * @list: A #CoglDrawList
+ * @pipeline: A #CoglPipeline state object
+ * @x_1: X coordinate of the top-left corner
+ * @y_1: Y coordinate of the top-left corner
+ * @x_2: X coordinate of the bottom-right corner
+ * @y_2: Y coordinate of the bottom-right corner
+ *
+ * Records a command to draw a rectangle in the same way as
+ * cogl_framebuffer_draw_rectangle().
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+void
+cogl_draw_list_draw_rectangle (CoglDrawList *list,
+                               CoglPipeline *pipeline,
+                               float x_1,
+                               float y_1,
+                               float x_2,
+                               float y_2);
+
+/**
+ * cogl_draw_list_draw_textured_rectangle:
+ * @list: A #CoglDrawList
+ * @pipeline: A #CoglPipeline state object
+ * @x_1: x coordinate upper left on screen.
+ * @y_1: y coordinate upper left on screen.
+ * @x_2: x coordinate lower right on screen.
+ * @y_2: y coordinate lower right on screen.
+ * @s_1: S texture coordinate of the top-left coorner
+ * @t_1: T texture coordinate of the top-left coorner
+ * @s_2: S texture coordinate of the bottom-right coorner
+ * @t_2: T texture coordinate of the bottom-right coorner
+ *
+ * Records a command to draw a textured rectangle in the same way as
+ * cogl_framebuffer_draw_textured_rectangle().
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+void
+cogl_draw_list_draw_textured_rectangle (CoglDrawList *list,
+                                        CoglPipeline *pipeline,
+                                        float x_1,
+                                        float y_1,
+                                        float x_2,
+                                        float y_2,
+                                        float s_1,
+                                        float t_1,
+                                        float s_2,
+                                        float t_2);
+
+/**
+ * cogl_draw_list_draw_multitextured_rectangle:
+ * @list: A #CoglDrawList
+ * @pipeline: A #CoglPipeline state object
+ * @x_1: x coordinate upper left on screen.
+ * @y_1: y coordinate upper left on screen.
+ * @x_2: x coordinate lower right on screen.
+ * @y_2: y coordinate lower right on screen.
+ * @tex_coords: (in) (array) (transfer none): An array containing groups of
+ *   4 float values: [s_1, t_1, s_2, t_2] that are interpreted as two texture
+ *   coordinates; one for the top left texel, and one for the bottom right
+ *   texel. Each value should be between 0.0 and 1.0, where the coordinate
+ *   (0.0, 0.0) represents the top left of the texture, and (1.0, 1.0) the
+ *   bottom right.
+ * @tex_coords_len: The length of the @tex_coords array. (For one layer
+ *   and one group of texture coordinates, this would be 4)
+ *
+ * Records a command to draw a rectangle with a set of texture
+ * coordinates for each layer in the same way as
+ * cogl_framebuffer_draw_multitextured_rectangle().
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+void
+cogl_draw_list_draw_multitextured_rectangle (CoglDrawList *list,
+                                             CoglPipeline *pipeline,
+                                             float x_1,
+                                             float y_1,
+                                             float x_2,
+                                             float y_2,
+                                             const float *tex_coords,
+                                             int tex_coords_len);
+
+/**
+ * cogl_draw_list_draw_primitive:
+ * @list: A #CoglDrawList
+ * @pipeline: A #CoglPipeline state object
+ * @primitive: A #CoglPrimitive geometry object
+ *
+ * Records a command to draw the given @primitive in the same way as
+ * cogl_primitive_draw(). The primitive is drawn with the
+ * transformation that is current when this is called.
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+void
+cogl_draw_list_draw_primitive (CoglDrawList *list,
+                               CoglPipeline *pipeline,
+                               CoglPrimitive *primitive);
+
+/**
+ * cogl_draw_list_replay:
+ * @list: A #CoglDrawList
+ * @framebuffer: A destination #CoglFramebuffer
+ *
+ * Draws all of the commands recorded in @list to @framebuffer. The
+ * recorded transformations are applied on top of the current
+ * model-view matrix of @framebuffer and the recorded clip rectangles
+ * are intersected with its current clip stack. The model-view matrix
+ * and clip stack of @framebuffer are left as they were before this
+ * was called, even if the list has more clip pushes than pops.
+ *
+ * The first time a list is replayed after recording more rectangles
+ * the vertices for them will be uploaded to the GPU. After that
+ * replaying only costs a draw call for each batch of rectangles.
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+void
+cogl_draw_list_replay (CoglDrawList *list,
+                       CoglFramebuffer *framebuffer);
+
+COGL_END_DECLS
+
+#endif /* __COGL_DRAW_LIST_H__ */
@@ -105,6 +105,21 @@ struct _CoglDriverVtable
                                            int n_attributes,
                                            CoglDrawFlags flags);
 
+  /* Draws n_instances copies of the given vertices. Attributes with
+   * an instance divisor advance per instance rather than per
+   * vertex. This is only called when instanced arrays are
+   * available */
+  void
+  (* framebuffer_draw_instanced_attributes) (CoglFramebuffer *framebuffer,
+                                             CoglPipeline *pipeline,
+                                             CoglVerticesMode mode,
+                                             int first_vertex,
+                                             int n_vertices,
+                                             int n_instances,
+                                             CoglAttribute **attributes,
+                                             int n_attributes,
+                                             CoglDrawFlags flags);
+
   CoglBool
   (* framebuffer_read_pixels_into_bitmap) (CoglFramebuffer *framebuffer,
                                            int x,
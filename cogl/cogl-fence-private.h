@@ -25,6 +25,7 @@
 #define __COGL_FENCE_PRIVATE_H__
 
 #include "cogl-fence.h"
+#include "cogl-bitmap.h"
 #include "cogl-list.h"
 #include "cogl-winsys-private.h"
 
@@ -48,8 +49,36 @@ struct _CoglFenceClosure
 
   CoglFenceCallback callback;
   void *user_data;
+
+  /* The target of an asynchronous read that completes when this
+   * fence is reached. The bitmap is kept alive until then and if
+   * flip_bitmap is set its rows are reversed before read_callback is
+   * invoked instead of callback */
+  CoglBitmap *bitmap;
+  CoglBool flip_bitmap;
+  CoglReadPixelsCallback read_callback;
 };
 
+/* Inserts a fence into the GPU command stream using the best
+ * mechanism available and returns its type. The fence can be polled
+ * with _cogl_fence_is_complete() and must be freed with
+ * _cogl_fence_destroy(). If no fence could be created then
+ * FENCE_TYPE_ERROR is returned and the fence is always considered
+ * complete */
+CoglFenceType
+_cogl_fence_insert (CoglContext *context,
+                    void **fence_obj);
+
+CoglBool
+_cogl_fence_is_complete (CoglContext *context,
+                         CoglFenceType type,
+                         void *fence_obj);
+
+void
+_cogl_fence_destroy (CoglContext *context,
+                     CoglFenceType type,
+                     void *fence_obj);
+
 void
 _cogl_fence_submit (CoglFenceClosure *fence);
 
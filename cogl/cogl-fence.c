@@ -28,6 +28,10 @@
 #include "cogl-fence-private.h"
 #include "cogl-context-private.h"
 #include "cogl-winsys-private.h"
+#include "cogl-bitmap-private.h"
+#include "cogl-pixel-buffer.h"
+#include "cogl-framebuffer-private.h"
+#include "cogl-error-private.h"
 
 #define FENCE_CHECK_TIMEOUT 5000 /* microseconds */
 
@@ -37,35 +41,108 @@ cogl_fence_closure_get_user_data (CoglFenceClosure *closure)
   return closure->user_data;
 }
 
-static void
-_cogl_fence_check (CoglFenceClosure *fence)
+CoglFenceType
+_cogl_fence_insert (CoglContext *context,
+                    void **fence_obj)
 {
-  CoglContext *context = fence->framebuffer->context;
+  const CoglWinsysVtable *winsys = _cogl_context_get_winsys (context);
+
+  if (winsys->fence_add)
+    {
+      *fence_obj = winsys->fence_add (context);
+      if (*fence_obj)
+        return FENCE_TYPE_WINSYS;
+    }
+
+#ifdef GL_ARB_sync
+  if (context->glFenceSync)
+    {
+      *fence_obj = context->glFenceSync (GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      if (*fence_obj)
+        return FENCE_TYPE_GL_ARB;
+    }
+#endif
+
+  *fence_obj = NULL;
 
-  if (fence->type == FENCE_TYPE_WINSYS)
+  return FENCE_TYPE_ERROR;
+}
+
+CoglBool
+_cogl_fence_is_complete (CoglContext *context,
+                         CoglFenceType type,
+                         void *fence_obj)
+{
+  if (type == FENCE_TYPE_WINSYS)
     {
       const CoglWinsysVtable *winsys = _cogl_context_get_winsys (context);
-      CoglBool ret;
 
-      ret = winsys->fence_is_complete (context, fence->fence_obj);
-      if (!ret)
-        return;
+      return winsys->fence_is_complete (context, fence_obj);
     }
 #ifdef GL_ARB_sync
-  else if (fence->type == FENCE_TYPE_GL_ARB)
+  else if (type == FENCE_TYPE_GL_ARB)
     {
       GLenum arb;
 
-      arb = context->glClientWaitSync (fence->fence_obj,
+      arb = context->glClientWaitSync (fence_obj,
                                        GL_SYNC_FLUSH_COMMANDS_BIT,
                                        0);
-      if (arb != GL_ALREADY_SIGNALED && arb != GL_CONDITION_SATISFIED)
-        return;
+      return arb == GL_ALREADY_SIGNALED || arb == GL_CONDITION_SATISFIED;
+    }
+#endif
+
+  return TRUE;
+}
+
+void
+_cogl_fence_destroy (CoglContext *context,
+                     CoglFenceType type,
+                     void *fence_obj)
+{
+  if (type == FENCE_TYPE_WINSYS)
+    {
+      const CoglWinsysVtable *winsys = _cogl_context_get_winsys (context);
+
+      winsys->fence_destroy (context, fence_obj);
+    }
+#ifdef GL_ARB_sync
+  else if (type == FENCE_TYPE_GL_ARB)
+    {
+      context->glDeleteSync (fence_obj);
     }
 #endif
+}
+
+static void
+_cogl_fence_check (CoglFenceClosure *fence)
+{
+  CoglContext *context = fence->framebuffer->context;
+
+  if (!_cogl_fence_is_complete (context, fence->type, fence->fence_obj))
+    return;
+
+  if (fence->bitmap)
+    {
+      CoglError *error = NULL;
+
+      /* The read has completed so mapping the buffer won't stall. If
+       * it can't be flipped then the application needs to know that
+       * the pixels are upside down */
+      if (fence->flip_bitmap)
+        _cogl_bitmap_flip_vertically (fence->bitmap, &error);
+
+      fence->read_callback (fence->framebuffer,
+                            fence->bitmap,
+                            error,
+                            fence->user_data);
+
+      if (error)
+        cogl_error_free (error);
+    }
+  else
+    fence->callback (NULL, /* dummy CoglFence object */
+                     fence->user_data);
 
-  fence->callback (NULL, /* dummy CoglFence object */
-                   fence->user_data);
   cogl_framebuffer_cancel_fence_callback (fence->framebuffer, fence);
 }
 
@@ -106,34 +183,9 @@ void
 _cogl_fence_submit (CoglFenceClosure *fence)
 {
   CoglContext *context = fence->framebuffer->context;
-  const CoglWinsysVtable *winsys = _cogl_context_get_winsys (context);
-
-  fence->type = FENCE_TYPE_ERROR;
-
-  if (winsys->fence_add)
-    {
-      fence->fence_obj = winsys->fence_add (context);
-      if (fence->fence_obj)
-        {
-          fence->type = FENCE_TYPE_WINSYS;
-          goto done;
-        }
-    }
 
-#ifdef GL_ARB_sync
-  if (context->glFenceSync)
-    {
-      fence->fence_obj = context->glFenceSync (GL_SYNC_GPU_COMMANDS_COMPLETE,
-                                               0);
-      if (fence->fence_obj)
-        {
-          fence->type = FENCE_TYPE_GL_ARB;
-          goto done;
-        }
-    }
-#endif
+  fence->type = _cogl_fence_insert (context, &fence->fence_obj);
 
- done:
   _cogl_list_insert (context->fences.prev, &fence->link);
 
   if (!context->fences_poll_source)
@@ -163,6 +215,9 @@ cogl_framebuffer_add_fence_callback (CoglFramebuffer *framebuffer,
   fence->callback = callback;
   fence->user_data = user_data;
   fence->fence_obj = NULL;
+  fence->bitmap = NULL;
+  fence->flip_bitmap = FALSE;
+  fence->read_callback = NULL;
 
   if (journal->entries->len)
     {
@@ -181,29 +236,79 @@ cogl_framebuffer_cancel_fence_callback (CoglFramebuffer *framebuffer,
 {
   CoglContext *context = framebuffer->context;
 
-  if (fence->type == FENCE_TYPE_PENDING)
+  _cogl_list_remove (&fence->link);
+
+  if (fence->type != FENCE_TYPE_PENDING)
+    _cogl_fence_destroy (context, fence->type, fence->fence_obj);
+
+  if (fence->bitmap)
+    cogl_object_unref (fence->bitmap);
+
+  g_slice_free (CoglFenceClosure, fence);
+}
+
+CoglFenceClosure *
+cogl_framebuffer_read_pixels_async (CoglFramebuffer *framebuffer,
+                                    int x,
+                                    int y,
+                                    CoglReadPixelsFlags source,
+                                    CoglBitmap *bitmap,
+                                    CoglReadPixelsCallback callback,
+                                    void *user_data,
+                                    CoglError **error)
+{
+  CoglContext *context;
+  CoglFenceClosure *fence;
+  CoglBool flip_bitmap = FALSE;
+
+  _COGL_RETURN_VAL_IF_FAIL (cogl_is_framebuffer (framebuffer), NULL);
+  _COGL_RETURN_VAL_IF_FAIL (cogl_is_bitmap (bitmap), NULL);
+  _COGL_RETURN_VAL_IF_FAIL (cogl_is_pixel_buffer (cogl_bitmap_get_buffer
+                                                  (bitmap)),
+                            NULL);
+
+  context = framebuffer->context;
+
+  if (!COGL_FLAGS_GET (context->features, COGL_FEATURE_ID_FENCE))
     {
-      _cogl_list_remove (&fence->link);
+      _cogl_set_error (error,
+                       COGL_SYSTEM_ERROR,
+                       COGL_SYSTEM_ERROR_UNSUPPORTED,
+                       "Fences are not supported so pixels can't be "
+                       "read asynchronously");
+      return NULL;
     }
-  else
+
+  /* If the driver can't flip the image while reading it then the
+   * flip would have to map the buffer straight away and wait for the
+   * read to finish. Instead we ask for the image upside down and
+   * flip it in place once the fence has been reached */
+  if (!cogl_is_offscreen (framebuffer) &&
+      !(context->private_feature_flags &
+        COGL_PRIVATE_FEATURE_MESA_PACK_INVERT))
     {
-      _cogl_list_remove (&fence->link);
+      source |= COGL_READ_PIXELS_NO_FLIP;
+      flip_bitmap = TRUE;
+    }
 
-      if (fence->type == FENCE_TYPE_WINSYS)
-        {
-          const CoglWinsysVtable *winsys = _cogl_context_get_winsys (context);
+  if (!_cogl_framebuffer_read_pixels_into_bitmap (framebuffer,
+                                                  x, y,
+                                                  source,
+                                                  bitmap,
+                                                  error))
+    return NULL;
 
-          winsys->fence_destroy (context, fence->fence_obj);
-        }
-#ifdef GL_ARB_sync
-      else if (fence->type == FENCE_TYPE_GL_ARB)
-        {
-          context->glDeleteSync (fence->fence_obj);
-        }
-#endif
-    }
+  fence = cogl_framebuffer_add_fence_callback (framebuffer,
+                                               NULL, /* callback */
+                                               user_data);
+  /* We've already checked that fences are supported */
+  _COGL_RETURN_VAL_IF_FAIL (fence != NULL, NULL);
 
-  g_slice_free (CoglFenceClosure, fence);
+  fence->bitmap = cogl_object_ref (bitmap);
+  fence->flip_bitmap = flip_bitmap;
+  fence->read_callback = callback;
+
+  return fence;
 }
 
 void
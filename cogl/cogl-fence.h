@@ -69,17 +69,6 @@ typedef struct _CoglFence CoglFence;
 typedef void (* CoglFenceCallback) (CoglFence *fence,
                                     void *user_data);
 
-/**
- * CoglFenceClosure:
- *
- * An opaque type representing one future callback to be made when the
- * GPU command stream has passed a certain point.
- *
- * Since: 2.0
- * Stability: Unstable
- */
-typedef struct _CoglFenceClosure CoglFenceClosure;
-
 /**
  * cogl_frame_closure_get_user_data:
  * @closure: A #CoglFenceClosure returned from cogl_framebuffer_add_fence()
@@ -430,6 +430,20 @@ _cogl_framebuffer_draw_indexed_attributes (CoglFramebuffer *framebuffer,
                                            int n_attributes,
                                            CoglDrawFlags flags);
 
+/* This is used by the CoglJournal to draw multiple instances of a
+ * quad. It must only be used when the context has instanced arrays
+ * and it isn't affected by the wireframe debug option. */
+void
+_cogl_framebuffer_draw_instanced_attributes (CoglFramebuffer *framebuffer,
+                                             CoglPipeline *pipeline,
+                                             CoglVerticesMode mode,
+                                             int first_vertex,
+                                             int n_vertices,
+                                             int n_instances,
+                                             CoglAttribute **attributes,
+                                             int n_attributes,
+                                             CoglDrawFlags flags);
+
 gboolean
 _cogl_framebuffer_try_creating_gl_fbo (CoglContext *ctx,
                                        CoglTexture *texture,
@@ -2383,6 +2383,19 @@ _cogl_framebuffer_draw_attributes (CoglFramebuffer *framebuffer,
     {
       CoglContext *ctx = framebuffer->context;
 
+      /* Small primitives are logged to the journal so that they can
+       * be batched with the surrounding rectangles */
+      if (_cogl_journal_log_primitive (framebuffer->journal,
+                                       pipeline,
+                                       mode,
+                                       first_vertex,
+                                       n_vertices,
+                                       NULL, /* indices */
+                                       attributes,
+                                       n_attributes,
+                                       flags))
+        return;
+
       ctx->driver_vtable->framebuffer_draw_attributes (framebuffer,
                                                        pipeline,
                                                        mode,
@@ -2474,6 +2487,17 @@ _cogl_framebuffer_draw_indexed_attributes (CoglFramebuffer *framebuffer,
     {
       CoglContext *ctx = framebuffer->context;
 
+      if (_cogl_journal_log_primitive (framebuffer->journal,
+                                       pipeline,
+                                       mode,
+                                       first_vertex,
+                                       n_vertices,
+                                       indices,
+                                       attributes,
+                                       n_attributes,
+                                       flags))
+        return;
+
       ctx->driver_vtable->framebuffer_draw_indexed_attributes (framebuffer,
                                                                pipeline,
                                                                mode,
@@ -2486,6 +2510,30 @@ _cogl_framebuffer_draw_indexed_attributes (CoglFramebuffer *framebuffer,
     }
 }
 
+void
+_cogl_framebuffer_draw_instanced_attributes (CoglFramebuffer *framebuffer,
+                                             CoglPipeline *pipeline,
+                                             CoglVerticesMode mode,
+                                             int first_vertex,
+                                             int n_vertices,
+                                             int n_instances,
+                                             CoglAttribute **attributes,
+                                             int n_attributes,
+                                             CoglDrawFlags flags)
+{
+  CoglContext *ctx = framebuffer->context;
+
+  ctx->driver_vtable->framebuffer_draw_instanced_attributes (framebuffer,
+                                                             pipeline,
+                                                             mode,
+                                                             first_vertex,
+                                                             n_vertices,
+                                                             n_instances,
+                                                             attributes,
+                                                             n_attributes,
+                                                             flags);
+}
+
 /* XXX: deprecated */
 void
 cogl_framebuffer_draw_indexed_attributes (CoglFramebuffer *framebuffer,
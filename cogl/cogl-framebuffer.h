@@ -37,6 +37,21 @@
  */
 typedef struct _CoglFramebuffer CoglFramebuffer;
 
+/* The fence closure is also forward declared here because it is
+ * returned by cogl_framebuffer_read_pixels_async() and cogl-fence.h
+ * depends on this header */
+
+/**
+ * CoglFenceClosure:
+ *
+ * An opaque type representing one future callback to be made when the
+ * GPU command stream has passed a certain point.
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+typedef struct _CoglFenceClosure CoglFenceClosure;
+
 #include <cogl/cogl-pipeline.h>
 #include <cogl/cogl-indices.h>
 #include <cogl/cogl-bitmap.h>
@@ -1725,6 +1740,83 @@ cogl_framebuffer_read_pixels (CoglFramebuffer *framebuffer,
                               CoglPixelFormat format,
                               uint8_t *pixels);
 
+/**
+ * CoglReadPixelsCallback:
+ * @framebuffer: The #CoglFramebuffer that the pixels were read from
+ * @bitmap: The #CoglBitmap that was passed to
+ *   cogl_framebuffer_read_pixels_async()
+ * @error: %NULL if the pixels are ready or a #CoglError describing
+ *   why they couldn't be read. The error is owned by Cogl and is
+ *   freed once the callback returns.
+ * @user_data: The private data passed to
+ *   cogl_framebuffer_read_pixels_async()
+ *
+ * The callback prototype used with
+ * cogl_framebuffer_read_pixels_async() for notification that the
+ * pixels have been read.
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+typedef void (* CoglReadPixelsCallback) (CoglFramebuffer *framebuffer,
+                                         CoglBitmap *bitmap,
+                                         const CoglError *error,
+                                         void *user_data);
+
+/**
+ * cogl_framebuffer_read_pixels_async:
+ * @framebuffer: A #CoglFramebuffer
+ * @x: The x position to read from
+ * @y: The y position to read from
+ * @source: Identifies which auxillary buffer you want to read
+ *          (only COGL_READ_PIXELS_COLOR_BUFFER supported currently)
+ * @bitmap: A #CoglBitmap created with cogl_bitmap_new_from_buffer()
+ *          using a #CoglPixelBuffer to receive the pixels
+ * @callback: A #CoglReadPixelsCallback to be called when the pixels
+ *            are ready
+ * @user_data: Private data that will be passed to the callback
+ * @error: A #CoglError for exceptions
+ *
+ * This is an asynchronous version of
+ * cogl_framebuffer_read_pixels_into_bitmap(). The read is queued on
+ * the GPU so that the pixels are written directly into the pixel
+ * buffer backing @bitmap without waiting for rendering to complete.
+ * @callback is invoked once the data is available, after which the
+ * buffer can be mapped with cogl_buffer_map() to access the pixels
+ * without any further copies.
+ *
+ * If the driver can't flip the image while reading it then Cogl
+ * flips it in place before invoking @callback. If that fails then
+ * the error is passed to the callback and the contents of the buffer
+ * are undefined.
+ *
+ * The callback is dispatched through the same mechanism as
+ * cogl_framebuffer_add_fence_callback() so the application must
+ * integrate Cogl with its main loop using cogl_poll_renderer_get_info()
+ * and cogl_poll_renderer_dispatch(). The contents of the buffer are
+ * undefined until the callback is invoked.
+ *
+ * The read is only fully asynchronous if the format of @bitmap
+ * matches a format that the GPU can write directly. Otherwise Cogl
+ * has to convert the pixels on the CPU before this function returns.
+ *
+ * Return value: A #CoglFenceClosure that can be passed to
+ *   cogl_framebuffer_cancel_fence_callback(), or %NULL if the read
+ *   could not be started. The closure is freed automatically when
+ *   the callback is invoked.
+ * Since: 2.0
+ * Stability: Unstable
+ */
+CoglFenceClosure *
+cogl_framebuffer_read_pixels_async (CoglFramebuffer *framebuffer,
+                                    int x,
+                                    int y,
+                                    CoglReadPixelsFlags source,
+                                    CoglBitmap *bitmap,
+                                    CoglReadPixelsCallback callback,
+                                    void *user_data,
+                                    CoglError **error);
+
 /**
  * cogl_get_draw_framebuffer:
  *
@@ -32,4 +32,21 @@ _cogl_glsl_shader_set_source_with_boilerplate (CoglContext *ctx,
                                                const char **strings_in,
                                                const GLint *lengths_in);
 
+/*
+ * Starts compiling a shader that already has its source set. The
+ * compile status isn't queried because that would make the driver
+ * finish compiling straight away instead of in the background.
+ */
+void
+_cogl_glsl_shader_compile (CoglContext *ctx,
+                           GLuint shader_gl_handle);
+
+/*
+ * Waits for a shader to finish compiling and logs a warning if
+ * compilation failed.
+ */
+CoglBool
+_cogl_glsl_shader_check_compile_status (CoglContext *ctx,
+                                        GLuint shader_gl_handle);
+
 #endif /* _COGL_GLSL_SHADER_PRIVATE_H_ */
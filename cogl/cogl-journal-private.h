@@ -28,8 +28,12 @@
 #include "cogl-object-private.h"
 #include "cogl-clip-stack.h"
 #include "cogl-fence-private.h"
+#include "cogl-attribute-private.h"
+#include "cogl-indices.h"
 
-#define COGL_JOURNAL_VBO_POOL_SIZE 8
+/* Primitives with more vertices than this are not worth transforming
+ * in software so they are drawn directly instead */
+#define COGL_JOURNAL_PRIMITIVE_MAX_VERTICES 64
 
 typedef struct _CoglJournal
 {
@@ -45,27 +49,23 @@ typedef struct _CoglJournal
 
   GArray *entries;
   GArray *vertices;
-  size_t needed_vbo_len;
-
-  /* A pool of attribute buffers is used so that we can avoid repeatedly
-     reallocating buffers. Only one of these buffers at a time will be
-     used by Cogl but we keep more than one alive anyway in case the
-     GL driver is internally using the buffer and it would have to
-     allocate a new one when we start writing to it */
-  CoglAttributeBuffer *vbo_pool[COGL_JOURNAL_VBO_POOL_SIZE];
-  /* The next vbo to use from the pool. We just cycle through them in
-     order */
-  unsigned int next_vbo_in_pool;
 
   int fast_read_pixel_count;
 
+  /* The corners of a unit quad used to expand the instance records
+     when drawing rectangles with instanced arrays. This is created
+     the first time it is needed */
+  CoglAttribute *quad_corner_attribute;
+
   CoglList pending_fences;
 
 } CoglJournal;
 
 /* To improve batching of geometry when submitting vertices to OpenGL we
  * log the texture rectangles we want to draw to a journal, so when we
- * later flush the journal we aim to batch data, and gl draw calls. */
+ * later flush the journal we aim to batch data, and gl draw calls.
+ * Small triangle primitives can also be logged so that they don't
+ * break up the batches of the surrounding rectangles. */
 typedef struct _CoglJournalEntry
 {
   CoglPipeline            *pipeline;
@@ -74,6 +74,13 @@ typedef struct _CoglJournalEntry
   /* Offset into ctx->logged_vertices */
   size_t                   array_offset;
   int                      n_layers;
+  /* The number of triangle vertices for an entry logged with
+   * _cogl_journal_log_primitive() or 0 if the entry is a rectangle */
+  int                      n_primitive_vertices;
+  /* Whether the rectangle is uploaded as a single instance record
+   * rather than four vertices. This is only decided when the journal
+   * is flushed */
+  CoglBool                 instanced;
 } CoglJournalEntry;
 
 CoglJournal *
@@ -88,6 +95,17 @@ _cogl_journal_log_quad (CoglJournal  *journal,
                         const float  *tex_coords,
                         unsigned int  tex_coords_len);
 
+CoglBool
+_cogl_journal_log_primitive (CoglJournal *journal,
+                             CoglPipeline *pipeline,
+                             CoglVerticesMode mode,
+                             int first_vertex,
+                             int n_vertices,
+                             CoglIndices *indices,
+                             CoglAttribute **attributes,
+                             int n_attributes,
+                             CoglDrawFlags flags);
+
 void
 _cogl_journal_flush (CoglJournal *journal);
 
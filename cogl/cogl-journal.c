@@ -31,10 +31,13 @@
 #include "cogl-texture-private.h"
 #include "cogl-pipeline-private.h"
 #include "cogl-pipeline-opengl-private.h"
+#include "cogl-pipeline-state-private.h"
 #include "cogl-vertex-buffer-private.h"
 #include "cogl-framebuffer-private.h"
 #include "cogl-profile.h"
 #include "cogl-attribute-private.h"
+#include "cogl-indices-private.h"
+#include "cogl-buffer-private.h"
 #include "cogl-point-in-poly-private.h"
 #include "cogl-private.h"
 #include "cogl1-context.h"
@@ -56,6 +59,25 @@
 #define GET_JOURNAL_ARRAY_STRIDE_FOR_N_LAYERS(N_LAYERS) \
   (N_LAYERS * 2 + 2)
 
+/* XXX NB:
+ * Entries logged with _cogl_journal_log_primitive() are instead
+ * stored as a list of triangle vertices:
+ *
+ * Per vertex:
+ *   3 floats for the untransformed position
+ *   4 RGBA GLubytes for the color
+ *   2 * n_layers floats for the texture coordinates
+ */
+#define GET_JOURNAL_PRIMITIVE_ARRAY_STRIDE_FOR_N_LAYERS(N_LAYERS) \
+  (N_LAYERS * 2 + 4)
+
+/* In the vertex array each primitive is padded with degenerate
+ * triangles so that it uses a multiple of this number of vertices.
+ * That keeps the vertices of any following quads aligned for the
+ * rectangle indices and it means a run of primitives can be drawn
+ * as a single list of triangles */
+#define PRIMITIVE_VERTEX_ALIGNMENT 12
+
 /* XXX NB:
  * Once in the vertex array, the journal's vertex data is arranged as follows:
  * 4 vertices per quad:
@@ -86,6 +108,49 @@
   (POS_STRIDE + COLOR_STRIDE + \
    TEX_STRIDE * (N_LAYERS < MIN_LAYER_PADING ? MIN_LAYER_PADING : N_LAYERS))
 
+/* XXX NB:
+ * When every position in a flush is transformed to an integer that
+ * fits in a short and every texture coordinate is between 0 and 1,
+ * the vertices are instead uploaded in a compact form:
+ *    3 GLshorts per position plus a GLshort of padding
+ *    4 RGBA GLubytes,
+ *    2 normalized GLushorts per tex coord * n_layers
+ *
+ * This roughly halves the size of the vertex data for pixel aligned
+ * 2D scenes.
+ */
+#define COMPACT_POS_STRIDE 2 /* number of 32bit words */
+#define COMPACT_TEX_STRIDE 1 /* number of 32bit words */
+#define GET_JOURNAL_COMPACT_VB_STRIDE_FOR_N_LAYERS(N_LAYERS) \
+  (COMPACT_POS_STRIDE + COLOR_STRIDE + \
+   COMPACT_TEX_STRIDE * \
+   (N_LAYERS < MIN_LAYER_PADING ? MIN_LAYER_PADING : N_LAYERS))
+
+/* XXX NB:
+ * When instanced arrays are available, rectangles are instead
+ * uploaded as a single instance record which is expanded to four
+ * vertices by the vertex shader:
+ *    3 GLfloats for the transformed top left corner
+ *    3 GLfloats for the edge to the transformed top right corner
+ *    3 GLfloats for the edge to the transformed bottom left corner
+ *    4 RGBA GLubytes,
+ *    4 GLfloats per layer for the texture rectangle (s1, t1, s2, t2)
+ *
+ * The layers are padded in the same way as for the vertices so that
+ * the stride only changes when the vertex stride would.
+ */
+#define INSTANCE_POS_STRIDE 9 /* number of 32bit words */
+#define INSTANCE_TEX_STRIDE 4 /* number of 32bit words */
+#define GET_JOURNAL_INSTANCE_STRIDE_FOR_N_LAYERS(N_LAYERS) \
+  (INSTANCE_POS_STRIDE + COLOR_STRIDE + \
+   INSTANCE_TEX_STRIDE * \
+   (N_LAYERS < MIN_LAYER_PADING ? MIN_LAYER_PADING : N_LAYERS))
+
+/* Instanced quads are drawn with five attributes plus one per layer.
+ * This keeps the total within the minimum of 8 vertex attributes that
+ * GLES 2 guarantees */
+#define COGL_JOURNAL_INSTANCED_MAX_LAYERS 3
+
 /* If a batch is longer than this threshold then we'll assume it's not
    worth doing software clipping and it's cheaper to program the GPU
    to do the clip */
@@ -105,6 +170,9 @@ typedef struct _CoglJournalFlushState
   size_t array_offset;
   GLuint current_vertex;
 
+  /* Whether the vertices were uploaded in the compact format */
+  CoglBool compact_vertices;
+
   CoglIndices *indices;
   size_t indices_type_size;
 
@@ -121,19 +189,28 @@ static void _cogl_journal_free (CoglJournal *journal);
 
 COGL_OBJECT_INTERNAL_DEFINE (Journal, journal);
 
+/* Gets the number of vertices that the entry uses in the vertex
+ * array */
+static int
+get_entry_n_vertices (const CoglJournalEntry *entry)
+{
+  if (entry->n_primitive_vertices)
+    return ((entry->n_primitive_vertices + PRIMITIVE_VERTEX_ALIGNMENT - 1) /
+            PRIMITIVE_VERTEX_ALIGNMENT * PRIMITIVE_VERTEX_ALIGNMENT);
+  else
+    return 4;
+}
+
 static void
 _cogl_journal_free (CoglJournal *journal)
 {
-  int i;
-
   if (journal->entries)
     g_array_free (journal->entries, TRUE);
   if (journal->vertices)
     g_array_free (journal->vertices, TRUE);
 
-  for (i = 0; i < COGL_JOURNAL_VBO_POOL_SIZE; i++)
-    if (journal->vbo_pool[i])
-      cogl_object_unref (journal->vbo_pool[i]);
+  if (journal->quad_corner_attribute)
+    cogl_object_unref (journal->quad_corner_attribute);
 
   g_slice_free (CoglJournal, journal);
 }
@@ -266,6 +343,251 @@ batch_and_call (CoglJournalEntry *entries,
   batch_callback (batch_start, batch_len, data);
 }
 
+static CoglUserDataKey instanced_pipeline_key;
+
+static void
+instanced_pipeline_destroyed_cb (CoglPipeline *weak_pipeline,
+                                 void *user_data)
+{
+  CoglPipeline *original_pipeline = user_data;
+
+  /* XXX: This has the same problem as the wireframe pipeline in
+   * cogl-framebuffer.c if the original pipeline is being freed */
+  cogl_object_set_user_data (COGL_OBJECT (original_pipeline),
+                             &instanced_pipeline_key, NULL, NULL);
+
+  cogl_object_unref (weak_pipeline);
+}
+
+static CoglBool
+add_instanced_layer_snippet_cb (CoglPipeline *pipeline,
+                                int layer_index,
+                                void *user_data)
+{
+  CoglSnippet *snippet = user_data;
+
+  cogl_pipeline_add_layer_snippet (pipeline, layer_index, snippet);
+
+  return TRUE;
+}
+
+/* Gets a pipeline that draws the same as the given pipeline but
+ * which expands the journal's instance records into quads in the
+ * vertex shader. The pipeline is cached as a weak copy so that it
+ * will be thrown away if the original pipeline is modified */
+static CoglPipeline *
+get_instanced_pipeline (CoglPipeline *pipeline)
+{
+  static CoglSnippet *globals_snippet = NULL;
+  static CoglSnippet *transform_snippet = NULL;
+  static CoglSnippet *layer_snippet = NULL;
+  CoglPipeline *instanced_pipeline;
+
+  instanced_pipeline = cogl_object_get_user_data (COGL_OBJECT (pipeline),
+                                                  &instanced_pipeline_key);
+  if (instanced_pipeline)
+    return instanced_pipeline;
+
+  /* The snippets are cached so that the programs can be shared
+   * between all of the instanced pipelines via the pipeline cache */
+  if (globals_snippet == NULL)
+    {
+      globals_snippet =
+        cogl_snippet_new (COGL_SNIPPET_HOOK_VERTEX_GLOBALS,
+                          "attribute vec2 _cogl_quad_corner_in;\n"
+                          "attribute vec3 _cogl_quad_x_edge_in;\n"
+                          "attribute vec3 _cogl_quad_y_edge_in;\n",
+                          NULL);
+
+      /* cogl_position_in contains the top left corner of the quad */
+      transform_snippet =
+        cogl_snippet_new (COGL_SNIPPET_HOOK_VERTEX_TRANSFORM, NULL, NULL);
+      cogl_snippet_set_replace (transform_snippet,
+                                "  cogl_position_out =\n"
+                                "    cogl_modelview_projection_matrix *\n"
+                                "    vec4 (cogl_position_in.xyz +\n"
+                                "          _cogl_quad_x_edge_in *\n"
+                                "          _cogl_quad_corner_in.x +\n"
+                                "          _cogl_quad_y_edge_in *\n"
+                                "          _cogl_quad_corner_in.y,\n"
+                                "          1.0);\n");
+
+      /* The texture coordinate attribute contains the texture
+       * rectangle of the layer */
+      layer_snippet =
+        cogl_snippet_new (COGL_SNIPPET_HOOK_TEXTURE_COORD_TRANSFORM,
+                          NULL, NULL);
+      cogl_snippet_set_replace (layer_snippet,
+                                "  cogl_tex_coord =\n"
+                                "    cogl_matrix *\n"
+                                "    vec4 (mix (cogl_tex_coord.xy,\n"
+                                "               cogl_tex_coord.zw,\n"
+                                "               _cogl_quad_corner_in),\n"
+                                "          0.0, 1.0);\n");
+    }
+
+  instanced_pipeline =
+    _cogl_pipeline_weak_copy (pipeline,
+                              instanced_pipeline_destroyed_cb,
+                              pipeline);
+
+  cogl_object_set_user_data (COGL_OBJECT (pipeline),
+                             &instanced_pipeline_key,
+                             instanced_pipeline,
+                             NULL);
+
+  cogl_pipeline_add_snippet (instanced_pipeline, globals_snippet);
+  cogl_pipeline_add_snippet (instanced_pipeline, transform_snippet);
+  cogl_pipeline_foreach_layer (instanced_pipeline,
+                               add_instanced_layer_snippet_cb,
+                               layer_snippet);
+
+  return instanced_pipeline;
+}
+
+static CoglAttribute *
+get_quad_corner_attribute (CoglJournal *journal)
+{
+  if (journal->quad_corner_attribute == NULL)
+    {
+      CoglContext *ctx = journal->framebuffer->context;
+      /* The corners are in the same order as the expanded vertices
+       * so that they can be drawn as a triangle fan */
+      static const float corners[] = { 0, 0, 0, 1, 1, 1, 1, 0 };
+      CoglAttributeBuffer *buffer =
+        cogl_attribute_buffer_new (ctx, sizeof (corners), corners);
+
+      journal->quad_corner_attribute =
+        cogl_attribute_new (buffer,
+                            "_cogl_quad_corner_in",
+                            sizeof (float) * 2,
+                            0, /* offset */
+                            2, /* n_components */
+                            COGL_ATTRIBUTE_TYPE_FLOAT);
+
+      cogl_object_unref (buffer);
+    }
+
+  return journal->quad_corner_attribute;
+}
+
+typedef struct _CreateInstanceAttributeState
+{
+  CoglJournalFlushState *flush_state;
+  size_t offset;
+  CoglAttribute **attributes;
+  int n_attributes;
+} CreateInstanceAttributeState;
+
+static CoglAttribute *
+create_instance_attribute (CreateInstanceAttributeState *state,
+                           const char *name,
+                           size_t offset,
+                           int n_components,
+                           CoglAttributeType type)
+{
+  CoglJournalFlushState *flush_state = state->flush_state;
+  CoglAttribute *attribute;
+
+  attribute = cogl_attribute_new (flush_state->attribute_buffer,
+                                  name,
+                                  flush_state->stride,
+                                  state->offset + offset,
+                                  n_components,
+                                  type);
+  _cogl_attribute_set_instance_divisor (attribute, 1);
+
+  state->attributes[state->n_attributes++] = attribute;
+
+  return attribute;
+}
+
+static CoglBool
+create_instance_tex_attribute_cb (CoglPipeline *pipeline,
+                                  int layer_number,
+                                  void *user_data)
+{
+  CreateInstanceAttributeState *state = user_data;
+  int layer_num = state->n_attributes - 4;
+  char *name = g_strdup_printf ("cogl_tex_coord%d_in", layer_number);
+
+  create_instance_attribute (state,
+                             name,
+                             (INSTANCE_POS_STRIDE + COLOR_STRIDE) * 4 +
+                             INSTANCE_TEX_STRIDE * 4 * layer_num,
+                             4,
+                             COGL_ATTRIBUTE_TYPE_FLOAT);
+
+  g_free (name);
+
+  return TRUE;
+}
+
+/* Draws a run of rectangles that were uploaded as instance records
+ * with a single instanced draw of a quad */
+static void
+draw_instanced_entries (CoglJournalFlushState *state,
+                        CoglJournalEntry *batch_start,
+                        int batch_len,
+                        CoglDrawFlags draw_flags)
+{
+  CoglAttribute *attributes[5 + COGL_JOURNAL_INSTANCED_MAX_LAYERS];
+  CreateInstanceAttributeState attrib_state;
+  int i;
+
+  attrib_state.flush_state = state;
+  /* There isn't a portable way to specify the first instance so the
+   * attributes are instead created at the offset of the first
+   * record */
+  attrib_state.offset = (state->array_offset +
+                         state->current_vertex * state->stride);
+  attrib_state.attributes = attributes;
+  attrib_state.n_attributes = 0;
+
+  create_instance_attribute (&attrib_state,
+                             "cogl_position_in",
+                             0,
+                             3,
+                             COGL_ATTRIBUTE_TYPE_FLOAT);
+  create_instance_attribute (&attrib_state,
+                             "_cogl_quad_x_edge_in",
+                             3 * 4,
+                             3,
+                             COGL_ATTRIBUTE_TYPE_FLOAT);
+  create_instance_attribute (&attrib_state,
+                             "_cogl_quad_y_edge_in",
+                             6 * 4,
+                             3,
+                             COGL_ATTRIBUTE_TYPE_FLOAT);
+  create_instance_attribute (&attrib_state,
+                             "cogl_color_in",
+                             INSTANCE_POS_STRIDE * 4,
+                             4,
+                             COGL_ATTRIBUTE_TYPE_UNSIGNED_BYTE);
+
+  cogl_pipeline_foreach_layer (batch_start->pipeline,
+                               create_instance_tex_attribute_cb,
+                               &attrib_state);
+
+  attributes[attrib_state.n_attributes] =
+    get_quad_corner_attribute (state->journal);
+
+  _cogl_framebuffer_draw_instanced_attributes (state->journal->framebuffer,
+                                               state->pipeline,
+                                               COGL_VERTICES_MODE_TRIANGLE_FAN,
+                                               0, /* first_vertex */
+                                               4, /* n_vertices */
+                                               batch_len, /* n_instances */
+                                               attributes,
+                                               attrib_state.n_attributes + 1,
+                                               draw_flags);
+
+  for (i = 0; i < attrib_state.n_attributes; i++)
+    cogl_object_unref (attributes[i]);
+
+  state->current_vertex += batch_len;
+}
+
 static void
 _cogl_journal_flush_modelview_and_entries (CoglJournalEntry *batch_start,
                                            int               batch_len,
@@ -275,6 +597,8 @@ _cogl_journal_flush_modelview_and_entries (CoglJournalEntry *batch_start,
   CoglContext *ctx = state->ctx;
   CoglFramebuffer *framebuffer = state->journal->framebuffer;
   CoglAttribute **attributes;
+  GLuint first_vertex;
+  int i, run_len;
   CoglDrawFlags draw_flags = (COGL_DRAW_SKIP_JOURNAL_FLUSH |
                               COGL_DRAW_SKIP_PIPELINE_VALIDATION |
                               COGL_DRAW_SKIP_FRAMEBUFFER_FLUSH |
@@ -300,30 +624,75 @@ _cogl_journal_flush_modelview_and_entries (CoglJournalEntry *batch_start,
   if (!_cogl_pipeline_get_real_blend_enabled (state->pipeline))
     draw_flags |= COGL_DRAW_COLOR_ATTRIBUTE_IS_OPAQUE;
 
-#ifdef HAVE_COGL_GL
-  if ((ctx->private_feature_flags & COGL_PRIVATE_FEATURE_QUADS))
+  if (batch_start->instanced)
     {
-      /* XXX: it's rather evil that we sneak in the GL_QUADS enum here... */
-      _cogl_framebuffer_draw_attributes (framebuffer,
-                                         state->pipeline,
-                                         GL_QUADS,
-                                         state->current_vertex, batch_len * 4,
-                                         attributes,
-                                         state->attributes->len,
-                                         draw_flags);
+      draw_instanced_entries (state, batch_start, batch_len, draw_flags);
+      COGL_TIMER_STOP (_cogl_uprof_context, time_flush_modelview_and_entries);
+      return;
     }
-  else
-#endif /* HAVE_COGL_GL */
+
+  first_vertex = state->current_vertex;
+
+  /* Quads and primitives need different draw calls so we split the
+   * batch into runs of each type of entry. They still share the
+   * pipeline, clip and attribute state flushed for the whole batch */
+  for (i = 0; i < batch_len; i += run_len)
     {
-      if (batch_len > 1)
+      CoglJournalEntry *run_start = batch_start + i;
+      CoglBool is_primitive = run_start->n_primitive_vertices > 0;
+      int n_vertices = 0;
+
+      for (run_len = 0; i + run_len < batch_len; run_len++)
+        {
+          CoglJournalEntry *entry = run_start + run_len;
+
+          if ((entry->n_primitive_vertices > 0) != is_primitive)
+            break;
+
+          n_vertices += get_entry_n_vertices (entry);
+        }
+
+      if (is_primitive)
+        {
+          CoglJournalEntry *last_entry = run_start + run_len - 1;
+
+          /* The padding is made of degenerate triangles so it doesn't
+           * matter that we draw it, except for the padding at the end
+           * which we can trivially skip */
+          _cogl_framebuffer_draw_attributes (framebuffer,
+                                             state->pipeline,
+                                             COGL_VERTICES_MODE_TRIANGLES,
+                                             state->current_vertex,
+                                             n_vertices -
+                                             get_entry_n_vertices (last_entry) +
+                                             last_entry->n_primitive_vertices,
+                                             attributes,
+                                             state->attributes->len,
+                                             draw_flags);
+        }
+#ifdef HAVE_COGL_GL
+      else if ((ctx->private_feature_flags & COGL_PRIVATE_FEATURE_QUADS))
+        {
+          /* XXX: it's rather evil that we sneak in the GL_QUADS enum here... */
+          _cogl_framebuffer_draw_attributes (framebuffer,
+                                             state->pipeline,
+                                             GL_QUADS,
+                                             state->current_vertex,
+                                             run_len * 4,
+                                             attributes,
+                                             state->attributes->len,
+                                             draw_flags);
+        }
+#endif /* HAVE_COGL_GL */
+      else if (run_len > 1)
         {
           CoglVerticesMode mode = COGL_VERTICES_MODE_TRIANGLES;
-          int first_vertex = state->current_vertex * 6 / 4;
+          int first_index = state->current_vertex * 6 / 4;
           _cogl_framebuffer_draw_indexed_attributes (framebuffer,
                                                      state->pipeline,
                                                      mode,
-                                                     first_vertex,
-                                                     batch_len * 6,
+                                                     first_index,
+                                                     run_len * 6,
                                                      state->indices,
                                                      attributes,
                                                      state->attributes->len,
@@ -339,6 +708,8 @@ _cogl_journal_flush_modelview_and_entries (CoglJournalEntry *batch_start,
                                              state->attributes->len,
                                              draw_flags);
         }
+
+      state->current_vertex += n_vertices;
     }
 
   /* DEBUGGING CODE XXX: This path will cause all rectangles to be
@@ -351,7 +722,7 @@ _cogl_journal_flush_modelview_and_entries (CoglJournalEntry *batch_start,
     {
       static CoglPipeline *outline = NULL;
       uint8_t color_intensity;
-      int i;
+      int vertex;
       CoglAttribute *loop_attributes[1];
 
       if (outline == NULL)
@@ -375,14 +746,35 @@ _cogl_journal_flush_modelview_and_entries (CoglJournalEntry *batch_start,
                                   0xff);
 
       loop_attributes[0] = attributes[0]; /* we just want the position */
+      vertex = first_vertex;
       for (i = 0; i < batch_len; i++)
-        _cogl_framebuffer_draw_attributes (framebuffer,
-                                           outline,
-                                           COGL_VERTICES_MODE_LINE_LOOP,
-                                           4 * i + state->current_vertex, 4,
-                                           loop_attributes,
-                                           1,
-                                           draw_flags);
+        {
+          CoglJournalEntry *entry = batch_start + i;
+
+          if (entry->n_primitive_vertices)
+            {
+              int j;
+
+              for (j = 0; j < entry->n_primitive_vertices; j += 3)
+                _cogl_framebuffer_draw_attributes (framebuffer,
+                                                   outline,
+                                                   COGL_VERTICES_MODE_LINE_LOOP,
+                                                   vertex + j, 3,
+                                                   loop_attributes,
+                                                   1,
+                                                   draw_flags);
+            }
+          else
+            _cogl_framebuffer_draw_attributes (framebuffer,
+                                               outline,
+                                               COGL_VERTICES_MODE_LINE_LOOP,
+                                               vertex, 4,
+                                               loop_attributes,
+                                               1,
+                                               draw_flags);
+
+          vertex += get_entry_n_vertices (entry);
+        }
 
       /* Go to the next color */
       do
@@ -393,8 +785,6 @@ _cogl_journal_flush_modelview_and_entries (CoglJournalEntry *batch_start,
              || (ctx->journal_rectangles_color & 0x07) == 0x07);
     }
 
-  state->current_vertex += (4 * batch_len);
-
   COGL_TIMER_STOP (_cogl_uprof_context, time_flush_modelview_and_entries);
 }
 
@@ -425,7 +815,10 @@ _cogl_journal_flush_pipeline_and_entries (CoglJournalEntry *batch_start,
   if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_BATCHING)))
     g_print ("BATCHING:    pipeline batch len = %d\n", batch_len);
 
-  state->pipeline = batch_start->pipeline;
+  if (batch_start->instanced)
+    state->pipeline = get_instanced_pipeline (batch_start->pipeline);
+  else
+    state->pipeline = batch_start->pipeline;
 
   /* If we haven't transformed the quads in software then we need to also break
    * up batches according to changes in the modelview matrix... */
@@ -502,15 +895,29 @@ create_attribute_cb (CoglPipeline *pipeline,
 
   /* XXX: it may be worth having some form of static initializer for
    * attributes... */
-  *attribute_entry =
-    cogl_attribute_new (flush_state->attribute_buffer,
-                        name,
-                        flush_state->stride,
-                        flush_state->array_offset +
-                        (POS_STRIDE + COLOR_STRIDE) * 4 +
-                        TEX_STRIDE * 4 * state->current,
-                        2,
-                        COGL_ATTRIBUTE_TYPE_FLOAT);
+  if (flush_state->compact_vertices)
+    {
+      *attribute_entry =
+        cogl_attribute_new (flush_state->attribute_buffer,
+                            name,
+                            flush_state->stride,
+                            flush_state->array_offset +
+                            (COMPACT_POS_STRIDE + COLOR_STRIDE) * 4 +
+                            COMPACT_TEX_STRIDE * 4 * state->current,
+                            2,
+                            COGL_ATTRIBUTE_TYPE_UNSIGNED_SHORT);
+      cogl_attribute_set_normalized (*attribute_entry, TRUE);
+    }
+  else
+    *attribute_entry =
+      cogl_attribute_new (flush_state->attribute_buffer,
+                          name,
+                          flush_state->stride,
+                          flush_state->array_offset +
+                          (POS_STRIDE + COLOR_STRIDE) * 4 +
+                          TEX_STRIDE * 4 * state->current,
+                          2,
+                          COGL_ATTRIBUTE_TYPE_FLOAT);
 
   if (layer_number >= 8)
     g_free (name);
@@ -541,19 +948,24 @@ _cogl_journal_flush_texcoord_vbo_offsets_and_entries (
 
   COGL_TIMER_START (_cogl_uprof_context, time_flush_texcoord_pipeline_entries);
 
-  /* NB: attributes 0 and 1 are position and color */
+  /* Instance records get their attributes when they are drawn */
+  if (!batch_start->instanced)
+    {
+      /* NB: attributes 0 and 1 are position and color */
 
-  for (i = 2; i < state->attributes->len; i++)
-    cogl_object_unref (g_array_index (state->attributes, CoglAttribute *, i));
+      for (i = 2; i < state->attributes->len; i++)
+        cogl_object_unref (g_array_index (state->attributes,
+                                          CoglAttribute *, i));
 
-  g_array_set_size (state->attributes, batch_start->n_layers + 2);
+      g_array_set_size (state->attributes, batch_start->n_layers + 2);
 
-  create_attrib_state.current = 0;
-  create_attrib_state.flush_state = state;
+      create_attrib_state.current = 0;
+      create_attrib_state.flush_state = state;
 
-  cogl_pipeline_foreach_layer (batch_start->pipeline,
-                               create_attribute_cb,
-                               &create_attrib_state);
+      cogl_pipeline_foreach_layer (batch_start->pipeline,
+                                   create_attribute_cb,
+                                   &create_attrib_state);
+    }
 
   batch_and_call (batch_start,
                   batch_len,
@@ -582,6 +994,7 @@ _cogl_journal_flush_vbo_offsets_and_entries (CoglJournalEntry *batch_start,
   CoglJournalFlushState *state = data;
   CoglContext *ctx = state->journal->framebuffer->context;
   size_t stride;
+  int n_vertices;
   int i;
   CoglAttribute **attribute_entry;
   COGL_STATIC_TIMER (time_flush_vbo_texcoord_pipeline_entries,
@@ -605,61 +1018,96 @@ _cogl_journal_flush_vbo_offsets_and_entries (CoglJournalEntry *batch_start,
    *    2 GLfloats per tex coord * n_layers
    * (though n_layers may be padded; see definition of
    *  GET_JOURNAL_VB_STRIDE_FOR_N_LAYERS for details)
+   *
+   * or one instance record per quad if the batch is instanced. The
+   * positions and texture coordinates may also be stored as shorts
+   * (see GET_JOURNAL_COMPACT_VB_STRIDE_FOR_N_LAYERS)
    */
-  stride = GET_JOURNAL_VB_STRIDE_FOR_N_LAYERS (batch_start->n_layers);
+  if (batch_start->instanced)
+    stride = GET_JOURNAL_INSTANCE_STRIDE_FOR_N_LAYERS (batch_start->n_layers);
+  else if (state->compact_vertices)
+    stride =
+      GET_JOURNAL_COMPACT_VB_STRIDE_FOR_N_LAYERS (batch_start->n_layers);
+  else
+    stride = GET_JOURNAL_VB_STRIDE_FOR_N_LAYERS (batch_start->n_layers);
   stride *= sizeof (float);
   state->stride = stride;
 
   for (i = 0; i < state->attributes->len; i++)
     cogl_object_unref (g_array_index (state->attributes, CoglAttribute *, i));
 
-  g_array_set_size (state->attributes, 2);
-
-  attribute_entry = &g_array_index (state->attributes, CoglAttribute *, 0);
-  *attribute_entry = cogl_attribute_new (state->attribute_buffer,
-                                         "cogl_position_in",
-                                         stride,
-                                         state->array_offset,
-                                         N_POS_COMPONENTS,
-                                         COGL_ATTRIBUTE_TYPE_FLOAT);
-
-  attribute_entry = &g_array_index (state->attributes, CoglAttribute *, 1);
-  *attribute_entry =
-    cogl_attribute_new (state->attribute_buffer,
-                        "cogl_color_in",
-                        stride,
-                        state->array_offset + (POS_STRIDE * 4),
-                        4,
-                        COGL_ATTRIBUTE_TYPE_UNSIGNED_BYTE);
-
-  if (!(ctx->private_feature_flags & COGL_PRIVATE_FEATURE_QUADS))
-    state->indices = cogl_get_rectangle_indices (ctx, batch_len);
-
-  /* We only create new Attributes when the stride within the
-   * AttributeBuffer changes. (due to a change in the number of pipeline
-   * layers) While the stride remains constant we walk forward through
-   * the above AttributeBuffer using a vertex offset passed to
-   * cogl_draw_attributes
-   */
-  state->current_vertex = 0;
-
-  if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_JOURNAL)))
+  if (batch_start->instanced)
     {
-      uint8_t *verts;
-
-      /* Mapping a buffer for read is probably a really bad thing to
-         do but this will only happen during debugging so it probably
-         doesn't matter */
-      verts = ((uint8_t *)_cogl_buffer_map (COGL_BUFFER (state->attribute_buffer),
-                                            COGL_BUFFER_ACCESS_READ, 0,
-                                            NULL) +
-               state->array_offset);
-
-      _cogl_journal_dump_quad_batch (verts,
-                                     batch_start->n_layers,
-                                     batch_len);
-
-      cogl_buffer_unmap (COGL_BUFFER (state->attribute_buffer));
+      /* The attributes for the instance records are created when they
+       * are drawn. Each record takes the place of a vertex */
+      g_array_set_size (state->attributes, 0);
+      n_vertices = batch_len;
+      state->current_vertex = 0;
+    }
+  else
+    {
+      g_array_set_size (state->attributes, 2);
+
+      attribute_entry =
+        &g_array_index (state->attributes, CoglAttribute *, 0);
+      *attribute_entry =
+        cogl_attribute_new (state->attribute_buffer,
+                            "cogl_position_in",
+                            stride,
+                            state->array_offset,
+                            N_POS_COMPONENTS,
+                            state->compact_vertices ?
+                            COGL_ATTRIBUTE_TYPE_SHORT :
+                            COGL_ATTRIBUTE_TYPE_FLOAT);
+
+      attribute_entry =
+        &g_array_index (state->attributes, CoglAttribute *, 1);
+      *attribute_entry =
+        cogl_attribute_new (state->attribute_buffer,
+                            "cogl_color_in",
+                            stride,
+                            state->array_offset +
+                            (state->compact_vertices ?
+                             COMPACT_POS_STRIDE : POS_STRIDE) * 4,
+                            4,
+                            COGL_ATTRIBUTE_TYPE_UNSIGNED_BYTE);
+
+      n_vertices = 0;
+      for (i = 0; i < batch_len; i++)
+        n_vertices += get_entry_n_vertices (batch_start + i);
+
+      /* Primitives are padded to keep the quads aligned so we can just
+       * get enough rectangle indices to cover all of the vertices */
+      if (!(ctx->private_feature_flags & COGL_PRIVATE_FEATURE_QUADS))
+        state->indices = cogl_get_rectangle_indices (ctx, n_vertices / 4);
+
+      /* We only create new Attributes when the stride within the
+       * AttributeBuffer changes. (due to a change in the number of
+       * pipeline layers) While the stride remains constant we walk
+       * forward through the above AttributeBuffer using a vertex
+       * offset passed to cogl_draw_attributes
+       */
+      state->current_vertex = 0;
+
+      if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_JOURNAL)))
+        {
+          CoglBuffer *buffer = COGL_BUFFER (state->attribute_buffer);
+          uint8_t *verts;
+
+          /* Mapping a buffer for read is probably a really bad thing to
+             do but this will only happen during debugging so it probably
+             doesn't matter */
+          verts = ((uint8_t *)_cogl_buffer_map (buffer,
+                                                COGL_BUFFER_ACCESS_READ, 0,
+                                                NULL) +
+                   state->array_offset);
+
+          _cogl_journal_dump_quad_batch (verts,
+                                         batch_start->n_layers,
+                                         n_vertices / 4);
+
+          cogl_buffer_unmap (buffer);
+        }
     }
 
   batch_and_call (batch_start,
@@ -669,7 +1117,7 @@ _cogl_journal_flush_vbo_offsets_and_entries (CoglJournalEntry *batch_start,
                   data);
 
   /* progress forward through the VBO containing all our vertices */
-  state->array_offset += (stride * 4 * batch_len);
+  state->array_offset += (stride * n_vertices);
   if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_JOURNAL)))
     g_print ("new vbo offset = %lu\n", (unsigned long)state->array_offset);
 
@@ -680,11 +1128,15 @@ _cogl_journal_flush_vbo_offsets_and_entries (CoglJournalEntry *batch_start,
 static CoglBool
 compare_entry_strides (CoglJournalEntry *entry0, CoglJournalEntry *entry1)
 {
-  /* Currently the only thing that affects the stride for our vertex arrays
-   * is the number of pipeline layers. We need to update our VBO offsets
-   * whenever the stride changes. */
+  /* Currently the only things that affect the stride for our vertex
+   * arrays are the number of pipeline layers and whether the entries
+   * are uploaded as instance records. We need to update our VBO
+   * offsets whenever the stride changes. */
   /* TODO: We should be padding the n_layers == 1 case as if it were
    * n_layers == 2 so we can reduce the need to split batches. */
+  if (entry0->instanced != entry1->instanced)
+    return FALSE;
+
   if (entry0->n_layers == entry1->n_layers ||
       (entry0->n_layers <= MIN_LAYER_PADING &&
        entry1->n_layers <= MIN_LAYER_PADING))
@@ -767,6 +1219,10 @@ can_software_clip_entry (CoglJournalEntry *journal_entry,
   CoglClipStack *clip_entry;
   int layer_num;
 
+  /* Only rectangles can be clipped in software */
+  if (journal_entry->n_primitive_vertices)
+    return FALSE;
+
   clip_bounds_out->x_1 = -G_MAXFLOAT;
   clip_bounds_out->y_1 = -G_MAXFLOAT;
   clip_bounds_out->x_2 = G_MAXFLOAT;
@@ -1038,151 +1494,1239 @@ compare_entry_clip_stacks (CoglJournalEntry *entry0, CoglJournalEntry *entry1)
   return entry0->clip_stack == entry1->clip_stack;
 }
 
-/* Gets a new vertex array from the pool. A reference is taken on the
-   array so it can be treated as if it was just newly allocated */
-static CoglAttributeBuffer *
-create_attribute_buffer (CoglJournal *journal,
-                         size_t n_bytes)
+/* When reordering the journal an entry is never moved back past more
+ * than this number of entries so that the cost of the overlap tests
+ * stays bounded */
+#define COGL_JOURNAL_REORDER_WINDOW 32
+
+typedef struct _ScreenBoundsState
 {
-  CoglAttributeBuffer *vbo;
-  CoglContext *ctx = journal->framebuffer->context;
+  CoglMatrix projection;
+  float viewport[4];
+  CoglMatrixEntry *modelview_entry;
+  CoglMatrix modelview;
+} ScreenBoundsState;
 
-  /* If CoglBuffers are being emulated with malloc then there's not
-     really any point in using the pool so we'll just allocate the
-     buffer directly */
-  if (!(ctx->private_feature_flags & COGL_PRIVATE_FEATURE_VBOS))
-    return cogl_attribute_buffer_new_with_size (ctx, n_bytes);
+static void
+init_screen_bounds_state (CoglFramebuffer *framebuffer,
+                          ScreenBoundsState *state)
+{
+  CoglMatrixStack *projection_stack =
+    _cogl_framebuffer_get_projection_stack (framebuffer);
 
-  vbo = journal->vbo_pool[journal->next_vbo_in_pool];
+  cogl_matrix_stack_get (projection_stack, &state->projection);
+  cogl_framebuffer_get_viewport4fv (framebuffer, state->viewport);
+  state->modelview_entry = NULL;
+}
 
-  if (vbo == NULL)
-    {
-      vbo = cogl_attribute_buffer_new_with_size (ctx, n_bytes);
-      journal->vbo_pool[journal->next_vbo_in_pool] = vbo;
-    }
-  else if (cogl_buffer_get_size (COGL_BUFFER (vbo)) < n_bytes)
-    {
-      /* If the buffer is too small then we'll just recreate it */
-      cogl_object_unref (vbo);
-      vbo = cogl_attribute_buffer_new_with_size (ctx, n_bytes);
-      journal->vbo_pool[journal->next_vbo_in_pool] = vbo;
-    }
+/* Transforms a point with the current modelview to window
+ * coordinates. The clip space w coordinate is returned in @w_out */
+static CoglBool
+transform_point_to_window (ScreenBoundsState *state,
+                           float *x_inout,
+                           float *y_inout,
+                           float z,
+                           float *w_out)
+{
+  float x = *x_inout, y = *y_inout;
+  float w = 1.0f;
 
-  journal->next_vbo_in_pool = ((journal->next_vbo_in_pool + 1) %
-                               COGL_JOURNAL_VBO_POOL_SIZE);
+  cogl_matrix_transform_point (&state->modelview, &x, &y, &z, &w);
+  cogl_matrix_transform_point (&state->projection, &x, &y, &z, &w);
 
-  return cogl_object_ref (vbo);
-}
+  /* Points behind the viewer would need to be clipped to get
+   * sensible bounds so we just give up */
+  if (w <= 0.0f)
+    return FALSE;
 
-static CoglAttributeBuffer *
-upload_vertices (CoglJournal *journal,
-                 const CoglJournalEntry *entries,
-                 int n_entries,
-                 size_t needed_vbo_len,
-                 GArray *vertices)
-{
-  CoglAttributeBuffer *attribute_buffer;
-  CoglBuffer *buffer;
-  const float *vin;
-  float *vout;
-  int entry_num;
-  int i;
-  CoglMatrixEntry *last_modelview_entry = NULL;
-  CoglMatrix modelview;
+  /* Convert to window coordinates in the same way as
+   * entry_to_screen_polygon() */
+  *x_inout = (x / w + 1.0f) * (state->viewport[2] / 2.0f) + state->viewport[0];
+  *y_inout = (1.0f - y / w) * (state->viewport[3] / 2.0f) + state->viewport[1];
+  *w_out = w;
 
-  g_assert (needed_vbo_len);
+  return TRUE;
+}
 
-  attribute_buffer = create_attribute_buffer (journal, needed_vbo_len * 4);
-  buffer = COGL_BUFFER (attribute_buffer);
-  cogl_buffer_set_update_hint (buffer, COGL_BUFFER_UPDATE_HINT_STATIC);
+static CoglBool
+add_point_to_screen_bounds (ScreenBoundsState *state,
+                            float x,
+                            float y,
+                            float z,
+                            ClipBounds *bounds)
+{
+  float w;
 
-  vout = _cogl_buffer_map_range_for_fill_or_fallback (buffer,
-                                                      0, /* offset */
-                                                      needed_vbo_len * 4);
-  vin = &g_array_index (vertices, float, 0);
+  if (!transform_point_to_window (state, &x, &y, z, &w))
+    return FALSE;
 
-  /* Expand the number of vertices from 2 to 4 while uploading */
-  for (entry_num = 0; entry_num < n_entries; entry_num++)
-    {
-      const CoglJournalEntry *entry = entries + entry_num;
-      size_t vb_stride = GET_JOURNAL_VB_STRIDE_FOR_N_LAYERS (entry->n_layers);
-      size_t array_stride =
-        GET_JOURNAL_ARRAY_STRIDE_FOR_N_LAYERS (entry->n_layers);
+  bounds->x_1 = MIN (bounds->x_1, x);
+  bounds->y_1 = MIN (bounds->y_1, y);
+  bounds->x_2 = MAX (bounds->x_2, x);
+  bounds->y_2 = MAX (bounds->y_2, y);
 
-      /* Copy the color to all four of the vertices */
-      for (i = 0; i < 4; i++)
-        memcpy (vout + vb_stride * i + POS_STRIDE, vin, 4);
-      vin++;
+  return TRUE;
+}
 
-      if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_DISABLE_SOFTWARE_TRANSFORM)))
-        {
-          vout[vb_stride * 0] = vin[0];
-          vout[vb_stride * 0 + 1] = vin[1];
-          vout[vb_stride * 1] = vin[0];
-          vout[vb_stride * 1 + 1] = vin[array_stride + 1];
-          vout[vb_stride * 2] = vin[array_stride];
-          vout[vb_stride * 2 + 1] = vin[array_stride + 1];
-          vout[vb_stride * 3] = vin[array_stride];
-          vout[vb_stride * 3 + 1] = vin[1];
-        }
-      else
-        {
-          float v[8];
+/* Calculates the window space bounding box of an entry. If this can't
+ * be reliably determined then the bounds will cover everything */
+static void
+get_entry_screen_bounds (CoglJournal *journal,
+                         ScreenBoundsState *state,
+                         const CoglJournalEntry *entry,
+                         ClipBounds *bounds)
+{
+  const float *v = &g_array_index (journal->vertices, float,
+                                   entry->array_offset);
+  CoglBool valid = TRUE;
+  int i;
 
-          v[0] = vin[0];
-          v[1] = vin[1];
-          v[2] = vin[0];
-          v[3] = vin[array_stride + 1];
-          v[4] = vin[array_stride];
-          v[5] = vin[array_stride + 1];
-          v[6] = vin[array_stride];
-          v[7] = vin[1];
+  bounds->x_1 = G_MAXFLOAT;
+  bounds->y_1 = G_MAXFLOAT;
+  bounds->x_2 = -G_MAXFLOAT;
+  bounds->y_2 = -G_MAXFLOAT;
 
-          if (entry->modelview_entry != last_modelview_entry)
-            cogl_matrix_entry_get (entry->modelview_entry, &modelview);
-          cogl_matrix_transform_points (&modelview,
-                                        2, /* n_components */
-                                        sizeof (float) * 2, /* stride_in */
-                                        v, /* points_in */
-                                        /* strideout */
-                                        vb_stride * sizeof (float),
-                                        vout, /* points_out */
-                                        4 /* n_points */);
-        }
+  /* The vertices could be moved anywhere by a vertex shader */
+  if (cogl_pipeline_get_user_program (entry->pipeline) ||
+      _cogl_pipeline_has_vertex_snippets (entry->pipeline))
+    goto unknown;
 
-      for (i = 0; i < entry->n_layers; i++)
-        {
-          const float *tin = vin + 2;
-          float *tout = vout + POS_STRIDE + COLOR_STRIDE;
+  if (entry->modelview_entry != state->modelview_entry)
+    {
+      cogl_matrix_entry_get (entry->modelview_entry, &state->modelview);
+      state->modelview_entry = entry->modelview_entry;
+    }
 
-          tout[vb_stride * 0 + i * 2] = tin[i * 2];
-          tout[vb_stride * 0 + 1 + i * 2] = tin[i * 2 + 1];
-          tout[vb_stride * 1 + i * 2] = tin[i * 2];
-          tout[vb_stride * 1 + 1 + i * 2] = tin[array_stride + i * 2 + 1];
-          tout[vb_stride * 2 + i * 2] = tin[array_stride + i * 2];
-          tout[vb_stride * 2 + 1 + i * 2] = tin[array_stride + i * 2 + 1];
-          tout[vb_stride * 3 + i * 2] = tin[array_stride + i * 2];
-          tout[vb_stride * 3 + 1 + i * 2] = tin[i * 2 + 1];
-        }
+  if (entry->n_primitive_vertices)
+    {
+      size_t stride =
+        GET_JOURNAL_PRIMITIVE_ARRAY_STRIDE_FOR_N_LAYERS (entry->n_layers);
 
-      vin += array_stride * 2;
-      vout += vb_stride * 4;
+      for (i = 0; valid && i < entry->n_primitive_vertices; i++, v += stride)
+        valid = add_point_to_screen_bounds (state, v[0], v[1], v[2], bounds);
+    }
+  else
+    {
+      size_t stride = GET_JOURNAL_ARRAY_STRIDE_FOR_N_LAYERS (entry->n_layers);
+
+      /* Skip the color */
+      v++;
+
+      /* The quad may be rotated so we need to consider all four
+       * corners */
+      valid = (add_point_to_screen_bounds (state, v[0], v[1], 0, bounds) &&
+               add_point_to_screen_bounds (state, v[0], v[stride + 1], 0,
+                                           bounds) &&
+               add_point_to_screen_bounds (state, v[stride], v[stride + 1], 0,
+                                           bounds) &&
+               add_point_to_screen_bounds (state, v[stride], v[1], 0,
+                                           bounds));
     }
 
-  _cogl_buffer_unmap_for_fill_or_fallback (buffer);
+  if (valid)
+    return;
 
-  return attribute_buffer;
+unknown:
+  bounds->x_1 = -G_MAXFLOAT;
+  bounds->y_1 = -G_MAXFLOAT;
+  bounds->x_2 = G_MAXFLOAT;
+  bounds->y_2 = G_MAXFLOAT;
 }
 
-void
-_cogl_journal_discard (CoglJournal *journal)
+static CoglBool
+screen_bounds_overlap (const ClipBounds *bounds0,
+                       const ClipBounds *bounds1)
 {
-  int i;
-
-  if (journal->entries->len <= 0)
-    return;
+  return (bounds0->x_1 < bounds1->x_2 &&
+          bounds1->x_1 < bounds0->x_2 &&
+          bounds0->y_1 < bounds1->y_2 &&
+          bounds1->y_1 < bounds0->y_2);
+}
 
-  for (i = 0; i < journal->entries->len; i++)
+/* Checks whether two entries would end up in the same batch if they
+ * were next to each other in the journal */
+static CoglBool
+compare_entry_batches (CoglJournalEntry *entry0, CoglJournalEntry *entry1)
+{
+  if (entry0->clip_stack != entry1->clip_stack ||
+      entry0->n_layers != entry1->n_layers ||
+      (entry0->n_primitive_vertices > 0) !=
+      (entry1->n_primitive_vertices > 0) ||
+      entry0->instanced != entry1->instanced)
+    return FALSE;
+
+  if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_DISABLE_SOFTWARE_TRANSFORM)) &&
+      !compare_entry_modelviews (entry0, entry1))
+    return FALSE;
+
+  return (_cogl_pipeline_layer_numbers_equal (entry0->pipeline,
+                                              entry1->pipeline) &&
+          compare_entry_pipelines (entry0, entry1));
+}
+
+/* Tries to improve batching by moving entries back to just after an
+ * earlier entry that they could be batched with. An entry is only
+ * moved past other entries if their window space bounds don't
+ * overlap so that the order of any overlapping geometry, and
+ * therefore the result of blending or depth testing, is preserved. */
+static void
+reorder_entries (CoglJournal *journal)
+{
+  CoglFramebuffer *framebuffer = journal->framebuffer;
+  CoglContext *ctx = framebuffer->context;
+  CoglJournalEntry *entries = (CoglJournalEntry *) journal->entries->data;
+  int n_entries = journal->entries->len;
+  ScreenBoundsState bounds_state;
+  ClipBounds *bounds;
+  int *order;
+  int n_ordered = 0;
+  int n_moved = 0;
+  int i, j;
+  COGL_STATIC_TIMER (time_reorder,
+                     "Journal Flush", /* parent */
+                     "flush: reorder",
+                     "Time spent reordering the journal",
+                     0 /* no application private data */);
+
+  if (n_entries < 3)
+    return;
+
+  COGL_TIMER_START (_cogl_uprof_context, time_reorder);
+
+  init_screen_bounds_state (framebuffer, &bounds_state);
+
+  /* The clip bounds scratch buffer isn't needed anymore once the
+   * software clipping pass is done so we can reuse it here */
+  if (ctx->journal_clip_bounds == NULL)
+    ctx->journal_clip_bounds = g_array_new (FALSE, FALSE, sizeof (ClipBounds));
+  g_array_set_size (ctx->journal_clip_bounds, n_entries);
+  bounds = (ClipBounds *) ctx->journal_clip_bounds->data;
+
+  order = g_new (int, n_entries);
+
+  for (i = 0; i < n_entries; i++)
+    {
+      int insert_pos = n_ordered;
+
+      get_entry_screen_bounds (journal, &bounds_state, entries + i,
+                               bounds + i);
+
+      for (j = n_ordered - 1;
+           j >= 0 && j >= n_ordered - COGL_JOURNAL_REORDER_WINDOW;
+           j--)
+        {
+          if (compare_entry_batches (entries + order[j], entries + i))
+            {
+              insert_pos = j + 1;
+              break;
+            }
+
+          if (screen_bounds_overlap (bounds + order[j], bounds + i))
+            break;
+        }
+
+      if (insert_pos < n_ordered)
+        {
+          memmove (order + insert_pos + 1,
+                   order + insert_pos,
+                   (n_ordered - insert_pos) * sizeof (int));
+          n_moved++;
+        }
+
+      order[insert_pos] = i;
+      n_ordered++;
+    }
+
+  if (n_moved)
+    {
+      CoglJournalEntry *copy = g_memdup (entries,
+                                         sizeof (CoglJournalEntry) *
+                                         n_entries);
+
+      for (i = 0; i < n_entries; i++)
+        entries[i] = copy[order[i]];
+
+      g_free (copy);
+    }
+
+  if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_BATCHING)))
+    g_print ("BATCHING: reordered %d of %d journal entries\n",
+             n_moved, n_entries);
+
+  g_free (order);
+
+  COGL_TIMER_STOP (_cogl_uprof_context, time_reorder);
+}
+
+/* The number of opaque rectangles that are remembered while looking
+ * for earlier entries that they cover. Only the largest are kept */
+#define COGL_JOURNAL_MAX_OCCLUDERS 8
+
+/* Window coordinates are compared with this tolerance so that
+ * rectangles which are meant to line up aren't missed because of
+ * rounding errors in the transformations */
+#define OCCLUSION_EPSILON 0.01f
+
+typedef struct
+{
+  CoglClipStack *clip_stack;
+  ClipBounds bounds;
+} JournalOccluder;
+
+/* The window space edges of a logged rectangle. The logged
+ * coordinate i (0 for x, 1 for y) lies along the window axis
+ * window_axis[i] and the edge at the coordinate from the logged
+ * corner c is at edges[i][c] along that axis */
+typedef struct
+{
+  int window_axis[2];
+  float edges[2][2];
+  ClipBounds bounds;
+} RectangleWindowEdges;
+
+static void
+get_bounds_range (const ClipBounds *bounds,
+                  int axis,
+                  float *min,
+                  float *max)
+{
+  *min = axis ? bounds->y_1 : bounds->x_1;
+  *max = axis ? bounds->y_2 : bounds->x_2;
+}
+
+static CoglBool
+bounds_contain (const ClipBounds *outer,
+                const ClipBounds *inner)
+{
+  return (inner->x_1 >= outer->x_1 - OCCLUSION_EPSILON &&
+          inner->y_1 >= outer->y_1 - OCCLUSION_EPSILON &&
+          inner->x_2 <= outer->x_2 + OCCLUSION_EPSILON &&
+          inner->y_2 <= outer->y_2 + OCCLUSION_EPSILON);
+}
+
+/* Works out where the edges of a rectangle entry end up in window
+ * coordinates. This fails unless the rectangle stays aligned to the
+ * window axes and is transformed without any perspective, in which
+ * case the vertex attributes are interpolated linearly in window
+ * space */
+static CoglBool
+get_rectangle_window_edges (CoglJournal *journal,
+                            ScreenBoundsState *state,
+                            const CoglJournalEntry *entry,
+                            RectangleWindowEdges *edges)
+{
+  /* Skip the color */
+  const float *v = &g_array_index (journal->vertices, float,
+                                   entry->array_offset + 1);
+  size_t stride = GET_JOURNAL_ARRAY_STRIDE_FOR_N_LAYERS (entry->n_layers);
+  float x[4], y[4], w[4];
+  int i;
+
+  if (entry->n_primitive_vertices ||
+      cogl_pipeline_get_user_program (entry->pipeline) ||
+      _cogl_pipeline_has_vertex_snippets (entry->pipeline))
+    return FALSE;
+
+  if (entry->modelview_entry != state->modelview_entry)
+    {
+      cogl_matrix_entry_get (entry->modelview_entry, &state->modelview);
+      state->modelview_entry = entry->modelview_entry;
+    }
+
+  /* The corners are in the order (x1,y1) (x2,y1) (x1,y2) (x2,y2) */
+  for (i = 0; i < 4; i++)
+    {
+      x[i] = v[(i & 1) ? stride : 0];
+      y[i] = v[(i & 2) ? stride + 1 : 1];
+
+      if (!transform_point_to_window (state, x + i, y + i, 0.0f, w + i))
+        return FALSE;
+    }
+
+  for (i = 1; i < 4; i++)
+    if (fabsf (w[i] - w[0]) > w[0] * 1e-5f)
+      return FALSE;
+
+  if (fabsf (y[1] - y[0]) < OCCLUSION_EPSILON &&
+      fabsf (y[3] - y[2]) < OCCLUSION_EPSILON &&
+      fabsf (x[2] - x[0]) < OCCLUSION_EPSILON &&
+      fabsf (x[3] - x[1]) < OCCLUSION_EPSILON)
+    {
+      edges->window_axis[0] = 0;
+      edges->window_axis[1] = 1;
+      edges->edges[0][0] = x[0];
+      edges->edges[0][1] = x[1];
+      edges->edges[1][0] = y[0];
+      edges->edges[1][1] = y[2];
+    }
+  else if (fabsf (x[1] - x[0]) < OCCLUSION_EPSILON &&
+           fabsf (x[3] - x[2]) < OCCLUSION_EPSILON &&
+           fabsf (y[2] - y[0]) < OCCLUSION_EPSILON &&
+           fabsf (y[3] - y[1]) < OCCLUSION_EPSILON)
+    {
+      /* The rectangle has been rotated by 90 or 270 degrees */
+      edges->window_axis[0] = 1;
+      edges->window_axis[1] = 0;
+      edges->edges[0][0] = y[0];
+      edges->edges[0][1] = y[1];
+      edges->edges[1][0] = x[0];
+      edges->edges[1][1] = x[2];
+    }
+  else
+    return FALSE;
+
+  edges->bounds.x_1 = MIN (MIN (x[0], x[1]), MIN (x[2], x[3]));
+  edges->bounds.y_1 = MIN (MIN (y[0], y[1]), MIN (y[2], y[3]));
+  edges->bounds.x_2 = MAX (MAX (x[0], x[1]), MAX (x[2], x[3]));
+  edges->bounds.y_2 = MAX (MAX (y[0], y[1]), MAX (y[2], y[3]));
+
+  return TRUE;
+}
+
+/* Checks whether drawing the entry is guaranteed to replace every
+ * pixel that it covers */
+static CoglBool
+entry_is_opaque (CoglJournalEntry *entry)
+{
+  CoglPipeline *pipeline = entry->pipeline;
+  CoglDepthState depth_state;
+
+  if (cogl_pipeline_get_alpha_test_function (pipeline) !=
+      COGL_PIPELINE_ALPHA_FUNC_ALWAYS ||
+      cogl_pipeline_get_color_mask (pipeline) != COGL_COLOR_MASK_ALL)
+    return FALSE;
+
+  /* A fragment snippet could discard fragments */
+  if (_cogl_pipeline_has_fragment_snippets (pipeline))
+    return FALSE;
+
+  cogl_pipeline_get_depth_state (pipeline, &depth_state);
+  if (cogl_depth_state_get_test_enabled (&depth_state))
+    return FALSE;
+
+  /* The color of a logged rectangle always comes from the pipeline
+   * so the alpha isn't unknown */
+  _cogl_pipeline_update_real_blend_enable (pipeline, FALSE);
+
+  return !_cogl_pipeline_get_real_blend_enabled (pipeline);
+}
+
+/* Moves the edges of a rectangle entry so that it no longer covers
+ * the part that is hidden by the occluder. This is only done when
+ * the remaining part is still a rectangle. The texture coordinates
+ * are moved by the same proportion so the pixels that remain are
+ * drawn exactly as before. Returns TRUE if the entry was changed */
+static CoglBool
+trim_rectangle_entry (CoglJournal *journal,
+                      CoglJournalEntry *entry,
+                      const RectangleWindowEdges *edges,
+                      const ClipBounds *occluder)
+{
+  float *v = &g_array_index (journal->vertices, float,
+                             entry->array_offset + 1);
+  size_t stride = GET_JOURNAL_ARRAY_STRIDE_FOR_N_LAYERS (entry->n_layers);
+  int i, j;
+
+  for (i = 0; i < 2; i++)
+    {
+      int axis = edges->window_axis[i];
+      float entry_min, entry_max;
+      float occluder_min, occluder_max;
+      float new_edge;
+      int near_corner, far_corner;
+      float t;
+
+      /* The occluder needs to cover the whole of the entry in the
+       * other direction */
+      get_bounds_range (&edges->bounds, !axis, &entry_min, &entry_max);
+      get_bounds_range (occluder, !axis, &occluder_min, &occluder_max);
+      if (occluder_min > entry_min + OCCLUSION_EPSILON ||
+          occluder_max < entry_max - OCCLUSION_EPSILON)
+        continue;
+
+      get_bounds_range (&edges->bounds, axis, &entry_min, &entry_max);
+      get_bounds_range (occluder, axis, &occluder_min, &occluder_max);
+
+      /* Work out which of the logged corners has the edge that is
+       * covered */
+      if (occluder_min <= entry_min + OCCLUSION_EPSILON &&
+          occluder_max > entry_min &&
+          occluder_max < entry_max)
+        {
+          new_edge = occluder_max;
+          near_corner = edges->edges[i][0] < edges->edges[i][1] ? 0 : 1;
+        }
+      else if (occluder_max >= entry_max - OCCLUSION_EPSILON &&
+               occluder_min < entry_max &&
+               occluder_min > entry_min)
+        {
+          new_edge = occluder_min;
+          near_corner = edges->edges[i][0] > edges->edges[i][1] ? 0 : 1;
+        }
+      else
+        continue;
+
+      far_corner = !near_corner;
+      t = ((new_edge - edges->edges[i][near_corner]) /
+           (edges->edges[i][far_corner] - edges->edges[i][near_corner]));
+
+      /* Interpolate the position and the texture coordinates for
+       * each layer */
+      for (j = 0; j <= entry->n_layers; j++)
+        {
+          float *near_v = v + near_corner * stride + j * 2 + i;
+          float *far_v = v + far_corner * stride + j * 2 + i;
+
+          *near_v += (*far_v - *near_v) * t;
+        }
+
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+static void
+add_occluder (JournalOccluder *occluders,
+              int *n_occluders,
+              CoglClipStack *clip_stack,
+              const ClipBounds *bounds)
+{
+  float area = ((bounds->x_2 - bounds->x_1) *
+                (bounds->y_2 - bounds->y_1));
+  int smallest = 0;
+  float smallest_area = G_MAXFLOAT;
+  int i;
+
+  if (*n_occluders < COGL_JOURNAL_MAX_OCCLUDERS)
+    {
+      smallest = (*n_occluders)++;
+    }
+  else
+    {
+      for (i = 0; i < COGL_JOURNAL_MAX_OCCLUDERS; i++)
+        {
+          const ClipBounds *b = &occluders[i].bounds;
+          float a = (b->x_2 - b->x_1) * (b->y_2 - b->y_1);
+
+          if (a < smallest_area)
+            {
+              smallest = i;
+              smallest_area = a;
+            }
+        }
+
+      if (area <= smallest_area)
+        return;
+    }
+
+  occluders[smallest].clip_stack = clip_stack;
+  occluders[smallest].bounds = *bounds;
+}
+
+/* Walks the journal backwards remembering the window space rectangles
+ * of opaque, axis aligned entries. Any earlier entry with the same
+ * clip stack that is completely hidden behind one of these is
+ * dropped and rectangles that are partly hidden are trimmed. */
+static void
+cull_overdrawn_entries (CoglJournal *journal)
+{
+  CoglFramebuffer *framebuffer = journal->framebuffer;
+  CoglJournalEntry *entries = (CoglJournalEntry *) journal->entries->data;
+  int n_entries = journal->entries->len;
+  JournalOccluder occluders[COGL_JOURNAL_MAX_OCCLUDERS];
+  int n_occluders = 0;
+  ScreenBoundsState bounds_state;
+  CoglBool *culled;
+  int n_culled = 0;
+  int n_trimmed = 0;
+  int i, j;
+  COGL_STATIC_TIMER (time_cull,
+                     "Journal Flush", /* parent */
+                     "flush: cull",
+                     "Time spent culling overdrawn journal entries",
+                     0 /* no application private data */);
+
+  if (n_entries < 2)
+    return;
+
+  COGL_TIMER_START (_cogl_uprof_context, time_cull);
+
+  init_screen_bounds_state (framebuffer, &bounds_state);
+
+  culled = g_new0 (CoglBool, n_entries);
+
+  for (i = n_entries - 1; i >= 0; i--)
+    {
+      CoglJournalEntry *entry = entries + i;
+      RectangleWindowEdges edges;
+      CoglBool is_rectangle;
+      ClipBounds bounds;
+      CoglDepthState depth_state;
+
+      /* An entry that is depth tested might write to the depth
+       * buffer so it has to be drawn even if it can't be seen */
+      cogl_pipeline_get_depth_state (entry->pipeline, &depth_state);
+      if (cogl_depth_state_get_test_enabled (&depth_state))
+        continue;
+
+      is_rectangle = get_rectangle_window_edges (journal,
+                                                 &bounds_state,
+                                                 entry,
+                                                 &edges);
+
+      if (n_occluders > 0)
+        {
+          if (is_rectangle)
+            bounds = edges.bounds;
+          else
+            get_entry_screen_bounds (journal, &bounds_state, entry, &bounds);
+
+          for (j = 0; j < n_occluders; j++)
+            {
+              if (occluders[j].clip_stack != entry->clip_stack)
+                continue;
+
+              if (bounds_contain (&occluders[j].bounds, &bounds))
+                {
+                  culled[i] = TRUE;
+                  break;
+                }
+
+              /* The window edges are updated after each trim so that
+               * the next occluder can trim the entry further */
+              if (is_rectangle &&
+                  trim_rectangle_entry (journal, entry, &edges,
+                                        &occluders[j].bounds))
+                {
+                  n_trimmed++;
+                  is_rectangle = get_rectangle_window_edges (journal,
+                                                             &bounds_state,
+                                                             entry,
+                                                             &edges);
+                  if (!is_rectangle)
+                    break;
+                  bounds = edges.bounds;
+                }
+            }
+
+          if (culled[i])
+            {
+              n_culled++;
+              continue;
+            }
+        }
+
+      if (is_rectangle && entry_is_opaque (entry))
+        add_occluder (occluders, &n_occluders,
+                      entry->clip_stack, &edges.bounds);
+    }
+
+  if (n_culled)
+    {
+      for (i = 0, j = 0; i < n_entries; i++)
+        {
+          if (culled[i])
+            {
+              _cogl_pipeline_journal_unref (entries[i].pipeline);
+              cogl_matrix_entry_unref (entries[i].modelview_entry);
+              _cogl_clip_stack_unref (entries[i].clip_stack);
+            }
+          else
+            entries[j++] = entries[i];
+        }
+
+      g_array_set_size (journal->entries, j);
+    }
+
+  if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_BATCHING)))
+    g_print ("BATCHING: culled %d and trimmed %d of %d journal entries\n",
+             n_culled, n_trimmed, n_entries);
+
+  g_free (culled);
+
+  COGL_TIMER_STOP (_cogl_uprof_context, time_cull);
+}
+
+/* Decides which rectangles will be uploaded as instance records and
+ * returns the size of the vertex array needed for all of the entries
+ * in 32-bit words. If the vertices could be uploaded in the compact
+ * format then the size they would need in that format is returned in
+ * @compact_vbo_len, otherwise it is set to 0 */
+static size_t
+prepare_entries (CoglJournal *journal,
+                 size_t *compact_vbo_len)
+{
+  CoglContext *ctx = journal->framebuffer->context;
+  CoglJournalEntry *entries = (CoglJournalEntry *) journal->entries->data;
+  CoglBool can_instance;
+  CoglBool can_compact;
+  size_t vbo_len = 0;
+  int i;
+
+  /* The instance records are expanded with snippets so we need GLSL
+   * and they contain positions that have already been transformed.
+   * The debug options that look at the expanded vertices also need
+   * the old path */
+  can_instance = (ctx->glDrawArraysInstanced != NULL &&
+                  cogl_has_feature (ctx, COGL_FEATURE_ID_GLSL) &&
+                  SW_TRANSFORM &&
+                  !COGL_DEBUG_ENABLED (COGL_DEBUG_DISABLE_INSTANCED_QUADS) &&
+                  !COGL_DEBUG_ENABLED (COGL_DEBUG_WIREFRAME) &&
+                  !COGL_DEBUG_ENABLED (COGL_DEBUG_RECTANGLES) &&
+                  !COGL_DEBUG_ENABLED (COGL_DEBUG_JOURNAL));
+
+  /* The compact format relies on the positions having been
+   * transformed. The fixed function pipeline can't use normalized
+   * texture coordinates and the journal debugging dumps the vertices
+   * assuming they are floats */
+  can_compact = (SW_TRANSFORM &&
+                 !(ctx->private_feature_flags &
+                   COGL_PRIVATE_FEATURE_GL_FIXED) &&
+                 !COGL_DEBUG_ENABLED (COGL_DEBUG_DISABLE_COMPACT_VERTICES) &&
+                 !COGL_DEBUG_ENABLED (COGL_DEBUG_JOURNAL));
+
+  *compact_vbo_len = 0;
+
+  for (i = 0; i < journal->entries->len; i++)
+    {
+      CoglJournalEntry *entry = entries + i;
+
+      /* The vertex transform gets replaced so the pipeline can't do
+       * any vertex processing of its own */
+      entry->instanced =
+        (can_instance &&
+         entry->n_primitive_vertices == 0 &&
+         entry->n_layers <= COGL_JOURNAL_INSTANCED_MAX_LAYERS &&
+         !cogl_pipeline_get_user_program (entry->pipeline) &&
+         !_cogl_pipeline_has_vertex_snippets (entry->pipeline));
+
+      if (entry->instanced)
+        {
+          size_t len =
+            GET_JOURNAL_INSTANCE_STRIDE_FOR_N_LAYERS (entry->n_layers);
+
+          vbo_len += len;
+          *compact_vbo_len += len;
+        }
+      else
+        {
+          int n_vertices = get_entry_n_vertices (entry);
+
+          vbo_len += (GET_JOURNAL_VB_STRIDE_FOR_N_LAYERS (entry->n_layers) *
+                      n_vertices);
+          *compact_vbo_len +=
+            (GET_JOURNAL_COMPACT_VB_STRIDE_FOR_N_LAYERS (entry->n_layers) *
+             n_vertices);
+        }
+    }
+
+  /* There's no point in checking the vertices if none of them would
+   * be made any smaller */
+  if (!can_compact || *compact_vbo_len == vbo_len)
+    *compact_vbo_len = 0;
+
+  return vbo_len;
+}
+
+/* Writes the instance record for a rectangle that will be expanded
+ * by the vertex shader */
+static void
+expand_instance (const CoglJournalEntry *entry,
+                 const float *vin,
+                 const CoglMatrix *modelview,
+                 float *vout)
+{
+  size_t array_stride =
+    GET_JOURNAL_ARRAY_STRIDE_FOR_N_LAYERS (entry->n_layers);
+  float v[6];
+  int i;
+
+  memcpy (vout + INSTANCE_POS_STRIDE, vin, 4);
+  vin++;
+
+  /* Transform the top left, top right and bottom left corners */
+  v[0] = vin[0];
+  v[1] = vin[1];
+  v[2] = vin[array_stride];
+  v[3] = vin[1];
+  v[4] = vin[0];
+  v[5] = vin[array_stride + 1];
+
+  cogl_matrix_transform_points (modelview,
+                                2, /* n_components */
+                                sizeof (float) * 2, /* stride_in */
+                                v, /* points_in */
+                                sizeof (float) * 3, /* stride_out */
+                                vout, /* points_out */
+                                3 /* n_points */);
+
+  /* The vertex shader wants the edges from the first corner
+   * rather than the other two corners */
+  for (i = 0; i < 3; i++)
+    {
+      vout[3 + i] -= vout[i];
+      vout[6 + i] -= vout[i];
+    }
+
+  for (i = 0; i < entry->n_layers; i++)
+    {
+      const float *tin = vin + 2;
+      float *tout = (vout + INSTANCE_POS_STRIDE + COLOR_STRIDE +
+                     INSTANCE_TEX_STRIDE * i);
+
+      tout[0] = tin[i * 2];
+      tout[1] = tin[i * 2 + 1];
+      tout[2] = tin[array_stride + i * 2];
+      tout[3] = tin[array_stride + i * 2 + 1];
+    }
+}
+
+/* Writes the vertices for all of the entries to @vout using floats */
+static void
+expand_vertices (const CoglJournalEntry *entries,
+                 int n_entries,
+                 GArray *vertices,
+                 float *vout)
+{
+  const float *vin;
+  int entry_num;
+  int i;
+  CoglMatrixEntry *last_modelview_entry = NULL;
+  CoglMatrix modelview;
+
+  /* Expand the number of vertices from 2 to 4 while uploading, or to
+   * 3 corners for instanced quads */
+  for (entry_num = 0; entry_num < n_entries; entry_num++)
+    {
+      const CoglJournalEntry *entry = entries + entry_num;
+      size_t vb_stride = GET_JOURNAL_VB_STRIDE_FOR_N_LAYERS (entry->n_layers);
+      size_t array_stride =
+        GET_JOURNAL_ARRAY_STRIDE_FOR_N_LAYERS (entry->n_layers);
+
+      /* The entries may have been reordered so we can't just walk
+       * through the logged vertices */
+      vin = &g_array_index (vertices, float, entry->array_offset);
+
+      if (entry->n_primitive_vertices)
+        {
+          int n_vertices = get_entry_n_vertices (entry);
+
+          array_stride =
+            GET_JOURNAL_PRIMITIVE_ARRAY_STRIDE_FOR_N_LAYERS (entry->n_layers);
+
+          if (entry->modelview_entry != last_modelview_entry)
+            {
+              cogl_matrix_entry_get (entry->modelview_entry, &modelview);
+              last_modelview_entry = entry->modelview_entry;
+            }
+          cogl_matrix_transform_points (&modelview,
+                                        3, /* n_components */
+                                        array_stride * sizeof (float),
+                                        vin, /* points_in */
+                                        /* strideout */
+                                        vb_stride * sizeof (float),
+                                        vout, /* points_out */
+                                        entry->n_primitive_vertices);
+
+          /* The color and texture coordinates are already laid out
+           * the same way as in the vertex buffer */
+          for (i = 0; i < entry->n_primitive_vertices; i++)
+            memcpy (vout + vb_stride * i + POS_STRIDE,
+                    vin + array_stride * i + 3,
+                    (COLOR_STRIDE + TEX_STRIDE * entry->n_layers) *
+                    sizeof (float));
+
+          /* Fill the padding with degenerate triangles */
+          memset (vout + vb_stride * entry->n_primitive_vertices,
+                  0,
+                  (n_vertices - entry->n_primitive_vertices) *
+                  vb_stride * sizeof (float));
+
+          vout += vb_stride * n_vertices;
+          continue;
+        }
+
+      if (entry->instanced)
+        {
+          if (entry->modelview_entry != last_modelview_entry)
+            {
+              cogl_matrix_entry_get (entry->modelview_entry, &modelview);
+              last_modelview_entry = entry->modelview_entry;
+            }
+
+          expand_instance (entry, vin, &modelview, vout);
+
+          vout += GET_JOURNAL_INSTANCE_STRIDE_FOR_N_LAYERS (entry->n_layers);
+          continue;
+        }
+
+      /* Copy the color to all four of the vertices */
+      for (i = 0; i < 4; i++)
+        memcpy (vout + vb_stride * i + POS_STRIDE, vin, 4);
+      vin++;
+
+      if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_DISABLE_SOFTWARE_TRANSFORM)))
+        {
+          vout[vb_stride * 0] = vin[0];
+          vout[vb_stride * 0 + 1] = vin[1];
+          vout[vb_stride * 1] = vin[0];
+          vout[vb_stride * 1 + 1] = vin[array_stride + 1];
+          vout[vb_stride * 2] = vin[array_stride];
+          vout[vb_stride * 2 + 1] = vin[array_stride + 1];
+          vout[vb_stride * 3] = vin[array_stride];
+          vout[vb_stride * 3 + 1] = vin[1];
+        }
+      else
+        {
+          float v[8];
+
+          v[0] = vin[0];
+          v[1] = vin[1];
+          v[2] = vin[0];
+          v[3] = vin[array_stride + 1];
+          v[4] = vin[array_stride];
+          v[5] = vin[array_stride + 1];
+          v[6] = vin[array_stride];
+          v[7] = vin[1];
+
+          if (entry->modelview_entry != last_modelview_entry)
+            {
+              cogl_matrix_entry_get (entry->modelview_entry, &modelview);
+              last_modelview_entry = entry->modelview_entry;
+            }
+          cogl_matrix_transform_points (&modelview,
+                                        2, /* n_components */
+                                        sizeof (float) * 2, /* stride_in */
+                                        v, /* points_in */
+                                        /* strideout */
+                                        vb_stride * sizeof (float),
+                                        vout, /* points_out */
+                                        4 /* n_points */);
+        }
+
+      for (i = 0; i < entry->n_layers; i++)
+        {
+          const float *tin = vin + 2;
+          float *tout = vout + POS_STRIDE + COLOR_STRIDE;
+
+          tout[vb_stride * 0 + i * 2] = tin[i * 2];
+          tout[vb_stride * 0 + 1 + i * 2] = tin[i * 2 + 1];
+          tout[vb_stride * 1 + i * 2] = tin[i * 2];
+          tout[vb_stride * 1 + 1 + i * 2] = tin[array_stride + i * 2 + 1];
+          tout[vb_stride * 2 + i * 2] = tin[array_stride + i * 2];
+          tout[vb_stride * 2 + 1 + i * 2] = tin[array_stride + i * 2 + 1];
+          tout[vb_stride * 3 + i * 2] = tin[array_stride + i * 2];
+          tout[vb_stride * 3 + 1 + i * 2] = tin[i * 2 + 1];
+        }
+
+      vout += vb_stride * 4;
+    }
+}
+
+/* Stores a transformed position as three shorts plus padding. If
+ * @out is NULL then the position is only checked. Returns FALSE if the
+ * position can't be stored without losing precision */
+static CoglBool
+pack_compact_position (const float *pos,
+                       uint8_t *out)
+{
+  int16_t *pos_out = (int16_t *) out;
+  int i;
+
+  for (i = 0; i < 3; i++)
+    {
+      if (!(pos[i] >= -32768.0f && pos[i] <= 32767.0f &&
+            pos[i] == floorf (pos[i])))
+        return FALSE;
+
+      if (out)
+        pos_out[i] = pos[i];
+    }
+
+  if (out)
+    pos_out[3] = 0;
+
+  return TRUE;
+}
+
+/* Stores a texture coordinate as a normalized unsigned short. Only
+ * coordinates between 0 and 1 can be represented so anything else,
+ * including NaN, makes this return FALSE. If @out is NULL then the
+ * coordinate is only checked */
+static CoglBool
+pack_compact_tex_coord (float v,
+                        uint16_t *out)
+{
+  if (!(v >= 0.0f && v <= 1.0f))
+    return FALSE;
+
+  if (out)
+    *out = v * 65535.0f + 0.5f;
+
+  return TRUE;
+}
+
+/* The number of primitive vertices that are transformed at a time
+ * while writing compact vertices */
+#define COMPACT_PRIMITIVE_CHUNK 16
+
+/* Writes the vertices for all of the entries directly in the compact
+ * format. The instance records are written unchanged. If @out is
+ * NULL then nothing is written and the vertices are only checked, so
+ * this can be used to decide on the format before mapping the vertex
+ * buffer. It stops at the first vertex that doesn't fit and returns
+ * FALSE */
+static CoglBool
+write_compact_vertices (const CoglJournalEntry *entries,
+                        int n_entries,
+                        GArray *vertices,
+                        uint8_t *out)
+{
+  const float *vin;
+  int entry_num;
+  int i, j, k;
+  CoglMatrixEntry *last_modelview_entry = NULL;
+  CoglMatrix modelview;
+
+  for (entry_num = 0; entry_num < n_entries; entry_num++)
+    {
+      const CoglJournalEntry *entry = entries + entry_num;
+      size_t compact_stride =
+        GET_JOURNAL_COMPACT_VB_STRIDE_FOR_N_LAYERS (entry->n_layers);
+      size_t array_stride;
+      float corners[8];
+      float pos[COMPACT_PRIMITIVE_CHUNK * 3];
+
+      vin = &g_array_index (vertices, float, entry->array_offset);
+
+      if (entry->modelview_entry != last_modelview_entry)
+        {
+          cogl_matrix_entry_get (entry->modelview_entry, &modelview);
+          last_modelview_entry = entry->modelview_entry;
+        }
+
+      if (entry->instanced)
+        {
+          size_t stride =
+            GET_JOURNAL_INSTANCE_STRIDE_FOR_N_LAYERS (entry->n_layers);
+
+          if (out)
+            {
+              expand_instance (entry, vin, &modelview, (float *) out);
+              out += stride * 4;
+            }
+          continue;
+        }
+
+      if (entry->n_primitive_vertices)
+        {
+          int n_vertices = get_entry_n_vertices (entry);
+
+          array_stride =
+            GET_JOURNAL_PRIMITIVE_ARRAY_STRIDE_FOR_N_LAYERS (entry->n_layers);
+
+          for (i = 0;
+               i < entry->n_primitive_vertices;
+               i += COMPACT_PRIMITIVE_CHUNK)
+            {
+              int n_chunk = MIN (COMPACT_PRIMITIVE_CHUNK,
+                                 entry->n_primitive_vertices - i);
+
+              cogl_matrix_transform_points (&modelview,
+                                            3, /* n_components */
+                                            array_stride * sizeof (float),
+                                            vin + array_stride * i,
+                                            sizeof (float) * 3,
+                                            pos, /* points_out */
+                                            n_chunk);
+
+              for (j = 0; j < n_chunk; j++)
+                {
+                  const float *v = vin + array_stride * (i + j);
+                  uint16_t *tout =
+                    (out ?
+                     (uint16_t *) (out + (COMPACT_POS_STRIDE +
+                                          COLOR_STRIDE) * 4) :
+                     NULL);
+
+                  if (!pack_compact_position (pos + j * 3, out))
+                    return FALSE;
+
+                  for (k = 0; k < entry->n_layers * 2; k++)
+                    if (!pack_compact_tex_coord (v[4 + k],
+                                                 tout ? tout + k : NULL))
+                      return FALSE;
+
+                  if (out)
+                    {
+                      memcpy (out + COMPACT_POS_STRIDE * 4, v + 3, 4);
+                      out += compact_stride * 4;
+                    }
+                }
+            }
+
+          /* Fill the padding with degenerate triangles */
+          if (out)
+            {
+              memset (out,
+                      0,
+                      (n_vertices - entry->n_primitive_vertices) *
+                      compact_stride * 4);
+              out += ((n_vertices - entry->n_primitive_vertices) *
+                      compact_stride * 4);
+            }
+          continue;
+        }
+
+      array_stride = GET_JOURNAL_ARRAY_STRIDE_FOR_N_LAYERS (entry->n_layers);
+
+      /* The texture coordinates are shared between the corners so
+       * they only need to be checked once */
+      for (i = 0; i < entry->n_layers * 2; i++)
+        if (!pack_compact_tex_coord (vin[1 + 2 + i], NULL) ||
+            !pack_compact_tex_coord (vin[1 + array_stride + 2 + i], NULL))
+          return FALSE;
+
+      /* The corners are in the same order as in expand_vertices() */
+      corners[0] = vin[1];
+      corners[1] = vin[2];
+      corners[2] = vin[1];
+      corners[3] = vin[array_stride + 2];
+      corners[4] = vin[array_stride + 1];
+      corners[5] = vin[array_stride + 2];
+      corners[6] = vin[array_stride + 1];
+      corners[7] = vin[2];
+
+      cogl_matrix_transform_points (&modelview,
+                                    2, /* n_components */
+                                    sizeof (float) * 2, /* stride_in */
+                                    corners, /* points_in */
+                                    sizeof (float) * 3, /* stride_out */
+                                    pos, /* points_out */
+                                    4 /* n_points */);
+
+      for (i = 0; i < 4; i++)
+        {
+          const float *tin = vin + 1 + 2;
+
+          if (!pack_compact_position (pos + i * 3,
+                                      out ? out + compact_stride * 4 * i :
+                                      NULL))
+            return FALSE;
+
+          if (out)
+            {
+              uint16_t *tout =
+                (uint16_t *) (out + compact_stride * 4 * i +
+                              (COMPACT_POS_STRIDE + COLOR_STRIDE) * 4);
+
+              memcpy (out + compact_stride * 4 * i + COMPACT_POS_STRIDE * 4,
+                      vin, 4);
+
+              for (j = 0; j < entry->n_layers; j++)
+                {
+                  /* The first two corners use the left edge and the
+                   * first and last corners use the top edge */
+                  pack_compact_tex_coord (tin[(i < 2 ? 0 : array_stride) +
+                                              j * 2],
+                                          tout + j * 2);
+                  pack_compact_tex_coord (tin[(i == 0 || i == 3 ?
+                                               0 : array_stride) +
+                                              j * 2 + 1],
+                                          tout + j * 2 + 1);
+                }
+            }
+        }
+
+      if (out)
+        out += compact_stride * 4 * 4;
+    }
+
+  return TRUE;
+}
+
+/* Allocates space for the vertices from the context's stream buffer
+ * and maps it */
+static CoglAttributeBuffer *
+create_and_map_attribute_buffer (CoglJournal *journal,
+                                 size_t n_bytes,
+                                 size_t *offset,
+                                 void **data)
+{
+  CoglContext *ctx = journal->framebuffer->context;
+  CoglAttributeBuffer *attribute_buffer;
+
+  *data = _cogl_stream_buffer_map (ctx->stream_buffer,
+                                   n_bytes,
+                                   &attribute_buffer,
+                                   offset);
+
+  return attribute_buffer;
+}
+
+/* Uploads the vertices for all of the entries. If @compact_vbo_len is
+ * non-zero then the vertices will be stored in the compact format
+ * when they fit and @compact_vertices will be set to TRUE. The
+ * offset of the vertices within the returned buffer is stored in
+ * @offset */
+static CoglAttributeBuffer *
+upload_vertices (CoglJournal *journal,
+                 const CoglJournalEntry *entries,
+                 int n_entries,
+                 size_t needed_vbo_len,
+                 size_t compact_vbo_len,
+                 GArray *vertices,
+                 size_t *offset,
+                 CoglBool *compact_vertices)
+{
+  CoglContext *ctx = journal->framebuffer->context;
+  CoglAttributeBuffer *attribute_buffer;
+  void *data;
+
+  g_assert (needed_vbo_len);
+
+  /* Checking the vertices only transforms the positions and it stops
+   * at the first one that doesn't fit, so it's cheaper than
+   * expanding everything to a temporary array. Either way the
+   * vertices are then written straight into the mapped buffer */
+  *compact_vertices = (compact_vbo_len > 0 &&
+                       write_compact_vertices (entries,
+                                               n_entries,
+                                               vertices,
+                                               NULL));
+
+  if (*compact_vertices)
+    {
+      attribute_buffer = create_and_map_attribute_buffer (journal,
+                                                          compact_vbo_len * 4,
+                                                          offset,
+                                                          &data);
+      write_compact_vertices (entries, n_entries, vertices, data);
+    }
+  else
+    {
+      attribute_buffer = create_and_map_attribute_buffer (journal,
+                                                          needed_vbo_len * 4,
+                                                          offset,
+                                                          &data);
+      expand_vertices (entries, n_entries, vertices, data);
+    }
+
+  _cogl_stream_buffer_unmap (ctx->stream_buffer);
+
+  return attribute_buffer;
+}
+
+void
+_cogl_journal_discard (CoglJournal *journal)
+{
+  int i;
+
+  if (journal->entries->len <= 0)
+    return;
+
+  for (i = 0; i < journal->entries->len; i++)
     {
       CoglJournalEntry *entry =
         &g_array_index (journal->entries, CoglJournalEntry, i);
@@ -1193,7 +2737,6 @@ _cogl_journal_discard (CoglJournal *journal)
 
   g_array_set_size (journal->entries, 0);
   g_array_set_size (journal->vertices, 0);
-  journal->needed_vbo_len = 0;
   journal->fast_read_pixel_count = 0;
 
   /* The journal only holds a reference to the framebuffer while the
@@ -1291,6 +2834,8 @@ _cogl_journal_flush (CoglJournal *journal)
   CoglFramebuffer *framebuffer;
   CoglContext *ctx;
   CoglJournalFlushState state;
+  size_t needed_vbo_len;
+  size_t compact_vbo_len;
   int i;
   COGL_STATIC_TIMER (flush_timer,
                      "Mainloop", /* parent */
@@ -1356,15 +2901,35 @@ _cogl_journal_flush (CoglJournal *journal)
                       &state); /* data */
     }
 
+  /* Culling needs to happen after the clip stack pass because the
+     software clipping can make more entries share the same clip
+     stack */
+  if (G_LIKELY (!COGL_DEBUG_ENABLED (COGL_DEBUG_DISABLE_OVERDRAW_CULLING)) &&
+      !COGL_DEBUG_ENABLED (COGL_DEBUG_WIREFRAME) &&
+      !COGL_DEBUG_ENABLED (COGL_DEBUG_RECTANGLES))
+    cull_overdrawn_entries (journal);
+
+  /* This needs to happen before reordering so that instanced and
+     expanded rectangles aren't considered to be in the same batch */
+  needed_vbo_len = prepare_entries (journal, &compact_vbo_len);
+
+  /* Moving entries past each other relies on the clip stack pass
+     having already happened because that can make more entries share
+     the same clip stack */
+  if (G_LIKELY (!COGL_DEBUG_ENABLED (COGL_DEBUG_DISABLE_JOURNAL_REORDER)))
+    reorder_entries (journal);
+
   /* We upload the vertices after the clip stack pass in case it
      modifies the entries */
   state.attribute_buffer =
     upload_vertices (journal,
                      &g_array_index (journal->entries, CoglJournalEntry, 0),
                      journal->entries->len,
-                     journal->needed_vbo_len,
-                     journal->vertices);
-  state.array_offset = 0;
+                     needed_vbo_len,
+                     compact_vbo_len,
+                     journal->vertices,
+                     &state.array_offset,
+                     &state.compact_vertices);
 
   /* batch_and_call() batches a list of journal entries according to some
    * given criteria and calls a callback once for each determined batch.
@@ -1375,8 +2940,9 @@ _cogl_journal_flush (CoglJournal *journal)
    * 2) We split the entries according to the stride of the vertices:
    *      Each time the stride of our vertex data changes we need to call
    *      gl{Vertex,Color}Pointer to inform GL of new VBO offsets.
-   *      Currently the only thing that affects the stride of our vertex data
-   *      is the number of pipeline layers.
+   *      Currently the only things that affect the stride of our vertex
+   *      data are the number of pipeline layers and whether the entries
+   *      are uploaded as instance records.
    * 3) We split the entries explicitly by the number of pipeline layers:
    *      We pad our vertex data when the number of layers is < 2 so that we
    *      can minimize changes in stride. Each time the number of layers
@@ -1480,11 +3046,6 @@ _cogl_journal_log_quad (CoglJournal  *journal,
   g_array_set_size (journal->vertices, next_vert + 2 * stride + 1);
   v = &g_array_index (journal->vertices, float, next_vert);
 
-  /* We calculate the needed size of the vbo as we go because it
-     depends on the number of layers in each entry and it's not easy
-     calculate based on the length of the logged vertices array */
-  journal->needed_vbo_len += GET_JOURNAL_VB_STRIDE_FOR_N_LAYERS (n_layers) * 4;
-
   /* XXX: All the jumping around to fill in this strided buffer doesn't
    * seem ideal. */
 
@@ -1519,6 +3080,7 @@ _cogl_journal_log_quad (CoglJournal  *journal,
 
   entry->n_layers = n_layers;
   entry->array_offset = next_vert;
+  entry->n_primitive_vertices = 0;
 
   final_pipeline = pipeline;
 
@@ -1564,6 +3126,435 @@ _cogl_journal_log_quad (CoglJournal  *journal,
   COGL_TIMER_STOP (_cogl_uprof_context, log_timer);
 }
 
+typedef struct _PrimitiveAttributeData
+{
+  const uint8_t *data;
+  size_t stride;
+  int n_components;
+} PrimitiveAttributeData;
+
+typedef struct _ValidatePrimitiveLayerState
+{
+  int *layer_indices;
+  int n_layers;
+  CoglBool valid;
+} ValidatePrimitiveLayerState;
+
+static CoglBool
+validate_primitive_layer_cb (CoglPipeline *pipeline,
+                             int layer_index,
+                             void *user_data)
+{
+  ValidatePrimitiveLayerState *state = user_data;
+  CoglTexture *texture =
+    cogl_pipeline_get_layer_texture (pipeline, layer_index);
+
+  state->layer_indices[state->n_layers++] = layer_index;
+
+  if (texture == NULL)
+    return TRUE;
+
+  /* This mirrors validate_layer_cb() in cogl-attribute.c except that
+   * instead of disabling layers that can't be repeated in hardware we
+   * give up and let the primitive be drawn directly */
+  _cogl_texture_flush_journal_rendering (texture);
+  _cogl_texture_ensure_non_quad_rendering (texture);
+  _cogl_pipeline_pre_paint_for_layer (pipeline, layer_index);
+
+  if (!_cogl_texture_can_hardware_repeat (texture))
+    {
+      state->valid = FALSE;
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static CoglBool
+get_primitive_attribute_data (CoglAttribute *attribute,
+                              int max_vertex,
+                              PrimitiveAttributeData *data_out)
+{
+  CoglBuffer *buffer = COGL_BUFFER (attribute->d.buffered.attribute_buffer);
+  const uint8_t *data = _cogl_buffer_get_cpu_data (buffer);
+  size_t element_size;
+  size_t stride;
+
+  if (data == NULL)
+    return FALSE;
+
+  if (attribute->d.buffered.type == COGL_ATTRIBUTE_TYPE_FLOAT)
+    element_size = attribute->d.buffered.n_components * sizeof (float);
+  else
+    element_size = attribute->d.buffered.n_components;
+
+  stride = attribute->d.buffered.stride;
+  if (stride == 0)
+    stride = element_size;
+
+  if (attribute->d.buffered.offset + stride * max_vertex + element_size >
+      buffer->size)
+    return FALSE;
+
+  data_out->data = data + attribute->d.buffered.offset;
+  data_out->stride = stride;
+  data_out->n_components = attribute->d.buffered.n_components;
+
+  return TRUE;
+}
+
+static CoglBool
+get_primitive_vertex_indices (CoglIndices *indices,
+                              int first_vertex,
+                              int n_vertices,
+                              int *vertex_indices)
+{
+  CoglBuffer *buffer;
+  const uint8_t *data;
+  size_t index_size;
+  int i;
+
+  if (indices == NULL)
+    {
+      for (i = 0; i < n_vertices; i++)
+        vertex_indices[i] = first_vertex + i;
+      return TRUE;
+    }
+
+  buffer = COGL_BUFFER (indices->buffer);
+  data = _cogl_buffer_get_cpu_data (buffer);
+
+  if (data == NULL)
+    return FALSE;
+
+  switch (indices->type)
+    {
+    case COGL_INDICES_TYPE_UNSIGNED_BYTE:
+      index_size = 1;
+      break;
+    case COGL_INDICES_TYPE_UNSIGNED_SHORT:
+      index_size = 2;
+      break;
+    case COGL_INDICES_TYPE_UNSIGNED_INT:
+      index_size = 4;
+      break;
+    default:
+      return FALSE;
+    }
+
+  if (indices->offset + (first_vertex + n_vertices) * index_size >
+      buffer->size)
+    return FALSE;
+
+  data += indices->offset + first_vertex * index_size;
+
+  for (i = 0; i < n_vertices; i++)
+    {
+      switch (indices->type)
+        {
+        case COGL_INDICES_TYPE_UNSIGNED_BYTE:
+          vertex_indices[i] = data[i];
+          break;
+        case COGL_INDICES_TYPE_UNSIGNED_SHORT:
+          {
+            uint16_t index;
+            memcpy (&index, data + i * 2, sizeof (index));
+            vertex_indices[i] = index;
+          }
+          break;
+        case COGL_INDICES_TYPE_UNSIGNED_INT:
+          {
+            uint32_t index;
+            memcpy (&index, data + i * 4, sizeof (index));
+            if (index > G_MAXINT)
+              return FALSE;
+            vertex_indices[i] = index;
+          }
+          break;
+        }
+    }
+
+  return TRUE;
+}
+
+/* Tries to log a primitive to the journal by converting it to a list
+ * of triangles. This is only done for small primitives using the
+ * builtin position, color and texture coordinate attributes where we
+ * can read the vertex data without mapping any buffers. Otherwise
+ * FALSE is returned and the caller should draw the primitive
+ * directly */
+CoglBool
+_cogl_journal_log_primitive (CoglJournal *journal,
+                             CoglPipeline *pipeline,
+                             CoglVerticesMode mode,
+                             int first_vertex,
+                             int n_vertices,
+                             CoglIndices *indices,
+                             CoglAttribute **attributes,
+                             int n_attributes,
+                             CoglDrawFlags flags)
+{
+  CoglFramebuffer *framebuffer = journal->framebuffer;
+  CoglContext *ctx = framebuffer->context;
+  int *vertex_indices;
+  int *triangle_indices;
+  int n_triangle_vertices;
+  int max_vertex;
+  PrimitiveAttributeData position;
+  PrimitiveAttributeData color;
+  PrimitiveAttributeData *tex_coords;
+  int *tex_coord_layers;
+  int n_tex_coords;
+  CoglBool has_position = FALSE;
+  CoglBool has_color = FALSE;
+  ValidatePrimitiveLayerState layer_state;
+  int n_layers;
+  uint8_t pipeline_color[4];
+  size_t stride;
+  int next_vert;
+  float *v;
+  int next_entry;
+  CoglJournalEntry *entry;
+  CoglClipStack *clip_stack;
+  CoglMatrixStack *modelview_stack;
+  int i, j;
+  COGL_STATIC_TIMER (log_timer,
+                     "Mainloop", /* parent */
+                     "Journal Log Primitive",
+                     "The time spent logging primitives in the Cogl journal",
+                     0 /* no application private data */);
+
+  /* If the caller is managing the framebuffer state itself or if the
+   * primitive is being drawn by the journal then we can't defer it */
+  if (flags & (COGL_DRAW_SKIP_JOURNAL_FLUSH |
+               COGL_DRAW_SKIP_PIPELINE_VALIDATION |
+               COGL_DRAW_SKIP_FRAMEBUFFER_FLUSH))
+    return FALSE;
+
+  if (!(flags & COGL_DRAW_SKIP_LEGACY_STATE) &&
+      ctx->legacy_state_set &&
+      _cogl_get_enable_legacy_state ())
+    return FALSE;
+
+  if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_DISABLE_SOFTWARE_TRANSFORM)))
+    return FALSE;
+
+  if (n_vertices < 3 || n_vertices > COGL_JOURNAL_PRIMITIVE_MAX_VERTICES)
+    return FALSE;
+
+  switch (mode)
+    {
+    case COGL_VERTICES_MODE_TRIANGLES:
+      n_triangle_vertices = n_vertices / 3 * 3;
+      break;
+    case COGL_VERTICES_MODE_TRIANGLE_FAN:
+    case COGL_VERTICES_MODE_TRIANGLE_STRIP:
+      n_triangle_vertices = (n_vertices - 2) * 3;
+      break;
+    default:
+      return FALSE;
+    }
+
+  vertex_indices = g_alloca (sizeof (int) * n_vertices);
+  if (!get_primitive_vertex_indices (indices,
+                                     first_vertex,
+                                     n_vertices,
+                                     vertex_indices))
+    return FALSE;
+
+  max_vertex = 0;
+  for (i = 0; i < n_vertices; i++)
+    max_vertex = MAX (max_vertex, vertex_indices[i]);
+
+  /* Expand the primitive into a list of triangles. The order of the
+   * vertices in a strip is swapped for every other triangle so that
+   * the winding stays consistent for backface culling */
+  triangle_indices = g_alloca (sizeof (int) * n_triangle_vertices);
+  for (i = 0; i < n_triangle_vertices / 3; i++)
+    {
+      int *t = triangle_indices + i * 3;
+
+      switch (mode)
+        {
+        case COGL_VERTICES_MODE_TRIANGLE_FAN:
+          t[0] = vertex_indices[0];
+          t[1] = vertex_indices[i + 1];
+          t[2] = vertex_indices[i + 2];
+          break;
+        case COGL_VERTICES_MODE_TRIANGLE_STRIP:
+          t[0] = vertex_indices[i + (i & 1)];
+          t[1] = vertex_indices[i + 1 - (i & 1)];
+          t[2] = vertex_indices[i + 2];
+          break;
+        default:
+          t[0] = vertex_indices[i * 3];
+          t[1] = vertex_indices[i * 3 + 1];
+          t[2] = vertex_indices[i * 3 + 2];
+          break;
+        }
+    }
+
+  tex_coords = g_alloca (sizeof (PrimitiveAttributeData) * n_attributes);
+  tex_coord_layers = g_alloca (sizeof (int) * n_attributes);
+  n_tex_coords = 0;
+
+  for (i = 0; i < n_attributes; i++)
+    {
+      CoglAttribute *attribute = attributes[i];
+
+      if (!attribute->is_buffered)
+        return FALSE;
+
+      switch (attribute->name_state->name_id)
+        {
+        case COGL_ATTRIBUTE_NAME_ID_POSITION_ARRAY:
+          if (has_position ||
+              attribute->d.buffered.type != COGL_ATTRIBUTE_TYPE_FLOAT ||
+              attribute->d.buffered.n_components < 2 ||
+              attribute->d.buffered.n_components > 3 ||
+              !get_primitive_attribute_data (attribute, max_vertex, &position))
+            return FALSE;
+          has_position = TRUE;
+          break;
+
+        case COGL_ATTRIBUTE_NAME_ID_COLOR_ARRAY:
+          if (has_color ||
+              attribute->d.buffered.type !=
+              COGL_ATTRIBUTE_TYPE_UNSIGNED_BYTE ||
+              attribute->d.buffered.n_components != 4 ||
+              !get_primitive_attribute_data (attribute, max_vertex, &color))
+            return FALSE;
+          has_color = TRUE;
+          break;
+
+        case COGL_ATTRIBUTE_NAME_ID_TEXTURE_COORD_ARRAY:
+          if (attribute->d.buffered.type != COGL_ATTRIBUTE_TYPE_FLOAT ||
+              attribute->d.buffered.n_components != 2 ||
+              !get_primitive_attribute_data (attribute,
+                                             max_vertex,
+                                             tex_coords + n_tex_coords))
+            return FALSE;
+          tex_coord_layers[n_tex_coords++] =
+            attribute->name_state->layer_number;
+          break;
+
+        default:
+          return FALSE;
+        }
+    }
+
+  if (!has_position)
+    return FALSE;
+
+  /* The journal tells GL that its color array is opaque whenever the
+   * pipeline doesn't need blending so we can only accept per-vertex
+   * colors that don't change that */
+  if (has_color)
+    for (i = 0; i < n_vertices; i++)
+      if (color.data[color.stride * vertex_indices[i] + 3] != 0xff)
+        return FALSE;
+
+  n_layers = cogl_pipeline_get_n_layers (pipeline);
+  layer_state.layer_indices = g_alloca (sizeof (int) * MAX (n_layers, 1));
+  layer_state.n_layers = 0;
+  layer_state.valid = TRUE;
+  cogl_pipeline_foreach_layer (pipeline,
+                               validate_primitive_layer_cb,
+                               &layer_state);
+  if (!layer_state.valid)
+    return FALSE;
+
+  COGL_TIMER_START (_cogl_uprof_context, log_timer);
+
+  _cogl_framebuffer_mark_mid_scene (framebuffer);
+
+  /* If the framebuffer was previously empty then we'll take a
+     reference to the current framebuffer. This reference will be
+     removed when the journal is flushed */
+  if (journal->vertices->len == 0)
+    cogl_object_ref (framebuffer);
+
+  stride = GET_JOURNAL_PRIMITIVE_ARRAY_STRIDE_FOR_N_LAYERS (n_layers);
+
+  next_vert = journal->vertices->len;
+  g_array_set_size (journal->vertices,
+                    next_vert + stride * n_triangle_vertices);
+  v = &g_array_index (journal->vertices, float, next_vert);
+
+  _cogl_pipeline_get_colorubv (pipeline, pipeline_color);
+
+  for (i = 0; i < n_triangle_vertices; i++)
+    {
+      int vertex = triangle_indices[i];
+      const uint8_t *p = position.data + position.stride * vertex;
+
+      /* XXX: See definition of
+       * GET_JOURNAL_PRIMITIVE_ARRAY_STRIDE_FOR_N_LAYERS for details
+       * about how we pack our vertex data */
+      v[2] = 0.0f;
+      memcpy (v, p, sizeof (float) * position.n_components);
+
+      if (has_color)
+        memcpy (v + 3, color.data + color.stride * vertex, 4);
+      else
+        memcpy (v + 3, pipeline_color, 4);
+
+      for (j = 0; j < n_layers; j++)
+        {
+          float *t = v + 4 + j * 2;
+          int k;
+
+          /* GL uses (0, 0) for layers without a texture coordinate
+           * array */
+          t[0] = 0.0f;
+          t[1] = 0.0f;
+
+          for (k = 0; k < n_tex_coords; k++)
+            if (tex_coord_layers[k] == layer_state.layer_indices[j])
+              {
+                memcpy (t,
+                        tex_coords[k].data + tex_coords[k].stride * vertex,
+                        sizeof (float) * 2);
+                break;
+              }
+        }
+
+      v += stride;
+    }
+
+  next_entry = journal->entries->len;
+  g_array_set_size (journal->entries, next_entry + 1);
+  entry = &g_array_index (journal->entries, CoglJournalEntry, next_entry);
+
+  entry->n_layers = n_layers;
+  entry->array_offset = next_vert;
+  entry->n_primitive_vertices = n_triangle_vertices;
+
+  if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_JOURNAL)))
+    g_print ("Logged new primitive: n_layers = %d, n_vertices = %d\n",
+             n_layers, n_triangle_vertices);
+
+  entry->pipeline = _cogl_pipeline_journal_ref (pipeline);
+
+  clip_stack = _cogl_framebuffer_get_clip_stack (framebuffer);
+  entry->clip_stack = _cogl_clip_stack_ref (clip_stack);
+
+  modelview_stack =
+    _cogl_framebuffer_get_modelview_stack (framebuffer);
+  entry->modelview_entry = cogl_matrix_entry_ref (modelview_stack->last_entry);
+
+  _cogl_pipeline_foreach_layer_internal (pipeline,
+                                         add_framebuffer_deps_cb,
+                                         framebuffer);
+
+  if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_DISABLE_BATCHING)))
+    _cogl_journal_flush (journal);
+
+  COGL_TIMER_STOP (_cogl_uprof_context, log_timer);
+
+  return TRUE;
+}
+
 static void
 entry_to_screen_polygon (CoglFramebuffer *framebuffer,
                          const CoglJournalEntry *entry,
@@ -1782,6 +3773,10 @@ _cogl_journal_try_read_pixel (CoglJournal *journal,
       uint8_t *pixel;
       CoglError *ignore_error;
 
+      /* We don't try to hit test primitives */
+      if (entry->n_primitive_vertices)
+        return FALSE;
+
       entry_to_screen_polygon (framebuffer, entry, vertices, poly);
 
       if (!_cogl_util_point_in_screen_poly (x, y, poly, sizeof (float) * 4, 4))
@@ -302,6 +302,8 @@ cogl_onscreen_swap_buffers_with_damage (CoglOnscreen *onscreen,
 
   onscreen->frame_counter++;
   framebuffer->mid_scene = FALSE;
+
+  _cogl_upload_ring_trim (framebuffer->context->upload_ring);
 }
 
 void
@@ -359,6 +361,8 @@ cogl_onscreen_swap_region (CoglOnscreen *onscreen,
 
   onscreen->frame_counter++;
   framebuffer->mid_scene = FALSE;
+
+  _cogl_upload_ring_trim (framebuffer->context->upload_ring);
 }
 
 int
@@ -33,16 +33,24 @@
 #include "cogl-pipeline-private.h"
 #include "cogl-pipeline-cache.h"
 #include "cogl-pipeline-hash-table.h"
+#include "cogl-pipeline-manifest-private.h"
+
+#include <string.h>
 
 struct _CoglPipelineCache
 {
   CoglPipelineHashTable fragment_hash;
   CoglPipelineHashTable vertex_hash;
   CoglPipelineHashTable combined_hash;
+
+  /* Records the state of every program that has been generated
+   * since the application first saved or loaded a manifest. This is
+   * NULL until then */
+  CoglPipelineManifest *manifest;
 };
 
 CoglPipelineCache *
-_cogl_pipeline_cache_new (void)
+_cogl_pipeline_cache_new (int max_entries)
 {
   CoglPipelineCache *cache = g_new (CoglPipelineCache, 1);
   unsigned long vertex_state;
@@ -64,16 +72,21 @@ _cogl_pipeline_cache_new (void)
   _cogl_pipeline_hash_table_init (&cache->vertex_hash,
                                   vertex_state,
                                   layer_vertex_state,
+                                  max_entries,
                                   "vertex shaders");
   _cogl_pipeline_hash_table_init (&cache->fragment_hash,
                                   fragment_state,
                                   layer_fragment_state,
+                                  max_entries,
                                   "fragment shaders");
   _cogl_pipeline_hash_table_init (&cache->combined_hash,
                                   vertex_state | fragment_state,
                                   layer_vertex_state | layer_fragment_state,
+                                  max_entries,
                                   "programs");
 
+  cache->manifest = NULL;
+
   return cache;
 }
 
@@ -83,6 +96,8 @@ _cogl_pipeline_cache_free (CoglPipelineCache *cache)
   _cogl_pipeline_hash_table_destroy (&cache->fragment_hash);
   _cogl_pipeline_hash_table_destroy (&cache->vertex_hash);
   _cogl_pipeline_hash_table_destroy (&cache->combined_hash);
+  if (cache->manifest)
+    _cogl_pipeline_manifest_free (cache->manifest);
   g_free (cache);
 }
 
@@ -106,6 +121,62 @@ CoglPipeline *
 _cogl_pipeline_cache_get_combined_template (CoglPipelineCache *cache,
                                             CoglPipeline *key_pipeline)
 {
-  return _cogl_pipeline_hash_table_get (&cache->combined_hash,
-                                        key_pipeline);
+  unsigned long n_misses = cache->combined_hash.n_misses;
+  CoglPipeline *template =
+    _cogl_pipeline_hash_table_get (&cache->combined_hash,
+                                   key_pipeline);
+
+  /* A miss means a new program is about to be generated so remember
+   * its state in case the application wants to save a manifest */
+  if (cache->manifest && cache->combined_hash.n_misses != n_misses)
+    _cogl_pipeline_manifest_add (cache->manifest, template);
+
+  return template;
+}
+
+static void
+add_template_to_manifest_cb (CoglPipeline *template,
+                             void *user_data)
+{
+  _cogl_pipeline_manifest_add (user_data, template);
+}
+
+CoglPipelineManifest *
+_cogl_pipeline_cache_get_manifest (CoglPipelineCache *cache)
+{
+  /* Recording only starts the first time the manifest is needed so
+   * that applications which never use it don't pay for serializing
+   * every program. The programs that are still in the cache are
+   * added straight away so that saving a manifest at the end of the
+   * first session still finds them */
+  if (cache->manifest == NULL)
+    {
+      cache->manifest = _cogl_pipeline_manifest_new ();
+      _cogl_pipeline_hash_table_foreach (&cache->combined_hash,
+                                         add_template_to_manifest_cb,
+                                         cache->manifest);
+    }
+
+  return cache->manifest;
+}
+
+static void
+add_hash_table_stats (CoglPipelineHashTable *hash,
+                      CoglPipelineCacheStats *stats)
+{
+  stats->n_entries += hash->n_entries;
+  stats->n_hits += hash->n_hits;
+  stats->n_misses += hash->n_misses;
+  stats->n_evictions += hash->n_evictions;
+}
+
+void
+_cogl_pipeline_cache_get_stats (CoglPipelineCache *cache,
+                                CoglPipelineCacheStats *stats)
+{
+  memset (stats, 0, sizeof (CoglPipelineCacheStats));
+
+  add_hash_table_stats (&cache->fragment_hash, stats);
+  add_hash_table_stats (&cache->vertex_hash, stats);
+  add_hash_table_stats (&cache->combined_hash, stats);
 }
@@ -25,11 +25,24 @@
 #define __COGL_PIPELINE_CACHE_H__
 
 #include "cogl-pipeline.h"
+#include "cogl-pipeline-manifest-private.h"
 
 typedef struct _CoglPipelineCache CoglPipelineCache;
 
+typedef struct
+{
+  int n_entries;
+  unsigned long n_hits;
+  unsigned long n_misses;
+  unsigned long n_evictions;
+} CoglPipelineCacheStats;
+
+/*
+ * @max_entries: The maximum number of templates to keep in each of
+ *   the caches or 0 to let them grow without bound.
+ */
 CoglPipelineCache *
-_cogl_pipeline_cache_new (void);
+_cogl_pipeline_cache_new (int max_entries);
 
 void
 _cogl_pipeline_cache_free (CoglPipelineCache *cache);
@@ -74,4 +87,18 @@ CoglPipeline *
 _cogl_pipeline_cache_get_combined_template (CoglPipelineCache *cache,
                                             CoglPipeline *key_pipeline);
 
+/*
+ * Gets the manifest that records the state of every pipeline that
+ * has been added to the combined cache.
+ */
+CoglPipelineManifest *
+_cogl_pipeline_cache_get_manifest (CoglPipelineCache *cache);
+
+/*
+ * Sums the statistics of all of the caches into @stats.
+ */
+void
+_cogl_pipeline_cache_get_stats (CoglPipelineCache *cache,
+                                CoglPipelineCacheStats *stats);
+
 #endif /* __COGL_PIPELINE_CACHE_H__ */
@@ -33,6 +33,8 @@
 #include "cogl-pipeline-private.h"
 #include "cogl-pipeline-hash-table.h"
 
+#include <test-fixtures/test-unit.h>
+
 typedef struct
 {
   /* The template pipeline */
@@ -49,13 +51,53 @@ typedef struct
    * store the pointer in every hash table entry. We will use this
    * entry as both the key and the value */
   CoglPipelineHashTable *hash;
+
+  /* Link in the hash table's LRU list */
+  CoglList lru_link;
 } CoglPipelineHashTableEntry;
 
+/* The number of different hash tables that a pipeline can remember
+ * its lookup results for. Each pipeline is usually looked up in at
+ * most the vertex, fragment and combined caches */
+#define COGL_PIPELINE_HASH_TABLE_N_MEMO_SLOTS 3
+
+typedef struct
+{
+  /* The id of the hash table that this slot is for */
+  unsigned int hash_id;
+
+  /* The age of the pipeline when the hash value was calculated */
+  unsigned int age;
+  unsigned int hash_value;
+
+  /* The entry that the pipeline matched. This is only valid if the
+   * generation of the hash table hasn't changed since */
+  unsigned int generation;
+  CoglPipelineHashTableEntry *entry;
+} CoglPipelineHashTableMemoSlot;
+
+/* This is attached to key pipelines so that a pipeline which is
+ * looked up repeatedly without being modified doesn't have to be
+ * hashed and compared again each time */
+typedef struct
+{
+  CoglPipelineHashTableMemoSlot slots[COGL_PIPELINE_HASH_TABLE_N_MEMO_SLOTS];
+  int next_slot;
+} CoglPipelineHashTableMemo;
+
+static CoglUserDataKey memo_key;
+
+/* This starts at 1 so that a zeroed memo slot never matches a table */
+static unsigned int next_generation = 1;
+
 static void
 value_destroy_cb (void *value)
 {
   CoglPipelineHashTableEntry *entry = value;
 
+  _cogl_list_remove (&entry->lru_link);
+  entry->hash->n_entries--;
+
   cogl_object_unref (entry->pipeline);
 
   g_slice_free (CoglPipelineHashTableEntry, entry);
@@ -88,12 +130,21 @@ void
 _cogl_pipeline_hash_table_init (CoglPipelineHashTable *hash,
                                 unsigned int main_state,
                                 unsigned int layer_state,
+                                int max_entries,
                                 const char *debug_string)
 {
   hash->n_unique_pipelines = 0;
   hash->debug_string = debug_string;
   hash->main_state = main_state;
   hash->layer_state = layer_state;
+  hash->max_entries = MAX (max_entries, 0);
+  hash->n_entries = 0;
+  hash->n_hits = 0;
+  hash->n_misses = 0;
+  hash->n_evictions = 0;
+  _cogl_list_init (&hash->lru_list);
+  hash->id = next_generation++;
+  hash->generation = hash->id;
   hash->table = g_hash_table_new_full (entry_hash,
                                        entry_equal,
                                        NULL, /* key destroy */
@@ -106,33 +157,134 @@ _cogl_pipeline_hash_table_destroy (CoglPipelineHashTable *hash)
   g_hash_table_destroy (hash->table);
 }
 
+static void
+evict_least_recently_used (CoglPipelineHashTable *hash)
+{
+  CoglPipelineHashTableEntry *entry;
+
+  entry = _cogl_container_of (hash->lru_list.prev, entry, lru_link);
+
+  COGL_NOTE (PERFORMANCE,
+             "Evicting one of the %i cached %s to make room for a new one",
+             hash->n_entries,
+             hash->debug_string);
+
+  /* This will drop the cache's reference on the template pipeline.
+   * Any pipelines that are already sharing its program will keep
+   * their own reference to it */
+  g_hash_table_remove (hash->table, entry);
+  hash->generation = next_generation++;
+
+  hash->n_evictions++;
+}
+
+static void
+destroy_memo_cb (void *user_data,
+                 void *instance)
+{
+  g_slice_free (CoglPipelineHashTableMemo, user_data);
+}
+
+static CoglPipelineHashTableMemoSlot *
+get_memo_slot (CoglPipelineHashTable *hash,
+               CoglPipeline *pipeline)
+{
+  CoglPipelineHashTableMemo *memo =
+    cogl_object_get_user_data (COGL_OBJECT (pipeline), &memo_key);
+  CoglPipelineHashTableMemoSlot *slot;
+  int i;
+
+  if (memo == NULL)
+    {
+      memo = g_slice_new0 (CoglPipelineHashTableMemo);
+      _cogl_object_set_user_data (COGL_OBJECT (pipeline),
+                                  &memo_key,
+                                  memo,
+                                  destroy_memo_cb);
+    }
+
+  for (i = 0; i < COGL_PIPELINE_HASH_TABLE_N_MEMO_SLOTS; i++)
+    if (memo->slots[i].hash_id == hash->id)
+      return memo->slots + i;
+
+  /* Replace the slots in turn if the pipeline is used with more
+   * tables than we have room for */
+  slot = memo->slots + memo->next_slot;
+  memo->next_slot = ((memo->next_slot + 1) %
+                     COGL_PIPELINE_HASH_TABLE_N_MEMO_SLOTS);
+
+  slot->hash_id = hash->id;
+  slot->entry = NULL;
+  /* Make sure the age won't match so the hash will be recalculated */
+  slot->age = pipeline->age - 1;
+
+  return slot;
+}
+
 CoglPipeline *
 _cogl_pipeline_hash_table_get (CoglPipelineHashTable *hash,
                                CoglPipeline *key_pipeline)
 {
   CoglPipelineHashTableEntry dummy_entry;
   CoglPipelineHashTableEntry *entry;
+  CoglPipelineHashTableMemoSlot *memo_slot;
   unsigned int copy_state;
 
-  dummy_entry.pipeline = key_pipeline;
-  dummy_entry.hash = hash;
-  dummy_entry.hash_value = _cogl_pipeline_hash (key_pipeline,
-                                                hash->main_state,
-                                                hash->layer_state,
-                                                0);
-  entry = g_hash_table_lookup (hash->table, &dummy_entry);
+  memo_slot = get_memo_slot (hash, key_pipeline);
+
+  /* Any modification of the pipeline increases its age so if it
+   * hasn't changed then neither has the hash value */
+  if (memo_slot->age != key_pipeline->age)
+    {
+      memo_slot->age = key_pipeline->age;
+      memo_slot->hash_value = _cogl_pipeline_hash (key_pipeline,
+                                                   hash->main_state,
+                                                   hash->layer_state,
+                                                   0);
+      memo_slot->entry = NULL;
+    }
+
+  /* If no entries have been removed since the last lookup then the
+   * entry that matched last time must still be in the table */
+  if (memo_slot->entry && memo_slot->generation == hash->generation)
+    entry = memo_slot->entry;
+  else
+    {
+      dummy_entry.pipeline = key_pipeline;
+      dummy_entry.hash = hash;
+      dummy_entry.hash_value = memo_slot->hash_value;
+      entry = g_hash_table_lookup (hash->table, &dummy_entry);
+    }
 
   if (entry)
-    return entry->pipeline;
+    {
+      hash->n_hits++;
+
+      /* Move the entry to the front of the LRU list */
+      _cogl_list_remove (&entry->lru_link);
+      _cogl_list_insert (&hash->lru_list, &entry->lru_link);
+
+      memo_slot->entry = entry;
+      memo_slot->generation = hash->generation;
+
+      return entry->pipeline;
+    }
 
-  if (hash->n_unique_pipelines == 50)
+  hash->n_misses++;
+
+  if (hash->max_entries > 0)
+    {
+      while (hash->n_entries >= hash->max_entries)
+        evict_least_recently_used (hash);
+    }
+  else if (hash->n_unique_pipelines == 50)
     g_warning ("Over 50 separate %s have been generated which is very "
                "unusual, so something is probably wrong!\n",
                hash->debug_string);
 
   entry = g_slice_new (CoglPipelineHashTableEntry);
   entry->hash = hash;
-  entry->hash_value = dummy_entry.hash_value;
+  entry->hash_value = memo_slot->hash_value;
 
   copy_state = hash->main_state;
   if (hash->layer_state)
@@ -147,7 +299,126 @@ _cogl_pipeline_hash_table_get (CoglPipelineHashTable *hash,
 
   g_hash_table_insert (hash->table, entry, entry);
 
+  _cogl_list_insert (&hash->lru_list, &entry->lru_link);
+  hash->n_entries++;
   hash->n_unique_pipelines++;
 
+  /* The generation is read after evicting any entries above so the
+   * new entry can be remembered */
+  memo_slot->entry = entry;
+  memo_slot->generation = hash->generation;
+
   return entry->pipeline;
 }
+
+void
+_cogl_pipeline_hash_table_foreach (CoglPipelineHashTable *hash,
+                                   CoglPipelineHashTableForeachFunc func,
+                                   void *user_data)
+{
+  CoglPipelineHashTableEntry *entry;
+
+  _cogl_list_for_each_reverse (entry, &hash->lru_list, lru_link)
+    func (entry->pipeline, user_data);
+}
+
+UNIT_TEST (check_pipeline_hash_table_lru,
+           0 /* no requirements */,
+           0 /* no known failures */)
+{
+  CoglPipelineHashTable hash;
+  CoglPipeline *pipelines[3];
+  CoglPipeline *templates[3];
+  int i;
+
+  _cogl_pipeline_hash_table_init (&hash,
+                                  COGL_PIPELINE_STATE_POINT_SIZE,
+                                  0, /* layer state */
+                                  2, /* max_entries */
+                                  "test pipelines");
+
+  for (i = 0; i < G_N_ELEMENTS (pipelines); i++)
+    {
+      pipelines[i] = cogl_pipeline_new (test_ctx);
+      cogl_pipeline_set_point_size (pipelines[i], i + 1);
+    }
+
+  templates[0] = _cogl_pipeline_hash_table_get (&hash, pipelines[0]);
+  templates[1] = _cogl_pipeline_hash_table_get (&hash, pipelines[1]);
+  g_assert_cmpint (hash.n_misses, ==, 2);
+
+  /* Looking up the first pipeline again should make it the most
+   * recently used so that the second one gets evicted instead */
+  g_assert (_cogl_pipeline_hash_table_get (&hash, pipelines[0]) ==
+            templates[0]);
+  g_assert_cmpint (hash.n_hits, ==, 1);
+
+  templates[2] = _cogl_pipeline_hash_table_get (&hash, pipelines[2]);
+  g_assert_cmpint (hash.n_entries, ==, 2);
+  g_assert_cmpint (hash.n_evictions, ==, 1);
+
+  g_assert (_cogl_pipeline_hash_table_get (&hash, pipelines[0]) ==
+            templates[0]);
+  g_assert (_cogl_pipeline_hash_table_get (&hash, pipelines[2]) ==
+            templates[2]);
+  g_assert_cmpint (hash.n_hits, ==, 3);
+
+  /* The second pipeline was evicted so it should need a new entry */
+  _cogl_pipeline_hash_table_get (&hash, pipelines[1]);
+  g_assert_cmpint (hash.n_misses, ==, 4);
+  g_assert_cmpint (hash.n_entries, ==, 2);
+  g_assert_cmpint (hash.n_evictions, ==, 2);
+
+  _cogl_pipeline_hash_table_destroy (&hash);
+
+  for (i = 0; i < G_N_ELEMENTS (pipelines); i++)
+    cogl_object_unref (pipelines[i]);
+}
+
+UNIT_TEST (check_pipeline_hash_table_memo,
+           0 /* no requirements */,
+           0 /* no known failures */)
+{
+  CoglPipelineHashTable hash;
+  CoglPipeline *pipeline, *other;
+  CoglPipeline *template, *other_template;
+
+  _cogl_pipeline_hash_table_init (&hash,
+                                  COGL_PIPELINE_STATE_POINT_SIZE,
+                                  0, /* layer state */
+                                  1, /* max_entries */
+                                  "test pipelines");
+
+  pipeline = cogl_pipeline_new (test_ctx);
+  cogl_pipeline_set_point_size (pipeline, 1);
+  other = cogl_pipeline_new (test_ctx);
+  cogl_pipeline_set_point_size (other, 2);
+
+  template = _cogl_pipeline_hash_table_get (&hash, pipeline);
+  g_assert (_cogl_pipeline_hash_table_get (&hash, pipeline) == template);
+  g_assert_cmpint (hash.n_hits, ==, 1);
+
+  /* Modifying the pipeline should invalidate the remembered hash */
+  cogl_pipeline_set_point_size (pipeline, 2);
+  template = _cogl_pipeline_hash_table_get (&hash, pipeline);
+  g_assert_cmpint (hash.n_misses, ==, 2);
+  g_assert_cmpfloat (cogl_pipeline_get_point_size (template), ==, 2);
+
+  /* A different pipeline with the same state should find it */
+  g_assert (_cogl_pipeline_hash_table_get (&hash, other) == template);
+
+  /* Evicting the entry must not leave the pipeline pointing at the
+   * destroyed template */
+  cogl_pipeline_set_point_size (other, 3);
+  other_template = _cogl_pipeline_hash_table_get (&hash, other);
+  g_assert_cmpint (hash.n_evictions, ==, 2);
+  g_assert_cmpfloat (cogl_pipeline_get_point_size (other_template), ==, 3);
+  template = _cogl_pipeline_hash_table_get (&hash, pipeline);
+  g_assert_cmpint (hash.n_misses, ==, 4);
+  g_assert_cmpfloat (cogl_pipeline_get_point_size (template), ==, 2);
+
+  _cogl_pipeline_hash_table_destroy (&hash);
+
+  cogl_object_unref (pipeline);
+  cogl_object_unref (other);
+}
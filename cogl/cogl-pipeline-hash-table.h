@@ -25,6 +25,7 @@
 #define __COGL_PIPELINE_HASH_H__
 
 #include "cogl-pipeline.h"
+#include "cogl-list.h"
 
 typedef struct
 {
@@ -42,6 +43,32 @@ typedef struct
   unsigned int main_state;
   unsigned int layer_state;
 
+  /* The maximum number of entries to keep in the table or 0 if the
+   * table can grow without bound. When a new entry is added to a full
+   * table the least recently used entry will be evicted */
+  int max_entries;
+  int n_entries;
+
+  /* Statistics that can be queried with
+   * cogl_get_pipeline_cache_stats() */
+  unsigned long n_hits;
+  unsigned long n_misses;
+  unsigned long n_evictions;
+
+  /* All of the entries ordered so that the most recently used is at
+   * the head of the list */
+  CoglList lru_list;
+
+  /* A number that identifies this table. This is used instead of
+   * the address of the table to decide whether a pipeline has
+   * remembered a hash value for it because the memory could be reused
+   * by a table with different state masks */
+  unsigned int id;
+  /* This is changed whenever an entry is removed from the table so
+   * that any entries remembered by the key pipelines can be
+   * invalidated. The values are unique across all tables */
+  unsigned int generation;
+
   GHashTable *table;
 } CoglPipelineHashTable;
 
@@ -49,6 +76,7 @@ void
 _cogl_pipeline_hash_table_init (CoglPipelineHashTable *hash,
                                 unsigned int main_state,
                                 unsigned int layer_state,
+                                int max_entries,
                                 const char *debug_string);
 
 void
@@ -66,4 +94,16 @@ CoglPipeline *
 _cogl_pipeline_hash_table_get (CoglPipelineHashTable *hash,
                                CoglPipeline *key_pipeline);
 
+typedef void (*CoglPipelineHashTableForeachFunc) (CoglPipeline *template,
+                                                  void *user_data);
+
+/*
+ * Calls @func for the template pipeline of every entry in the hash,
+ * starting with the least recently used.
+ */
+void
+_cogl_pipeline_hash_table_foreach (CoglPipelineHashTable *hash,
+                                   CoglPipelineHashTableForeachFunc func,
+                                   void *user_data);
+
 #endif /* __COGL_PIPELINE_HASH_H__ */
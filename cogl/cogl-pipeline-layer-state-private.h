@@ -36,6 +36,20 @@ _cogl_pipeline_set_layer_unit (CoglPipeline *required_owner,
                                CoglPipelineLayer *layer,
                                int unit_index);
 
+/* Sets the combine state of a layer directly from the values that
+ * would be generated by parsing a blend string with
+ * cogl_pipeline_set_layer_combine(). Each of the source and op
+ * arrays should have 3 elements */
+void
+_cogl_pipeline_set_layer_combine_funcs (CoglPipeline *pipeline,
+                                        int layer_index,
+                                        CoglPipelineCombineFunc rgb_func,
+                                        const CoglPipelineCombineSource *rgb_src,
+                                        const CoglPipelineCombineOp *rgb_op,
+                                        CoglPipelineCombineFunc alpha_func,
+                                        const CoglPipelineCombineSource *alpha_src,
+                                        const CoglPipelineCombineOp *alpha_op);
+
 CoglPipelineFilter
 _cogl_pipeline_get_layer_min_filter (CoglPipeline *pipeline,
                                      int layer_index);
@@ -1167,22 +1167,21 @@ setup_texture_combine_state (CoglBlendStringStatement *statement,
     }
 }
 
-CoglBool
-cogl_pipeline_set_layer_combine (CoglPipeline *pipeline,
-				 int layer_index,
-				 const char *combine_description,
-                                 CoglError **error)
+void
+_cogl_pipeline_set_layer_combine_funcs (CoglPipeline *pipeline,
+                                        int layer_index,
+                                        CoglPipelineCombineFunc rgb_func,
+                                        const CoglPipelineCombineSource *rgb_src,
+                                        const CoglPipelineCombineOp *rgb_op,
+                                        CoglPipelineCombineFunc alpha_func,
+                                        const CoglPipelineCombineSource *alpha_src,
+                                        const CoglPipelineCombineOp *alpha_op)
 {
   CoglPipelineLayerState state = COGL_PIPELINE_LAYER_STATE_COMBINE;
   CoglPipelineLayer *authority;
   CoglPipelineLayer *layer;
-  CoglBlendStringStatement statements[2];
-  CoglBlendStringStatement split[2];
-  CoglBlendStringStatement *rgb;
-  CoglBlendStringStatement *a;
-  int count;
-
-  _COGL_RETURN_VAL_IF_FAIL (cogl_is_pipeline (pipeline), FALSE);
+  CoglPipelineLayerBigState *big_state;
+  int n_args, i;
 
   /* Note: this will ensure that the layer exists, creating one if it
    * doesn't already.
@@ -1196,41 +1195,28 @@ cogl_pipeline_set_layer_combine (CoglPipeline *pipeline,
    * state we want to change */
   authority = _cogl_pipeline_layer_get_authority (layer, state);
 
-  count =
-    _cogl_blend_string_compile (combine_description,
-                                COGL_BLEND_STRING_CONTEXT_TEXTURE_COMBINE,
-                                statements,
-                                error);
-  if (!count)
-    return FALSE;
-
-  if (statements[0].mask == COGL_BLEND_STRING_CHANNEL_MASK_RGBA)
-    {
-      _cogl_blend_string_split_rgba_statement (statements,
-                                               &split[0], &split[1]);
-      rgb = &split[0];
-      a = &split[1];
-    }
-  else
-    {
-      rgb = &statements[0];
-      a = &statements[1];
-    }
-
   /* FIXME: compare the new state with the current state! */
 
   /* possibly flush primitives referencing the current state... */
   layer = _cogl_pipeline_layer_pre_change_notify (pipeline, layer, state);
 
-  setup_texture_combine_state (rgb,
-                               &layer->big_state->texture_combine_rgb_func,
-                               layer->big_state->texture_combine_rgb_src,
-                               layer->big_state->texture_combine_rgb_op);
-
-  setup_texture_combine_state (a,
-                               &layer->big_state->texture_combine_alpha_func,
-                               layer->big_state->texture_combine_alpha_src,
-                               layer->big_state->texture_combine_alpha_op);
+  /* Only the arguments used by each function are copied in the same
+   * way as when parsing a blend string */
+  big_state = layer->big_state;
+  big_state->texture_combine_rgb_func = rgb_func;
+  n_args = _cogl_get_n_args_for_combine_func (rgb_func);
+  for (i = 0; i < n_args; i++)
+    {
+      big_state->texture_combine_rgb_src[i] = rgb_src[i];
+      big_state->texture_combine_rgb_op[i] = rgb_op[i];
+    }
+  big_state->texture_combine_alpha_func = alpha_func;
+  n_args = _cogl_get_n_args_for_combine_func (alpha_func);
+  for (i = 0; i < n_args; i++)
+    {
+      big_state->texture_combine_alpha_src[i] = alpha_src[i];
+      big_state->texture_combine_alpha_op[i] = alpha_op[i];
+    }
 
   /* If the original layer we found is currently the authority on
    * the state we are changing see if we can revert to one of our
@@ -1268,6 +1254,54 @@ cogl_pipeline_set_layer_combine (CoglPipeline *pipeline,
 changed:
 
   pipeline->dirty_real_blend_enable = TRUE;
+}
+
+CoglBool
+cogl_pipeline_set_layer_combine (CoglPipeline *pipeline,
+				 int layer_index,
+				 const char *combine_description,
+                                 CoglError **error)
+{
+  CoglBlendStringStatement statements[2];
+  CoglBlendStringStatement split[2];
+  CoglBlendStringStatement *rgb;
+  CoglBlendStringStatement *a;
+  CoglPipelineCombineFunc rgb_func, alpha_func;
+  CoglPipelineCombineSource rgb_src[3], alpha_src[3];
+  CoglPipelineCombineOp rgb_op[3], alpha_op[3];
+  int count;
+
+  _COGL_RETURN_VAL_IF_FAIL (cogl_is_pipeline (pipeline), FALSE);
+
+  count =
+    _cogl_blend_string_compile (combine_description,
+                                COGL_BLEND_STRING_CONTEXT_TEXTURE_COMBINE,
+                                statements,
+                                error);
+  if (!count)
+    return FALSE;
+
+  if (statements[0].mask == COGL_BLEND_STRING_CHANNEL_MASK_RGBA)
+    {
+      _cogl_blend_string_split_rgba_statement (statements,
+                                               &split[0], &split[1]);
+      rgb = &split[0];
+      a = &split[1];
+    }
+  else
+    {
+      rgb = &statements[0];
+      a = &statements[1];
+    }
+
+  setup_texture_combine_state (rgb, &rgb_func, rgb_src, rgb_op);
+  setup_texture_combine_state (a, &alpha_func, alpha_src, alpha_op);
+
+  _cogl_pipeline_set_layer_combine_funcs (pipeline,
+                                          layer_index,
+                                          rgb_func, rgb_src, rgb_op,
+                                          alpha_func, alpha_src, alpha_op);
+
   return TRUE;
 }
 
@@ -0,0 +1,83 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2013 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#ifndef __COGL_PIPELINE_MANIFEST_PRIVATE_H
+#define __COGL_PIPELINE_MANIFEST_PRIVATE_H
+
+#include "cogl-pipeline.h"
+#include "cogl-error.h"
+
+/* A manifest records the state that affects code generation for
+ * the programs that have been created by a context. It can be saved
+ * to a file and later replayed to create the same programs ahead of
+ * time */
+typedef struct _CoglPipelineManifest CoglPipelineManifest;
+
+CoglPipelineManifest *
+_cogl_pipeline_manifest_new (void);
+
+void
+_cogl_pipeline_manifest_free (CoglPipelineManifest *manifest);
+
+/*
+ * _cogl_pipeline_manifest_add:
+ * @manifest: A #CoglPipelineManifest
+ * @pipeline: A pipeline containing only codegen state, such as one of
+ *   the templates from the #CoglPipelineCache
+ *
+ * Records the codegen state of @pipeline. Pipelines that are already
+ * in the manifest or that use state which can't be serialized, such
+ * as a #CoglProgram, are ignored. Nothing more is recorded once the
+ * manifest is full.
+ */
+void
+_cogl_pipeline_manifest_add (CoglPipelineManifest *manifest,
+                             CoglPipeline *pipeline);
+
+CoglBool
+_cogl_pipeline_manifest_save (CoglPipelineManifest *manifest,
+                              const char *filename,
+                              CoglError **error);
+
+/*
+ * _cogl_pipeline_manifest_replay:
+ * @context: A #CoglContext
+ * @filename: A manifest previously written with
+ *   _cogl_pipeline_manifest_save()
+ * @error: A #CoglError return location
+ *
+ * Recreates a pipeline for each entry in the file and precompiles it
+ * so that the programs will be in the pipeline cache before they are
+ * needed. Entries that can't be used with the current driver are
+ * skipped.
+ *
+ * Return value: %FALSE if the file couldn't be read or isn't a
+ *   manifest.
+ */
+CoglBool
+_cogl_pipeline_manifest_replay (CoglContext *context,
+                                const char *filename,
+                                CoglError **error);
+
+#endif /* __COGL_PIPELINE_MANIFEST_PRIVATE_H */
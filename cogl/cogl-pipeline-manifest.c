@@ -0,0 +1,612 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2013 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "cogl-context-private.h"
+#include "cogl-pipeline-private.h"
+#include "cogl-pipeline-layer-private.h"
+#include "cogl-pipeline-layer-state-private.h"
+#include "cogl-pipeline-manifest-private.h"
+#include "cogl-snippet-private.h"
+#include "cogl-error-private.h"
+
+/* The manifest is a text file with one record per line and the
+ * fields of each record separated by tabs. Strings are escaped with
+ * g_strescape() so that they can't contain either separator. A
+ * string field starts with a '+' so that it can be distinguished
+ * from an empty field which represents NULL.
+ *
+ * Each entry starts with a 'pipeline' record which is followed by a
+ * 'layer' record for each layer and a 'snippet' record for each
+ * snippet. Layer snippets apply to the preceding layer record.
+ *
+ * This should be bumped whenever the format of the records changes */
+#define COGL_PIPELINE_MANIFEST_HEADER "cogl-pipeline-manifest 1"
+
+/* The maximum number of pipelines to record. Once this is reached
+ * any new pipelines are ignored so that the entries that were loaded
+ * from a previous session or seen first are the ones that are kept */
+#define COGL_PIPELINE_MANIFEST_MAX_ENTRIES 1024
+
+#define COGL_PIPELINE_MANIFEST_NON_ZERO_POINT_SIZE (1 << 0)
+#define COGL_PIPELINE_MANIFEST_PER_VERTEX_POINT_SIZE (1 << 1)
+
+struct _CoglPipelineManifest
+{
+  /* The serialized entries in the order they were added */
+  GPtrArray *entries;
+  /* A set of the same strings so that duplicates can quickly be
+     skipped. The strings are owned by the array */
+  GHashTable *entry_set;
+};
+
+CoglPipelineManifest *
+_cogl_pipeline_manifest_new (void)
+{
+  CoglPipelineManifest *manifest = g_slice_new (CoglPipelineManifest);
+
+  manifest->entries = g_ptr_array_new_with_free_func (g_free);
+  manifest->entry_set = g_hash_table_new (g_str_hash, g_str_equal);
+
+  return manifest;
+}
+
+void
+_cogl_pipeline_manifest_free (CoglPipelineManifest *manifest)
+{
+  g_hash_table_destroy (manifest->entry_set);
+  g_ptr_array_free (manifest->entries, TRUE);
+  g_slice_free (CoglPipelineManifest, manifest);
+}
+
+static void
+append_string_field (GString *buf,
+                     const char *str)
+{
+  g_string_append_c (buf, '\t');
+
+  if (str)
+    {
+      char *escaped = g_strescape (str, NULL);
+      g_string_append_c (buf, '+');
+      g_string_append (buf, escaped);
+      g_free (escaped);
+    }
+}
+
+static void
+serialize_snippets (GString *buf,
+                    CoglPipelineSnippetList *list)
+{
+  GList *l;
+
+  for (l = list->entries; l; l = l->next)
+    {
+      CoglSnippet *snippet = l->data;
+
+      g_string_append_printf (buf, "snippet\t%i", snippet->hook);
+      append_string_field (buf, snippet->declarations);
+      append_string_field (buf, snippet->pre);
+      append_string_field (buf, snippet->replace);
+      append_string_field (buf, snippet->post);
+      g_string_append_c (buf, '\n');
+    }
+}
+
+static void
+serialize_combine (GString *buf,
+                   CoglPipelineCombineFunc func,
+                   const CoglPipelineCombineSource *src,
+                   const CoglPipelineCombineOp *op)
+{
+  int n_args = _cogl_get_n_args_for_combine_func (func);
+  int i;
+
+  g_string_append_printf (buf, "\t%i", func);
+
+  /* The unused arguments aren't initialized so they are written as
+   * zeroes to keep the output stable */
+  for (i = 0; i < 3; i++)
+    g_string_append_printf (buf, "\t%i\t%i",
+                            i < n_args ? src[i] : 0,
+                            i < n_args ? op[i] : 0);
+}
+
+static CoglBool
+serialize_layer_cb (CoglPipelineLayer *layer,
+                    void *user_data)
+{
+  GString *buf = user_data;
+  CoglPipelineLayer *combine_authority =
+    _cogl_pipeline_layer_get_authority (layer,
+                                        COGL_PIPELINE_LAYER_STATE_COMBINE);
+  CoglPipelineLayerBigState *big_state = combine_authority->big_state;
+  CoglPipelineLayer *sprite_authority =
+    _cogl_pipeline_layer_get_authority
+    (layer, COGL_PIPELINE_LAYER_STATE_POINT_SPRITE_COORDS);
+  CoglPipelineLayer *vertex_snippets_authority =
+    _cogl_pipeline_layer_get_authority
+    (layer, COGL_PIPELINE_LAYER_STATE_VERTEX_SNIPPETS);
+  CoglPipelineLayer *fragment_snippets_authority =
+    _cogl_pipeline_layer_get_authority
+    (layer, COGL_PIPELINE_LAYER_STATE_FRAGMENT_SNIPPETS);
+
+  g_string_append_printf (buf, "layer\t%i\t%i\t%i",
+                          layer->index,
+                          _cogl_pipeline_layer_get_texture_type (layer),
+                          sprite_authority->big_state->point_sprite_coords);
+
+  serialize_combine (buf,
+                     big_state->texture_combine_rgb_func,
+                     big_state->texture_combine_rgb_src,
+                     big_state->texture_combine_rgb_op);
+  serialize_combine (buf,
+                     big_state->texture_combine_alpha_func,
+                     big_state->texture_combine_alpha_src,
+                     big_state->texture_combine_alpha_op);
+
+  g_string_append_c (buf, '\n');
+
+  serialize_snippets (buf,
+                      &vertex_snippets_authority->big_state->vertex_snippets);
+  serialize_snippets (buf,
+                      &fragment_snippets_authority->big_state->
+                      fragment_snippets);
+
+  return TRUE;
+}
+
+void
+_cogl_pipeline_manifest_add (CoglPipelineManifest *manifest,
+                             CoglPipeline *pipeline)
+{
+  CoglPipeline *authority;
+  GString *buf;
+  int flags = 0;
+
+  /* There's no way to serialize a user program so pipelines using
+   * the old CoglProgram API just won't be precompiled */
+  if (cogl_pipeline_get_user_program (pipeline))
+    return;
+
+  if (manifest->entries->len >= COGL_PIPELINE_MANIFEST_MAX_ENTRIES)
+    return;
+
+  if (cogl_pipeline_get_point_size (pipeline) != 0.0f)
+    flags |= COGL_PIPELINE_MANIFEST_NON_ZERO_POINT_SIZE;
+  if (cogl_pipeline_get_per_vertex_point_size (pipeline))
+    flags |= COGL_PIPELINE_MANIFEST_PER_VERTEX_POINT_SIZE;
+
+  buf = g_string_new (NULL);
+
+  g_string_append_printf (buf, "pipeline\t%i\t%i\n",
+                          flags,
+                          cogl_pipeline_get_alpha_test_function (pipeline));
+
+  authority =
+    _cogl_pipeline_get_authority (pipeline,
+                                  COGL_PIPELINE_STATE_VERTEX_SNIPPETS);
+  serialize_snippets (buf, &authority->big_state->vertex_snippets);
+  authority =
+    _cogl_pipeline_get_authority (pipeline,
+                                  COGL_PIPELINE_STATE_FRAGMENT_SNIPPETS);
+  serialize_snippets (buf, &authority->big_state->fragment_snippets);
+
+  _cogl_pipeline_foreach_layer_internal (pipeline, serialize_layer_cb, buf);
+
+  if (g_hash_table_lookup (manifest->entry_set, buf->str))
+    {
+      g_string_free (buf, TRUE);
+      return;
+    }
+
+  g_ptr_array_add (manifest->entries, buf->str);
+  g_hash_table_insert (manifest->entry_set, buf->str, buf->str);
+  g_string_free (buf, FALSE);
+}
+
+CoglBool
+_cogl_pipeline_manifest_save (CoglPipelineManifest *manifest,
+                              const char *filename,
+                              CoglError **error)
+{
+  GString *contents = g_string_new (COGL_PIPELINE_MANIFEST_HEADER "\n");
+  GError *glib_error = NULL;
+  CoglBool ret;
+  int i;
+
+  for (i = 0; i < manifest->entries->len; i++)
+    g_string_append (contents, g_ptr_array_index (manifest->entries, i));
+
+  ret = g_file_set_contents (filename,
+                             contents->str,
+                             contents->len,
+                             &glib_error);
+
+  if (!ret)
+    _cogl_propagate_error (error, (CoglError *) glib_error);
+
+  g_string_free (contents, TRUE);
+
+  return ret;
+}
+
+typedef struct
+{
+  CoglContext *context;
+  CoglPipeline *pipeline;
+  /* The index of the last layer record or -1 if there hasn't been
+     one yet for this pipeline */
+  int layer_index;
+  /* Set if any record for the current pipeline can't be used. The
+     pipeline will then be thrown away instead of precompiled */
+  CoglBool invalid;
+  int n_precompiled;
+} ReplayState;
+
+static CoglBool
+parse_int (const char *str,
+           int *value)
+{
+  char *end;
+  long result;
+
+  result = strtol (str, &end, 10);
+  if (end == str || *end != '\0')
+    return FALSE;
+
+  *value = result;
+
+  return TRUE;
+}
+
+static CoglBool
+parse_string (const char *str,
+              char **value)
+{
+  if (*str == '\0')
+    *value = NULL;
+  else if (*str == '+')
+    *value = g_strcompress (str + 1);
+  else
+    return FALSE;
+
+  return TRUE;
+}
+
+static CoglBool
+is_valid_combine_func (int func)
+{
+  switch (func)
+    {
+    case COGL_PIPELINE_COMBINE_FUNC_ADD:
+    case COGL_PIPELINE_COMBINE_FUNC_ADD_SIGNED:
+    case COGL_PIPELINE_COMBINE_FUNC_SUBTRACT:
+    case COGL_PIPELINE_COMBINE_FUNC_INTERPOLATE:
+    case COGL_PIPELINE_COMBINE_FUNC_REPLACE:
+    case COGL_PIPELINE_COMBINE_FUNC_MODULATE:
+    case COGL_PIPELINE_COMBINE_FUNC_DOT3_RGB:
+    case COGL_PIPELINE_COMBINE_FUNC_DOT3_RGBA:
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+static CoglBool
+is_valid_combine_op (int op)
+{
+  switch (op)
+    {
+    case COGL_PIPELINE_COMBINE_OP_SRC_COLOR:
+    case COGL_PIPELINE_COMBINE_OP_ONE_MINUS_SRC_COLOR:
+    case COGL_PIPELINE_COMBINE_OP_SRC_ALPHA:
+    case COGL_PIPELINE_COMBINE_OP_ONE_MINUS_SRC_ALPHA:
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+static CoglBool
+parse_combine (char **fields,
+               CoglPipelineCombineFunc *func,
+               CoglPipelineCombineSource *src,
+               CoglPipelineCombineOp *op)
+{
+  int value, n_args, i;
+
+  if (!parse_int (fields[0], &value) || !is_valid_combine_func (value))
+    return FALSE;
+  *func = value;
+
+  n_args = _cogl_get_n_args_for_combine_func (*func);
+
+  for (i = 0; i < n_args; i++)
+    {
+      if (!parse_int (fields[i * 2 + 1], &value) || value < 0)
+        return FALSE;
+      src[i] = value;
+
+      if (!parse_int (fields[i * 2 + 2], &value) ||
+          !is_valid_combine_op (value))
+        return FALSE;
+      op[i] = value;
+    }
+
+  return TRUE;
+}
+
+static CoglBool
+is_supported_texture_type (CoglContext *context,
+                           int texture_type)
+{
+  switch (texture_type)
+    {
+    case COGL_TEXTURE_TYPE_2D:
+      return TRUE;
+    case COGL_TEXTURE_TYPE_3D:
+      return context->default_gl_texture_3d_tex != NULL;
+    case COGL_TEXTURE_TYPE_RECTANGLE:
+      return context->default_gl_texture_rect_tex != NULL;
+    }
+
+  return FALSE;
+}
+
+static void
+finish_pipeline (ReplayState *state)
+{
+  if (state->pipeline == NULL)
+    return;
+
+  if (state->invalid)
+    COGL_NOTE (PERFORMANCE, "Skipping unusable pipeline manifest entry");
+  else
+    {
+      cogl_pipeline_precompile (state->pipeline);
+      state->n_precompiled++;
+    }
+
+  /* The programs are attached to the templates in the pipeline cache
+   * so the pipeline itself isn't needed anymore */
+  cogl_object_unref (state->pipeline);
+  state->pipeline = NULL;
+}
+
+static void
+start_pipeline (ReplayState *state,
+                char **fields)
+{
+  int flags, alpha_func;
+
+  finish_pipeline (state);
+
+  state->pipeline = cogl_pipeline_new (state->context);
+  state->layer_index = -1;
+  state->invalid = FALSE;
+
+  if (g_strv_length (fields) != 3 ||
+      !parse_int (fields[1], &flags) ||
+      !parse_int (fields[2], &alpha_func))
+    {
+      state->invalid = TRUE;
+      return;
+    }
+
+  if ((flags & COGL_PIPELINE_MANIFEST_NON_ZERO_POINT_SIZE))
+    cogl_pipeline_set_point_size (state->pipeline, 1.0f);
+
+  if ((flags & COGL_PIPELINE_MANIFEST_PER_VERTEX_POINT_SIZE) &&
+      !cogl_pipeline_set_per_vertex_point_size (state->pipeline,
+                                                TRUE,
+                                                NULL))
+    state->invalid = TRUE;
+
+  switch (alpha_func)
+    {
+    case COGL_PIPELINE_ALPHA_FUNC_NEVER:
+    case COGL_PIPELINE_ALPHA_FUNC_LESS:
+    case COGL_PIPELINE_ALPHA_FUNC_EQUAL:
+    case COGL_PIPELINE_ALPHA_FUNC_LEQUAL:
+    case COGL_PIPELINE_ALPHA_FUNC_GREATER:
+    case COGL_PIPELINE_ALPHA_FUNC_NOTEQUAL:
+    case COGL_PIPELINE_ALPHA_FUNC_GEQUAL:
+    case COGL_PIPELINE_ALPHA_FUNC_ALWAYS:
+      cogl_pipeline_set_alpha_test_function (state->pipeline,
+                                             alpha_func,
+                                             0.0f);
+      break;
+
+    default:
+      state->invalid = TRUE;
+    }
+}
+
+static void
+add_layer (ReplayState *state,
+           char **fields)
+{
+  CoglPipelineCombineFunc rgb_func, alpha_func;
+  CoglPipelineCombineSource rgb_src[3], alpha_src[3];
+  CoglPipelineCombineOp rgb_op[3], alpha_op[3];
+  int layer_index, texture_type, point_sprite_coords;
+
+  if (g_strv_length (fields) != 18 ||
+      !parse_int (fields[1], &layer_index) ||
+      layer_index < 0 ||
+      !parse_int (fields[2], &texture_type) ||
+      !parse_int (fields[3], &point_sprite_coords) ||
+      !parse_combine (fields + 4, &rgb_func, rgb_src, rgb_op) ||
+      !parse_combine (fields + 11, &alpha_func, alpha_src, alpha_op) ||
+      !is_supported_texture_type (state->context, texture_type))
+    {
+      state->invalid = TRUE;
+      return;
+    }
+
+  state->layer_index = layer_index;
+
+  cogl_pipeline_set_layer_null_texture (state->pipeline,
+                                        layer_index,
+                                        texture_type);
+
+  if (point_sprite_coords &&
+      !cogl_pipeline_set_layer_point_sprite_coords_enabled (state->pipeline,
+                                                            layer_index,
+                                                            TRUE,
+                                                            NULL))
+    state->invalid = TRUE;
+
+  _cogl_pipeline_set_layer_combine_funcs (state->pipeline,
+                                          layer_index,
+                                          rgb_func, rgb_src, rgb_op,
+                                          alpha_func, alpha_src, alpha_op);
+}
+
+static void
+add_snippet (ReplayState *state,
+             char **fields)
+{
+  CoglSnippet *snippet;
+  char *declarations = NULL, *pre = NULL, *replace = NULL, *post = NULL;
+  int hook;
+
+  if (g_strv_length (fields) != 6 ||
+      !parse_int (fields[1], &hook) ||
+      hook < 0 ||
+      !parse_string (fields[2], &declarations) ||
+      !parse_string (fields[3], &pre) ||
+      !parse_string (fields[4], &replace) ||
+      !parse_string (fields[5], &post) ||
+      (hook >= COGL_SNIPPET_FIRST_LAYER_HOOK && state->layer_index < 0))
+    {
+      state->invalid = TRUE;
+      goto out;
+    }
+
+  snippet = cogl_snippet_new (hook, declarations, post);
+  cogl_snippet_set_pre (snippet, pre);
+  cogl_snippet_set_replace (snippet, replace);
+
+  if (hook >= COGL_SNIPPET_FIRST_LAYER_HOOK)
+    cogl_pipeline_add_layer_snippet (state->pipeline,
+                                     state->layer_index,
+                                     snippet);
+  else
+    cogl_pipeline_add_snippet (state->pipeline, snippet);
+
+  cogl_object_unref (snippet);
+
+ out:
+  g_free (declarations);
+  g_free (pre);
+  g_free (replace);
+  g_free (post);
+}
+
+static void
+replay_record (ReplayState *state,
+               const char *line)
+{
+  char **fields;
+
+  if (*line == '\0')
+    return;
+
+  fields = g_strsplit (line, "\t", 0);
+
+  if (!strcmp (fields[0], "pipeline"))
+    start_pipeline (state, fields);
+  /* Ignore anything that isn't part of a pipeline entry */
+  else if (state->pipeline == NULL || state->invalid)
+    ;
+  else if (!strcmp (fields[0], "layer"))
+    add_layer (state, fields);
+  else if (!strcmp (fields[0], "snippet"))
+    add_snippet (state, fields);
+  else
+    state->invalid = TRUE;
+
+  g_strfreev (fields);
+}
+
+CoglBool
+_cogl_pipeline_manifest_replay (CoglContext *context,
+                                const char *filename,
+                                CoglError **error)
+{
+  GError *glib_error = NULL;
+  ReplayState state;
+  char *contents;
+  char **lines;
+  int i;
+
+  if (!g_file_get_contents (filename, &contents, NULL, &glib_error))
+    {
+      _cogl_propagate_error (error, (CoglError *) glib_error);
+      return FALSE;
+    }
+
+  lines = g_strsplit (contents, "\n", 0);
+  g_free (contents);
+
+  if (lines[0] == NULL || strcmp (lines[0], COGL_PIPELINE_MANIFEST_HEADER))
+    {
+      _cogl_set_error (error,
+                       COGL_SYSTEM_ERROR,
+                       COGL_SYSTEM_ERROR_UNSUPPORTED,
+                       "%s is not a pipeline manifest or it was written "
+                       "by an incompatible version of Cogl",
+                       filename);
+      g_strfreev (lines);
+      return FALSE;
+    }
+
+  state.context = context;
+  state.pipeline = NULL;
+  state.layer_index = -1;
+  state.invalid = FALSE;
+  state.n_precompiled = 0;
+
+  for (i = 1; lines[i]; i++)
+    replay_record (&state, lines[i]);
+
+  finish_pipeline (&state);
+
+  COGL_NOTE (PERFORMANCE,
+             "Precompiled %i pipelines from manifest %s",
+             state.n_precompiled,
+             filename);
+
+  g_strfreev (lines);
+
+  return TRUE;
+}
@@ -565,6 +565,16 @@ typedef struct
      pipeline is flushed, even if the pipeline hasn't changed since
      the last flush */
   void (* pre_paint) (CoglPipeline *pipeline, CoglFramebuffer *framebuffer);
+  /* This is called instead of end() by cogl_pipeline_precompile()
+     after the vertend and fragend have generated their code. It
+     should start creating the program without flushing any state or
+     waiting for the driver. This can be NULL if there is nothing
+     worth doing ahead of time */
+  void (* precompile) (CoglPipeline *pipeline);
+  /* Checks without blocking whether the pipeline can be flushed
+     without waiting for the driver to compile anything. If this is
+     NULL then the pipeline is always considered ready */
+  CoglBool (* is_ready) (CoglPipeline *pipeline);
 } CoglPipelineProgend;
 
 typedef enum
@@ -988,5 +998,22 @@ _cogl_pipeline_get_layer_state_for_fragment_codegen (CoglContext *context);
 CoglPipelineState
 _cogl_pipeline_get_state_for_fragment_codegen (CoglContext *context);
 
+struct _CoglPipelineReadyClosure
+{
+  /* Link in the context's list of pending ready closures */
+  CoglList link;
+
+  CoglPipeline *pipeline;
+
+  CoglPipelineReadyCallback callback;
+  void *user_data;
+  CoglUserDataDestroyCallback destroy;
+};
+
+/* Removes any ready callbacks that haven't been invoked yet. This is
+ * used when the context is destroyed */
+void
+_cogl_pipeline_remove_all_ready_callbacks (CoglContext *context);
+
 #endif /* __COGL_PIPELINE_PRIVATE_H */
 
@@ -3151,3 +3151,164 @@ cogl_pipeline_get_uniform_location (CoglPipeline *pipeline,
 
   return ctx->n_uniform_names++;
 }
+
+void
+cogl_pipeline_precompile (CoglPipeline *pipeline)
+{
+  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
+
+  _cogl_pipeline_precompile_gl (ctx, pipeline);
+}
+
+CoglBool
+cogl_pipeline_is_ready (CoglPipeline *pipeline)
+{
+  const CoglPipelineProgend *progend;
+
+  /* If the pipeline hasn't been precompiled or flushed yet then we
+   * don't know which progend it will use so there can't be a program
+   * ready for it */
+  if (pipeline->progend == COGL_PIPELINE_PROGEND_UNDEFINED)
+    return FALSE;
+
+  progend = _cogl_pipeline_progends[pipeline->progend];
+
+  if (progend->is_ready)
+    return progend->is_ready (pipeline);
+  else
+    return TRUE;
+}
+
+#define PIPELINE_READY_CHECK_TIMEOUT 5000 /* microseconds */
+
+static void
+remove_ready_closure (CoglPipelineReadyClosure *closure)
+{
+  _cogl_list_remove (&closure->link);
+
+  if (closure->destroy)
+    closure->destroy (closure->user_data);
+
+  cogl_object_unref (closure->pipeline);
+
+  g_slice_free (CoglPipelineReadyClosure, closure);
+}
+
+static void
+_cogl_pipeline_ready_poll_dispatch (void *source, int revents)
+{
+  CoglContext *context = source;
+  CoglPipelineReadyClosure *closure, *tmp;
+  CoglList ready_list;
+
+  /* Move the closures for the ready pipelines to a separate list
+   * before invoking any of them. A callback may remove other pending
+   * closures so we can't rely on the next pointer staying valid while
+   * iterating the context's list */
+  _cogl_list_init (&ready_list);
+
+  _cogl_list_for_each_safe (closure, tmp,
+                            &context->pipeline_ready_closures,
+                            link)
+    {
+      if (!cogl_pipeline_is_ready (closure->pipeline))
+        continue;
+
+      _cogl_list_remove (&closure->link);
+      _cogl_list_insert (ready_list.prev, &closure->link);
+    }
+
+  while (!_cogl_list_empty (&ready_list))
+    {
+      closure = _cogl_container_of (ready_list.next, closure, link);
+
+      closure->callback (closure->pipeline, closure->user_data);
+
+      /* The callback is allowed to remove its own closure, in which
+       * case it will no longer be at the head of the list */
+      if (ready_list.next == &closure->link)
+        remove_ready_closure (closure);
+    }
+}
+
+static int64_t
+_cogl_pipeline_ready_poll_prepare (void *source)
+{
+  CoglContext *context = source;
+  CoglPipelineReadyClosure *closure;
+
+  if (_cogl_list_empty (&context->pipeline_ready_closures))
+    return -1;
+
+  /* Checking whether a program has finished linking is cheap so if
+   * any pipeline is already ready we can dispatch immediately.
+   * Otherwise we have to poll because the driver doesn't give us
+   * anything to wait on */
+  _cogl_list_for_each (closure, &context->pipeline_ready_closures, link)
+    if (cogl_pipeline_is_ready (closure->pipeline))
+      return 0;
+
+  return PIPELINE_READY_CHECK_TIMEOUT;
+}
+
+CoglPipelineReadyClosure *
+cogl_pipeline_add_ready_callback (CoglPipeline *pipeline,
+                                  CoglPipelineReadyCallback callback,
+                                  void *user_data,
+                                  CoglUserDataDestroyCallback destroy)
+{
+  CoglPipelineReadyClosure *closure;
+
+  _COGL_GET_CONTEXT (ctx, NULL);
+
+  cogl_pipeline_precompile (pipeline);
+
+  closure = g_slice_new (CoglPipelineReadyClosure);
+  closure->pipeline = cogl_object_ref (pipeline);
+  closure->callback = callback;
+  closure->user_data = user_data;
+  closure->destroy = destroy;
+
+  _cogl_list_insert (ctx->pipeline_ready_closures.prev, &closure->link);
+
+  if (!ctx->pipeline_ready_poll_source)
+    {
+      ctx->pipeline_ready_poll_source =
+        _cogl_poll_renderer_add_source (ctx->display->renderer,
+                                        _cogl_pipeline_ready_poll_prepare,
+                                        _cogl_pipeline_ready_poll_dispatch,
+                                        ctx);
+    }
+
+  return closure;
+}
+
+void
+cogl_pipeline_remove_ready_callback (CoglPipeline *pipeline,
+                                     CoglPipelineReadyClosure *closure)
+{
+  _COGL_RETURN_IF_FAIL (closure->pipeline == pipeline);
+
+  remove_ready_closure (closure);
+}
+
+void
+_cogl_pipeline_remove_all_ready_callbacks (CoglContext *context)
+{
+  while (!_cogl_list_empty (&context->pipeline_ready_closures))
+    {
+      CoglPipelineReadyClosure *closure =
+        _cogl_container_of (context->pipeline_ready_closures.next,
+                            closure,
+                            link);
+
+      remove_ready_closure (closure);
+    }
+
+  if (context->pipeline_ready_poll_source)
+    {
+      _cogl_poll_renderer_remove_source (context->display->renderer,
+                                         context->pipeline_ready_poll_source);
+      context->pipeline_ready_poll_source = NULL;
+    }
+}
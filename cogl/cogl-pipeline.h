@@ -34,6 +34,7 @@
 typedef struct _CoglPipeline CoglPipeline;
 
 #include <cogl/cogl-types.h>
+#include <cogl/cogl-object.h>
 #include <cogl/cogl-context.h>
 #include <cogl/cogl-snippet.h>
 
@@ -165,6 +166,129 @@ int
 cogl_pipeline_get_uniform_location (CoglPipeline *pipeline,
                                     const char *uniform_name);
 
+/**
+ * cogl_pipeline_precompile:
+ * @pipeline: A #CoglPipeline object
+ *
+ * Starts generating and compiling the program that will be needed to
+ * render with @pipeline without having to wait for the driver to
+ * finish. Normally Cogl only creates the program the first time the
+ * pipeline is used to paint which can cause a noticeable stall. An
+ * application can call this function for pipelines that it knows
+ * it will need soon, for example while showing a loading screen, so
+ * that the work will have been done by the time they are used.
+ *
+ * If the driver supports the GL_KHR_parallel_shader_compile
+ * extension then the compilation will happen on the driver's own
+ * threads and cogl_pipeline_is_ready() can be used to check whether
+ * it has completed. Otherwise the work will be done the first time
+ * the pipeline is used or when cogl_pipeline_is_ready() is called.
+ *
+ * Any later modifications to @pipeline that affect the generated
+ * program will cause the work to be thrown away.
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+void
+cogl_pipeline_precompile (CoglPipeline *pipeline);
+
+/**
+ * cogl_pipeline_is_ready:
+ * @pipeline: A #CoglPipeline object
+ *
+ * Checks whether the program for @pipeline has finished compiling
+ * after a call to cogl_pipeline_precompile(). If this returns %TRUE
+ * then painting with the pipeline won't have to wait for the driver
+ * to compile any shaders. This only avoids blocking if the driver
+ * supports the GL_KHR_parallel_shader_compile extension. Otherwise
+ * it will wait for the driver to finish.
+ *
+ * Return value: %TRUE if @pipeline can be used without stalling or
+ *   %FALSE if it hasn't been precompiled or is still compiling
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+CoglBool
+cogl_pipeline_is_ready (CoglPipeline *pipeline);
+
+/**
+ * CoglPipelineReadyClosure:
+ *
+ * An opaque type that tracks a #CoglPipelineReadyCallback and
+ * associated user data. A #CoglPipelineReadyClosure pointer will be
+ * returned from cogl_pipeline_add_ready_callback() and it allows
+ * you to remove a callback later using
+ * cogl_pipeline_remove_ready_callback().
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+typedef struct _CoglPipelineReadyClosure CoglPipelineReadyClosure;
+
+/**
+ * CoglPipelineReadyCallback:
+ * @pipeline: The #CoglPipeline that has finished compiling
+ * @user_data: The private data passed to
+ *   cogl_pipeline_add_ready_callback()
+ *
+ * The callback prototype used with cogl_pipeline_add_ready_callback()
+ * to be notified when a pipeline is ready to be used.
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+typedef void (*CoglPipelineReadyCallback) (CoglPipeline *pipeline,
+                                           void *user_data);
+
+/**
+ * cogl_pipeline_add_ready_callback:
+ * @pipeline: A #CoglPipeline object
+ * @callback: A #CoglPipelineReadyCallback to call when @pipeline is
+ *   ready
+ * @user_data: Private data that will be passed to the callback
+ * @destroy: (allow-none): An optional destroy notify that will be
+ *   called for @user_data once the callback has been invoked or
+ *   removed
+ *
+ * Starts compiling @pipeline as if cogl_pipeline_precompile() had
+ * been called and installs a callback that will be invoked once
+ * cogl_pipeline_is_ready() would return %TRUE. The callback will only
+ * be invoked once and it is dispatched from the Cogl main loop
+ * integration so the application must be using cogl_poll_get_info()
+ * and cogl_poll_dispatch() or the #GSource returned by
+ * cogl_glib_source_new() for it to be called. A reference is kept on
+ * @pipeline until the callback has been invoked or removed.
+ *
+ * Return value: (transfer none): a #CoglPipelineReadyClosure pointer
+ *   that can be used to remove the callback and user data without
+ *   it being invoked.
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+CoglPipelineReadyClosure *
+cogl_pipeline_add_ready_callback (CoglPipeline *pipeline,
+                                  CoglPipelineReadyCallback callback,
+                                  void *user_data,
+                                  CoglUserDataDestroyCallback destroy);
+
+/**
+ * cogl_pipeline_remove_ready_callback:
+ * @pipeline: A #CoglPipeline object
+ * @closure: A #CoglPipelineReadyClosure returned from
+ *   cogl_pipeline_add_ready_callback()
+ *
+ * Removes a callback that was previously added with
+ * cogl_pipeline_add_ready_callback() before it has been invoked.
+ *
+ * Since: 2.0
+ * Stability: Unstable
+ */
+void
+cogl_pipeline_remove_ready_callback (CoglPipeline *pipeline,
+                                     CoglPipelineReadyClosure *closure);
 
 #endif /* COGL_ENABLE_EXPERIMENTAL_API */
 
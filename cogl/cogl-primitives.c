@@ -979,6 +979,20 @@ _cogl_polygon_validate_layer_cb (CoglPipeline *pipeline,
   return TRUE;
 }
 
+static CoglBool
+flush_layer_journal_cb (CoglPipeline *pipeline,
+                        int layer_index,
+                        void *user_data)
+{
+  CoglTexture *texture =
+    cogl_pipeline_get_layer_texture (pipeline, layer_index);
+
+  if (texture)
+    _cogl_texture_flush_journal_rendering (texture);
+
+  return TRUE;
+}
+
 void
 cogl_polygon (const CoglTextureVertex *vertices,
               unsigned int n_vertices,
@@ -992,11 +1006,15 @@ cogl_polygon (const CoglTextureVertex *vertices,
   int i;
   unsigned int stride;
   size_t stride_bytes;
+  size_t offset;
+  CoglBool use_stream_buffer;
   CoglAttributeBuffer *attribute_buffer;
+  CoglFramebuffer *framebuffer;
   float *v;
 
   _COGL_GET_CONTEXT (ctx, NO_RETVAL);
 
+  framebuffer = cogl_get_draw_framebuffer ();
   pipeline = cogl_get_source ();
 
   validate_state.original_pipeline = pipeline;
@@ -1016,18 +1034,45 @@ cogl_polygon (const CoglTextureVertex *vertices,
   stride = 3 + (2 * n_layers) + (use_color ? 1 : 0);
   stride_bytes = stride * sizeof (float);
 
-  /* Make sure there is enough space in the global vertex array. This
-   * is used so we can render the polygon with a single call to OpenGL
-   * but still support any number of vertices */
-  g_array_set_size (ctx->polygon_vertices, n_vertices * stride);
+  /* Small polygons are given their own buffer so that the journal
+   * can read the vertices back and batch them with the surrounding
+   * geometry. Anything bigger is drawn directly so we can write it
+   * straight into the context's stream buffer */
+  use_stream_buffer = n_vertices > COGL_JOURNAL_PRIMITIVE_MAX_VERTICES;
 
-  attribute_buffer =
-    cogl_attribute_buffer_new (ctx, n_vertices * stride_bytes, NULL);
+  if (use_stream_buffer)
+    {
+      /* Drawing the polygon would flush these journals which would
+       * make the journals allocate from the stream buffer before our
+       * vertices have been drawn so we flush them up front */
+      _cogl_framebuffer_flush_journal (framebuffer);
+      cogl_pipeline_foreach_layer (pipeline,
+                                   flush_layer_journal_cb,
+                                   NULL);
+
+      v = _cogl_stream_buffer_map (ctx->stream_buffer,
+                                   n_vertices * stride_bytes,
+                                   &attribute_buffer,
+                                   &offset);
+    }
+  else
+    {
+      /* Make sure there is enough space in the global vertex
+       * array. This is used so we can render the polygon with a
+       * single call to OpenGL but still support any number of
+       * vertices */
+      g_array_set_size (ctx->polygon_vertices, n_vertices * stride);
+      v = (float *)ctx->polygon_vertices->data;
+
+      attribute_buffer =
+        cogl_attribute_buffer_new (ctx, n_vertices * stride_bytes, NULL);
+      offset = 0;
+    }
 
   attributes[0] = cogl_attribute_new (attribute_buffer,
                                       "cogl_position_in",
                                       stride_bytes,
-                                      0,
+                                      offset,
                                       3,
                                       COGL_ATTRIBUTE_TYPE_FLOAT);
 
@@ -1055,7 +1100,7 @@ cogl_polygon (const CoglTextureVertex *vertices,
                                               name,
                                               stride_bytes,
                                               /* NB: [X,Y,Z,TX,TY...,R,G,B,A,...] */
-                                              12 + 8 * i,
+                                              offset + 12 + 8 * i,
                                               2,
                                               COGL_ATTRIBUTE_TYPE_FLOAT);
 
@@ -1069,13 +1114,12 @@ cogl_polygon (const CoglTextureVertex *vertices,
                             "cogl_color_in",
                             stride_bytes,
                             /* NB: [X,Y,Z,TX,TY...,R,G,B,A,...] */
-                            12 + 8 * n_layers,
+                            offset + 12 + 8 * n_layers,
                             4,
                             COGL_ATTRIBUTE_TYPE_UNSIGNED_BYTE);
     }
 
   /* Convert the vertices into an array of float vertex attributes */
-  v = (float *)ctx->polygon_vertices->data;
   for (i = 0; i < n_vertices; i++)
     {
       AppendTexCoordsState append_tex_coords_state;
@@ -1107,11 +1151,13 @@ cogl_polygon (const CoglTextureVertex *vertices,
       v += stride;
     }
 
-  v = (float *)ctx->polygon_vertices->data;
-  cogl_buffer_set_data (COGL_BUFFER (attribute_buffer),
-                        0,
-                        v,
-                        ctx->polygon_vertices->len * sizeof (float));
+  if (use_stream_buffer)
+    _cogl_stream_buffer_unmap (ctx->stream_buffer);
+  else
+    cogl_buffer_set_data (COGL_BUFFER (attribute_buffer),
+                          0,
+                          ctx->polygon_vertices->data,
+                          ctx->polygon_vertices->len * sizeof (float));
 
   /* XXX: although this may seem redundant, we need to do this since
    * cogl_polygon() can be used with legacy state and its the source stack
@@ -1121,7 +1167,7 @@ cogl_polygon (const CoglTextureVertex *vertices,
    *  to enable it) */
   cogl_push_source (pipeline);
 
-  _cogl_framebuffer_draw_attributes (cogl_get_draw_framebuffer (),
+  _cogl_framebuffer_draw_attributes (framebuffer,
                                      pipeline,
                                      COGL_VERTICES_MODE_TRIANGLE_FAN,
                                      0, n_vertices,
@@ -0,0 +1,64 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2013 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#ifndef __COGL_STREAM_BUFFER_PRIVATE_H
+#define __COGL_STREAM_BUFFER_PRIVATE_H
+
+#include "cogl-context.h"
+#include "cogl-attribute-buffer.h"
+
+/* The stream buffer is a large attribute buffer owned by the context
+ * that transient geometry is sub-allocated from. The buffer is split
+ * into segments which are filled in order. When a segment is left a
+ * fence is inserted so that it won't be written to again until the
+ * GPU has finished drawing from it. This means that the buffer can
+ * be mapped without GL having to synchronise with the GPU and
+ * without having to reallocate the buffer storage every time.
+ *
+ * All of the drawing that uses an allocation must be submitted to GL
+ * before the next allocation is made. Geometry that needs to be kept
+ * alive for longer than that should use its own buffer. */
+
+typedef struct _CoglStreamBuffer CoglStreamBuffer;
+
+CoglStreamBuffer *
+_cogl_stream_buffer_new (CoglContext *context);
+
+void
+_cogl_stream_buffer_free (CoglStreamBuffer *stream);
+
+/* Allocates @size bytes and maps them for writing. A reference to
+ * the buffer containing the allocation is returned in @buffer_out
+ * and the offset of the allocation within that buffer is returned
+ * in @offset_out. The allocation must be unmapped with
+ * _cogl_stream_buffer_unmap() before anything else is allocated */
+void *
+_cogl_stream_buffer_map (CoglStreamBuffer *stream,
+                         size_t size,
+                         CoglAttributeBuffer **buffer_out,
+                         size_t *offset_out);
+
+void
+_cogl_stream_buffer_unmap (CoglStreamBuffer *stream);
+
+#endif /* __COGL_STREAM_BUFFER_PRIVATE_H */
@@ -0,0 +1,309 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2013 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "cogl-util.h"
+#include "cogl-stream-buffer-private.h"
+#include "cogl-context-private.h"
+#include "cogl-private.h"
+#include "cogl-fence-private.h"
+#include "cogl-buffer-private.h"
+#include "cogl-error-private.h"
+
+#define COGL_STREAM_BUFFER_SIZE (4 * 1024 * 1024)
+#define COGL_STREAM_BUFFER_N_SEGMENTS 4
+#define COGL_STREAM_BUFFER_SEGMENT_SIZE \
+  (COGL_STREAM_BUFFER_SIZE / COGL_STREAM_BUFFER_N_SEGMENTS)
+
+/* Allocations are aligned so that any attribute type can be used at
+ * the start of an allocation */
+#define COGL_STREAM_BUFFER_ALIGNMENT 16
+
+typedef struct
+{
+  /* FENCE_TYPE_PENDING if the segment isn't waiting for a fence */
+  CoglFenceType type;
+  void *fence_obj;
+} CoglStreamBufferFence;
+
+struct _CoglStreamBuffer
+{
+  CoglContext *context;
+
+  CoglAttributeBuffer *buffer;
+  /* The next free byte in the buffer */
+  size_t offset;
+  /* The segment that contains the offset */
+  int segment;
+
+  /* Whether allocations can share the stream buffer. This needs
+   * glMapBufferRange because otherwise mapping a range would map the
+   * whole buffer without orphaning it and stall until the GPU has
+   * finished with every earlier allocation */
+  CoglBool sub_allocate;
+
+  /* Whether fences are available. If not the buffer is mapped with
+   * the normal synchronisation */
+  CoglBool use_fences;
+  CoglStreamBufferFence fences[COGL_STREAM_BUFFER_N_SEGMENTS];
+
+  /* The buffer that is currently mapped. This is either the stream
+   * buffer or a dedicated buffer for allocations that are too big */
+  CoglAttributeBuffer *mapped_buffer;
+  size_t mapped_offset;
+
+  /* If mapping the buffer fails then the data is written here
+   * instead and uploaded when the buffer is unmapped */
+  GByteArray *fallback_data;
+  CoglBool mapped_fallback;
+};
+
+CoglStreamBuffer *
+_cogl_stream_buffer_new (CoglContext *context)
+{
+  CoglStreamBuffer *stream = g_slice_new0 (CoglStreamBuffer);
+  int i;
+
+  stream->context = context;
+  stream->sub_allocate =
+    ((context->private_feature_flags & COGL_PRIVATE_FEATURE_VBOS) &&
+     context->glMapBufferRange != NULL);
+  stream->use_fences = cogl_has_feature (context, COGL_FEATURE_ID_FENCE);
+  stream->fallback_data = g_byte_array_new ();
+
+  for (i = 0; i < COGL_STREAM_BUFFER_N_SEGMENTS; i++)
+    stream->fences[i].type = FENCE_TYPE_PENDING;
+
+  return stream;
+}
+
+static void
+clear_fence (CoglStreamBuffer *stream,
+             int segment)
+{
+  CoglStreamBufferFence *fence = &stream->fences[segment];
+
+  if (fence->type != FENCE_TYPE_PENDING)
+    {
+      _cogl_fence_destroy (stream->context, fence->type, fence->fence_obj);
+      fence->type = FENCE_TYPE_PENDING;
+      fence->fence_obj = NULL;
+    }
+}
+
+static void
+clear_all_fences (CoglStreamBuffer *stream)
+{
+  int i;
+
+  for (i = 0; i < COGL_STREAM_BUFFER_N_SEGMENTS; i++)
+    clear_fence (stream, i);
+}
+
+void
+_cogl_stream_buffer_free (CoglStreamBuffer *stream)
+{
+  _COGL_RETURN_IF_FAIL (stream->mapped_buffer == NULL);
+
+  clear_all_fences (stream);
+
+  if (stream->buffer)
+    cogl_object_unref (stream->buffer);
+
+  g_byte_array_free (stream->fallback_data, TRUE);
+
+  g_slice_free (CoglStreamBuffer, stream);
+}
+
+static CoglBool
+segment_is_free (CoglStreamBuffer *stream,
+                 int segment)
+{
+  CoglStreamBufferFence *fence = &stream->fences[segment];
+
+  if (fence->type == FENCE_TYPE_PENDING)
+    return TRUE;
+  /* If we couldn't create the fence then we can't know when the GPU
+   * has finished with the segment */
+  else if (fence->type == FENCE_TYPE_ERROR)
+    return FALSE;
+  else
+    return _cogl_fence_is_complete (stream->context,
+                                    fence->type,
+                                    fence->fence_obj);
+}
+
+static void
+create_buffer (CoglStreamBuffer *stream)
+{
+  if (stream->buffer)
+    cogl_object_unref (stream->buffer);
+
+  stream->buffer =
+    cogl_attribute_buffer_new_with_size (stream->context,
+                                         COGL_STREAM_BUFFER_SIZE);
+  cogl_buffer_set_update_hint (COGL_BUFFER (stream->buffer),
+                               COGL_BUFFER_UPDATE_HINT_STREAM);
+
+  clear_all_fences (stream);
+
+  stream->offset = 0;
+  stream->segment = 0;
+}
+
+/* Finds space for @size bytes in the stream buffer and returns the
+ * offset */
+static size_t
+allocate (CoglStreamBuffer *stream,
+          size_t size)
+{
+  size_t offset;
+  int next_segment;
+
+  if (stream->buffer == NULL)
+    create_buffer (stream);
+
+  offset = ((stream->offset + COGL_STREAM_BUFFER_ALIGNMENT - 1) &
+            ~(size_t) (COGL_STREAM_BUFFER_ALIGNMENT - 1));
+
+  if (offset + size >
+      (stream->segment + 1) * COGL_STREAM_BUFFER_SEGMENT_SIZE)
+    {
+      /* Everything drawn from the current segment has been submitted
+       * so we can put a fence after it and move on to the next */
+      if (stream->use_fences)
+        {
+          CoglStreamBufferFence *fence = &stream->fences[stream->segment];
+
+          clear_fence (stream, stream->segment);
+          fence->type = _cogl_fence_insert (stream->context,
+                                            &fence->fence_obj);
+        }
+
+      next_segment = (stream->segment + 1) % COGL_STREAM_BUFFER_N_SEGMENTS;
+
+      if (segment_is_free (stream, next_segment))
+        {
+          clear_fence (stream, next_segment);
+          stream->segment = next_segment;
+          offset = next_segment * COGL_STREAM_BUFFER_SEGMENT_SIZE;
+        }
+      else
+        {
+          /* The GPU is still using the next segment so rather than
+           * waiting we'll start again with a fresh buffer. The old
+           * buffer will be kept alive by GL until it has finished
+           * with it */
+          create_buffer (stream);
+          offset = 0;
+        }
+    }
+
+  stream->offset = offset + size;
+
+  return offset;
+}
+
+void *
+_cogl_stream_buffer_map (CoglStreamBuffer *stream,
+                         size_t size,
+                         CoglAttributeBuffer **buffer_out,
+                         size_t *offset_out)
+{
+  CoglContext *ctx = stream->context;
+  CoglBufferMapHint hints;
+  CoglError *ignore_error = NULL;
+  void *data;
+
+  _COGL_RETURN_VAL_IF_FAIL (stream->mapped_buffer == NULL, NULL);
+
+  /* If CoglBuffers are being emulated with malloc or ranges can't be
+   * mapped then there's no point in sub-allocating and each mapping
+   * gets a fresh buffer which is discarded as a whole. Allocations
+   * that wouldn't fit in a segment also get their own buffer */
+  if (!stream->sub_allocate ||
+      size > COGL_STREAM_BUFFER_SEGMENT_SIZE)
+    {
+      stream->mapped_buffer = cogl_attribute_buffer_new_with_size (ctx, size);
+      stream->mapped_offset = 0;
+      hints = COGL_BUFFER_MAP_HINT_DISCARD;
+    }
+  else
+    {
+      stream->mapped_offset = allocate (stream, size);
+      stream->mapped_buffer = cogl_object_ref (stream->buffer);
+      hints = COGL_BUFFER_MAP_HINT_DISCARD_RANGE;
+      /* The fences guarantee that the GPU isn't using this range */
+      if (stream->use_fences)
+        hints |= COGL_BUFFER_MAP_HINT_UNSYNCHRONIZED;
+    }
+
+  data = cogl_buffer_map_range (COGL_BUFFER (stream->mapped_buffer),
+                                stream->mapped_offset,
+                                size,
+                                COGL_BUFFER_ACCESS_WRITE,
+                                hints,
+                                &ignore_error);
+
+  if (data == NULL)
+    {
+      cogl_error_free (ignore_error);
+
+      g_byte_array_set_size (stream->fallback_data, size);
+      stream->mapped_fallback = TRUE;
+      data = stream->fallback_data->data;
+    }
+
+  *buffer_out = cogl_object_ref (stream->mapped_buffer);
+  *offset_out = stream->mapped_offset;
+
+  return data;
+}
+
+void
+_cogl_stream_buffer_unmap (CoglStreamBuffer *stream)
+{
+  CoglBuffer *buffer = COGL_BUFFER (stream->mapped_buffer);
+
+  _COGL_RETURN_IF_FAIL (buffer != NULL);
+
+  if (stream->mapped_fallback)
+    {
+      /* Note: we don't try to catch OOM errors here for the same
+       * reason as _cogl_buffer_unmap_for_fill_or_fallback() */
+      _cogl_buffer_set_data (buffer,
+                             stream->mapped_offset,
+                             stream->fallback_data->data,
+                             stream->fallback_data->len,
+                             NULL);
+      stream->mapped_fallback = FALSE;
+    }
+  else
+    cogl_buffer_unmap (buffer);
+
+  cogl_object_unref (stream->mapped_buffer);
+  stream->mapped_buffer = NULL;
+}
@@ -467,6 +467,31 @@ _cogl_texture_set_region (CoglTexture *texture,
   if (rowstride == 0)
     rowstride = _cogl_pixel_format_get_bytes_per_pixel (format) * width;
 
+  /* If possible copy the data into a pixel buffer so that GL can do
+   * the upload asynchronously instead of copying out of the client
+   * memory before returning */
+  source_bmp = _cogl_upload_ring_stage (ctx->upload_ring,
+                                        texture,
+                                        width, height,
+                                        format,
+                                        rowstride,
+                                        data);
+
+  if (source_bmp)
+    {
+      ret = _cogl_texture_set_region_from_bitmap (texture,
+                                                  0, 0,
+                                                  width, height,
+                                                  source_bmp,
+                                                  dst_x, dst_y,
+                                                  level,
+                                                  error);
+
+      _cogl_upload_ring_release (ctx->upload_ring, source_bmp);
+
+      return ret;
+    }
+
   /* Init source bitmap */
   source_bmp = cogl_bitmap_new_for_data (ctx,
                                          width, height,
@@ -303,6 +303,10 @@ typedef struct _CoglTextureVertex       CoglTextureVertex;
  * @COGL_PIXEL_FORMAT_RGBA_5551: RGBA, 16 bits
  * @COGL_PIXEL_FORMAT_YUV: Not currently supported
  * @COGL_PIXEL_FORMAT_G_8: Single luminance component
+ * @COGL_PIXEL_FORMAT_RG_88: RG, 16 bits. Note that red-green textures
+ *   are only available if %COGL_FEATURE_ID_TEXTURE_RG is advertised.
+ *   Otherwise the texture will be stored as %COGL_PIXEL_FORMAT_RGB_888
+ *   with the blue component set to zero. (Since 2.0)
  * @COGL_PIXEL_FORMAT_RGB_888: RGB, 24 bits
  * @COGL_PIXEL_FORMAT_BGR_888: BGR, 24 bits
  * @COGL_PIXEL_FORMAT_RGBA_8888: RGBA, 32 bits
@@ -355,6 +359,8 @@ typedef enum { /*< prefix=COGL_PIXEL_FORMAT >*/
   COGL_PIXEL_FORMAT_YUV           = 7,
   COGL_PIXEL_FORMAT_G_8           = 8,
 
+  COGL_PIXEL_FORMAT_RG_88         = 9,
+
   COGL_PIXEL_FORMAT_RGB_888       = 2,
   COGL_PIXEL_FORMAT_BGR_888       = (2 | COGL_BGR_BIT),
 
@@ -664,6 +670,9 @@ _cogl_system_error_quark (void);
  * @COGL_ATTRIBUTE_TYPE_UNSIGNED_SHORT: Data is the same size of
  *   an unsigned short integer
  * @COGL_ATTRIBUTE_TYPE_FLOAT: Data is the same size of a float
+ * @COGL_ATTRIBUTE_TYPE_HALF_FLOAT: Data is a 16-bit half precision
+ *   float. This can only be used if the
+ *   %COGL_FEATURE_ID_HALF_FLOAT_VERTEX feature is available. (Since 2.0)
  *
  * Data types for the components of a vertex attribute.
  *
@@ -674,7 +683,8 @@ typedef enum {
   COGL_ATTRIBUTE_TYPE_UNSIGNED_BYTE  = 0x1401,
   COGL_ATTRIBUTE_TYPE_SHORT          = 0x1402,
   COGL_ATTRIBUTE_TYPE_UNSIGNED_SHORT = 0x1403,
-  COGL_ATTRIBUTE_TYPE_FLOAT          = 0x1406
+  COGL_ATTRIBUTE_TYPE_FLOAT          = 0x1406,
+  COGL_ATTRIBUTE_TYPE_HALF_FLOAT     = 0x140B
 } CoglAttributeType;
 
 /**
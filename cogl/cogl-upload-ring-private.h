@@ -0,0 +1,75 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2013 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#ifndef __COGL_UPLOAD_RING_PRIVATE_H
+#define __COGL_UPLOAD_RING_PRIVATE_H
+
+#include "cogl-context.h"
+#include "cogl-texture.h"
+#include "cogl-bitmap.h"
+
+/* The upload ring is a set of pixel buffers owned by the context
+ * that texture data is copied into before being uploaded. This lets
+ * GL transfer the data to the texture asynchronously instead of
+ * having to copy it out of client memory before glTexSubImage2D
+ * returns. Each slot is protected by a fence so that it is only
+ * reused once the GPU has finished reading from it */
+
+typedef struct _CoglUploadRing CoglUploadRing;
+
+CoglUploadRing *
+_cogl_upload_ring_new (CoglContext *context);
+
+void
+_cogl_upload_ring_free (CoglUploadRing *ring);
+
+/* Copies the given data into a free slot of the ring and returns a
+ * bitmap that refers to it. NULL is returned if the data can't be
+ * staged for @texture or if no slot is free in which case the caller
+ * should upload directly from the data. Once the upload from the
+ * bitmap has been submitted it must be passed back to
+ * _cogl_upload_ring_release() */
+CoglBitmap *
+_cogl_upload_ring_stage (CoglUploadRing *ring,
+                         CoglTexture *texture,
+                         int width,
+                         int height,
+                         CoglPixelFormat format,
+                         int rowstride,
+                         const uint8_t *data);
+
+/* Marks the slot used by @bitmap as busy until all of the GPU
+ * commands submitted so far have completed and drops the reference
+ * on the bitmap */
+void
+_cogl_upload_ring_release (CoglUploadRing *ring,
+                           CoglBitmap *bitmap);
+
+/* Called once per frame. This frees the buffers of any slots that
+ * haven't been used for the last few frames so that a burst of
+ * uploads doesn't keep the memory alive for the lifetime of the
+ * context */
+void
+_cogl_upload_ring_trim (CoglUploadRing *ring);
+
+#endif /* __COGL_UPLOAD_RING_PRIVATE_H */
@@ -0,0 +1,297 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2013 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "cogl-util.h"
+#include "cogl-upload-ring-private.h"
+#include "cogl-context-private.h"
+#include "cogl-private.h"
+#include "cogl-fence-private.h"
+#include "cogl-pixel-buffer.h"
+#include "cogl-buffer-private.h"
+#include "cogl-bitmap-private.h"
+#include "cogl-primitive-texture.h"
+#include "cogl-texture-private.h"
+#include "cogl-error-private.h"
+
+#define COGL_UPLOAD_RING_N_SLOTS 8
+
+/* Small uploads aren't worth the overhead of going through a
+ * buffer */
+#define COGL_UPLOAD_RING_MIN_SIZE 4096
+/* Limit how much memory each slot can hold on to */
+#define COGL_UPLOAD_RING_MAX_SIZE (4 * 1024 * 1024)
+/* Number of frames a slot can go unused before its buffer is freed */
+#define COGL_UPLOAD_RING_MAX_IDLE_FRAMES 3
+
+typedef struct
+{
+  CoglPixelBuffer *buffer;
+
+  /* The fence that must be reached before the buffer can be written
+   * to again. fence_type is FENCE_TYPE_PENDING when there is no
+   * outstanding upload */
+  CoglFenceType fence_type;
+  void *fence_obj;
+
+  /* The value of the ring's frame counter when the slot was last
+   * staged into */
+  unsigned int last_used_frame;
+} CoglUploadRingSlot;
+
+struct _CoglUploadRing
+{
+  CoglContext *context;
+
+  CoglUploadRingSlot slots[COGL_UPLOAD_RING_N_SLOTS];
+  /* The slot that was least recently used */
+  int next_slot;
+
+  /* Incremented by _cogl_upload_ring_trim() once per frame */
+  unsigned int frame;
+};
+
+CoglUploadRing *
+_cogl_upload_ring_new (CoglContext *context)
+{
+  CoglUploadRing *ring = g_slice_new0 (CoglUploadRing);
+  int i;
+
+  ring->context = context;
+
+  for (i = 0; i < COGL_UPLOAD_RING_N_SLOTS; i++)
+    ring->slots[i].fence_type = FENCE_TYPE_PENDING;
+
+  return ring;
+}
+
+static void
+clear_slot_fence (CoglUploadRing *ring,
+                  CoglUploadRingSlot *slot)
+{
+  if (slot->fence_type != FENCE_TYPE_PENDING)
+    {
+      _cogl_fence_destroy (ring->context, slot->fence_type, slot->fence_obj);
+      slot->fence_type = FENCE_TYPE_PENDING;
+      slot->fence_obj = NULL;
+    }
+}
+
+void
+_cogl_upload_ring_free (CoglUploadRing *ring)
+{
+  int i;
+
+  for (i = 0; i < COGL_UPLOAD_RING_N_SLOTS; i++)
+    {
+      CoglUploadRingSlot *slot = &ring->slots[i];
+
+      clear_slot_fence (ring, slot);
+
+      if (slot->buffer)
+        cogl_object_unref (slot->buffer);
+    }
+
+  g_slice_free (CoglUploadRing, ring);
+}
+
+static CoglBool
+can_stage_upload (CoglUploadRing *ring,
+                  CoglTexture *texture,
+                  CoglPixelFormat format,
+                  size_t size)
+{
+  CoglContext *ctx = ring->context;
+
+  if (!(ctx->private_feature_flags & COGL_PRIVATE_FEATURE_PBOS))
+    return FALSE;
+
+  if (size < COGL_UPLOAD_RING_MIN_SIZE || size > COGL_UPLOAD_RING_MAX_SIZE)
+    return FALSE;
+
+  /* Meta textures may need to convert or split up the data on the
+   * CPU which would mean reading back from the buffer */
+  if (!cogl_is_primitive_texture (texture))
+    return FALSE;
+
+  /* Likewise we only want to stage data that GL can upload without
+   * Cogl having to convert it first */
+  if (format != cogl_texture_get_format (texture) ||
+      ctx->driver_vtable->pixel_format_to_gl (ctx,
+                                              format,
+                                              NULL, /* internal format */
+                                              NULL, /* gl format */
+                                              NULL /* gl type */) != format)
+    return FALSE;
+
+  return TRUE;
+}
+
+CoglBitmap *
+_cogl_upload_ring_stage (CoglUploadRing *ring,
+                         CoglTexture *texture,
+                         int width,
+                         int height,
+                         CoglPixelFormat format,
+                         int rowstride,
+                         const uint8_t *data)
+{
+  CoglUploadRingSlot *slot;
+  int bpp = _cogl_pixel_format_get_bytes_per_pixel (format);
+  int packed_rowstride = width * bpp;
+  size_t size = (size_t) packed_rowstride * height;
+  CoglError *ignore_error = NULL;
+  uint8_t *dst;
+  int y;
+
+  if (!can_stage_upload (ring, texture, format, size))
+    return NULL;
+
+  /* The slots are used in order so if the oldest one is still busy
+   * then all of the others will be too. Rather than waiting we let
+   * the caller upload directly */
+  slot = &ring->slots[ring->next_slot];
+
+  if (slot->fence_type != FENCE_TYPE_PENDING)
+    {
+      if (!_cogl_fence_is_complete (ring->context,
+                                    slot->fence_type,
+                                    slot->fence_obj))
+        return NULL;
+
+      clear_slot_fence (ring, slot);
+    }
+
+  if (slot->buffer &&
+      cogl_buffer_get_size (COGL_BUFFER (slot->buffer)) < size)
+    {
+      cogl_object_unref (slot->buffer);
+      slot->buffer = NULL;
+    }
+
+  if (slot->buffer == NULL)
+    {
+      /* Round up the size so that the buffer is likely to be big
+       * enough for subsequent uploads of a similar size */
+      size_t buffer_size = MIN ((size_t) 1 << g_bit_storage (size - 1),
+                                COGL_UPLOAD_RING_MAX_SIZE);
+
+      slot->buffer = cogl_pixel_buffer_new (ring->context,
+                                            buffer_size,
+                                            NULL);
+      cogl_buffer_set_update_hint (COGL_BUFFER (slot->buffer),
+                                   COGL_BUFFER_UPDATE_HINT_STREAM);
+    }
+
+  dst = cogl_buffer_map_range (COGL_BUFFER (slot->buffer),
+                               0, /* offset */
+                               size,
+                               COGL_BUFFER_ACCESS_WRITE,
+                               COGL_BUFFER_MAP_HINT_DISCARD,
+                               &ignore_error);
+  if (dst == NULL)
+    {
+      cogl_error_free (ignore_error);
+      return NULL;
+    }
+
+  if (rowstride == packed_rowstride)
+    memcpy (dst, data, size);
+  else
+    for (y = 0; y < height; y++)
+      memcpy (dst + y * packed_rowstride,
+              data + y * rowstride,
+              packed_rowstride);
+
+  cogl_buffer_unmap (COGL_BUFFER (slot->buffer));
+
+  slot->last_used_frame = ring->frame;
+  ring->next_slot = (ring->next_slot + 1) % COGL_UPLOAD_RING_N_SLOTS;
+
+  return cogl_bitmap_new_from_buffer (COGL_BUFFER (slot->buffer),
+                                      format,
+                                      width, height,
+                                      packed_rowstride,
+                                      0 /* offset */);
+}
+
+void
+_cogl_upload_ring_release (CoglUploadRing *ring,
+                           CoglBitmap *bitmap)
+{
+  CoglPixelBuffer *buffer = cogl_bitmap_get_buffer (bitmap);
+  int i;
+
+  for (i = 0; i < COGL_UPLOAD_RING_N_SLOTS; i++)
+    {
+      CoglUploadRingSlot *slot = &ring->slots[i];
+
+      if (slot->buffer == buffer)
+        {
+          clear_slot_fence (ring, slot);
+          slot->fence_type = _cogl_fence_insert (ring->context,
+                                                 &slot->fence_obj);
+          break;
+        }
+    }
+
+  cogl_object_unref (bitmap);
+}
+
+void
+_cogl_upload_ring_trim (CoglUploadRing *ring)
+{
+  int i;
+
+  ring->frame++;
+
+  for (i = 0; i < COGL_UPLOAD_RING_N_SLOTS; i++)
+    {
+      CoglUploadRingSlot *slot = &ring->slots[i];
+
+      if (slot->buffer == NULL ||
+          ring->frame - slot->last_used_frame <=
+          COGL_UPLOAD_RING_MAX_IDLE_FRAMES)
+        continue;
+
+      /* Don't free the buffer while the GPU may still be reading
+       * from it. It will be checked again next frame */
+      if (slot->fence_type != FENCE_TYPE_PENDING)
+        {
+          if (!_cogl_fence_is_complete (ring->context,
+                                        slot->fence_type,
+                                        slot->fence_obj))
+            continue;
+
+          clear_slot_fence (ring, slot);
+        }
+
+      cogl_object_unref (slot->buffer);
+      slot->buffer = NULL;
+    }
+}
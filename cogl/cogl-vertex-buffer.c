@@ -370,6 +370,8 @@ sizeof_attribute_type (CoglAttributeType type)
       return 2;
     case COGL_ATTRIBUTE_TYPE_FLOAT:
       return 4;
+    case COGL_ATTRIBUTE_TYPE_HALF_FLOAT:
+      return 2;
     }
   g_return_val_if_reached (0);
 }
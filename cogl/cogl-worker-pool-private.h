@@ -0,0 +1,74 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2013 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _COGL_WORKER_POOL_PRIVATE_H_
+#define _COGL_WORKER_POOL_PRIVATE_H_
+
+#include "cogl-types.h"
+
+/*
+ * CoglWorkerPool:
+ *
+ * A small pool of threads that Cogl can use to split up expensive
+ * CPU-only work such as converting large bitmaps. The jobs must not
+ * call any Cogl API or touch any GL state because that is only
+ * allowed on the thread that owns the context.
+ *
+ * Worker pools are only available when Cogl is built with GLib
+ * support. Otherwise _cogl_worker_pool_new() will always return NULL
+ * and all of the functions that take a pool accept NULL to mean that
+ * the work should just be done on the calling thread.
+ */
+typedef struct _CoglWorkerPool CoglWorkerPool;
+
+typedef void (* CoglWorkerPoolJobFunc) (int job_index,
+                                        void *user_data);
+
+CoglWorkerPool *
+_cogl_worker_pool_new (int n_threads);
+
+void
+_cogl_worker_pool_free (CoglWorkerPool *pool);
+
+int
+_cogl_worker_pool_get_n_threads (CoglWorkerPool *pool);
+
+/*
+ * _cogl_worker_pool_run:
+ * @pool: A #CoglWorkerPool or %NULL
+ * @n_jobs: The number of jobs to run
+ * @func: The function to call for each job
+ * @user_data: Private data to pass to @func
+ *
+ * Calls @func once for every job index in [0, @n_jobs) and waits for
+ * all of them to complete. The calling thread runs one of the jobs
+ * itself so there is no point in passing more than
+ * _cogl_worker_pool_get_n_threads() + 1 jobs.
+ */
+void
+_cogl_worker_pool_run (CoglWorkerPool *pool,
+                       int n_jobs,
+                       CoglWorkerPoolJobFunc func,
+                       void *user_data);
+
+#endif /* _COGL_WORKER_POOL_PRIVATE_H_ */
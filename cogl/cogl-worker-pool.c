@@ -0,0 +1,224 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2013 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <glib.h>
+#include <string.h>
+
+#include <test-fixtures/test-unit.h>
+
+#include "cogl-worker-pool-private.h"
+
+#ifdef COGL_HAS_GLIB_SUPPORT
+
+struct _CoglWorkerPool
+{
+  GThreadPool *thread_pool;
+  int n_threads;
+};
+
+/* State for one call to _cogl_worker_pool_run. This lives on the
+   stack of the calling thread which waits for n_pending to reach zero
+   before returning */
+typedef struct
+{
+  CoglWorkerPoolJobFunc func;
+  void *user_data;
+
+  GMutex mutex;
+  GCond cond;
+  int n_pending;
+} CoglWorkerPoolBatch;
+
+typedef struct
+{
+  CoglWorkerPoolBatch *batch;
+  int job_index;
+} CoglWorkerPoolJob;
+
+static void
+_cogl_worker_pool_thread_func (void *data,
+                               void *user_data)
+{
+  CoglWorkerPoolJob *job = data;
+  CoglWorkerPoolBatch *batch = job->batch;
+
+  batch->func (job->job_index, batch->user_data);
+
+  g_mutex_lock (&batch->mutex);
+  if (--batch->n_pending == 0)
+    g_cond_signal (&batch->cond);
+  g_mutex_unlock (&batch->mutex);
+}
+
+CoglWorkerPool *
+_cogl_worker_pool_new (int n_threads)
+{
+  CoglWorkerPool *pool;
+  GThreadPool *thread_pool;
+
+  if (n_threads <= 0)
+    return NULL;
+
+  thread_pool = g_thread_pool_new (_cogl_worker_pool_thread_func,
+                                   NULL, /* user_data */
+                                   n_threads,
+                                   FALSE, /* not exclusive */
+                                   NULL /* error */);
+  if (thread_pool == NULL)
+    return NULL;
+
+  pool = g_slice_new (CoglWorkerPool);
+  pool->thread_pool = thread_pool;
+  pool->n_threads = n_threads;
+
+  return pool;
+}
+
+void
+_cogl_worker_pool_free (CoglWorkerPool *pool)
+{
+  g_thread_pool_free (pool->thread_pool,
+                      FALSE, /* don't drop queued jobs */
+                      TRUE /* wait */);
+  g_slice_free (CoglWorkerPool, pool);
+}
+
+int
+_cogl_worker_pool_get_n_threads (CoglWorkerPool *pool)
+{
+  return pool ? pool->n_threads : 0;
+}
+
+void
+_cogl_worker_pool_run (CoglWorkerPool *pool,
+                       int n_jobs,
+                       CoglWorkerPoolJobFunc func,
+                       void *user_data)
+{
+  CoglWorkerPoolBatch batch;
+  CoglWorkerPoolJob *jobs;
+  int i;
+
+  if (pool == NULL || n_jobs <= 1)
+    {
+      for (i = 0; i < n_jobs; i++)
+        func (i, user_data);
+      return;
+    }
+
+  batch.func = func;
+  batch.user_data = user_data;
+  g_mutex_init (&batch.mutex);
+  g_cond_init (&batch.cond);
+  batch.n_pending = n_jobs - 1;
+
+  jobs = g_new (CoglWorkerPoolJob, n_jobs);
+
+  for (i = 1; i < n_jobs; i++)
+    {
+      jobs[i].batch = &batch;
+      jobs[i].job_index = i;
+      g_thread_pool_push (pool->thread_pool, jobs + i, NULL);
+    }
+
+  /* Do the first job ourselves rather than just waiting */
+  func (0, user_data);
+
+  g_mutex_lock (&batch.mutex);
+  while (batch.n_pending > 0)
+    g_cond_wait (&batch.cond, &batch.mutex);
+  g_mutex_unlock (&batch.mutex);
+
+  g_mutex_clear (&batch.mutex);
+  g_cond_clear (&batch.cond);
+
+  g_free (jobs);
+}
+
+#else /* COGL_HAS_GLIB_SUPPORT */
+
+CoglWorkerPool *
+_cogl_worker_pool_new (int n_threads)
+{
+  return NULL;
+}
+
+void
+_cogl_worker_pool_free (CoglWorkerPool *pool)
+{
+}
+
+int
+_cogl_worker_pool_get_n_threads (CoglWorkerPool *pool)
+{
+  return 0;
+}
+
+void
+_cogl_worker_pool_run (CoglWorkerPool *pool,
+                       int n_jobs,
+                       CoglWorkerPoolJobFunc func,
+                       void *user_data)
+{
+  int i;
+
+  for (i = 0; i < n_jobs; i++)
+    func (i, user_data);
+}
+
+#endif /* COGL_HAS_GLIB_SUPPORT */
+
+static void
+count_job_cb (int job_index,
+              void *user_data)
+{
+  int *counts = user_data;
+
+  g_atomic_int_inc (counts + job_index);
+}
+
+UNIT_TEST (check_worker_pool_runs_all_jobs,
+           0 /* no requirements */,
+           0 /* no failure cases */)
+{
+  CoglWorkerPool *pool = _cogl_worker_pool_new (3);
+  int counts[8];
+  int n_jobs, i;
+
+  for (n_jobs = 0; n_jobs <= G_N_ELEMENTS (counts); n_jobs++)
+    {
+      memset (counts, 0, sizeof (counts));
+
+      _cogl_worker_pool_run (pool, n_jobs, count_job_cb, counts);
+
+      for (i = 0; i < G_N_ELEMENTS (counts); i++)
+        g_assert_cmpint (counts[i], ==, i < n_jobs ? 1 : 0);
+    }
+
+  if (pool)
+    _cogl_worker_pool_free (pool);
+}
@@ -42,6 +42,10 @@
 #include "cogl-pipeline-progend-glsl-private.h"
 #include "cogl-buffer-gl-private.h"
 
+#ifndef GL_HALF_FLOAT_OES
+#define GL_HALF_FLOAT_OES 0x8D61
+#endif
+
 typedef struct _ForeachChangedBitState
 {
   CoglContext *context;
@@ -127,6 +131,21 @@ toggle_custom_attribute_enabled_cb (int bit_num, void *user_data)
   return TRUE;
 }
 
+static CoglBool
+toggle_instanced_attribute_cb (int bit_num, void *user_data)
+{
+  ForeachChangedBitState *state = user_data;
+  CoglContext *context = state->context;
+
+  /* Divisors for newly instanced attributes have already been set
+   * when the attribute pointer was set up so we only need to reset
+   * the divisor for attributes that are no longer instanced */
+  if (!_cogl_bitmask_get (state->new_bits, bit_num))
+    GE( context, glVertexAttribDivisor (bit_num, 0) );
+
+  return TRUE;
+}
+
 static void
 foreach_changed_bit_and_save (CoglContext *context,
                               CoglBitmask *current_bits,
@@ -161,18 +180,33 @@ setup_generic_buffered_attribute (CoglContext *context,
   int name_index = attribute->name_state->name_index;
   int attrib_location =
     _cogl_pipeline_progend_glsl_get_attrib_location (pipeline, name_index);
+  GLenum type = attribute->d.buffered.type;
 
   if (attrib_location == -1)
     return;
 
+  /* GL_OES_vertex_half_float uses a different enum from the one in
+   * big GL which is the one used by CoglAttributeType */
+  if (type == COGL_ATTRIBUTE_TYPE_HALF_FLOAT &&
+      context->driver == COGL_DRIVER_GLES2)
+    type = GL_HALF_FLOAT_OES;
+
   GE( context, glVertexAttribPointer (attrib_location,
                                       attribute->d.buffered.n_components,
-                                      attribute->d.buffered.type,
+                                      type,
                                       attribute->normalized,
                                       attribute->d.buffered.stride,
                                       base + attribute->d.buffered.offset) );
   _cogl_bitmask_set (&context->enable_custom_attributes_tmp,
                      attrib_location, TRUE);
+
+  if (attribute->instance_divisor)
+    {
+      GE( context, glVertexAttribDivisor (attrib_location,
+                                          attribute->instance_divisor) );
+      _cogl_bitmask_set (&context->instanced_custom_attributes_tmp,
+                         attrib_location, TRUE);
+    }
 }
 
 static void
@@ -382,6 +416,13 @@ apply_attribute_enable_updates (CoglContext *context,
                                 &context->enable_custom_attributes_tmp,
                                 toggle_custom_attribute_enabled_cb,
                                 &changed_bits_state);
+
+  changed_bits_state.new_bits = &context->instanced_custom_attributes_tmp;
+  foreach_changed_bit_and_save (context,
+                                &context->instanced_custom_attributes,
+                                &context->instanced_custom_attributes_tmp,
+                                toggle_instanced_attribute_cb,
+                                &changed_bits_state);
 }
 
 void
@@ -469,6 +510,7 @@ _cogl_gl_flush_attributes_state (CoglFramebuffer *framebuffer,
   _cogl_bitmask_clear_all (&ctx->enable_builtin_attributes_tmp);
   _cogl_bitmask_clear_all (&ctx->enable_texcoord_attributes_tmp);
   _cogl_bitmask_clear_all (&ctx->enable_custom_attributes_tmp);
+  _cogl_bitmask_clear_all (&ctx->instanced_custom_attributes_tmp);
 
   /* Bind the attribute pointers. We need to do this after the
    * pipeline is flushed because when using GLSL that is the only
@@ -524,6 +566,7 @@ _cogl_gl_disable_all_attributes (CoglContext *ctx)
   _cogl_bitmask_clear_all (&ctx->enable_builtin_attributes_tmp);
   _cogl_bitmask_clear_all (&ctx->enable_texcoord_attributes_tmp);
   _cogl_bitmask_clear_all (&ctx->enable_custom_attributes_tmp);
+  _cogl_bitmask_clear_all (&ctx->instanced_custom_attributes_tmp);
 
   /* XXX: we can pass a NULL source pipeline here because we know a
    * source pipeline only needs to be referenced when enabling
@@ -71,6 +71,9 @@
 #ifndef GL_MAP_INVALIDATE_BUFFER_BIT
 #define GL_MAP_INVALIDATE_BUFFER_BIT 0x0008
 #endif
+#ifndef GL_MAP_UNSYNCHRONIZED_BIT
+#define GL_MAP_UNSYNCHRONIZED_BIT 0x0020
+#endif
 
 void
 _cogl_buffer_gl_create (CoglBuffer *buffer)
@@ -265,6 +268,10 @@ _cogl_buffer_gl_map_range (CoglBuffer *buffer,
                !(access & COGL_BUFFER_ACCESS_READ))
         gl_access |= GL_MAP_INVALIDATE_RANGE_BIT;
 
+      if ((hints & COGL_BUFFER_MAP_HINT_UNSYNCHRONIZED) &&
+          !(access & COGL_BUFFER_ACCESS_READ))
+        gl_access |= GL_MAP_UNSYNCHRONIZED_BIT;
+
       if (should_recreate_store)
         {
           if (!recreate_store (buffer, error))
@@ -1095,6 +1095,27 @@ _cogl_framebuffer_gl_draw_attributes (CoglFramebuffer *framebuffer,
       glDrawArrays ((GLenum)mode, first_vertex, n_vertices));
 }
 
+void
+_cogl_framebuffer_gl_draw_instanced_attributes (CoglFramebuffer *framebuffer,
+                                                CoglPipeline *pipeline,
+                                                CoglVerticesMode mode,
+                                                int first_vertex,
+                                                int n_vertices,
+                                                int n_instances,
+                                                CoglAttribute **attributes,
+                                                int n_attributes,
+                                                CoglDrawFlags flags)
+{
+  _cogl_flush_attributes_state (framebuffer, pipeline, flags,
+                                attributes, n_attributes);
+
+  GE (framebuffer->context,
+      glDrawArraysInstanced ((GLenum)mode,
+                             first_vertex,
+                             n_vertices,
+                             n_instances));
+}
+
 static size_t
 sizeof_index_type (CoglIndicesType type)
 {
@@ -1485,38 +1506,8 @@ _cogl_framebuffer_gl_read_pixels_into_bitmap (CoglFramebuffer *framebuffer,
       (source & COGL_READ_PIXELS_NO_FLIP) == 0 &&
       !pack_invert_set)
     {
-      uint8_t *temprow;
-      int rowstride;
-      uint8_t *pixels;
-
-      rowstride = cogl_bitmap_get_rowstride (bitmap);
-      pixels = _cogl_bitmap_map (bitmap,
-                                 COGL_BUFFER_ACCESS_READ |
-                                 COGL_BUFFER_ACCESS_WRITE,
-                                 0, /* hints */
-                                 error);
-
-      if (pixels == NULL)
+      if (!_cogl_bitmap_flip_vertically (bitmap, error))
         goto EXIT;
-
-      temprow = g_alloca (rowstride * sizeof (uint8_t));
-
-      /* vertically flip the buffer in-place */
-      for (y = 0; y < height / 2; y++)
-        {
-          if (y != height - y - 1) /* skip center row */
-            {
-              memcpy (temprow,
-                      pixels + y * rowstride, rowstride);
-              memcpy (pixels + y * rowstride,
-                      pixels + (height - y - 1) * rowstride, rowstride);
-              memcpy (pixels + (height - y - 1) * rowstride,
-                      temprow,
-                      rowstride);
-            }
-        }
-
-      _cogl_bitmap_unmap (bitmap);
     }
 
   status = TRUE;
@@ -87,6 +87,8 @@ typedef struct
   int ref_count;
 
   GLuint gl_shader;
+  /* Whether glCompileShader has been called for gl_shader */
+  CoglBool compiled;
   GString *header, *source;
   UnitState *unit_state;
 
@@ -168,6 +170,20 @@ _cogl_pipeline_fragend_glsl_get_shader (CoglPipeline *pipeline)
     return 0;
 }
 
+void
+_cogl_pipeline_fragend_glsl_ensure_compiled (CoglPipeline *pipeline)
+{
+  CoglPipelineShaderState *shader_state = get_shader_state (pipeline);
+
+  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
+
+  if (shader_state && shader_state->gl_shader && !shader_state->compiled)
+    {
+      _cogl_glsl_shader_compile (ctx, shader_state->gl_shader);
+      shader_state->compiled = TRUE;
+    }
+}
+
 static CoglPipelineSnippetList *
 get_fragment_snippets (CoglPipeline *pipeline)
 {
@@ -335,6 +351,7 @@ _cogl_pipeline_fragend_glsl_start (CoglPipeline *pipeline,
             {
               GE( ctx, glDeleteShader (shader_state->gl_shader) );
               shader_state->gl_shader = 0;
+              shader_state->compiled = FALSE;
             }
           return;
         }
@@ -981,7 +998,6 @@ _cogl_pipeline_fragend_glsl_end (CoglPipeline *pipeline,
     {
       const char *source_strings[2];
       GLint lengths[2];
-      GLint compile_status;
       GLuint shader;
       CoglPipelineSnippetData snippet_data;
 
@@ -1052,18 +1068,13 @@ _cogl_pipeline_fragend_glsl_end (CoglPipeline *pipeline,
                                                      2, /* count */
                                                      source_strings, lengths);
 
-      GE( ctx, glCompileShader (shader) );
-      GE( ctx, glGetShaderiv (shader, GL_COMPILE_STATUS, &compile_status) );
-
-      if (!compile_status)
+      /* If there is a program binary cache then the program might
+       * be loaded without needing the shader to be compiled so it is
+       * left to the progend to compile it when it links */
+      if (ctx->program_binary_cache == NULL)
         {
-          GLint len = 0;
-          char *shader_log;
-
-          GE( ctx, glGetShaderiv (shader, GL_INFO_LOG_LENGTH, &len) );
-          shader_log = g_alloca (len);
-          GE( ctx, glGetShaderInfoLog (shader, len, &len, shader_log) );
-          g_warning ("Shader compilation failed:\n%s", shader_log);
+          _cogl_glsl_shader_compile (ctx, shader);
+          shader_state->compiled = TRUE;
         }
 
       shader_state->header = NULL;
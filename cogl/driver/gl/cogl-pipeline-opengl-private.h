@@ -148,5 +148,13 @@ _cogl_pipeline_flush_gl_state (CoglContext *context,
                                CoglBool skip_gl_state,
                                CoglBool unknown_color_alpha);
 
+/*
+ * Generates the programs for @pipeline without flushing any of its
+ * state so that they will be ready by the time it is used.
+ */
+void
+_cogl_pipeline_precompile_gl (CoglContext *context,
+                              CoglPipeline *pipeline);
+
 #endif /* __COGL_PIPELINE_OPENGL_PRIVATE_H */
 
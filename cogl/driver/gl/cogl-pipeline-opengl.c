@@ -1147,6 +1147,103 @@ fragend_add_layer_cb (CoglPipelineLayer *layer,
   return TRUE;
 }
 
+/* Runs the progend, vertend and fragend for the pipeline, falling
+ * back to the next progend if any of them can't handle it. If
+ * @precompile is TRUE then the progend's precompile function is
+ * called instead of end() so that the program will only be generated
+ * without flushing it */
+static void
+flush_backends (CoglPipeline *pipeline,
+                CoglFramebuffer *framebuffer,
+                int n_layers,
+                unsigned long pipelines_difference,
+                unsigned long *layer_differences,
+                CoglBool precompile)
+{
+  const CoglPipelineProgend *progend;
+  int i;
+
+  if (pipeline->progend == COGL_PIPELINE_PROGEND_UNDEFINED)
+    _cogl_pipeline_set_progend (pipeline, COGL_PIPELINE_PROGEND_DEFAULT);
+
+  for (i = pipeline->progend;
+       i < COGL_PIPELINE_N_PROGENDS;
+       i++, _cogl_pipeline_set_progend (pipeline, i))
+    {
+      const CoglPipelineVertend *vertend;
+      const CoglPipelineFragend *fragend;
+      CoglPipelineAddLayerState state;
+
+      progend = _cogl_pipeline_progends[i];
+
+      if (G_UNLIKELY (!progend->start (pipeline)))
+        continue;
+
+      vertend = _cogl_pipeline_vertends[progend->vertend];
+
+      vertend->start (pipeline,
+                      n_layers,
+                      pipelines_difference);
+
+      state.framebuffer = framebuffer;
+      state.vertend = vertend;
+      state.pipeline = pipeline;
+      state.layer_differences = layer_differences;
+      state.error_adding_layer = FALSE;
+      state.added_layer = FALSE;
+
+      _cogl_pipeline_foreach_layer_internal (pipeline,
+                                             vertend_add_layer_cb,
+                                             &state);
+
+      if (G_UNLIKELY (state.error_adding_layer))
+        continue;
+
+      if (G_UNLIKELY (!vertend->end (pipeline, pipelines_difference)))
+        continue;
+
+      /* Now prepare the fragment processing state (fragend)
+       *
+       * NB: We can't combine the setup of the vertend and fragend
+       * since the backends that do code generation share
+       * ctx->codegen_source_buffer as a scratch buffer.
+       */
+
+      fragend = _cogl_pipeline_fragends[progend->fragend];
+      state.fragend = fragend;
+
+      fragend->start (pipeline,
+                      n_layers,
+                      pipelines_difference);
+
+      _cogl_pipeline_foreach_layer_internal (pipeline,
+                                             fragend_add_layer_cb,
+                                             &state);
+
+      if (G_UNLIKELY (state.error_adding_layer))
+        continue;
+
+      if (!state.added_layer)
+        {
+          if (fragend->passthrough &&
+              G_UNLIKELY (!fragend->passthrough (pipeline)))
+            continue;
+        }
+
+      if (G_UNLIKELY (!fragend->end (pipeline, pipelines_difference)))
+        continue;
+
+      if (precompile)
+        {
+          if (progend->precompile)
+            progend->precompile (pipeline);
+        }
+      else if (progend->end)
+        progend->end (pipeline, pipelines_difference);
+      break;
+    }
+}
+
 /*
  * _cogl_pipeline_flush_gl_state:
  *
@@ -1208,7 +1305,6 @@ _cogl_pipeline_flush_gl_state (CoglContext *ctx,
   unsigned long pipelines_difference;
   int n_layers;
   unsigned long *layer_differences;
-  int i;
   CoglTextureUnit *unit1;
   const CoglPipelineProgend *progend;
 
@@ -1323,80 +1419,12 @@ _cogl_pipeline_flush_gl_state (CoglContext *ctx,
    * with the given progend so we will simply use that to avoid
    * fallback code paths.
    */
-  if (pipeline->progend == COGL_PIPELINE_PROGEND_UNDEFINED)
-    _cogl_pipeline_set_progend (pipeline, COGL_PIPELINE_PROGEND_DEFAULT);
-
-  for (i = pipeline->progend;
-       i < COGL_PIPELINE_N_PROGENDS;
-       i++, _cogl_pipeline_set_progend (pipeline, i))
-    {
-      const CoglPipelineVertend *vertend;
-      const CoglPipelineFragend *fragend;
-      CoglPipelineAddLayerState state;
-
-      progend = _cogl_pipeline_progends[i];
-
-      if (G_UNLIKELY (!progend->start (pipeline)))
-        continue;
-
-      vertend = _cogl_pipeline_vertends[progend->vertend];
-
-      vertend->start (pipeline,
-                      n_layers,
-                      pipelines_difference);
-
-      state.framebuffer = framebuffer;
-      state.vertend = vertend;
-      state.pipeline = pipeline;
-      state.layer_differences = layer_differences;
-      state.error_adding_layer = FALSE;
-      state.added_layer = FALSE;
-
-      _cogl_pipeline_foreach_layer_internal (pipeline,
-                                             vertend_add_layer_cb,
-                                             &state);
-
-      if (G_UNLIKELY (state.error_adding_layer))
-        continue;
-
-      if (G_UNLIKELY (!vertend->end (pipeline, pipelines_difference)))
-        continue;
-
-      /* Now prepare the fragment processing state (fragend)
-       *
-       * NB: We can't combine the setup of the vertend and fragend
-       * since the backends that do code generation share
-       * ctx->codegen_source_buffer as a scratch buffer.
-       */
-
-      fragend = _cogl_pipeline_fragends[progend->fragend];
-      state.fragend = fragend;
-
-      fragend->start (pipeline,
-                      n_layers,
-                      pipelines_difference);
-
-      _cogl_pipeline_foreach_layer_internal (pipeline,
-                                             fragend_add_layer_cb,
-                                             &state);
-
-      if (G_UNLIKELY (state.error_adding_layer))
-        continue;
-
-      if (!state.added_layer)
-        {
-          if (fragend->passthrough &&
-              G_UNLIKELY (!fragend->passthrough (pipeline)))
-            continue;
-        }
-
-      if (G_UNLIKELY (!fragend->end (pipeline, pipelines_difference)))
-        continue;
-
-      if (progend->end)
-        progend->end (pipeline, pipelines_difference);
-      break;
-    }
+  flush_backends (pipeline,
+                  framebuffer,
+                  n_layers,
+                  pipelines_difference,
+                  layer_differences,
+                  FALSE /* not precompiling */);
 
   /* FIXME: This reference is actually resulting in lots of
    * copy-on-write reparenting because one-shot pipelines end up
@@ -1471,3 +1499,35 @@ done:
   COGL_TIMER_STOP (_cogl_uprof_context, pipeline_flush_timer);
 }
 
+void
+_cogl_pipeline_precompile_gl (CoglContext *ctx,
+                              CoglPipeline *pipeline)
+{
+  int n_layers = cogl_pipeline_get_n_layers (pipeline);
+  unsigned long *layer_differences = NULL;
+
+  /* The differences are all zero so that the backends will only
+   * generate code and won't try to update any GL state for the
+   * pipeline */
+  if (n_layers)
+    {
+      layer_differences = g_alloca (sizeof (unsigned long) * n_layers);
+      memset (layer_differences, 0, sizeof (unsigned long) * n_layers);
+    }
+
+  flush_backends (pipeline,
+                  NULL, /* framebuffer */
+                  n_layers,
+                  0, /* pipelines_difference */
+                  layer_differences,
+                  TRUE /* precompiling */);
+
+  /* Some backends bind their program as a side effect of generating
+   * it so make sure the next flush doesn't assume the state of the
+   * current pipeline is still valid */
+  if (ctx->current_pipeline)
+    {
+      cogl_object_unref (ctx->current_pipeline);
+      ctx->current_pipeline = NULL;
+    }
+}
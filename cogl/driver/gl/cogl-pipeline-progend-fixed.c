@@ -100,7 +100,9 @@ const CoglPipelineProgend _cogl_pipeline_fixed_progend =
     NULL, /* end */
     NULL, /* pre_change_notify */
     NULL, /* layer_pre_change_notify */
-    _cogl_pipeline_progend_fixed_pre_paint
+    _cogl_pipeline_progend_fixed_pre_paint,
+    NULL, /* precompile */
+    NULL /* is_ready */
   };
 
 #endif /* COGL_PIPELINE_PROGEND_FIXED */
@@ -50,6 +50,15 @@
 #include "cogl-attribute-private.h"
 #include "cogl-framebuffer-private.h"
 #include "cogl-pipeline-progend-glsl-private.h"
+#include "cogl-glsl-shader-private.h"
+#include "cogl-program-binary-cache-private.h"
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
 
 /* These are used to generalise updating some uniforms that are
    required when building for drivers missing some fixed function
@@ -109,6 +118,21 @@ typedef struct
 
   GLuint program;
 
+  /* Set from when the program is created until the link status has
+     been checked and the uniform locations have been queried. This
+     is done lazily so that a precompiled program can be linked in the
+     background by the driver */
+  CoglBool link_pending;
+  /* Set by finish_program() until the uniform and attribute locations
+     have been queried for the newly linked program. This is separate
+     from link_pending because the link may be finished by
+     _cogl_pipeline_progend_glsl_is_ready() outside of a flush */
+  CoglBool needs_uniform_setup;
+
+  /* The key to save the program binary with once it is linked or
+     NULL if it shouldn't be saved */
+  GString *binary_key;
+
   unsigned long dirty_builtin_uniforms;
   GLint builtin_uniform_locations[G_N_ELEMENTS (builtin_uniforms)];
 
@@ -235,6 +259,9 @@ program_state_new (int n_layers)
   program_state = g_slice_new (CoglPipelineProgramState);
   program_state->ref_count = 1;
   program_state->program = 0;
+  program_state->link_pending = FALSE;
+  program_state->needs_uniform_setup = FALSE;
+  program_state->binary_key = NULL;
   program_state->unit_state = g_new (UnitState, n_layers);
   program_state->uniform_locations = NULL;
   program_state->attribute_locations = NULL;
@@ -269,6 +296,9 @@ destroy_program_state (void *user_data,
       if (program_state->program)
         GE( ctx, glDeleteProgram (program_state->program) );
 
+      if (program_state->binary_key)
+        g_string_free (program_state->binary_key, TRUE);
+
       g_free (program_state->unit_state);
 
       if (program_state->uniform_locations)
@@ -297,22 +327,33 @@ dirty_program_state (CoglPipeline *pipeline)
                              NULL);
 }
 
-static void
-link_program (GLint gl_program)
+static CoglBool
+check_link_status (CoglContext *ctx,
+                   GLuint gl_program)
 {
   GLint link_status;
 
-  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
-
-  GE( ctx, glLinkProgram (gl_program) );
-
   GE( ctx, glGetProgramiv (gl_program, GL_LINK_STATUS, &link_status) );
 
   if (!link_status)
     {
+      GLuint shaders[8];
+      GLsizei n_shaders;
       GLint log_length;
       GLsizei out_log_length;
       char *log;
+      int i;
+
+      /* The compile status of the shaders isn't checked when they
+       * are compiled so that the driver can do it in the background.
+       * A failed compile will also make the link fail so this is
+       * the time to report it */
+      GE( ctx, glGetAttachedShaders (gl_program,
+                                     G_N_ELEMENTS (shaders),
+                                     &n_shaders,
+                                     shaders) );
+      for (i = 0; i < n_shaders; i++)
+        _cogl_glsl_shader_check_compile_status (ctx, shaders[i]);
 
       GE( ctx, glGetProgramiv (gl_program, GL_INFO_LOG_LENGTH, &log_length) );
 
@@ -326,6 +367,141 @@ link_program (GLint gl_program)
 
       g_free (log);
     }
+
+  return link_status;
+}
+
+static void
+attach_shaders (CoglContext *ctx,
+                CoglPipeline *pipeline,
+                CoglPipelineProgramState *program_state,
+                CoglProgram *user_program,
+                int n_backend_shaders,
+                const GLuint *backend_shaders)
+{
+  GSList *l;
+  int i;
+
+  /* Attach all of the shader from the user program */
+  if (user_program)
+    {
+      for (l = user_program->attached_shaders; l; l = l->next)
+        {
+          CoglShader *shader = l->data;
+
+          _cogl_shader_compile_real (shader, pipeline);
+
+          g_assert (shader->language == COGL_SHADER_LANGUAGE_GLSL);
+
+          GE( ctx, glAttachShader (program_state->program,
+                                   shader->gl_handle) );
+        }
+
+      program_state->user_program_age = user_program->age;
+    }
+
+  /* When there is a program binary cache the vertend and fragend
+   * leave compiling their shaders to us */
+  if (ctx->program_binary_cache)
+    {
+      _cogl_pipeline_fragend_glsl_ensure_compiled (pipeline);
+      _cogl_pipeline_vertend_glsl_ensure_compiled (pipeline);
+    }
+
+  /* Attach any shaders from the GLSL backends */
+  for (i = 0; i < n_backend_shaders; i++)
+    GE( ctx, glAttachShader (program_state->program, backend_shaders[i]) );
+
+  /* XXX: OpenGL as a special case requires the vertex position to
+   * be bound to generic attribute 0 so for simplicity we
+   * unconditionally bind the cogl_position_in attribute here...
+   */
+  GE( ctx, glBindAttribLocation (program_state->program,
+                                 0, "cogl_position_in"));
+}
+
+/* Creates the GL program for a program state and either loads it from
+ * the binary cache or starts linking it. The link status isn't
+ * checked here so that when GL_KHR_parallel_shader_compile is
+ * available the driver can link in the background. finish_program()
+ * must be called before the program is used */
+static void
+start_program (CoglContext *ctx,
+               CoglPipeline *pipeline,
+               CoglPipelineProgramState *program_state,
+               CoglProgram *user_program)
+{
+  GLuint backend_shaders[2];
+  int n_backend_shaders = 0;
+
+  GE_RET( program_state->program, ctx, glCreateProgram () );
+
+  program_state->link_pending = TRUE;
+
+  if ((backend_shaders[n_backend_shaders] =
+       _cogl_pipeline_fragend_glsl_get_shader (pipeline)))
+    n_backend_shaders++;
+  if ((backend_shaders[n_backend_shaders] =
+       _cogl_pipeline_vertend_glsl_get_shader (pipeline)))
+    n_backend_shaders++;
+
+  /* Programs using a CoglProgram aren't cached because the user
+   * shaders are compiled separately */
+  if (ctx->program_binary_cache && user_program == NULL)
+    {
+      GString *binary_key =
+        _cogl_program_binary_cache_make_key (ctx->program_binary_cache,
+                                             n_backend_shaders,
+                                             backend_shaders);
+
+      if (_cogl_program_binary_cache_load (ctx->program_binary_cache,
+                                           program_state->program,
+                                           binary_key))
+        {
+          g_string_free (binary_key, TRUE);
+          return;
+        }
+
+      /* Keep the key so the binary can be saved once it is linked */
+      program_state->binary_key = binary_key;
+
+      /* Desktop GL drivers are allowed to return an empty binary
+       * unless they are told before linking that it will be
+       * retrieved. GLES doesn't have the hint and always keeps it */
+      if (ctx->glProgramParameteri)
+        GE( ctx, glProgramParameteri (program_state->program,
+                                      GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                                      GL_TRUE) );
+    }
+
+  attach_shaders (ctx,
+                  pipeline,
+                  program_state,
+                  user_program,
+                  n_backend_shaders,
+                  backend_shaders);
+
+  GE( ctx, glLinkProgram (program_state->program) );
+}
+
+static void
+finish_program (CoglContext *ctx,
+                CoglPipelineProgramState *program_state)
+{
+  if (check_link_status (ctx, program_state->program) &&
+      program_state->binary_key)
+    _cogl_program_binary_cache_save (ctx->program_binary_cache,
+                                     program_state->program,
+                                     program_state->binary_key);
+
+  if (program_state->binary_key)
+    {
+      g_string_free (program_state->binary_key, TRUE);
+      program_state->binary_key = NULL;
+    }
+
+  program_state->link_pending = FALSE;
+  program_state->needs_uniform_setup = TRUE;
 }
 
 typedef struct
@@ -632,19 +808,17 @@ _cogl_pipeline_progend_glsl_start (CoglPipeline *pipeline)
   return TRUE;
 }
 
-static void
-_cogl_pipeline_progend_glsl_end (CoglPipeline *pipeline,
-                                 unsigned long pipelines_difference)
+/* Gets the program state for the pipeline, sharing it with an
+ * equivalent pipeline if possible, and makes sure the GL program has
+ * at least been started */
+static CoglPipelineProgramState *
+ensure_program_started (CoglContext *ctx,
+                        CoglPipeline *pipeline)
 {
   CoglPipelineProgramState *program_state;
-  GLuint gl_program;
-  CoglBool program_changed = FALSE;
-  UpdateUniformsState state;
   CoglProgram *user_program;
   CoglPipeline *template_pipeline = NULL;
 
-  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
-
   program_state = get_program_state (pipeline);
 
   user_program = cogl_pipeline_get_user_program (pipeline);
@@ -709,48 +883,42 @@ _cogl_pipeline_progend_glsl_end (CoglPipeline *pipeline,
     {
       GE( ctx, glDeleteProgram (program_state->program) );
       program_state->program = 0;
-    }
 
-  if (program_state->program == 0)
-    {
-      GLuint backend_shader;
-      GSList *l;
-
-      GE_RET( program_state->program, ctx, glCreateProgram () );
-
-      /* Attach all of the shader from the user program */
-      if (user_program)
+      if (program_state->binary_key)
         {
-          for (l = user_program->attached_shaders; l; l = l->next)
-            {
-              CoglShader *shader = l->data;
+          g_string_free (program_state->binary_key, TRUE);
+          program_state->binary_key = NULL;
+        }
+    }
 
-              _cogl_shader_compile_real (shader, pipeline);
+  if (program_state->program == 0)
+    start_program (ctx, pipeline, program_state, user_program);
 
-              g_assert (shader->language == COGL_SHADER_LANGUAGE_GLSL);
+  return program_state;
+}
 
-              GE( ctx, glAttachShader (program_state->program,
-                                       shader->gl_handle) );
-            }
+static void
+_cogl_pipeline_progend_glsl_end (CoglPipeline *pipeline,
+                                 unsigned long pipelines_difference)
+{
+  CoglPipelineProgramState *program_state;
+  GLuint gl_program;
+  CoglBool program_changed = FALSE;
+  UpdateUniformsState state;
+  CoglProgram *user_program;
 
-          program_state->user_program_age = user_program->age;
-        }
+  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
 
-      /* Attach any shaders from the GLSL backends */
-      if ((backend_shader = _cogl_pipeline_fragend_glsl_get_shader (pipeline)))
-        GE( ctx, glAttachShader (program_state->program, backend_shader) );
-      if ((backend_shader = _cogl_pipeline_vertend_glsl_get_shader (pipeline)))
-        GE( ctx, glAttachShader (program_state->program, backend_shader) );
+  user_program = cogl_pipeline_get_user_program (pipeline);
 
-      /* XXX: OpenGL as a special case requires the vertex position to
-       * be bound to generic attribute 0 so for simplicity we
-       * unconditionally bind the cogl_position_in attribute here...
-       */
-      GE( ctx, glBindAttribLocation (program_state->program,
-                                     0, "cogl_position_in"));
+  program_state = ensure_program_started (ctx, pipeline);
 
-      link_program (program_state->program);
+  if (program_state->link_pending)
+    finish_program (ctx, program_state);
 
+  if (program_state->needs_uniform_setup)
+    {
+      program_state->needs_uniform_setup = FALSE;
       program_changed = TRUE;
     }
 
@@ -1038,6 +1206,47 @@ update_float_uniform (CoglPipeline *pipeline,
   GE( ctx, glUniform1f (uniform_location, value) );
 }
 
+static void
+_cogl_pipeline_progend_glsl_precompile (CoglPipeline *pipeline)
+{
+  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
+
+  ensure_program_started (ctx, pipeline);
+}
+
+static CoglBool
+_cogl_pipeline_progend_glsl_is_ready (CoglPipeline *pipeline)
+{
+  CoglPipelineProgramState *program_state = get_program_state (pipeline);
+  GLint completion_status;
+
+  _COGL_GET_CONTEXT (ctx, FALSE);
+
+  if (program_state == NULL || program_state->program == 0)
+    return FALSE;
+
+  if (!program_state->link_pending)
+    return TRUE;
+
+  /* Without GL_KHR_parallel_shader_compile there is no way to find out
+   * whether the driver has finished linking without waiting for it */
+  if (ctx->glMaxShaderCompilerThreads)
+    {
+      GE( ctx, glGetProgramiv (program_state->program,
+                               GL_COMPLETION_STATUS_KHR,
+                               &completion_status) );
+
+      if (!completion_status)
+        return FALSE;
+    }
+
+  /* The link has finished so this won't block unless the extension
+   * isn't available */
+  finish_program (ctx, program_state);
+
+  return TRUE;
+}
+
 const CoglPipelineProgend _cogl_pipeline_glsl_progend =
   {
     COGL_PIPELINE_VERTEND_GLSL,
@@ -1046,7 +1255,9 @@ const CoglPipelineProgend _cogl_pipeline_glsl_progend =
     _cogl_pipeline_progend_glsl_end,
     _cogl_pipeline_progend_glsl_pre_change_notify,
     _cogl_pipeline_progend_glsl_layer_pre_change_notify,
-    _cogl_pipeline_progend_glsl_pre_paint
+    _cogl_pipeline_progend_glsl_pre_paint,
+    _cogl_pipeline_progend_glsl_precompile,
+    _cogl_pipeline_progend_glsl_is_ready
   };
 
 #endif /* COGL_PIPELINE_PROGEND_GLSL */
@@ -35,5 +35,11 @@ extern const CoglPipelineVertend _cogl_pipeline_glsl_vertend;
 GLuint
 _cogl_pipeline_vertend_glsl_get_shader (CoglPipeline *pipeline);
 
+/* The shader isn't compiled when there is a program binary cache in
+ * case the program can be loaded without it. This must be called
+ * before linking the shader into a program */
+void
+_cogl_pipeline_vertend_glsl_ensure_compiled (CoglPipeline *pipeline);
+
 #endif /* __COGL_PIPELINE_VERTEND_GLSL_PRIVATE_H */
 
@@ -0,0 +1,103 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2013 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#ifndef __COGL_PROGRAM_BINARY_CACHE_PRIVATE_H
+#define __COGL_PROGRAM_BINARY_CACHE_PRIVATE_H
+
+#include "cogl-context.h"
+#include "cogl-gl-header.h"
+
+typedef struct _CoglProgramBinaryCache CoglProgramBinaryCache;
+
+/*
+ * _cogl_program_binary_cache_new:
+ * @context: A #CoglContext
+ * @directory: The directory to store the program binaries in. This
+ *   will be created if it doesn't already exist.
+ *
+ * Creates a cache that stores linked GLSL programs on disk so that
+ * they can be reloaded by later processes instead of compiling and
+ * linking the shaders again.
+ *
+ * Return value: a new cache or %NULL if the driver doesn't support
+ *   retrieving program binaries.
+ */
+CoglProgramBinaryCache *
+_cogl_program_binary_cache_new (CoglContext *context,
+                                const char *directory);
+
+void
+_cogl_program_binary_cache_free (CoglProgramBinaryCache *cache);
+
+/*
+ * _cogl_program_binary_cache_make_key:
+ * @cache: A #CoglProgramBinaryCache
+ * @n_shaders: The number of shaders in @shaders
+ * @shaders: The GL shader objects that will be linked into the program
+ *
+ * Builds the key used to look up a program. This contains the source
+ * of all of the shaders as well as a description of the GPU and
+ * driver so that binaries will never be shared between drivers. The
+ * shaders don't need to have been compiled yet.
+ *
+ * Return value: the key which should be freed with g_string_free().
+ */
+GString *
+_cogl_program_binary_cache_make_key (CoglProgramBinaryCache *cache,
+                                     int n_shaders,
+                                     const GLuint *shaders);
+
+/*
+ * _cogl_program_binary_cache_load:
+ * @cache: A #CoglProgramBinaryCache
+ * @program: An unlinked GL program object
+ * @key: A key created with _cogl_program_binary_cache_make_key()
+ *
+ * Tries to load a previously saved binary for @key into @program. If
+ * the binary is missing, corrupt or rejected by the driver then this
+ * will return %FALSE and the program should be linked normally.
+ *
+ * Return value: %TRUE if @program is now successfully linked.
+ */
+CoglBool
+_cogl_program_binary_cache_load (CoglProgramBinaryCache *cache,
+                                 GLuint program,
+                                 GString *key);
+
+/*
+ * _cogl_program_binary_cache_save:
+ * @cache: A #CoglProgramBinaryCache
+ * @program: A successfully linked GL program object
+ * @key: A key created with _cogl_program_binary_cache_make_key()
+ *
+ * Stores the binary for @program on disk so that a later call to
+ * _cogl_program_binary_cache_load() with the same key can use it.
+ * Failing to write the file is not considered an error.
+ */
+void
+_cogl_program_binary_cache_save (CoglProgramBinaryCache *cache,
+                                 GLuint program,
+                                 GString *key);
+
+#endif /* __COGL_PROGRAM_BINARY_CACHE_PRIVATE_H */
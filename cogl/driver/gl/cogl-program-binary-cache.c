@@ -0,0 +1,313 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2013 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "cogl-util.h"
+#include "cogl-context-private.h"
+#include "cogl-util-gl-private.h"
+#include "cogl-program-binary-cache-private.h"
+
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#ifndef GL_PROGRAM_BINARY_FORMATS
+#define GL_PROGRAM_BINARY_FORMATS 0x87FF
+#endif
+
+/* This should be bumped whenever the layout of the files changes */
+#define COGL_PROGRAM_BINARY_MAGIC "COGLPB01"
+
+struct _CoglProgramBinaryCache
+{
+  CoglContext *context;
+
+  char *directory;
+
+  /* Description of the GPU, driver and Cogl version. This is
+   * prepended to every key so that a binary will never be given to a
+   * driver other than the one that created it */
+  char *identity;
+
+  int n_formats;
+  GLint *formats;
+};
+
+/* Header at the start of every file in the cache. The full key is
+ * stored after the header followed by the program binary. Storing
+ * the whole key means a collision in the file name is detected
+ * instead of loading the wrong program */
+typedef struct
+{
+  char magic[8];
+  uint32_t key_length;
+  uint32_t binary_format;
+  uint32_t binary_length;
+} CoglProgramBinaryHeader;
+
+CoglProgramBinaryCache *
+_cogl_program_binary_cache_new (CoglContext *context,
+                                const char *directory)
+{
+  CoglProgramBinaryCache *cache;
+  GLint n_formats = 0;
+
+  if (!context->glGetProgramBinary || !context->glProgramBinary)
+    return NULL;
+
+  /* Some drivers expose the extension but don't support any formats */
+  GE( context, glGetIntegerv (GL_NUM_PROGRAM_BINARY_FORMATS, &n_formats) );
+  if (n_formats <= 0)
+    return NULL;
+
+  if (g_mkdir_with_parents (directory, 0700) == -1)
+    {
+      g_warning ("Failed to create the program cache directory \"%s\"",
+                 directory);
+      return NULL;
+    }
+
+  cache = g_slice_new (CoglProgramBinaryCache);
+  cache->context = context;
+  cache->directory = g_strdup (directory);
+  cache->n_formats = n_formats;
+  cache->formats = g_new (GLint, n_formats);
+  GE( context, glGetIntegerv (GL_PROGRAM_BINARY_FORMATS, cache->formats) );
+
+  cache->identity =
+    g_strdup_printf ("cogl " PACKAGE_VERSION "\n"
+                     "%s\n%s\n%s\n"
+                     "%s %i\n"
+                     "glsl %i\n",
+                     (const char *) context->glGetString (GL_VENDOR),
+                     (const char *) context->glGetString (GL_RENDERER),
+                     _cogl_context_get_gl_version (context),
+                     context->gpu.driver_package_name,
+                     context->gpu.driver_package_version,
+                     context->glsl_version_to_use);
+
+  return cache;
+}
+
+void
+_cogl_program_binary_cache_free (CoglProgramBinaryCache *cache)
+{
+  g_free (cache->directory);
+  g_free (cache->identity);
+  g_free (cache->formats);
+  g_slice_free (CoglProgramBinaryCache, cache);
+}
+
+GString *
+_cogl_program_binary_cache_make_key (CoglProgramBinaryCache *cache,
+                                     int n_shaders,
+                                     const GLuint *shaders)
+{
+  CoglContext *ctx = cache->context;
+  GString *key = g_string_new (cache->identity);
+  int i;
+
+  for (i = 0; i < n_shaders; i++)
+    {
+      GLint source_length = 0;
+      GLint shader_type;
+      GLsizei length = 0;
+      size_t start;
+
+      GE( ctx, glGetShaderiv (shaders[i], GL_SHADER_TYPE, &shader_type) );
+      GE( ctx, glGetShaderiv (shaders[i],
+                              GL_SHADER_SOURCE_LENGTH,
+                              &source_length) );
+
+      g_string_append_printf (key, "\nshader 0x%x %i\n",
+                              shader_type, source_length);
+
+      if (source_length <= 0)
+        continue;
+
+      /* The source length includes the null terminator */
+      start = key->len;
+      g_string_set_size (key, start + source_length);
+      GE( ctx, glGetShaderSource (shaders[i],
+                                  source_length,
+                                  &length,
+                                  key->str + start) );
+      g_string_set_size (key, start + length);
+    }
+
+  return key;
+}
+
+static char *
+get_filename (CoglProgramBinaryCache *cache,
+              GString *key)
+{
+  unsigned int hash_a, hash_b;
+  char *basename, *filename;
+
+  /* Two hashes with different seeds are used to make collisions in
+   * the file name less likely. They would still be caught by
+   * comparing the stored key */
+  hash_a = _cogl_util_one_at_a_time_hash (0, key->str, key->len);
+  hash_a = _cogl_util_one_at_a_time_mix (hash_a);
+  hash_b = _cogl_util_one_at_a_time_hash (0x9e3779b9, key->str, key->len);
+  hash_b = _cogl_util_one_at_a_time_mix (hash_b);
+
+  basename = g_strdup_printf ("%08x%08x.bin", hash_a, hash_b);
+  filename = g_build_filename (cache->directory, basename, NULL);
+  g_free (basename);
+
+  return filename;
+}
+
+static CoglBool
+is_supported_format (CoglProgramBinaryCache *cache,
+                     GLenum format)
+{
+  int i;
+
+  for (i = 0; i < cache->n_formats; i++)
+    if (cache->formats[i] == format)
+      return TRUE;
+
+  return FALSE;
+}
+
+CoglBool
+_cogl_program_binary_cache_load (CoglProgramBinaryCache *cache,
+                                 GLuint program,
+                                 GString *key)
+{
+  CoglContext *ctx = cache->context;
+  CoglProgramBinaryHeader header;
+  char *filename = get_filename (cache, key);
+  char *contents = NULL;
+  gsize length;
+  GLint link_status = FALSE;
+
+  if (!g_file_get_contents (filename, &contents, &length, NULL))
+    goto out;
+
+  if (length < sizeof (header))
+    goto mismatch;
+
+  memcpy (&header, contents, sizeof (header));
+
+  if (memcmp (header.magic,
+              COGL_PROGRAM_BINARY_MAGIC,
+              sizeof (header.magic)) ||
+      header.key_length != key->len ||
+      length != sizeof (header) + header.key_length + header.binary_length ||
+      memcmp (contents + sizeof (header), key->str, key->len) ||
+      !is_supported_format (cache, header.binary_format))
+    goto mismatch;
+
+  GE( ctx, glProgramBinary (program,
+                            header.binary_format,
+                            contents + sizeof (header) + header.key_length,
+                            header.binary_length) );
+  GE( ctx, glGetProgramiv (program, GL_LINK_STATUS, &link_status) );
+
+  /* The driver is allowed to reject a binary for any reason, for
+   * example if it has been updated since the binary was saved. The
+   * caller will just link the program normally and then replace the
+   * file */
+  if (!link_status)
+    goto mismatch;
+
+  COGL_NOTE (PERFORMANCE, "Loaded program binary from %s", filename);
+
+  goto out;
+
+ mismatch:
+  COGL_NOTE (PERFORMANCE,
+             "Ignoring stale or invalid program binary %s", filename);
+
+ out:
+  g_free (contents);
+  g_free (filename);
+
+  return link_status;
+}
+
+void
+_cogl_program_binary_cache_save (CoglProgramBinaryCache *cache,
+                                 GLuint program,
+                                 GString *key)
+{
+  CoglContext *ctx = cache->context;
+  CoglProgramBinaryHeader header;
+  GLint binary_length = 0;
+  GLsizei length = 0;
+  GLenum binary_format;
+  char *filename;
+  char *contents;
+
+  GE( ctx, glGetProgramiv (program,
+                           GL_PROGRAM_BINARY_LENGTH,
+                           &binary_length) );
+  if (binary_length <= 0)
+    return;
+
+  contents = g_malloc (sizeof (header) + key->len + binary_length);
+
+  GE( ctx, glGetProgramBinary (program,
+                               binary_length,
+                               &length,
+                               &binary_format,
+                               contents + sizeof (header) + key->len) );
+  if (length <= 0)
+    {
+      g_free (contents);
+      return;
+    }
+
+  memcpy (header.magic, COGL_PROGRAM_BINARY_MAGIC, sizeof (header.magic));
+  header.key_length = key->len;
+  header.binary_format = binary_format;
+  header.binary_length = length;
+
+  memcpy (contents, &header, sizeof (header));
+  memcpy (contents + sizeof (header), key->str, key->len);
+
+  filename = get_filename (cache, key);
+
+  /* g_file_set_contents writes to a temporary file and renames it so
+   * another process will never see a partially written binary */
+  if (!g_file_set_contents (filename,
+                            contents,
+                            sizeof (header) + key->len + length,
+                            NULL))
+    COGL_NOTE (PERFORMANCE, "Failed to save program binary %s", filename);
+
+  g_free (filename);
+  g_free (contents);
+}
@@ -90,6 +90,19 @@ _cogl_framebuffer_nop_draw_attributes (CoglFramebuffer *framebuffer,
 {
 }
 
+void
+_cogl_framebuffer_nop_draw_instanced_attributes (CoglFramebuffer *framebuffer,
+                                                 CoglPipeline *pipeline,
+                                                 CoglVerticesMode mode,
+                                                 int first_vertex,
+                                                 int n_vertices,
+                                                 int n_instances,
+                                                 CoglAttribute **attributes,
+                                                 int n_attributes,
+                                                 CoglDrawFlags flags)
+{
+}
+
 void
 _cogl_framebuffer_nop_draw_indexed_attributes (CoglFramebuffer *framebuffer,
                                                CoglPipeline *pipeline,
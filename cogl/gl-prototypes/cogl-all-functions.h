@@ -298,6 +298,57 @@ COGL_EXT_FUNCTION (GLvoid *, glMapBufferRange,
                     GLbitfield access))
 COGL_EXT_END ()
 
+COGL_EXT_BEGIN (get_program_binary, 4, 1,
+                0, /* not in either GLES */
+                "ARB:\0OES\0",
+                "get_program_binary\0")
+COGL_EXT_FUNCTION (void, glGetProgramBinary,
+                   (GLuint program,
+                    GLsizei bufSize,
+                    GLsizei *length,
+                    GLenum *binaryFormat,
+                    GLvoid *binary))
+COGL_EXT_FUNCTION (void, glProgramBinary,
+                   (GLuint program,
+                    GLenum binaryFormat,
+                    const GLvoid *binary,
+                    GLint length))
+COGL_EXT_END ()
+
+/* GL_OES_get_program_binary doesn't have glProgramParameteri so it
+ * is checked separately from the rest of the extension */
+COGL_EXT_BEGIN (program_parameteri, 4, 1,
+                0, /* not in either GLES */
+                "ARB:\0",
+                "get_program_binary\0")
+COGL_EXT_FUNCTION (void, glProgramParameteri,
+                   (GLuint program,
+                    GLenum pname,
+                    GLint value))
+COGL_EXT_END ()
+
+COGL_EXT_BEGIN (parallel_shader_compile, 255, 255,
+                0, /* not in either GLES */
+                "KHR\0ARB\0",
+                "parallel_shader_compile\0")
+COGL_EXT_FUNCTION (void, glMaxShaderCompilerThreads,
+                   (GLuint count))
+COGL_EXT_END ()
+
+COGL_EXT_BEGIN (instanced_arrays, 3, 3,
+                0, /* not in either GLES */
+                "ARB\0ANGLE\0EXT\0NV\0",
+                "instanced_arrays\0")
+COGL_EXT_FUNCTION (void, glDrawArraysInstanced,
+                   (GLenum mode,
+                    GLint first,
+                    GLsizei count,
+                    GLsizei primcount))
+COGL_EXT_FUNCTION (void, glVertexAttribDivisor,
+                   (GLuint index,
+                    GLuint divisor))
+COGL_EXT_END ()
+
 #ifdef GL_ARB_sync
 COGL_EXT_BEGIN (sync, 3, 2,
                 0, /* not in either GLES */
@@ -343,6 +343,38 @@ test_utils_create_color_texture (CoglContext *context,
   return COGL_TEXTURE (tex_2d);
 }
 
+CoglTexture *
+test_utils_create_quadrant_texture (CoglContext *context)
+{
+  static const uint8_t data[] =
+    {
+      0xff, 0x00, 0x00, 0xff,   0x00, 0xff, 0x00, 0xff,
+      0x00, 0x00, 0xff, 0xff,   0xff, 0xff, 0xff, 0xff
+    };
+
+  return test_utils_texture_new_from_data (context,
+                                           2, 2, /* width/height */
+                                           TEST_UTILS_TEXTURE_NO_ATLAS,
+                                           COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                           COGL_PIXEL_FORMAT_ANY,
+                                           8, /* rowstride */
+                                           data);
+}
+
+void
+test_utils_check_quadrants (CoglFramebuffer *framebuffer,
+                            int x, int y,
+                            uint32_t top_left,
+                            uint32_t top_right,
+                            uint32_t bottom_left,
+                            uint32_t bottom_right)
+{
+  test_utils_check_region (framebuffer, x + 2, y + 2, 6, 6, top_left);
+  test_utils_check_region (framebuffer, x + 12, y + 2, 6, 6, top_right);
+  test_utils_check_region (framebuffer, x + 2, y + 12, 6, 6, bottom_left);
+  test_utils_check_region (framebuffer, x + 12, y + 12, 6, 6, bottom_right);
+}
+
 CoglBool
 cogl_test_verbose (void)
 {
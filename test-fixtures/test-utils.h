@@ -253,6 +253,40 @@ CoglTexture *
 test_utils_create_color_texture (CoglContext *context,
                                  uint32_t color);
 
+/*
+ * test_utils_create_quadrant_texture:
+ * @context: A #CoglContext
+ *
+ * Creates a 2x2-pixel RGBA texture with a different color in each
+ * texel. The top row is red and green and the bottom row is blue and
+ * white. The texture is never put in an atlas.
+ */
+CoglTexture *
+test_utils_create_quadrant_texture (CoglContext *context);
+
+/*
+ * test_utils_check_quadrants:
+ * @framebuffer: The #CoglFramebuffer to read from
+ * @x: x co-ordinate of a 20x20 square
+ * @y: y co-ordinate of a 20x20 square
+ * @top_left: The expected RGBA value of the top left quadrant
+ * @top_right: The expected RGBA value of the top right quadrant
+ * @bottom_left: The expected RGBA value of the bottom left quadrant
+ * @bottom_right: The expected RGBA value of the bottom right quadrant
+ *
+ * Checks that each 10x10 quadrant of the square is filled with the
+ * given color, ignoring a 2 pixel border around each quadrant. This
+ * is useful to check a square drawn with the texture from
+ * test_utils_create_quadrant_texture() using nearest filtering.
+ */
+void
+test_utils_check_quadrants (CoglFramebuffer *framebuffer,
+                            int x, int y,
+                            uint32_t top_left,
+                            uint32_t top_right,
+                            uint32_t bottom_left,
+                            uint32_t bottom_right);
+
 /* cogl_test_verbose:
  *
  * Queries if the user asked for verbose output or not.
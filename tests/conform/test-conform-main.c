@@ -59,6 +59,10 @@ main (int argc, char **argv)
   UNPORTED_TEST (test_readpixels);
 #ifdef COGL_HAS_COGL_PATH_SUPPORT
   ADD_TEST (test_path, 0, 0);
+#endif
+#ifdef COGL_HAS_COGL_PANGO_SUPPORT
+  ADD_TEST (test_pango_glyph_cache, 0, 0);
+  ADD_TEST (test_pango_glyph_regions, 0, 0);
 #endif
   ADD_TEST (test_depth_test, 0, 0);
   ADD_TEST (test_color_mask, 0, 0);
@@ -127,10 +131,18 @@ main (int argc, char **argv)
   ADD_TEST (test_map_buffer_range, TEST_REQUIREMENT_MAP_WRITE, 0);
 
   ADD_TEST (test_primitive_and_journal, 0, 0);
+  ADD_TEST (test_journal_primitives, 0, 0);
+  ADD_TEST (test_journal_reorder, 0, 0);
+  ADD_TEST (test_journal_instanced, 0, 0);
+  ADD_TEST (test_journal_compact, 0, 0);
+  ADD_TEST (test_journal_cull, 0, 0);
+  ADD_TEST (test_draw_list, 0, 0);
+  ADD_TEST (test_stream_buffer, 0, 0);
 
   ADD_TEST (test_copy_replace_texture, 0, 0);
 
   ADD_TEST (test_pipeline_cache_unrefs_texture, 0, 0);
+  ADD_TEST (test_pipeline_manifest, TEST_REQUIREMENT_GLSL, 0);
 
   UNPORTED_TEST (test_viewport);
 
@@ -144,8 +156,17 @@ main (int argc, char **argv)
   ADD_TEST (test_color_hsl, 0, 0);
 
   ADD_TEST (test_fence, TEST_REQUIREMENT_FENCE, 0);
+  ADD_TEST (test_read_pixels_async, TEST_REQUIREMENT_FENCE, 0);
+
+  ADD_TEST (test_pipeline_precompile, TEST_REQUIREMENT_GLSL, 0);
+#ifdef COGL_HAS_GLIB_SUPPORT
+  ADD_TEST (test_program_binary_cache,
+            TEST_REQUIREMENT_GLSL | TEST_REQUIREMENT_OFFSCREEN,
+            0);
+#endif
 
   ADD_TEST (test_texture_no_allocate, 0, 0);
+  ADD_TEST (test_texture_upload_ring, 0, 0);
 
   g_printerr ("Unknown test name \"%s\"\n", argv[1]);
 
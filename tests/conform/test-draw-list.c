@@ -0,0 +1,150 @@
+#include <cogl/cogl.h>
+
+#include "test-utils.h"
+
+static CoglTexture *
+create_texture (TestUtilsTextureFlags flags)
+{
+  /* A 2x1 texture with a red and a green texel */
+  static const uint8_t data[] =
+    {
+      0xff, 0x00, 0x00, 0xff,   0x00, 0xff, 0x00, 0xff
+    };
+
+  return test_utils_texture_new_from_data (test_ctx,
+                                           2, 1, /* width/height */
+                                           flags,
+                                           COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                           COGL_PIXEL_FORMAT_ANY,
+                                           8, /* rowstride */
+                                           data);
+}
+
+static CoglPipeline *
+create_texture_pipeline (CoglTexture *texture)
+{
+  CoglPipeline *pipeline = cogl_pipeline_new (test_ctx);
+
+  cogl_pipeline_set_layer_texture (pipeline, 0, texture);
+  cogl_pipeline_set_layer_filters (pipeline, 0,
+                                   COGL_PIPELINE_FILTER_NEAREST,
+                                   COGL_PIPELINE_FILTER_NEAREST);
+
+  return pipeline;
+}
+
+static CoglDrawList *
+record_list (void)
+{
+  static const CoglVertexP2 verts[] =
+    {
+      { 0, 0 }, { 0, 10 }, { 10, 0 }, { 10, 10 }
+    };
+  CoglDrawList *list = cogl_draw_list_new (test_ctx);
+  CoglPipeline *blue = cogl_pipeline_new (test_ctx);
+  CoglPipeline *yellow = cogl_pipeline_new (test_ctx);
+  CoglTexture *plain_texture, *atlas_texture;
+  CoglPipeline *plain_pipeline, *atlas_pipeline;
+  CoglPrimitive *primitive;
+
+  cogl_pipeline_set_color4ub (blue, 0x00, 0x00, 0xff, 0xff);
+  cogl_pipeline_set_color4ub (yellow, 0xff, 0xff, 0x00, 0xff);
+
+  plain_texture = create_texture (TEST_UTILS_TEXTURE_NO_ATLAS);
+  plain_pipeline = create_texture_pipeline (plain_texture);
+  /* This texture may end up in the atlas in which case the rectangle
+   * can't be batched */
+  atlas_texture = create_texture (TEST_UTILS_TEXTURE_NONE);
+  atlas_pipeline = create_texture_pipeline (atlas_texture);
+
+  /* Two rectangles which should end up in the same batch */
+  cogl_draw_list_draw_rectangle (list, blue, 0, 0, 10, 10);
+  cogl_draw_list_push_matrix (list);
+  cogl_draw_list_translate (list, 10, 0, 0);
+  cogl_draw_list_draw_rectangle (list, blue, 0, 0, 10, 10);
+  cogl_draw_list_pop_matrix (list);
+
+  cogl_draw_list_draw_textured_rectangle (list, plain_pipeline,
+                                          20, 0, 40, 10,
+                                          0, 0, 1, 1);
+  cogl_draw_list_draw_textured_rectangle (list, atlas_pipeline,
+                                          40, 0, 60, 10,
+                                          0, 0, 1, 1);
+
+  /* A clipped rectangle where only the left half should be visible */
+  cogl_draw_list_push_rectangle_clip (list, 60, 0, 65, 10);
+  cogl_draw_list_draw_rectangle (list, yellow, 60, 0, 70, 10);
+  cogl_draw_list_pop_clip (list);
+
+  /* A primitive drawn with a transformation */
+  primitive = cogl_primitive_new_p2 (test_ctx,
+                                     COGL_VERTICES_MODE_TRIANGLE_STRIP,
+                                     G_N_ELEMENTS (verts),
+                                     verts);
+  cogl_draw_list_push_matrix (list);
+  cogl_draw_list_translate (list, 70, 0, 0);
+  cogl_draw_list_draw_primitive (list, yellow, primitive);
+  cogl_draw_list_pop_matrix (list);
+
+  cogl_object_unref (primitive);
+  cogl_object_unref (atlas_pipeline);
+  cogl_object_unref (atlas_texture);
+  cogl_object_unref (plain_pipeline);
+  cogl_object_unref (plain_texture);
+  cogl_object_unref (yellow);
+  cogl_object_unref (blue);
+
+  return list;
+}
+
+static void
+check_list (int x, int y)
+{
+  test_utils_check_region (test_fb, x + 1, y + 1, 18, 8, 0x0000ffff);
+  test_utils_check_region (test_fb, x + 21, y + 1, 8, 8, 0xff0000ff);
+  test_utils_check_region (test_fb, x + 31, y + 1, 8, 8, 0x00ff00ff);
+  test_utils_check_region (test_fb, x + 41, y + 1, 8, 8, 0xff0000ff);
+  test_utils_check_region (test_fb, x + 51, y + 1, 8, 8, 0x00ff00ff);
+  test_utils_check_region (test_fb, x + 61, y + 1, 3, 8, 0xffff00ff);
+  test_utils_check_region (test_fb, x + 66, y + 1, 3, 8, 0x000000ff);
+  test_utils_check_region (test_fb, x + 71, y + 1, 8, 8, 0xffff00ff);
+}
+
+void
+test_draw_list (void)
+{
+  CoglDrawList *list;
+
+  cogl_framebuffer_orthographic (test_fb,
+                                 0, 0,
+                                 cogl_framebuffer_get_width (test_fb),
+                                 cogl_framebuffer_get_height (test_fb),
+                                 -1,
+                                 100);
+
+  cogl_framebuffer_clear4f (test_fb, COGL_BUFFER_BIT_COLOR, 0, 0, 0, 1);
+
+  list = record_list ();
+
+  /* Replay the list twice with a different modelview each time */
+  cogl_draw_list_replay (list, test_fb);
+
+  cogl_framebuffer_push_matrix (test_fb);
+  cogl_framebuffer_translate (test_fb, 0, 20, 0);
+  cogl_draw_list_replay (list, test_fb);
+  cogl_framebuffer_pop_matrix (test_fb);
+
+  check_list (0, 0);
+  check_list (0, 20);
+
+  /* Clearing the list should leave it empty */
+  cogl_draw_list_clear (list);
+  cogl_framebuffer_translate (test_fb, 0, 40, 0);
+  cogl_draw_list_replay (list, test_fb);
+  test_utils_check_region (test_fb, 1, 41, 78, 8, 0x000000ff);
+
+  cogl_object_unref (list);
+
+  if (cogl_test_verbose ())
+    g_print ("OK\n");
+}
@@ -0,0 +1,85 @@
+#include <cogl/cogl.h>
+
+#include "test-utils.h"
+
+static void
+draw_triangle (CoglPipeline *pipeline, float x, float y)
+{
+  CoglVertexP2C4 verts[] =
+    {
+      { x, y, 0x00, 0xff, 0x00, 0xff },
+      { x + 20, y, 0x00, 0xff, 0x00, 0xff },
+      { x, y + 20, 0x00, 0xff, 0x00, 0xff }
+    };
+  CoglPrimitive *prim =
+    cogl_primitive_new_p2c4 (test_ctx,
+                             COGL_VERTICES_MODE_TRIANGLES,
+                             3, verts);
+
+  cogl_primitive_draw (prim, test_fb, pipeline);
+
+  cogl_object_unref (prim);
+}
+
+void
+test_journal_compact (void)
+{
+  CoglTexture *texture;
+  CoglPipeline *textured, *plain;
+
+  cogl_framebuffer_orthographic (test_fb,
+                                 0, 0,
+                                 cogl_framebuffer_get_width (test_fb),
+                                 cogl_framebuffer_get_height (test_fb),
+                                 -1,
+                                 100);
+
+  texture = test_utils_create_quadrant_texture (test_ctx);
+  textured = cogl_pipeline_new (test_ctx);
+  cogl_pipeline_set_layer_texture (textured, 0, texture);
+  cogl_pipeline_set_layer_filters (textured, 0,
+                                   COGL_PIPELINE_FILTER_NEAREST,
+                                   COGL_PIPELINE_FILTER_NEAREST);
+  cogl_pipeline_set_layer_wrap_mode (textured, 0,
+                                     COGL_PIPELINE_WRAP_MODE_REPEAT);
+  plain = cogl_pipeline_new (test_ctx);
+
+  /* Everything in this flush is pixel aligned and only uses texture
+   * coordinates between 0 and 1 so it can use the compact vertices */
+  cogl_framebuffer_draw_rectangle (test_fb, textured, 0, 0, 20, 20);
+  cogl_framebuffer_draw_textured_rectangle (test_fb, textured,
+                                            30, 0, 50, 20,
+                                            0.5f, 0.5f, 1.0f, 1.0f);
+  cogl_framebuffer_push_matrix (test_fb);
+  cogl_framebuffer_translate (test_fb, 60, 0, 0);
+  draw_triangle (plain, 0, 0);
+  cogl_framebuffer_pop_matrix (test_fb);
+  cogl_framebuffer_finish (test_fb);
+
+  test_utils_check_quadrants (test_fb, 0, 0,
+                              0xff0000ff, 0x00ff00ff, 0x0000ffff, 0xffffffff);
+  test_utils_check_region (test_fb, 32, 2, 16, 16, 0xffffffff);
+  test_utils_check_pixel (test_fb, 62, 2, 0x00ff00ff);
+
+  /* A position that isn't pixel aligned and texture coordinates that
+   * repeat both need the vertices to be uploaded as floats */
+  cogl_framebuffer_draw_rectangle (test_fb, textured, 0.5f, 30, 20.5f, 50);
+  cogl_framebuffer_draw_textured_rectangle (test_fb, textured,
+                                            30, 30, 70, 70,
+                                            0.0f, 0.0f, 2.0f, 2.0f);
+  cogl_framebuffer_finish (test_fb);
+
+  test_utils_check_quadrants (test_fb, 0, 30,
+                              0xff0000ff, 0x00ff00ff, 0x0000ffff, 0xffffffff);
+  test_utils_check_quadrants (test_fb, 30, 30,
+                              0xff0000ff, 0x00ff00ff, 0x0000ffff, 0xffffffff);
+  test_utils_check_quadrants (test_fb, 50, 50,
+                              0xff0000ff, 0x00ff00ff, 0x0000ffff, 0xffffffff);
+
+  cogl_object_unref (plain);
+  cogl_object_unref (textured);
+  cogl_object_unref (texture);
+
+  if (cogl_test_verbose ())
+    g_print ("OK\n");
+}
@@ -0,0 +1,106 @@
+#include <cogl/cogl.h>
+
+#include "test-utils.h"
+
+static CoglTexture *
+create_texture (void)
+{
+  /* A 4x1 texture with a different color in each texel */
+  static const uint8_t data[] =
+    {
+      0xff, 0x00, 0x00, 0xff,   0x00, 0xff, 0x00, 0xff,
+      0x00, 0x00, 0xff, 0xff,   0xff, 0xff, 0xff, 0xff
+    };
+
+  return test_utils_texture_new_from_data (test_ctx,
+                                           4, 1, /* width/height */
+                                           TEST_UTILS_TEXTURE_NO_ATLAS,
+                                           COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                           COGL_PIXEL_FORMAT_ANY,
+                                           16, /* rowstride */
+                                           data);
+}
+
+static CoglPipeline *
+create_color_pipeline (uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+  CoglPipeline *pipeline = cogl_pipeline_new (test_ctx);
+
+  cogl_pipeline_set_color4ub (pipeline, r, g, b, a);
+
+  return pipeline;
+}
+
+void
+test_journal_cull (void)
+{
+  CoglTexture *texture;
+  CoglPipeline *red, *blue, *half_green, *textured;
+
+  cogl_framebuffer_orthographic (test_fb,
+                                 0, 0,
+                                 cogl_framebuffer_get_width (test_fb),
+                                 cogl_framebuffer_get_height (test_fb),
+                                 -1,
+                                 100);
+
+  red = create_color_pipeline (0xff, 0x00, 0x00, 0xff);
+  blue = create_color_pipeline (0x00, 0x00, 0xff, 0xff);
+  half_green = create_color_pipeline (0x00, 0x80, 0x00, 0x80);
+  texture = create_texture ();
+  textured = cogl_pipeline_new (test_ctx);
+  cogl_pipeline_set_layer_texture (textured, 0, texture);
+  cogl_pipeline_set_layer_filters (textured, 0,
+                                   COGL_PIPELINE_FILTER_NEAREST,
+                                   COGL_PIPELINE_FILTER_NEAREST);
+
+  /* A rectangle that is completely covered by a later opaque one */
+  cogl_framebuffer_draw_rectangle (test_fb, red, 5, 5, 15, 15);
+  cogl_framebuffer_draw_rectangle (test_fb, blue, 0, 0, 20, 20);
+
+  /* A rectangle that is covered by a translucent one still needs to
+   * be drawn */
+  cogl_framebuffer_draw_rectangle (test_fb, red, 30, 0, 50, 20);
+  cogl_framebuffer_draw_rectangle (test_fb, half_green, 30, 0, 50, 20);
+
+  /* A textured rectangle that has its left half covered. The right
+   * half should still show the last two texels */
+  cogl_framebuffer_draw_rectangle (test_fb, textured, 60, 0, 100, 20);
+  cogl_framebuffer_draw_rectangle (test_fb, blue, 50, 0, 80, 20);
+
+  /* The same with the rectangle rotated so that the left and right
+   * edges of the logged rectangle become the top and bottom in
+   * window space */
+  cogl_framebuffer_push_matrix (test_fb);
+  cogl_framebuffer_translate (test_fb, 120, 30, 0);
+  cogl_framebuffer_rotate (test_fb, 90, 0, 0, 1);
+  cogl_framebuffer_draw_rectangle (test_fb, textured, 0, 0, 40, 20);
+  cogl_framebuffer_pop_matrix (test_fb);
+  cogl_framebuffer_draw_rectangle (test_fb, blue, 100, 50, 120, 70);
+
+  /* A rectangle that is only covered in the middle can't be trimmed
+   * or culled */
+  cogl_framebuffer_draw_rectangle (test_fb, red, 130, 0, 160, 20);
+  cogl_framebuffer_draw_rectangle (test_fb, blue, 140, 0, 150, 20);
+
+  test_utils_check_region (test_fb, 1, 1, 18, 18, 0x0000ffff);
+  test_utils_check_region (test_fb, 32, 2, 16, 16, 0x7f8000ff);
+  test_utils_check_region (test_fb, 52, 2, 26, 16, 0x0000ffff);
+  test_utils_check_region (test_fb, 82, 2, 6, 16, 0x0000ffff);
+  test_utils_check_region (test_fb, 92, 2, 6, 16, 0xffffffff);
+  test_utils_check_region (test_fb, 102, 32, 16, 6, 0xff0000ff);
+  test_utils_check_region (test_fb, 102, 42, 16, 6, 0x00ff00ff);
+  test_utils_check_region (test_fb, 102, 52, 16, 16, 0x0000ffff);
+  test_utils_check_region (test_fb, 132, 2, 6, 16, 0xff0000ff);
+  test_utils_check_region (test_fb, 142, 2, 6, 16, 0x0000ffff);
+  test_utils_check_region (test_fb, 152, 2, 6, 16, 0xff0000ff);
+
+  cogl_object_unref (textured);
+  cogl_object_unref (texture);
+  cogl_object_unref (half_green);
+  cogl_object_unref (blue);
+  cogl_object_unref (red);
+
+  if (cogl_test_verbose ())
+    g_print ("OK\n");
+}
@@ -0,0 +1,90 @@
+#include <cogl/cogl.h>
+
+#include "test-utils.h"
+
+static CoglPipeline *
+create_textured_pipeline (CoglTexture *texture, int n_layers)
+{
+  CoglPipeline *pipeline = cogl_pipeline_new (test_ctx);
+  int i;
+
+  for (i = 0; i < n_layers; i++)
+    {
+      cogl_pipeline_set_layer_texture (pipeline, i, texture);
+      cogl_pipeline_set_layer_filters (pipeline, i,
+                                       COGL_PIPELINE_FILTER_NEAREST,
+                                       COGL_PIPELINE_FILTER_NEAREST);
+    }
+
+  return pipeline;
+}
+
+void
+test_journal_instanced (void)
+{
+  CoglTexture *texture;
+  CoglPipeline *one_layer, *two_layers, *plain;
+  float tex_coords[8];
+
+  cogl_framebuffer_orthographic (test_fb,
+                                 0, 0,
+                                 cogl_framebuffer_get_width (test_fb),
+                                 cogl_framebuffer_get_height (test_fb),
+                                 -1,
+                                 100);
+
+  texture = test_utils_create_quadrant_texture (test_ctx);
+  one_layer = create_textured_pipeline (texture, 1);
+  two_layers = create_textured_pipeline (texture, 2);
+  plain = cogl_pipeline_new (test_ctx);
+  cogl_pipeline_set_color4ub (plain, 0x00, 0x00, 0xff, 0xff);
+
+  /* The whole texture */
+  cogl_framebuffer_draw_rectangle (test_fb, one_layer, 0, 0, 20, 20);
+
+  /* Just the white texel */
+  cogl_framebuffer_draw_textured_rectangle (test_fb, one_layer,
+                                            30, 0, 50, 20,
+                                            0.5f, 0.5f, 1.0f, 1.0f);
+
+  /* The whole texture rotated by 90 degrees so that the corners of
+   * the quad aren't axis aligned with the logged rectangle */
+  cogl_framebuffer_push_matrix (test_fb);
+  cogl_framebuffer_translate (test_fb, 80, 0, 0);
+  cogl_framebuffer_rotate (test_fb, 90, 0, 0, 1);
+  cogl_framebuffer_draw_rectangle (test_fb, one_layer, 0, 0, 20, 20);
+  cogl_framebuffer_pop_matrix (test_fb);
+
+  /* The white texel modulated by the green texel to check that each
+   * layer gets its own texture rectangle */
+  tex_coords[0] = 0.5f;
+  tex_coords[1] = 0.5f;
+  tex_coords[2] = 1.0f;
+  tex_coords[3] = 1.0f;
+  tex_coords[4] = 0.5f;
+  tex_coords[5] = 0.0f;
+  tex_coords[6] = 1.0f;
+  tex_coords[7] = 0.5f;
+  cogl_framebuffer_draw_multitextured_rectangle (test_fb, two_layers,
+                                                 100, 0, 120, 20,
+                                                 tex_coords, 8);
+
+  /* An untextured rectangle using the per-instance color */
+  cogl_framebuffer_draw_rectangle (test_fb, plain, 130, 0, 150, 20);
+
+  test_utils_check_quadrants (test_fb, 0, 0,
+                              0xff0000ff, 0x00ff00ff, 0x0000ffff, 0xffffffff);
+  test_utils_check_region (test_fb, 32, 2, 16, 16, 0xffffffff);
+  test_utils_check_quadrants (test_fb, 60, 0,
+                              0x0000ffff, 0xff0000ff, 0xffffffff, 0x00ff00ff);
+  test_utils_check_region (test_fb, 102, 2, 16, 16, 0x00ff00ff);
+  test_utils_check_region (test_fb, 132, 2, 16, 16, 0x0000ffff);
+
+  cogl_object_unref (plain);
+  cogl_object_unref (two_layers);
+  cogl_object_unref (one_layer);
+  cogl_object_unref (texture);
+
+  if (cogl_test_verbose ())
+    g_print ("OK\n");
+}
@@ -0,0 +1,137 @@
+#include <cogl/cogl.h>
+
+#include "test-utils.h"
+
+static void
+setup_orthographic_modelview (void)
+{
+  CoglMatrix matrix;
+  int fb_width = cogl_framebuffer_get_width (test_fb);
+  int fb_height = cogl_framebuffer_get_height (test_fb);
+
+  /* The journal transforms the vertices of primitives in software so
+   * we use a non-identity modelview matrix to check that it gets
+   * applied */
+  cogl_matrix_init_identity (&matrix);
+  cogl_matrix_orthographic (&matrix,
+                            0.0f, 0.0f, /* x_1 y_1 */
+                            fb_width,
+                            fb_height,
+                            -1.0f, /* nearval */
+                            1.0f /* farval */);
+  cogl_framebuffer_set_modelview_matrix (test_fb, &matrix);
+}
+
+static CoglPipeline *
+create_pipeline (uint32_t color)
+{
+  CoglPipeline *pipeline = cogl_pipeline_new (test_ctx);
+
+  cogl_pipeline_set_color4ub (pipeline,
+                              color >> 24,
+                              (color >> 16) & 0xff,
+                              (color >> 8) & 0xff,
+                              color & 0xff);
+
+  return pipeline;
+}
+
+void
+test_journal_primitives (void)
+{
+  static const CoglVertexP2 fan_data[] =
+    {
+      { 100, 0 }, { 100, 100 }, { 200, 100 }, { 200, 0 }
+    };
+  static const CoglVertexP2C4 indexed_data[] =
+    {
+      { 200, 0, 0, 0, 255, 255 },
+      { 200, 100, 0, 0, 255, 255 },
+      { 300, 100, 0, 0, 255, 255 },
+      { 300, 0, 0, 0, 255, 255 }
+    };
+  static const CoglVertexP2C4 moved_data[] =
+    {
+      { 0, 0, 255, 255, 255, 255 },
+      { 0, 0, 255, 255, 255, 255 },
+      { 0, 0, 255, 255, 255, 255 },
+      { 0, 0, 255, 255, 255, 255 }
+    };
+  static const uint8_t index_data[] = { 0, 1, 2, 0, 2, 3 };
+  CoglPipeline *red, *green, *yellow;
+  CoglPrimitive *fan, *indexed;
+  CoglAttributeBuffer *attribute_buffer;
+  CoglAttribute *attributes[2];
+  CoglIndices *indices;
+
+  setup_orthographic_modelview ();
+
+  red = create_pipeline (0xff0000ff);
+  green = create_pipeline (0x00ff00ff);
+  yellow = create_pipeline (0xffff00ff);
+
+  fan = cogl_primitive_new_p2 (test_ctx,
+                               COGL_VERTICES_MODE_TRIANGLE_FAN,
+                               G_N_ELEMENTS (fan_data),
+                               fan_data);
+
+  attribute_buffer = cogl_attribute_buffer_new (test_ctx,
+                                                sizeof (indexed_data),
+                                                indexed_data);
+  attributes[0] = cogl_attribute_new (attribute_buffer,
+                                      "cogl_position_in",
+                                      sizeof (CoglVertexP2C4),
+                                      G_STRUCT_OFFSET (CoglVertexP2C4, x),
+                                      2, /* n_components */
+                                      COGL_ATTRIBUTE_TYPE_FLOAT);
+  attributes[1] = cogl_attribute_new (attribute_buffer,
+                                      "cogl_color_in",
+                                      sizeof (CoglVertexP2C4),
+                                      G_STRUCT_OFFSET (CoglVertexP2C4, r),
+                                      4, /* n_components */
+                                      COGL_ATTRIBUTE_TYPE_UNSIGNED_BYTE);
+  indexed = cogl_primitive_new_with_attributes (COGL_VERTICES_MODE_TRIANGLES,
+                                                G_N_ELEMENTS (index_data),
+                                                attributes,
+                                                2);
+  indices = cogl_indices_new (test_ctx,
+                              COGL_INDICES_TYPE_UNSIGNED_BYTE,
+                              index_data,
+                              G_N_ELEMENTS (index_data));
+  cogl_primitive_set_indices (indexed, indices, G_N_ELEMENTS (index_data));
+
+  /* Mix rectangles and primitives so that the primitives end up in
+   * the journal in-between rectangles using the same pipelines */
+  cogl_framebuffer_draw_rectangle (test_fb, red, 0, 0, 100, 100);
+  cogl_primitive_draw (fan, test_fb, green);
+  cogl_primitive_draw (indexed, test_fb, red);
+  /* This should be drawn on top of the fan */
+  cogl_framebuffer_draw_rectangle (test_fb, yellow, 150, 50, 200, 100);
+
+  /* The primitive's data should have been copied when it was logged
+   * so modifying the buffer before the journal is flushed shouldn't
+   * affect the result */
+  cogl_buffer_set_data (COGL_BUFFER (attribute_buffer),
+                        0, /* offset */
+                        moved_data,
+                        sizeof (moved_data));
+
+  test_utils_check_region (test_fb, 1, 1, 98, 98, 0xff0000ff);
+  test_utils_check_region (test_fb, 101, 1, 98, 48, 0x00ff00ff);
+  test_utils_check_region (test_fb, 101, 51, 48, 48, 0x00ff00ff);
+  test_utils_check_region (test_fb, 151, 51, 48, 48, 0xffff00ff);
+  test_utils_check_region (test_fb, 201, 1, 98, 98, 0x0000ffff);
+
+  cogl_object_unref (indices);
+  cogl_object_unref (indexed);
+  cogl_object_unref (attributes[0]);
+  cogl_object_unref (attributes[1]);
+  cogl_object_unref (attribute_buffer);
+  cogl_object_unref (fan);
+  cogl_object_unref (red);
+  cogl_object_unref (green);
+  cogl_object_unref (yellow);
+
+  if (cogl_test_verbose ())
+    g_print ("OK\n");
+}
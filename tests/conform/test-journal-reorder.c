@@ -0,0 +1,67 @@
+#include <cogl/cogl.h>
+
+#include "test-utils.h"
+
+static CoglPipeline *
+create_pipeline (uint32_t color)
+{
+  CoglPipeline *pipeline = cogl_pipeline_new (test_ctx);
+
+  cogl_pipeline_set_color4ub (pipeline,
+                              color >> 24,
+                              (color >> 16) & 0xff,
+                              (color >> 8) & 0xff,
+                              color & 0xff);
+
+  return pipeline;
+}
+
+void
+test_journal_reorder (void)
+{
+  CoglPipeline *red, *green, *blue;
+  int i;
+
+  cogl_framebuffer_orthographic (test_fb,
+                                 0, 0,
+                                 cogl_framebuffer_get_width (test_fb),
+                                 cogl_framebuffer_get_height (test_fb),
+                                 -1,
+                                 100);
+
+  red = create_pipeline (0xff0000ff);
+  green = create_pipeline (0x00ff00ff);
+  blue = create_pipeline (0x0000ffff);
+
+  /* A row of alternating rectangles that don't overlap. The journal
+   * is free to group these by pipeline */
+  for (i = 0; i < 8; i++)
+    cogl_framebuffer_draw_rectangle (test_fb,
+                                     (i & 1) ? green : red,
+                                     i * 20, 0,
+                                     i * 20 + 20, 20);
+
+  /* Overlapping rectangles that must be drawn in order. The last
+   * rectangle can be batched with the first but it can't be moved
+   * before the blue one */
+  cogl_framebuffer_draw_rectangle (test_fb, red, 0, 50, 100, 100);
+  cogl_framebuffer_draw_rectangle (test_fb, blue, 50, 50, 150, 100);
+  cogl_framebuffer_draw_rectangle (test_fb, red, 120, 50, 200, 100);
+
+  for (i = 0; i < 8; i++)
+    test_utils_check_region (test_fb,
+                             i * 20 + 1, 1,
+                             18, 18,
+                             (i & 1) ? 0x00ff00ff : 0xff0000ff);
+
+  test_utils_check_region (test_fb, 1, 51, 48, 48, 0xff0000ff);
+  test_utils_check_region (test_fb, 51, 51, 68, 48, 0x0000ffff);
+  test_utils_check_region (test_fb, 121, 51, 78, 48, 0xff0000ff);
+
+  cogl_object_unref (red);
+  cogl_object_unref (green);
+  cogl_object_unref (blue);
+
+  if (cogl_test_verbose ())
+    g_print ("OK\n");
+}
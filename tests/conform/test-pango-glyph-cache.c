@@ -0,0 +1,209 @@
+#define COGL_ENABLE_EXPERIMENTAL_2_0_API
+#include <cogl/cogl.h>
+#include <cogl-pango/cogl-pango.h>
+
+#include <string.h>
+
+#include "test-utils.h"
+
+#define TEST_TEXT "The quick brown fox jumps over the lazy dog"
+#define CHURN_TEXT "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ!?@#%&*()[]{}"
+/* Enough for all of the glyphs of the biggest churn layout but a lot
+   less than all of the churn layouts together */
+#define CHURN_BUDGET (512 * 1024)
+
+typedef struct _TestState
+{
+  CoglPangoFontMap *font_map;
+  PangoContext *pango_context;
+  PangoLayout *layout;
+  int width, height;
+} TestState;
+
+static PangoLayout *
+create_layout (TestState *state,
+               const char *text,
+               int size)
+{
+  PangoFontDescription *desc = pango_font_description_new ();
+  PangoLayout *layout = pango_layout_new (state->pango_context);
+
+  pango_font_description_set_family (desc, "Sans");
+  pango_font_description_set_absolute_size (desc, size * PANGO_SCALE);
+  pango_layout_set_font_description (layout, desc);
+  pango_font_description_free (desc);
+
+  pango_layout_set_text (layout, text, -1);
+
+  return layout;
+}
+
+static void
+draw_layout (PangoLayout *layout)
+{
+  CoglColor color;
+
+  cogl_framebuffer_clear4f (test_fb, COGL_BUFFER_BIT_COLOR, 0, 0, 0, 1);
+
+  cogl_color_init_from_4ub (&color, 0xff, 0xff, 0xff, 0xff);
+  cogl_pango_show_layout (test_fb, layout, 0, 0, &color);
+}
+
+static uint8_t *
+draw_and_read_test_layout (TestState *state)
+{
+  uint8_t *pixels = g_malloc (state->width * state->height * 4);
+
+  draw_layout (state->layout);
+
+  cogl_framebuffer_read_pixels (test_fb,
+                                0, 0,
+                                state->width, state->height,
+                                COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                pixels);
+
+  return pixels;
+}
+
+static void
+check_pixels (TestState *state,
+              const uint8_t *reference,
+              const uint8_t *pixels)
+{
+  int i;
+
+  for (i = 0; i < state->width * state->height * 4; i++)
+    g_assert_cmpint (pixels[i], ==, reference[i]);
+}
+
+static void
+check_cache_size (TestState *state,
+                  size_t budget)
+{
+  size_t size = cogl_pango_font_map_get_glyph_cache_size (state->font_map);
+
+  if (cogl_test_verbose ())
+    g_print ("Glyph cache size: %lu / %lu\n",
+             (unsigned long) size,
+             (unsigned long) budget);
+
+  g_assert_cmpint (size, <=, budget);
+}
+
+void
+test_pango_glyph_cache (void)
+{
+  TestState state;
+  PangoRectangle extents;
+  uint8_t *reference, *pixels;
+  int n_threads;
+  int size;
+
+  cogl_framebuffer_orthographic (test_fb,
+                                 0, 0,
+                                 cogl_framebuffer_get_width (test_fb),
+                                 cogl_framebuffer_get_height (test_fb),
+                                 -1,
+                                 100);
+
+  state.font_map = COGL_PANGO_FONT_MAP (cogl_pango_font_map_new ());
+  state.pango_context =
+    cogl_pango_font_map_create_context (state.font_map);
+
+  /* Check the budget API */
+  g_assert_cmpint (cogl_pango_font_map_get_glyph_cache_budget (state.font_map),
+                   ==,
+                   16 * 1024 * 1024);
+  cogl_pango_font_map_set_glyph_cache_budget (state.font_map, 0);
+  g_assert_cmpint (cogl_pango_font_map_get_glyph_cache_budget (state.font_map),
+                   ==,
+                   0);
+
+  state.layout = create_layout (&state, TEST_TEXT, 16);
+  pango_layout_get_pixel_extents (state.layout, NULL, &extents);
+  state.width = MIN (extents.width, cogl_framebuffer_get_width (test_fb));
+  state.height = MIN (extents.height, cogl_framebuffer_get_height (test_fb));
+
+  /* Render the layout without any limit to get the reference image */
+  reference = draw_and_read_test_layout (&state);
+
+  /* Rasterizing the glyphs on worker threads should give exactly the
+   * same result */
+  cogl_pango_font_map_set_rasterization_threads (state.font_map, 2);
+  n_threads = cogl_pango_font_map_get_rasterization_threads (state.font_map);
+  g_assert_cmpint (n_threads, ==, 2);
+  cogl_pango_font_map_clear_glyph_cache (state.font_map);
+
+  pixels = draw_and_read_test_layout (&state);
+  check_pixels (&state, reference, pixels);
+  g_free (pixels);
+
+  cogl_pango_font_map_set_rasterization_threads (state.font_map, 0);
+
+  /* With a budget that is too small for all of the glyphs in the
+   * layout, none of them should be evicted while it is being
+   * drawn */
+  cogl_pango_font_map_clear_glyph_cache (state.font_map);
+  cogl_pango_font_map_set_glyph_cache_budget (state.font_map, 1024);
+  g_assert_cmpint (cogl_pango_font_map_get_glyph_cache_budget (state.font_map),
+                   ==,
+                   1024);
+
+  pixels = draw_and_read_test_layout (&state);
+  check_pixels (&state, reference, pixels);
+  g_free (pixels);
+
+  /* Draw lots of other glyphs so that the ones for the test layout
+   * get evicted. Drawing the layout again should give the same
+   * result */
+  for (size = 8; size <= 48; size += 4)
+    {
+      PangoLayout *churn_layout = create_layout (&state, CHURN_TEXT, size);
+
+      draw_layout (churn_layout);
+      g_object_unref (churn_layout);
+    }
+
+  pixels = draw_and_read_test_layout (&state);
+  check_pixels (&state, reference, pixels);
+  g_free (pixels);
+
+  /* Lowering the budget evicts straight away and shouldn't affect
+   * anything that gets drawn afterwards either */
+  cogl_pango_font_map_set_glyph_cache_budget (state.font_map, 1);
+
+  pixels = draw_and_read_test_layout (&state);
+  check_pixels (&state, reference, pixels);
+  g_free (pixels);
+
+  /* With a budget that is big enough for the glyphs of any single
+   * layout the cache should never grow beyond it, however much other
+   * text is drawn */
+  cogl_pango_font_map_set_glyph_cache_budget (state.font_map,
+                                              CHURN_BUDGET);
+
+  for (size = 8; size <= 48; size += 2)
+    {
+      PangoLayout *churn_layout = create_layout (&state, CHURN_TEXT, size);
+
+      draw_layout (churn_layout);
+      g_object_unref (churn_layout);
+
+      check_cache_size (&state, CHURN_BUDGET);
+    }
+
+  pixels = draw_and_read_test_layout (&state);
+  check_pixels (&state, reference, pixels);
+  g_free (pixels);
+
+  check_cache_size (&state, CHURN_BUDGET);
+
+  g_free (reference);
+
+  g_object_unref (state.layout);
+  g_object_unref (state.pango_context);
+  g_object_unref (state.font_map);
+
+  if (cogl_test_verbose ())
+    g_print ("OK\n");
+}
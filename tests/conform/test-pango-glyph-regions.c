@@ -0,0 +1,130 @@
+#include <cogl/cogl.h>
+#include <string.h>
+
+/* This is a whitebox test of the way the glyph cache combines dirty
+   glyphs into regions so it includes the source directly */
+#include <cogl-pango/cogl-pango-glyph-cache.c>
+
+#include "test-utils.h"
+
+typedef struct
+{
+  int x, y;
+  int width, height;
+} TestGlyph;
+
+/* The glyphs are in the order that the cache sorts them in. The
+   first glyph is tall and thin so that it can't be combined with the
+   second. The other two glyphs are short and wide and are on either
+   side of the first one so the bounding box of the two overlaps the
+   first glyph. Combining them would clear the first glyph again after
+   it has been drawn */
+static const TestGlyph
+test_glyphs[] =
+  {
+    { 20, 0, 4, 20 },
+    { 0, 10, 8, 4 },
+    { 26, 10, 12, 4 }
+  };
+
+typedef struct
+{
+  const CoglPangoGlyphCacheDirtyGlyph *all_glyphs;
+  int n_all_glyphs;
+  int n_redrawn[G_N_ELEMENTS (test_glyphs)];
+} TestState;
+
+static void
+redraw_cb (CoglTexture *texture,
+           int x,
+           int y,
+           int width,
+           int height,
+           const CoglPangoGlyphCacheDirtyGlyph *glyphs,
+           int n_glyphs,
+           void *user_data)
+{
+  TestState *state = user_data;
+  CoglPangoGlyphCacheRegion region;
+  int i, j;
+
+  region.x1 = x;
+  region.y1 = y;
+  region.x2 = x + width;
+  region.y2 = y + height;
+
+  for (i = 0; i < state->n_all_glyphs; i++)
+    {
+      const CoglPangoGlyphCacheDirtyGlyph *glyph = state->all_glyphs + i;
+      CoglBool in_region = FALSE;
+
+      for (j = 0; j < n_glyphs; j++)
+        if (glyphs[j].value == glyph->value)
+          in_region = TRUE;
+
+      if (in_region)
+        {
+          /* Every glyph should be inside the region it is drawn in */
+          g_assert_cmpint (glyph->value->tx_pixel, >=, region.x1);
+          g_assert_cmpint (glyph->value->ty_pixel, >=, region.y1);
+          g_assert_cmpint (glyph->value->tx_pixel +
+                           glyph->value->draw_width, <=, region.x2);
+          g_assert_cmpint (glyph->value->ty_pixel +
+                           glyph->value->draw_height, <=, region.y2);
+
+          state->n_redrawn[i]++;
+        }
+      else
+        /* The region is cleared so it mustn't touch any other
+           glyph */
+        g_assert (!region_overlaps_glyph (&region, glyph->value));
+    }
+}
+
+void
+test_pango_glyph_regions (void)
+{
+  CoglPangoGlyphCacheValue values[G_N_ELEMENTS (test_glyphs)];
+  CoglPangoGlyphCacheDirtyGlyph glyphs[G_N_ELEMENTS (test_glyphs)];
+  TestState state;
+  CoglAtlas *atlas;
+  int i;
+
+  /* The glyphs need to look like they are in a local atlas so that
+     the regions include the border */
+  atlas = _cogl_atlas_new (COGL_PIXEL_FORMAT_A_8, 0, NULL);
+
+  memset (values, 0, sizeof (values));
+  memset (glyphs, 0, sizeof (glyphs));
+
+  for (i = 0; i < G_N_ELEMENTS (test_glyphs); i++)
+    {
+      values[i].tx_pixel = test_glyphs[i].x;
+      values[i].ty_pixel = test_glyphs[i].y;
+      values[i].draw_width = test_glyphs[i].width;
+      values[i].draw_height = test_glyphs[i].height;
+      values[i].atlas = atlas;
+      values[i].dirty = TRUE;
+      glyphs[i].value = values + i;
+    }
+
+  state.all_glyphs = glyphs;
+  state.n_all_glyphs = G_N_ELEMENTS (glyphs);
+  memset (state.n_redrawn, 0, sizeof (state.n_redrawn));
+
+  _cogl_pango_glyph_cache_redraw_texture (glyphs,
+                                          G_N_ELEMENTS (glyphs),
+                                          NULL, /* clean glyphs */
+                                          0,
+                                          redraw_cb,
+                                          &state);
+
+  /* Every glyph should be drawn exactly once */
+  for (i = 0; i < G_N_ELEMENTS (test_glyphs); i++)
+    g_assert_cmpint (state.n_redrawn[i], ==, 1);
+
+  cogl_object_unref (atlas);
+
+  if (cogl_test_verbose ())
+    g_print ("OK\n");
+}
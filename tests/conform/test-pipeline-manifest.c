@@ -0,0 +1,81 @@
+#include <cogl/cogl.h>
+
+#include <glib/gstdio.h>
+
+#include "test-utils.h"
+
+static void
+get_n_misses (unsigned long *n_misses)
+{
+  cogl_get_pipeline_cache_stats (test_ctx, NULL, NULL, n_misses, NULL);
+}
+
+static void
+paint (CoglPipeline *pipeline)
+{
+  cogl_framebuffer_draw_rectangle (test_fb, pipeline, 0, 0, 10, 10);
+  cogl_framebuffer_finish (test_fb);
+}
+
+void
+test_pipeline_manifest (void)
+{
+  CoglPipeline *pipeline;
+  CoglSnippet *snippet;
+  CoglError *error = NULL;
+  unsigned long n_misses_before, n_misses_after;
+  char *filename;
+
+  filename = g_build_filename (g_get_tmp_dir (),
+                               "cogl-test-pipeline-manifest",
+                               NULL);
+
+  /* Create a pipeline with a variety of codegen state */
+  pipeline = cogl_pipeline_new (test_ctx);
+  cogl_pipeline_set_layer_null_texture (pipeline, 3, COGL_TEXTURE_TYPE_2D);
+  cogl_pipeline_set_layer_combine (pipeline, 3,
+                                   "RGB = ADD (PREVIOUS, TEXTURE[A]) "
+                                   "A = REPLACE (PRIMARY)",
+                                   NULL);
+  snippet = cogl_snippet_new (COGL_SNIPPET_HOOK_FRAGMENT,
+                              "uniform float manifest_test;\n",
+                              "cogl_color_out.r += manifest_test;");
+  cogl_pipeline_add_snippet (pipeline, snippet);
+  cogl_object_unref (snippet);
+  /* The comment checks that awkward characters are escaped */
+  snippet = cogl_snippet_new (COGL_SNIPPET_HOOK_TEXTURE_LOOKUP,
+                              "/* \"quote\"\ttab */\n",
+                              NULL);
+  cogl_snippet_set_replace (snippet, "cogl_texel = vec4 (1.0);");
+  cogl_pipeline_add_layer_snippet (pipeline, 3, snippet);
+  cogl_object_unref (snippet);
+
+  paint (pipeline);
+  cogl_object_unref (pipeline);
+
+  if (!cogl_save_pipeline_manifest (test_ctx, filename, &error))
+    g_error ("Failed to save manifest: %s", error->message);
+
+  get_n_misses (&n_misses_before);
+
+  /* Loading the manifest into the same context should find all of
+   * the pipelines in the cache already which shows that the state was
+   * recreated exactly */
+  if (!cogl_load_pipeline_manifest (test_ctx, filename, &error))
+    g_error ("Failed to load manifest: %s", error->message);
+
+  get_n_misses (&n_misses_after);
+  g_assert_cmpint (n_misses_before, ==, n_misses_after);
+
+  /* Something that isn't a manifest should be rejected */
+  g_assert (g_file_set_contents (filename, "not a manifest\n", -1, NULL));
+  g_assert (!cogl_load_pipeline_manifest (test_ctx, filename, &error));
+  g_assert (error != NULL);
+  cogl_error_free (error);
+
+  g_unlink (filename);
+  g_free (filename);
+
+  if (cogl_test_verbose ())
+    g_print ("OK\n");
+}
@@ -0,0 +1,136 @@
+#include <cogl/cogl.h>
+
+#include "test-utils.h"
+
+typedef struct
+{
+  GMainLoop *loop;
+  CoglPipeline *pipeline;
+  int n_callbacks;
+  int n_destroys;
+} TestState;
+
+static gboolean
+timeout (void *user_data)
+{
+  g_assert (!"timeout not reached");
+
+  return FALSE;
+}
+
+static void
+ready_cb (CoglPipeline *pipeline,
+          void *user_data)
+{
+  TestState *state = user_data;
+
+  g_assert (pipeline == state->pipeline);
+  g_assert (cogl_pipeline_is_ready (pipeline));
+
+  state->n_callbacks++;
+
+  g_main_loop_quit (state->loop);
+}
+
+static void
+destroy_cb (void *user_data)
+{
+  TestState *state = user_data;
+
+  state->n_destroys++;
+}
+
+static void
+never_called_cb (CoglPipeline *pipeline,
+                 void *user_data)
+{
+  g_assert_not_reached ();
+}
+
+void
+test_pipeline_precompile (void)
+{
+  TestState state;
+  GSource *cogl_source;
+  CoglSnippet *snippet;
+  CoglPipeline *other_pipeline;
+  CoglPipelineReadyClosure *closure;
+  CoglTexture *red_tex, *green_tex;
+  int fb_width = cogl_framebuffer_get_width (test_fb);
+  int fb_height = cogl_framebuffer_get_height (test_fb);
+
+  cogl_source = cogl_glib_source_new (test_ctx, G_PRIORITY_DEFAULT);
+  g_source_attach (cogl_source, NULL);
+
+  state.loop = g_main_loop_new (NULL, TRUE);
+  state.n_callbacks = 0;
+  state.n_destroys = 0;
+
+  /* Use a snippet to make sure the pipeline needs a generated
+   * program. The result comes from the texture on the second layer so
+   * that it is only correct if the sampler uniforms were set up after
+   * the program was linked */
+  state.pipeline = cogl_pipeline_new (test_ctx);
+  snippet = cogl_snippet_new (COGL_SNIPPET_HOOK_FRAGMENT,
+                              "uniform float precompile_test;\n",
+                              NULL);
+  cogl_pipeline_add_snippet (state.pipeline, snippet);
+  cogl_object_unref (snippet);
+
+  red_tex = test_utils_create_color_texture (test_ctx, 0xff0000ff);
+  green_tex = test_utils_create_color_texture (test_ctx, 0x00ff00ff);
+  cogl_pipeline_set_layer_texture (state.pipeline, 0, red_tex);
+  cogl_pipeline_set_layer_texture (state.pipeline, 1, green_tex);
+  cogl_pipeline_set_layer_combine (state.pipeline, 1,
+                                   "RGBA = REPLACE (TEXTURE)",
+                                   NULL);
+  cogl_object_unref (red_tex);
+  cogl_object_unref (green_tex);
+
+  /* Nothing has been compiled yet */
+  g_assert (!cogl_pipeline_is_ready (state.pipeline));
+
+  /* A callback that is removed before it is dispatched should never
+   * be invoked but its destroy notify should */
+  other_pipeline = cogl_pipeline_copy (state.pipeline);
+  closure = cogl_pipeline_add_ready_callback (other_pipeline,
+                                              never_called_cb,
+                                              &state,
+                                              destroy_cb);
+  cogl_pipeline_remove_ready_callback (other_pipeline, closure);
+  cogl_object_unref (other_pipeline);
+  g_assert_cmpint (state.n_destroys, ==, 1);
+
+  cogl_pipeline_add_ready_callback (state.pipeline,
+                                    ready_cb,
+                                    &state,
+                                    destroy_cb);
+
+  g_timeout_add_seconds (5, timeout, NULL);
+
+  g_main_loop_run (state.loop);
+
+  g_assert_cmpint (state.n_callbacks, ==, 1);
+  g_assert_cmpint (state.n_destroys, ==, 2);
+
+  /* The precompiled pipeline should still paint correctly. Only the
+   * right half of the framebuffer is drawn so that the result depends
+   * on the matrix uniforms too */
+  cogl_framebuffer_clear4f (test_fb, COGL_BUFFER_BIT_COLOR, 0, 0, 0, 1);
+  cogl_framebuffer_orthographic (test_fb, 0, 0, fb_width, fb_height, -1, 100);
+  cogl_framebuffer_draw_rectangle (test_fb,
+                                   state.pipeline,
+                                   fb_width / 2, 0, fb_width, fb_height);
+  test_utils_check_pixel (test_fb, fb_width / 4, fb_height / 2, 0x000000ff);
+  test_utils_check_pixel (test_fb,
+                          fb_width * 3 / 4, fb_height / 2,
+                          0x00ff00ff);
+
+  cogl_object_unref (state.pipeline);
+  g_main_loop_unref (state.loop);
+  g_source_destroy (cogl_source);
+  g_source_unref (cogl_source);
+
+  if (cogl_test_verbose ())
+    g_print ("OK\n");
+}
@@ -0,0 +1,151 @@
+#include <cogl/cogl.h>
+
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "test-utils.h"
+
+/* The program binary cache is only set up when a context is created
+ * so this test makes its own contexts instead of using test_ctx */
+
+static void
+paint_with_fresh_context (void)
+{
+  CoglContext *ctx;
+  CoglTexture2D *tex;
+  CoglOffscreen *offscreen;
+  CoglFramebuffer *fb;
+  CoglPipeline *pipeline;
+  CoglSnippet *snippet;
+  CoglError *error = NULL;
+
+  ctx = cogl_context_new (NULL, &error);
+  if (!ctx)
+    g_error ("Failed to create context: %s", error->message);
+
+  tex = cogl_texture_2d_new_with_size (ctx, 16, 16,
+                                       COGL_PIXEL_FORMAT_RGBA_8888_PRE);
+  offscreen = cogl_offscreen_new_with_texture (COGL_TEXTURE (tex));
+  fb = COGL_FRAMEBUFFER (offscreen);
+  if (!cogl_framebuffer_allocate (fb, &error))
+    g_error ("Failed to allocate framebuffer: %s", error->message);
+
+  cogl_framebuffer_orthographic (fb, 0, 0, 16, 16, -1, 100);
+  cogl_framebuffer_clear4f (fb, COGL_BUFFER_BIT_COLOR, 0, 0, 0, 1);
+
+  /* Use a snippet to make sure the pipeline needs a generated
+   * program */
+  pipeline = cogl_pipeline_new (ctx);
+  snippet = cogl_snippet_new (COGL_SNIPPET_HOOK_FRAGMENT,
+                              "uniform float binary_cache_test;\n",
+                              "cogl_color_out = vec4 (0.0, 1.0, 0.0, 1.0);");
+  cogl_pipeline_add_snippet (pipeline, snippet);
+  cogl_object_unref (snippet);
+
+  cogl_framebuffer_draw_rectangle (fb, pipeline, 0, 0, 16, 16);
+  test_utils_check_pixel (fb, 8, 8, 0x00ff00ff);
+
+  cogl_object_unref (pipeline);
+  cogl_object_unref (offscreen);
+  cogl_object_unref (tex);
+  cogl_object_unref (ctx);
+}
+
+static GPtrArray *
+list_files (const char *dir_name)
+{
+  GPtrArray *files = g_ptr_array_new_with_free_func (g_free);
+  GDir *dir = g_dir_open (dir_name, 0, NULL);
+  const char *name;
+
+  g_assert (dir);
+
+  while ((name = g_dir_read_name (dir)))
+    g_ptr_array_add (files, g_build_filename (dir_name, name, NULL));
+
+  g_dir_close (dir);
+
+  return files;
+}
+
+static void
+empty_dir (const char *dir_name)
+{
+  GPtrArray *files = list_files (dir_name);
+  int i;
+
+  for (i = 0; i < files->len; i++)
+    g_unlink (g_ptr_array_index (files, i));
+
+  g_ptr_array_free (files, TRUE);
+}
+
+void
+test_program_binary_cache (void)
+{
+  char *cache_dir;
+  GPtrArray *files;
+  char *contents;
+  gsize length;
+
+  cache_dir = g_build_filename (g_get_tmp_dir (),
+                                "cogl-test-program-binary-cache",
+                                NULL);
+  g_mkdir_with_parents (cache_dir, 0700);
+  empty_dir (cache_dir);
+
+  g_setenv ("COGL_PROGRAM_CACHE_DIR", cache_dir, TRUE);
+
+  /* Link the program and save it */
+  paint_with_fresh_context ();
+
+  files = list_files (cache_dir);
+
+  if (files->len == 0)
+    {
+      /* The driver can't retrieve program binaries so the cache
+       * isn't used at all. Painting again should still link the
+       * program normally */
+      paint_with_fresh_context ();
+      g_ptr_array_free (files, TRUE);
+      files = list_files (cache_dir);
+      g_assert_cmpint (files->len, ==, 0);
+
+      if (cogl_test_verbose ())
+        g_print ("Program binaries not supported\n");
+    }
+  else
+    {
+      /* Reload the program from a fresh cache. This shouldn't need
+       * to write any new binaries */
+      paint_with_fresh_context ();
+      g_ptr_array_free (files, TRUE);
+      files = list_files (cache_dir);
+      g_assert_cmpint (files->len, ==, 1);
+
+      /* Corrupt the binary. The cache should fall back to linking the
+       * program and then replace the file */
+      g_assert (g_file_set_contents (g_ptr_array_index (files, 0),
+                                     "COGLPB01", -1,
+                                     NULL));
+
+      paint_with_fresh_context ();
+
+      g_assert (g_file_get_contents (g_ptr_array_index (files, 0),
+                                     &contents, &length,
+                                     NULL));
+      g_assert_cmpint (length, >, strlen ("COGLPB01"));
+      g_free (contents);
+    }
+
+  g_ptr_array_free (files, TRUE);
+
+  g_unsetenv ("COGL_PROGRAM_CACHE_DIR");
+
+  empty_dir (cache_dir);
+  g_rmdir (cache_dir);
+  g_free (cache_dir);
+
+  if (cogl_test_verbose ())
+    g_print ("OK\n");
+}
@@ -0,0 +1,122 @@
+#include <cogl/cogl.h>
+
+#include <string.h>
+
+#include "test-utils.h"
+
+#define WIDTH 16
+#define HEIGHT 16
+
+typedef struct _TestState
+{
+  GMainLoop *loop;
+  CoglPixelBuffer *buffer;
+} TestState;
+
+static gboolean
+timeout (void *user_data)
+{
+  g_assert (!"timeout not reached");
+
+  return FALSE;
+}
+
+static void
+read_callback (CoglFramebuffer *framebuffer,
+               CoglBitmap *bitmap,
+               const CoglError *error,
+               void *user_data)
+{
+  TestState *state = user_data;
+  const uint8_t *pixels;
+  int x, y;
+
+  g_assert (error == NULL);
+  g_assert (framebuffer == test_fb);
+  g_assert (cogl_bitmap_get_buffer (bitmap) == state->buffer);
+
+  pixels = cogl_buffer_map (COGL_BUFFER (state->buffer),
+                            COGL_BUFFER_ACCESS_READ,
+                            0 /* hints */);
+  g_assert (pixels != NULL);
+
+  /* The top half should be red and the bottom half green */
+  for (y = 0; y < HEIGHT; y++)
+    for (x = 0; x < WIDTH; x++)
+      {
+        const uint8_t *p = pixels + (y * WIDTH + x) * 4;
+        uint32_t expected = y < HEIGHT / 2 ? 0xff0000ff : 0x00ff00ff;
+
+        test_utils_compare_pixel (p, expected);
+      }
+
+  cogl_buffer_unmap (COGL_BUFFER (state->buffer));
+
+  g_main_loop_quit (state->loop);
+}
+
+void
+test_read_pixels_async (void)
+{
+  TestState state;
+  GSource *cogl_source;
+  CoglPipeline *red, *green;
+  CoglBitmap *bitmap;
+  CoglFenceClosure *closure;
+  CoglError *error = NULL;
+
+  cogl_source = cogl_glib_source_new (test_ctx, G_PRIORITY_DEFAULT);
+  g_source_attach (cogl_source, NULL);
+  state.loop = g_main_loop_new (NULL, TRUE);
+
+  cogl_framebuffer_orthographic (test_fb,
+                                 0, 0,
+                                 cogl_framebuffer_get_width (test_fb),
+                                 cogl_framebuffer_get_height (test_fb),
+                                 -1,
+                                 100);
+
+  red = cogl_pipeline_new (test_ctx);
+  cogl_pipeline_set_color4ub (red, 0xff, 0x00, 0x00, 0xff);
+  green = cogl_pipeline_new (test_ctx);
+  cogl_pipeline_set_color4ub (green, 0x00, 0xff, 0x00, 0xff);
+
+  cogl_framebuffer_draw_rectangle (test_fb, red,
+                                   0, 0, WIDTH, HEIGHT / 2);
+  cogl_framebuffer_draw_rectangle (test_fb, green,
+                                   0, HEIGHT / 2, WIDTH, HEIGHT);
+
+  state.buffer = cogl_pixel_buffer_new (test_ctx, WIDTH * HEIGHT * 4, NULL);
+  bitmap = cogl_bitmap_new_from_buffer (COGL_BUFFER (state.buffer),
+                                        COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                        WIDTH, HEIGHT,
+                                        WIDTH * 4, /* rowstride */
+                                        0 /* offset */);
+
+  closure = cogl_framebuffer_read_pixels_async (test_fb,
+                                                0, 0,
+                                                COGL_READ_PIXELS_COLOR_BUFFER,
+                                                bitmap,
+                                                read_callback,
+                                                &state,
+                                                &error);
+  g_assert (error == NULL);
+  g_assert (closure != NULL);
+
+  /* The closure keeps its own reference on the bitmap */
+  cogl_object_unref (bitmap);
+
+  g_timeout_add_seconds (5, timeout, NULL);
+
+  g_main_loop_run (state.loop);
+
+  cogl_object_unref (state.buffer);
+  cogl_object_unref (green);
+  cogl_object_unref (red);
+  g_main_loop_unref (state.loop);
+  g_source_destroy (cogl_source);
+  g_source_unref (cogl_source);
+
+  if (cogl_test_verbose ())
+    g_print ("OK\n");
+}
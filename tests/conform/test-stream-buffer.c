@@ -0,0 +1,146 @@
+#include <cogl/cogl.h>
+
+#include "test-utils.h"
+
+/* Each frame draws a block of single pixel rectangles through the
+ * journal and a polygon with enough vertices that it is drawn
+ * directly. Each frame uploads a couple of hundred kilobytes of
+ * vertices so over all of the frames the 4MB stream buffer has to
+ * wrap around several times. The pixels are checked after every
+ * frame so that any data that was overwritten too early would show
+ * up */
+#define N_FRAMES 96
+#define N_BLOCKS 16
+#define BLOCK_SIZE 64
+#define N_POLYGON_VERTICES 128
+
+static uint32_t
+get_color (int frame)
+{
+  return (((frame * 16) & 0xff) << 24 |
+          ((255 - frame * 8) & 0xff) << 16 |
+          ((frame * 5 + 32) & 0xff) << 8 |
+          0xff);
+}
+
+static void
+get_block_position (int frame,
+                    int *x,
+                    int *y)
+{
+  int block = frame % N_BLOCKS;
+
+  *x = (block % 8) * BLOCK_SIZE;
+  *y = (block / 8) * BLOCK_SIZE * 2;
+}
+
+static void
+draw_frame (int frame)
+{
+  uint32_t color = get_color (frame);
+  CoglTextureVertex verts[N_POLYGON_VERTICES];
+  CoglPipeline *pipeline;
+  int block_x, block_y;
+  int x, y, i;
+
+  get_block_position (frame, &block_x, &block_y);
+
+  pipeline = cogl_pipeline_new (test_ctx);
+  cogl_pipeline_set_color4ub (pipeline,
+                              color >> 24,
+                              color >> 16,
+                              color >> 8,
+                              color);
+
+  for (y = 0; y < BLOCK_SIZE; y++)
+    for (x = 0; x < BLOCK_SIZE; x++)
+      cogl_framebuffer_draw_rectangle (test_fb,
+                                       pipeline,
+                                       block_x + x,
+                                       block_y + y,
+                                       block_x + x + 1,
+                                       block_y + y + 1);
+
+  cogl_object_unref (pipeline);
+
+  /* Walk around the edge of a square below the rectangles */
+  for (i = 0; i < N_POLYGON_VERTICES; i++)
+    {
+      int side = i / (N_POLYGON_VERTICES / 4);
+      float t = ((i % (N_POLYGON_VERTICES / 4)) * BLOCK_SIZE /
+                 (float) (N_POLYGON_VERTICES / 4));
+
+      switch (side)
+        {
+        case 0:
+          verts[i].x = t;
+          verts[i].y = 0;
+          break;
+        case 1:
+          verts[i].x = BLOCK_SIZE;
+          verts[i].y = t;
+          break;
+        case 2:
+          verts[i].x = BLOCK_SIZE - t;
+          verts[i].y = BLOCK_SIZE;
+          break;
+        default:
+          verts[i].x = 0;
+          verts[i].y = BLOCK_SIZE - t;
+          break;
+        }
+
+      verts[i].x += block_x;
+      verts[i].y += block_y + BLOCK_SIZE;
+      verts[i].z = 0;
+      verts[i].tx = 0;
+      verts[i].ty = 0;
+    }
+
+  cogl_push_framebuffer (test_fb);
+  cogl_set_source_color4ub (color >> 24,
+                            color >> 16,
+                            color >> 8,
+                            color);
+  cogl_polygon (verts, N_POLYGON_VERTICES, FALSE);
+  cogl_pop_framebuffer ();
+}
+
+void
+test_stream_buffer (void)
+{
+  int frame;
+
+  cogl_framebuffer_orthographic (test_fb,
+                                 0, 0,
+                                 cogl_framebuffer_get_width (test_fb),
+                                 cogl_framebuffer_get_height (test_fb),
+                                 -1,
+                                 100);
+
+  for (frame = 0; frame < N_FRAMES; frame++)
+    {
+      uint32_t color = get_color (frame);
+      int block_x, block_y;
+
+      draw_frame (frame);
+
+      /* Reading back flushes the journal so each frame is a separate
+       * upload. The block was last drawn N_BLOCKS frames ago with a
+       * different color */
+      get_block_position (frame, &block_x, &block_y);
+
+      test_utils_check_pixel (test_fb, block_x + 1, block_y + 1, color);
+      test_utils_check_pixel (test_fb,
+                              block_x + BLOCK_SIZE - 2,
+                              block_y + BLOCK_SIZE - 2,
+                              color);
+      test_utils_check_pixel (test_fb,
+                              block_x + BLOCK_SIZE / 2,
+                              block_y + BLOCK_SIZE * 3 / 2,
+                              color);
+    }
+
+  if (cogl_test_verbose ())
+    g_print ("OK\n");
+}
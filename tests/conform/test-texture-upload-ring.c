@@ -0,0 +1,116 @@
+#include <cogl/cogl.h>
+
+#include <string.h>
+
+#include "test-utils.h"
+
+/* Each update writes to a separate cell of the texture. There are
+ * three times as many updates as slots in the upload ring and nothing
+ * waits for the GPU in between, so the ring has to cope with slots
+ * that are still busy */
+#define CELL_SIZE 16
+#define N_CELLS_X 8
+#define N_CELLS_Y 3
+#define N_UPDATES (N_CELLS_X * N_CELLS_Y)
+
+static void
+fill_data (uint8_t *data,
+           uint32_t color,
+           int rowstride)
+{
+  int x, y;
+
+  for (y = 0; y < CELL_SIZE; y++)
+    for (x = 0; x < CELL_SIZE; x++)
+      {
+        uint8_t *p = data + y * rowstride + x * 4;
+
+        p[0] = color >> 24;
+        p[1] = color >> 16;
+        p[2] = color >> 8;
+        p[3] = color;
+      }
+}
+
+static uint32_t
+get_color (int update)
+{
+  /* An opaque color that is different for each update */
+  return (((update * 40) & 0xff) << 24 |
+          ((255 - update * 10) & 0xff) << 16 |
+          ((update * 7) & 0xff) << 8 |
+          0xff);
+}
+
+void
+test_texture_upload_ring (void)
+{
+  /* Use a padded rowstride for the odd updates to check that the
+   * data is repacked correctly */
+  int rowstride = CELL_SIZE * 4 + 16;
+  uint8_t *data = g_malloc (rowstride * CELL_SIZE);
+  CoglTexture2D *tex_2d;
+  CoglPipeline *pipeline;
+  int i;
+
+  cogl_framebuffer_orthographic (test_fb,
+                                 0, 0,
+                                 cogl_framebuffer_get_width (test_fb),
+                                 cogl_framebuffer_get_height (test_fb),
+                                 -1,
+                                 100);
+
+  tex_2d = cogl_texture_2d_new_with_size (test_ctx,
+                                          CELL_SIZE * N_CELLS_X,
+                                          CELL_SIZE * N_CELLS_Y,
+                                          COGL_PIXEL_FORMAT_RGBA_8888_PRE);
+
+  pipeline = cogl_pipeline_new (test_ctx);
+  cogl_pipeline_set_layer_texture (pipeline, 0, COGL_TEXTURE (tex_2d));
+  cogl_pipeline_set_layer_filters (pipeline, 0,
+                                   COGL_PIPELINE_FILTER_NEAREST,
+                                   COGL_PIPELINE_FILTER_NEAREST);
+
+  for (i = 0; i < N_UPDATES; i++)
+    {
+      uint32_t color = get_color (i);
+      int update_rowstride = (i & 1) ? rowstride : CELL_SIZE * 4;
+      CoglBool status;
+
+      fill_data (data, color, update_rowstride);
+
+      status = cogl_texture_set_region (COGL_TEXTURE (tex_2d),
+                                        0, 0, /* src_x/y */
+                                        (i % N_CELLS_X) * CELL_SIZE,
+                                        (i / N_CELLS_X) * CELL_SIZE,
+                                        CELL_SIZE, CELL_SIZE,
+                                        CELL_SIZE, CELL_SIZE,
+                                        COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                        update_rowstride,
+                                        data);
+      g_assert (status);
+
+      /* Clobber the data to make sure the texture doesn't depend on
+       * it after the upload */
+      memset (data, 0, rowstride * CELL_SIZE);
+    }
+
+  cogl_framebuffer_draw_rectangle (test_fb, pipeline,
+                                   0, 0,
+                                   CELL_SIZE * N_CELLS_X,
+                                   CELL_SIZE * N_CELLS_Y);
+
+  for (i = 0; i < N_UPDATES; i++)
+    test_utils_check_region (test_fb,
+                             (i % N_CELLS_X) * CELL_SIZE + 1,
+                             (i / N_CELLS_X) * CELL_SIZE + 1,
+                             CELL_SIZE - 2, CELL_SIZE - 2,
+                             get_color (i));
+
+  cogl_object_unref (pipeline);
+  cogl_object_unref (tex_2d);
+  g_free (data);
+
+  if (cogl_test_verbose ())
+    g_print ("OK\n");
+}